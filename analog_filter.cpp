@@ -0,0 +1,34 @@
+// *****************************************************************************
+// Analog stick/trigger decimation
+// *****************************************************************************
+
+#include "analog_filter.h"
+
+void analog_decimate_block(const uint16_t *block, uint8_t oversample_log2, uint16_t *out)
+{
+    uint32_t sum[ANALOG_ADC_CHANNELS] = {0};
+    uint32_t rounds = 1u << oversample_log2;
+    const uint16_t *sample = block + ANALOG_SETTLE_ROUNDS * ANALOG_ADC_CHANNELS;
+
+    for (uint32_t round = 0; round < rounds; round++) {
+        for (uint32_t channel = 0; channel < ANALOG_ADC_CHANNELS; channel++) {
+            sum[channel] += *sample++ & 0x0FFF;
+        }
+    }
+
+    // The sum has 12 + oversample_log2 significant bits; scale to 16
+    for (uint32_t channel = 0; channel < ANALOG_ADC_CHANNELS; channel++) {
+        uint32_t bits = 12 + oversample_log2;
+        out[channel] = (uint16_t)(bits >= 16 ? sum[channel] >> (bits - 16) : sum[channel] << (16 - bits));
+    }
+}
+
+void analog_frame_apply(const analog_frame_t *frame, gamepad_report_t *report)
+{
+    report->left_x = (int16_t)(frame->value[ANALOG_LEFT_X] - 32768);
+    report->left_y = (int16_t)(frame->value[ANALOG_LEFT_Y] - 32768);
+    report->right_x = (int16_t)(frame->value[ANALOG_RIGHT_X] - 32768);
+    report->right_y = (int16_t)(frame->value[ANALOG_RIGHT_Y] - 32768);
+    report->left_trigger = (uint8_t)(frame->value[ANALOG_LEFT_TRIGGER] >> 8);
+    report->right_trigger = (uint8_t)(frame->value[ANALOG_RIGHT_TRIGGER] >> 8);
+}
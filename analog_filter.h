@@ -0,0 +1,61 @@
+// *****************************************************************************
+// Analog stick/trigger decimation
+//
+// The RP2040 ADC runs free in round-robin mode and DMA fills one block per
+// mux bank: ANALOG_SETTLE_ROUNDS discarded rounds followed by 2^oversample
+// rounds of ANALOG_ADC_CHANNELS interleaved 12-bit samples. Each channel is
+// summed over the kept rounds and scaled to a 16-bit value, which is where
+// the extra resolution over a single 12-bit conversion comes from.
+//
+// Pure integer code with no hardware access, so it runs on the host against
+// recorded sample buffers.
+// *****************************************************************************
+
+#ifndef ANALOG_FILTER_H
+#define ANALOG_FILTER_H
+
+#include <stdint.h>
+
+#include "gamepad.h"
+
+// ADC inputs used in round-robin (ADC0..ADC2 = GPIO26..28; ADC3 is VSYS on Pico W)
+#define ANALOG_ADC_CHANNELS    3
+
+// An external 2:1 analog mux doubles the inputs: bank A, then bank B
+#define ANALOG_BANKS           2
+#define ANALOG_NUM_CHANNELS    (ANALOG_ADC_CHANNELS * ANALOG_BANKS)
+
+// Rounds at the start of each block sampled while the mux was switching
+#ifndef ANALOG_SETTLE_ROUNDS
+#define ANALOG_SETTLE_ROUNDS   2
+#endif
+
+// Logical channels: bank * ANALOG_ADC_CHANNELS + ADC input
+enum {
+    ANALOG_LEFT_X = 0,          // Bank A, ADC0
+    ANALOG_LEFT_Y,              // Bank A, ADC1
+    ANALOG_LEFT_TRIGGER,        // Bank A, ADC2
+    ANALOG_RIGHT_X,             // Bank B, ADC0
+    ANALOG_RIGHT_Y,             // Bank B, ADC1
+    ANALOG_RIGHT_TRIGGER,       // Bank B, ADC2
+};
+
+typedef struct {
+    uint16_t value[ANALOG_NUM_CHANNELS];   // 0..65535, 32768 = mid-scale
+    uint32_t timestamp_us;                 // Completion of the last bank
+    uint32_t sequence;
+} analog_frame_t;
+
+// Samples in one DMA block for the given oversampling
+static inline uint32_t analog_block_samples(uint8_t oversample_log2)
+{
+    return (uint32_t)(ANALOG_SETTLE_ROUNDS + (1u << oversample_log2)) * ANALOG_ADC_CHANNELS;
+}
+
+// Decimate one bank's block into ANALOG_ADC_CHANNELS 16-bit values
+void analog_decimate_block(const uint16_t *block, uint8_t oversample_log2, uint16_t *out);
+
+// Map a frame onto the stick and trigger fields of a report
+void analog_frame_apply(const analog_frame_t *frame, gamepad_report_t *report);
+
+#endif // ANALOG_FILTER_H
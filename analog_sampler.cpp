@@ -0,0 +1,285 @@
+// *****************************************************************************
+// ADC acquisition for sticks and triggers (RP2040)
+// *****************************************************************************
+
+#include <atomic>
+
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+
+#include "analog_filter.h"
+#include "analog_sampler.h"
+#include "gamepad_config.h"
+
+// Core1's DMA IRQ line; core0 has DMA_IRQ_0 (imu_sampler.cpp)
+#define ANALOG_DMA_IRQ          1
+#define ANALOG_ADC_GPIO_BASE    26
+#define ANALOG_ADC_CLOCK_HZ     48000000u
+#define ANALOG_ADC_MAX_RATE     500000u
+
+#define ANALOG_BLOCK_SAMPLES    ((ANALOG_SETTLE_ROUNDS + (1u << ANALOG_OVERSAMPLE_LOG2)) * ANALOG_ADC_CHANNELS)
+#define ANALOG_CONVERSION_RATE  (ANALOG_FRAME_RATE_HZ * ANALOG_BANKS * ANALOG_BLOCK_SAMPLES)
+
+static_assert(ANALOG_OVERSAMPLE_LOG2 >= 2 && ANALOG_OVERSAMPLE_LOG2 <= 6, "oversampling must be 4x..64x");
+static_assert(ANALOG_CONVERSION_RATE <= ANALOG_ADC_MAX_RATE,
+              "ANALOG_FRAME_RATE_HZ too high for this oversampling ratio");
+
+static uint16_t blocks[ANALOG_BANKS][ANALOG_BLOCK_SAMPLES];
+static int dma_channel[ANALOG_BANKS];
+static uint16_t frame_values[ANALOG_NUM_CHANNELS];
+
+// Latest frame, published under a sequence lock: odd while being written
+static analog_frame_t latest_frame;
+static std::atomic<uint32_t> latest_sequence;
+
+static std::atomic<bool> started;
+
+// Conversion of another input between frames: requested by core0, the last
+// bank's DMA unchained by the first bank's interrupt, run by the last's
+static uint8_t convert_input;
+static uint8_t convert_samples;
+static uint32_t convert_sum;
+static std::atomic<bool> convert_requested;
+static std::atomic<bool> convert_done;
+static bool convert_armed;
+
+// Flash writes on core0 stop the chain (analog_sampler_pause()): parked by
+// the multicore lockout, core1 takes no interrupt to re-arm a finished bank,
+// and the next trigger would fill it on from where it ended
+static std::atomic<bool> paused;
+static std::atomic<bool> in_interrupt;
+
+static void analog_set_chain(int bank, int to)
+{
+    dma_channel_config config = dma_get_channel_config(dma_channel[bank]);
+    channel_config_set_chain_to(&config, dma_channel[to]);
+    dma_channel_set_config(dma_channel[bank], &config, false);
+}
+
+static uint32_t analog_convert_once(uint8_t input, uint8_t samples)
+{
+    adc_select_input(input);
+    // The sample capacitor still holds the previous input's voltage
+    (void)adc_read();
+    uint32_t sum = 0;
+    for (int i = 0; i < samples; i++) {
+        sum += adc_read();
+    }
+    return sum;
+}
+
+// Between frames: the last bank did not chain, so no DMA drains the FIFO
+static void analog_convert_between_frames(void)
+{
+    adc_run(false);
+    while (!(adc_hw->cs & ADC_CS_READY_BITS)) {
+        tight_loop_contents();
+    }
+    hw_clear_bits(&adc_hw->fcs, ADC_FCS_EN_BITS);
+    adc_fifo_drain();
+    adc_set_round_robin(0);
+
+    convert_sum = analog_convert_once(convert_input, convert_samples);
+    convert_armed = false;
+    convert_requested.store(false, std::memory_order_relaxed);
+    convert_done.store(true, std::memory_order_release);
+
+    // The next frame starts over at ADC0 with the first bank
+    adc_select_input(0);
+    adc_set_round_robin((1u << ANALOG_ADC_CHANNELS) - 1);
+    hw_set_bits(&adc_hw->fcs, ADC_FCS_EN_BITS);
+    analog_set_chain(ANALOG_BANKS - 1, 0);
+    dma_channel_start(dma_channel[0]);
+    adc_run(true);
+}
+
+static void analog_publish_frame(void)
+{
+    uint32_t sequence = latest_sequence.load(std::memory_order_relaxed);
+    latest_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (int i = 0; i < ANALOG_NUM_CHANNELS; i++) {
+        latest_frame.value[i] = frame_values[i];
+    }
+    latest_frame.timestamp_us = time_us_32();
+    latest_frame.sequence = (sequence + 2) / 2;
+
+    latest_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static void analog_block_complete(int bank)
+{
+    // The other bank's block is already filling; switch the mux now so its
+    // settle rounds absorb the transition
+    gpio_put(ANALOG_MUX_GPIO, bank == 0);
+
+    // Re-arm for the next chain trigger (the transfer count reloads itself)
+    dma_channel_set_write_addr(dma_channel[bank], blocks[bank], false);
+
+    // The last bank is filling now; unchained, the frame ends with it
+    if (bank == 0 && !convert_armed && convert_requested.load(std::memory_order_acquire)) {
+        analog_set_chain(ANALOG_BANKS - 1, ANALOG_BANKS - 1);
+        convert_armed = true;
+    }
+
+    analog_decimate_block(blocks[bank], ANALOG_OVERSAMPLE_LOG2, &frame_values[bank * ANALOG_ADC_CHANNELS]);
+    if (bank == ANALOG_BANKS - 1) {
+        analog_publish_frame();
+        if (convert_armed) {
+            analog_convert_between_frames();
+        }
+    }
+}
+
+static void analog_dma_irq_handler(void)
+{
+    // Sequentially consistent with analog_sampler_pause(): either it sees
+    // this interrupt running or this interrupt sees the pause
+    in_interrupt.store(true);
+    bool stopping = paused.load();
+    for (int bank = 0; bank < ANALOG_BANKS; bank++) {
+        if (dma_irqn_get_channel_status(ANALOG_DMA_IRQ, dma_channel[bank])) {
+            dma_irqn_acknowledge_channel(ANALOG_DMA_IRQ, dma_channel[bank]);
+            if (!stopping) {
+                analog_block_complete(bank);
+            }
+        }
+    }
+    in_interrupt.store(false, std::memory_order_release);
+}
+
+void analog_sampler_start(void)
+{
+    gpio_init(ANALOG_MUX_GPIO);
+    gpio_set_dir(ANALOG_MUX_GPIO, GPIO_OUT);
+    gpio_put(ANALOG_MUX_GPIO, 0);
+
+    adc_init();
+    for (int input = 0; input < ANALOG_ADC_CHANNELS; input++) {
+        adc_gpio_init(ANALOG_ADC_GPIO_BASE + input);
+    }
+    adc_select_input(0);
+    adc_set_round_robin((1u << ANALOG_ADC_CHANNELS) - 1);
+    adc_fifo_setup(true, true, 1, false, false);
+    adc_set_clkdiv((float)ANALOG_ADC_CLOCK_HZ / ANALOG_CONVERSION_RATE - 1.0f);
+
+    for (int bank = 0; bank < ANALOG_BANKS; bank++) {
+        dma_channel[bank] = dma_claim_unused_channel(true);
+    }
+
+    // Bank A chains to bank B and back, so the FIFO is drained continuously
+    for (int bank = 0; bank < ANALOG_BANKS; bank++) {
+        dma_channel_config config = dma_channel_get_default_config(dma_channel[bank]);
+        channel_config_set_transfer_data_size(&config, DMA_SIZE_16);
+        channel_config_set_read_increment(&config, false);
+        channel_config_set_write_increment(&config, true);
+        channel_config_set_dreq(&config, DREQ_ADC);
+        channel_config_set_chain_to(&config, dma_channel[(bank + 1) % ANALOG_BANKS]);
+        dma_channel_configure(dma_channel[bank], &config, blocks[bank], &adc_hw->fifo, ANALOG_BLOCK_SAMPLES, false);
+        dma_irqn_set_channel_enabled(ANALOG_DMA_IRQ, dma_channel[bank], true);
+    }
+
+    irq_add_shared_handler(DMA_IRQ_0 + ANALOG_DMA_IRQ, analog_dma_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0 + ANALOG_DMA_IRQ, true);
+
+    dma_channel_start(dma_channel[0]);
+    adc_run(true);
+    started.store(true, std::memory_order_release);
+}
+
+void analog_sampler_pause(void)
+{
+    if (!started.load(std::memory_order_acquire)) return;
+    paused.store(true);
+    while (in_interrupt.load()) {
+        tight_loop_contents();
+    }
+
+    adc_run(false);
+    while (!(adc_hw->cs & ADC_CS_READY_BITS)) {
+        tight_loop_contents();
+    }
+    // Aborting can raise the completion interrupt (RP2040-E13); unchained,
+    // an aborted bank cannot start the other one either
+    uint32_t mask = 0;
+    for (int bank = 0; bank < ANALOG_BANKS; bank++) {
+        dma_irqn_set_channel_enabled(ANALOG_DMA_IRQ, dma_channel[bank], false);
+        analog_set_chain(bank, bank);
+        mask |= 1u << dma_channel[bank];
+    }
+    dma_hw->abort = mask;
+    for (int bank = 0; bank < ANALOG_BANKS; bank++) {
+        while (dma_channel_is_busy(dma_channel[bank])) {
+            tight_loop_contents();
+        }
+        dma_irqn_acknowledge_channel(ANALOG_DMA_IRQ, dma_channel[bank]);
+    }
+    adc_fifo_drain();
+}
+
+void analog_sampler_resume(void)
+{
+    if (!started.load(std::memory_order_acquire)) return;
+
+    // The interrupted frame is dropped; the next one starts over at ADC0
+    // with the first bank (the transfer counts reload on the trigger)
+    gpio_put(ANALOG_MUX_GPIO, 0);
+    for (int bank = 0; bank < ANALOG_BANKS; bank++) {
+        dma_channel_set_write_addr(dma_channel[bank], blocks[bank], false);
+        analog_set_chain(bank, (bank + 1) % ANALOG_BANKS);
+        dma_irqn_set_channel_enabled(ANALOG_DMA_IRQ, dma_channel[bank], true);
+    }
+    // A conversion armed for the end of the frame goes with it; its caller
+    // already gave up, flash writes run on the same core
+    convert_armed = false;
+    adc_select_input(0);
+
+    paused.store(false);
+    dma_channel_start(dma_channel[0]);
+    adc_run(true);
+}
+
+bool analog_sampler_read(analog_frame_t *frame)
+{
+    while (true) {
+        uint32_t before = latest_sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        *frame = latest_frame;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (latest_sequence.load(std::memory_order_relaxed) == before) {
+            return before != 0;
+        }
+    }
+}
+
+bool analog_sampler_convert(uint8_t input, uint8_t samples, uint32_t *sum)
+{
+    if (!started.load(std::memory_order_acquire)) {
+        // Nothing else uses the ADC
+        adc_init();
+        *sum = analog_convert_once(input, samples);
+        return true;
+    }
+
+    convert_input = input;
+    convert_samples = samples;
+    convert_done.store(false, std::memory_order_relaxed);
+    convert_requested.store(true, std::memory_order_release);
+    uint32_t start_us = time_us_32();
+    while (!convert_done.load(std::memory_order_acquire)) {
+        if (time_us_32() - start_us > 2000000u / ANALOG_FRAME_RATE_HZ) {
+            // Withdrawn unless the interrupt already armed it; then it runs
+            // at the end of this frame and its result is dropped
+            convert_requested.store(false, std::memory_order_relaxed);
+            return false;
+        }
+        tight_loop_contents();
+    }
+    *sum = convert_sum;
+    return true;
+}
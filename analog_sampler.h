@@ -0,0 +1,48 @@
+// *****************************************************************************
+// ADC acquisition for sticks and triggers (RP2040)
+//
+// The ADC free-runs in round-robin over ADC0..ADC2 and paces two chained
+// DMA channels, one per analog mux bank, so sampling never stops and no CPU
+// time is spent reading the FIFO. Each block completion interrupt flips the
+// mux, decimates the finished block (analog_filter) and, after the last
+// bank, publishes a complete frame. Readers take the latest frame at any
+// time without blocking the interrupt.
+//
+// Call analog_sampler_start() from the core that should take the DMA
+// interrupt (core1, from the input sampler).
+//
+// Other ADC inputs (VSYS for the battery) are converted between two
+// frames: the DMA chain stops after the last bank, the interrupt runs the
+// conversions and restarts it, so they never take a stick or trigger slot
+// and only delay the next frame by their own conversion time.
+//
+// Flash writes stop the sampler: core1 cannot take the DMA interrupt while
+// the multicore lockout parks it, so deferred_tlv.cpp pauses it first and
+// resumes it after, dropping the frame in progress.
+// *****************************************************************************
+
+#ifndef ANALOG_SAMPLER_H
+#define ANALOG_SAMPLER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "analog_filter.h"
+
+void analog_sampler_start(void);
+
+// Copy the newest complete frame; false until the first one is ready
+bool analog_sampler_read(analog_frame_t *frame);
+
+// Convert ADC input samples times and add up the results (core0). Between
+// frames once the sampler runs, blocking for up to two frames; at once
+// while it does not. False if the sampler did not get to it in time.
+bool analog_sampler_convert(uint8_t input, uint8_t samples, uint32_t *sum);
+
+// Stop the conversions and their DMA until analog_sampler_resume(), which
+// starts a new frame (core0, around flash writes). No-ops while the sampler
+// does not run.
+void analog_sampler_pause(void);
+void analog_sampler_resume(void);
+
+#endif // ANALOG_SAMPLER_H
@@ -0,0 +1,196 @@
+// *****************************************************************************
+// Stick and trigger processing
+// *****************************************************************************
+
+#include <string.h>
+
+#include "axis_processing.h"
+#include "gamepad_config.h"
+
+#define AXIS_FULL_SCALE 32767
+
+// Q16 factor mapping 0..range onto 0..full; range >= 1
+static uint32_t q16_scale(uint32_t full, uint32_t range)
+{
+    return (uint32_t)(((uint64_t)full << 16) / range);
+}
+
+// Bit-by-bit integer square root
+static uint32_t isqrt32(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > value) bit >>= 2;
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+void axis_curve_fill(uint16_t *curve, axis_curve_t shape)
+{
+    // Points run up to 32768 so the last segment has the same slope as the
+    // others; lookups clamp to full scale
+    for (uint32_t i = 0; i < AXIS_CURVE_POINTS; i++) {
+        uint32_t x = i << AXIS_CURVE_SHIFT;
+        switch (shape) {
+            case AXIS_CURVE_SQUARE:
+                x = (x * x) >> 15;
+                break;
+            case AXIS_CURVE_CUBE:
+                x = (((x * x) >> 15) * x) >> 15;
+                break;
+            case AXIS_CURVE_LINEAR:
+            default:
+                break;
+        }
+        curve[i] = (uint16_t)x;
+    }
+}
+
+void axis_profile_default(axis_profile_t *profile)
+{
+    memset(profile, 0, sizeof(*profile));
+    profile->version = AXIS_PROFILE_VERSION;
+    profile->radial_deadzone = AXIS_RADIAL_DEADZONE;
+    profile->axial_deadzone = AXIS_AXIAL_DEADZONE;
+    for (int axis = 0; axis < AXIS_STICK_AXES; axis++) {
+        profile->axes[axis].min = -32768;
+        profile->axes[axis].center = 0;
+        profile->axes[axis].max = 32767;
+    }
+    axis_curve_fill(profile->curve, AXIS_CURVE_LINEAR);
+    for (int trigger = 0; trigger < AXIS_TRIGGERS; trigger++) {
+        profile->trigger_low[trigger] = AXIS_TRIGGER_LOW;
+        profile->trigger_high[trigger] = AXIS_TRIGGER_HIGH;
+    }
+}
+
+int axis_profile_valid(const axis_profile_t *profile)
+{
+    if (profile->version != AXIS_PROFILE_VERSION) return 0;
+    if (profile->radial_deadzone >= AXIS_FULL_SCALE || profile->axial_deadzone >= AXIS_FULL_SCALE) return 0;
+    for (int axis = 0; axis < AXIS_STICK_AXES; axis++) {
+        const axis_calibration_t *calibration = &profile->axes[axis];
+        if (calibration->min >= calibration->center || calibration->center >= calibration->max) return 0;
+    }
+    for (int i = 0; i < AXIS_CURVE_POINTS; i++) {
+        if (profile->curve[i] > AXIS_FULL_SCALE + 1) return 0;
+        if (i > 0 && profile->curve[i] < profile->curve[i - 1]) return 0;
+    }
+    for (int trigger = 0; trigger < AXIS_TRIGGERS; trigger++) {
+        if (profile->trigger_low[trigger] >= profile->trigger_high[trigger]) return 0;
+    }
+    return 1;
+}
+
+void axis_processor_init(axis_processor_t *processor, const axis_profile_t *profile)
+{
+    memset(processor, 0, sizeof(*processor));
+    for (int axis = 0; axis < AXIS_STICK_AXES; axis++) {
+        const axis_calibration_t *calibration = &profile->axes[axis];
+        int32_t neg_range = (int32_t)calibration->center - calibration->min;
+        int32_t pos_range = (int32_t)calibration->max - calibration->center;
+        if (neg_range < 1) neg_range = 1;
+        if (pos_range < 1) pos_range = 1;
+        processor->axes[axis].center = calibration->center;
+        processor->axes[axis].neg_range = neg_range;
+        processor->axes[axis].pos_range = pos_range;
+        processor->axes[axis].neg_scale = q16_scale(AXIS_FULL_SCALE, (uint32_t)neg_range);
+        processor->axes[axis].pos_scale = q16_scale(AXIS_FULL_SCALE, (uint32_t)pos_range);
+    }
+    processor->axial_deadzone = profile->axial_deadzone;
+    processor->axial_scale = q16_scale(AXIS_FULL_SCALE, AXIS_FULL_SCALE - profile->axial_deadzone);
+    processor->radial_deadzone = profile->radial_deadzone;
+    processor->radial_deadzone_sq = (uint32_t)profile->radial_deadzone * profile->radial_deadzone;
+    processor->radial_scale = q16_scale(AXIS_FULL_SCALE, AXIS_FULL_SCALE - profile->radial_deadzone);
+    memcpy(processor->curve, profile->curve, sizeof(processor->curve));
+    for (int trigger = 0; trigger < AXIS_TRIGGERS; trigger++) {
+        uint8_t low = profile->trigger_low[trigger];
+        uint8_t high = profile->trigger_high[trigger];
+        if (high <= low) high = (uint8_t)(low + 1);
+        processor->trigger_low[trigger] = low;
+        processor->trigger_high[trigger] = high;
+        processor->trigger_scale[trigger] = q16_scale(255, (uint32_t)(high - low));
+    }
+}
+
+// Raw reading to -32767..32767 around the calibrated center. The deflection
+// is clamped to the calibrated range first, which keeps the Q16 product
+// within 32 bits.
+static int32_t axis_calibrate(const axis_processor_t *processor, int axis, int16_t raw)
+{
+    int32_t deflection = (int32_t)raw - processor->axes[axis].center;
+    if (deflection < 0) {
+        uint32_t magnitude = (uint32_t)-deflection;
+        if (magnitude > (uint32_t)processor->axes[axis].neg_range) magnitude = (uint32_t)processor->axes[axis].neg_range;
+        return -(int32_t)((magnitude * processor->axes[axis].neg_scale + 0x8000) >> 16);
+    }
+    uint32_t magnitude = (uint32_t)deflection;
+    if (magnitude > (uint32_t)processor->axes[axis].pos_range) magnitude = (uint32_t)processor->axes[axis].pos_range;
+    return (int32_t)((magnitude * processor->axes[axis].pos_scale + 0x8000) >> 16);
+}
+
+// Drop the band around center and stretch the rest back to full scale
+static int32_t axis_axial_deadzone(const axis_processor_t *processor, int32_t value)
+{
+    uint32_t magnitude = (uint32_t)(value < 0 ? -value : value);
+    if (magnitude <= processor->axial_deadzone) return 0;
+    magnitude = ((magnitude - processor->axial_deadzone) * processor->axial_scale + 0x8000) >> 16;
+    return value < 0 ? -(int32_t)magnitude : (int32_t)magnitude;
+}
+
+// Linear interpolation between curve points
+static uint32_t axis_curve_lookup(const axis_processor_t *processor, uint32_t deflection)
+{
+    uint32_t index = deflection >> AXIS_CURVE_SHIFT;
+    int32_t fraction = (int32_t)(deflection & ((1u << AXIS_CURVE_SHIFT) - 1));
+    int32_t low = processor->curve[index];
+    int32_t high = processor->curve[index + 1];
+    int32_t value = low + (((high - low) * fraction + (1 << (AXIS_CURVE_SHIFT - 1))) >> AXIS_CURVE_SHIFT);
+    return value > AXIS_FULL_SCALE ? AXIS_FULL_SCALE : (uint32_t)value;
+}
+
+// Radial deadzone and response curve on the stick's deflection; the
+// direction is kept and corners are pulled in to the unit circle
+static void axis_process_stick(const axis_processor_t *processor, int axis_x, int16_t *x_out, int16_t *y_out)
+{
+    int32_t x = axis_axial_deadzone(processor, axis_calibrate(processor, axis_x, *x_out));
+    int32_t y = axis_axial_deadzone(processor, axis_calibrate(processor, axis_x + 1, *y_out));
+
+    uint32_t magnitude_sq = (uint32_t)(x * x) + (uint32_t)(y * y);
+    if (magnitude_sq <= processor->radial_deadzone_sq) {
+        *x_out = 0;
+        *y_out = 0;
+        return;
+    }
+    uint32_t magnitude = isqrt32(magnitude_sq);
+    uint32_t deflection = magnitude > AXIS_FULL_SCALE ? AXIS_FULL_SCALE : magnitude;
+    deflection = ((deflection - processor->radial_deadzone) * processor->radial_scale + 0x8000) >> 16;
+    int32_t output = (int32_t)axis_curve_lookup(processor, deflection);
+
+    *x_out = (int16_t)(x * output / (int32_t)magnitude);
+    *y_out = (int16_t)(y * output / (int32_t)magnitude);
+}
+
+static uint8_t axis_process_trigger(const axis_processor_t *processor, int trigger, uint8_t raw)
+{
+    if (raw <= processor->trigger_low[trigger]) return 0;
+    if (raw >= processor->trigger_high[trigger]) return 255;
+    return (uint8_t)(((uint32_t)(raw - processor->trigger_low[trigger]) * processor->trigger_scale[trigger] + 0x8000) >>
+                     16);
+}
+
+void axis_process(const axis_processor_t *processor, gamepad_report_t *report)
+{
+    axis_process_stick(processor, AXIS_LEFT_X, &report->left_x, &report->left_y);
+    axis_process_stick(processor, AXIS_RIGHT_X, &report->right_x, &report->right_y);
+    report->left_trigger = axis_process_trigger(processor, 0, report->left_trigger);
+    report->right_trigger = axis_process_trigger(processor, 1, report->right_trigger);
+}
@@ -0,0 +1,101 @@
+// *****************************************************************************
+// Stick and trigger processing
+//
+// Turns raw axis readings into what the host should see: per-axis
+// center/min/max calibration, an axial deadzone per axis, a radial deadzone
+// per stick, a response curve applied to the stick's deflection (so the
+// direction is kept) and release/full-press thresholds for the triggers.
+//
+// A profile holds the user-facing settings. axis_processor_init() turns it
+// into fixed-point factors once, so processing a sample is integer
+// multiplies, shifts and one divide per stick; no floating point (the
+// Cortex-M0+ has no FPU). Centered sticks inside the deadzone come out as
+// exactly zero, so ADC noise at rest does not produce reports.
+//
+// Pure integer code with no hardware access; it runs on the host too.
+// *****************************************************************************
+
+#ifndef AXIS_PROCESSING_H
+#define AXIS_PROCESSING_H
+
+#include <stdint.h>
+
+#include "gamepad.h"
+
+// Bump when axis_profile_t changes; stored profiles of another version are ignored
+#define AXIS_PROFILE_VERSION 1
+
+// Stick axes in profile order
+enum {
+    AXIS_LEFT_X = 0,
+    AXIS_LEFT_Y,
+    AXIS_RIGHT_X,
+    AXIS_RIGHT_Y,
+    AXIS_STICK_AXES
+};
+
+#define AXIS_TRIGGERS 2
+
+// Response curve: output deflection (0..32768) at input 0, 2048, ... 32768
+#define AXIS_CURVE_SHIFT  11
+#define AXIS_CURVE_POINTS ((32768 >> AXIS_CURVE_SHIFT) + 1)
+
+// Built-in curves for axis_curve_fill()
+typedef enum {
+    AXIS_CURVE_LINEAR = 0,
+    AXIS_CURVE_SQUARE,           // Finer control near center
+    AXIS_CURVE_CUBE,
+} axis_curve_t;
+
+typedef struct {
+    int16_t min;                 // Raw reading at full negative deflection
+    int16_t center;              // Raw reading at rest
+    int16_t max;                 // Raw reading at full positive deflection
+} axis_calibration_t;
+
+typedef struct {
+    uint16_t version;            // AXIS_PROFILE_VERSION
+    uint16_t radial_deadzone;    // Stick deflection read as centered (0..32767)
+    uint16_t axial_deadzone;     // Per-axis band around center (0..32767)
+    axis_calibration_t axes[AXIS_STICK_AXES];
+    uint16_t curve[AXIS_CURVE_POINTS];
+    uint8_t trigger_low[AXIS_TRIGGERS];   // At or below: released
+    uint8_t trigger_high[AXIS_TRIGGERS];  // At or above: fully pressed
+} axis_profile_t;
+
+// Fixed-point form of a profile, built by axis_processor_init()
+typedef struct {
+    struct {
+        int16_t center;
+        int32_t neg_range;       // center - min, at least 1
+        int32_t pos_range;       // max - center, at least 1
+        uint32_t neg_scale;      // Q16: 32767 / neg_range
+        uint32_t pos_scale;      // Q16: 32767 / pos_range
+    } axes[AXIS_STICK_AXES];
+    uint16_t axial_deadzone;
+    uint32_t axial_scale;        // Q16: 32767 / (32767 - axial_deadzone)
+    uint16_t radial_deadzone;
+    uint32_t radial_deadzone_sq;
+    uint32_t radial_scale;       // Q16: 32767 / (32767 - radial_deadzone)
+    uint16_t curve[AXIS_CURVE_POINTS];
+    uint8_t trigger_low[AXIS_TRIGGERS];
+    uint8_t trigger_high[AXIS_TRIGGERS];
+    uint32_t trigger_scale[AXIS_TRIGGERS];  // Q16: 255 / (high - low)
+} axis_processor_t;
+
+// Fill a curve with one of the built-in shapes
+void axis_curve_fill(uint16_t *curve, axis_curve_t shape);
+
+// Defaults from gamepad_config.h: full-range calibration, AXIS_*_DEADZONE,
+// linear curve and AXIS_TRIGGER_LOW/HIGH thresholds
+void axis_profile_default(axis_profile_t *profile);
+
+// Returns 1 if the profile is of this version and its values make sense
+int axis_profile_valid(const axis_profile_t *profile);
+
+void axis_processor_init(axis_processor_t *processor, const axis_profile_t *profile);
+
+// Process sticks and triggers of a report in place
+void axis_process(const axis_processor_t *processor, gamepad_report_t *report);
+
+#endif // AXIS_PROCESSING_H
@@ -0,0 +1,103 @@
+// *****************************************************************************
+// Stick and trigger profiles in flash
+// *****************************************************************************
+
+#include <atomic>
+#include <stdio.h>
+
+#include "btstack.h"
+#include "btstack_tlv.h"
+
+#include "axis_profiles.h"
+#include "gamepad_config.h"
+
+// TLV tag per player: 'A','X','P', player
+#define AXIS_PROFILE_TAG(player) (((uint32_t)'A' << 24) | ((uint32_t)'X' << 16) | ((uint32_t)'P' << 8) | (player))
+
+// Saving a profile must not stall input either
+static_assert(sizeof(axis_profile_t) <= DEFERRED_TLV_VALUE_SIZE, "Axis profile too large to stage");
+
+static axis_profile_t profiles[GAMEPAD_PLAYERS];
+
+// Two processors per player; the sampler uses the active one. Stores are
+// user-paced, far apart compared to one sample, so the idle half is never
+// still in use when it is rebuilt.
+static axis_processor_t processors[GAMEPAD_PLAYERS][2];
+static std::atomic<uint8_t> active_processor[GAMEPAD_PLAYERS];
+
+static void axis_profiles_publish(uint8_t player)
+{
+    uint8_t idle = active_processor[player].load(std::memory_order_relaxed) ^ 1;
+    axis_processor_init(&processors[player][idle], &profiles[player]);
+    active_processor[player].store(idle, std::memory_order_release);
+}
+
+static const btstack_tlv_t *axis_profiles_tlv(void **context)
+{
+    const btstack_tlv_t *tlv_impl = NULL;
+    btstack_tlv_get_instance(&tlv_impl, context);
+    return tlv_impl;
+}
+
+void axis_profiles_init(void)
+{
+    void *tlv_context = NULL;
+    const btstack_tlv_t *tlv_impl = axis_profiles_tlv(&tlv_context);
+
+    for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+        axis_profile_t stored;
+        int size = tlv_impl ? tlv_impl->get_tag(tlv_context, AXIS_PROFILE_TAG(player), (uint8_t *)&stored,
+                                                sizeof(stored))
+                            : 0;
+        if (size == (int)sizeof(stored) && axis_profile_valid(&stored)) {
+            profiles[player] = stored;
+            printf("Axis profile for player %u loaded\n", player + 1);
+        } else {
+            axis_profile_default(&profiles[player]);
+        }
+        axis_profiles_publish(player);
+    }
+}
+
+const axis_profile_t *axis_profiles_get(uint8_t player)
+{
+    return &profiles[player];
+}
+
+int axis_profiles_store(uint8_t player, const axis_profile_t *profile)
+{
+    if (player >= GAMEPAD_PLAYERS) return -1;
+    if (!axis_profile_valid(profile)) {
+        printf("Axis profile for player %u rejected\n", player + 1);
+        return -1;
+    }
+
+    void *tlv_context = NULL;
+    const btstack_tlv_t *tlv_impl = axis_profiles_tlv(&tlv_context);
+    if (!tlv_impl || tlv_impl->store_tag(tlv_context, AXIS_PROFILE_TAG(player), (const uint8_t *)profile,
+                                         sizeof(*profile)) != 0) {
+        printf("Axis profile for player %u not saved\n", player + 1);
+        return -1;
+    }
+    profiles[player] = *profile;
+    axis_profiles_publish(player);
+    return 0;
+}
+
+void axis_profiles_reset(uint8_t player)
+{
+    if (player >= GAMEPAD_PLAYERS) return;
+
+    void *tlv_context = NULL;
+    const btstack_tlv_t *tlv_impl = axis_profiles_tlv(&tlv_context);
+    if (tlv_impl) {
+        tlv_impl->delete_tag(tlv_context, AXIS_PROFILE_TAG(player));
+    }
+    axis_profile_default(&profiles[player]);
+    axis_profiles_publish(player);
+}
+
+const axis_processor_t *axis_profiles_processor(uint8_t player)
+{
+    return &processors[player][active_processor[player].load(std::memory_order_acquire)];
+}
@@ -0,0 +1,35 @@
+// *****************************************************************************
+// Stick and trigger profiles in flash
+//
+// One axis_profile_t per player, kept in BTstack's TLV store next to the
+// bonding keys and loaded at boot; players without a valid stored profile
+// use axis_profile_default(). The sampler on core1 processes every sample
+// with axis_profiles_processor(). A profile stored on core0 is built into
+// the idle half of a double buffer and then published, so the sampler never
+// sees a half-written processor.
+// *****************************************************************************
+
+#ifndef AXIS_PROFILES_H
+#define AXIS_PROFILES_H
+
+#include <stdint.h>
+
+#include "axis_processing.h"
+
+// Load all players' profiles; core0, after the TLV store is set up and
+// before the sampler starts
+void axis_profiles_init(void);
+
+const axis_profile_t *axis_profiles_get(uint8_t player);
+
+// Use and persist a profile. Returns 0 on success; an invalid profile or a
+// failed flash write is reported and leaves the active profile unchanged.
+int axis_profiles_store(uint8_t player, const axis_profile_t *profile);
+
+// Forget the stored profile and go back to the defaults
+void axis_profiles_reset(uint8_t player);
+
+// Processor for the player's current profile (any core)
+const axis_processor_t *axis_profiles_processor(uint8_t player);
+
+#endif // AXIS_PROFILES_H
@@ -0,0 +1,38 @@
+// *****************************************************************************
+// VSYS measurement (Pico W)
+// *****************************************************************************
+
+#include "pico/stdlib.h"
+#include "pico/cyw43_arch.h"
+#include "hardware/adc.h"
+
+#include "analog_sampler.h"
+#include "battery_adc.h"
+
+#ifndef PICO_VSYS_PIN
+#define PICO_VSYS_PIN 29
+#endif
+
+#define BATTERY_ADC_GPIO_BASE 26
+
+// Conversions per reading, 2 us each
+#define BATTERY_ADC_SAMPLES 8
+
+bool battery_adc_read_mv(uint16_t *mv)
+{
+#if CYW43_USES_VSYS_PIN
+    // The driver sets the pin up for SPI again before its next transfer
+    cyw43_thread_enter();
+#endif
+    adc_gpio_init(PICO_VSYS_PIN);
+    uint32_t sum = 0;
+    bool ok = analog_sampler_convert(PICO_VSYS_PIN - BATTERY_ADC_GPIO_BASE, BATTERY_ADC_SAMPLES, &sum);
+#if CYW43_USES_VSYS_PIN
+    cyw43_thread_exit();
+#endif
+    if (!ok) return false;
+
+    // 12-bit codes of VSYS / 3 against the 3.3 V reference
+    *mv = (uint16_t)(sum * 3u * 3300u / (4096u * BATTERY_ADC_SAMPLES));
+    return true;
+}
@@ -0,0 +1,20 @@
+// *****************************************************************************
+// VSYS measurement (Pico W)
+//
+// VSYS reaches ADC3 through a 1:3 divider on GPIO29, which the Pico W
+// shares with the CYW43's SPI clock: a reading holds the CYW43 driver off
+// the pin and goes through analog_sampler_convert(), so it never takes an
+// ADC slot from the sticks. The host build replaces this with a mock.
+// *****************************************************************************
+
+#ifndef BATTERY_ADC_H
+#define BATTERY_ADC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// VSYS in millivolts (core0, after cyw43_arch_init()); false if the
+// conversion could not run
+bool battery_adc_read_mv(uint16_t *mv);
+
+#endif // BATTERY_ADC_H
@@ -0,0 +1,135 @@
+// *****************************************************************************
+// Battery monitor
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "btstack.h"
+#include "ble/gatt-service/battery_service_server.h"
+#include "battery_adc.h"
+#include "battery_monitor.h"
+#include "gamepad_config.h"
+
+typedef struct {
+    uint16_t mv;
+    uint8_t percent;
+} curve_point_t;
+
+// Single LiPo cell at a light load, highest voltage first; linear between
+// points. A diode between cell and VSYS shifts it down by its drop.
+static const curve_point_t discharge_curve[] = {
+    { 4200, 100 },
+    { 4100, 90 },
+    { 4000, 79 },
+    { 3900, 64 },
+    { 3800, 50 },
+    { 3750, 40 },
+    { 3700, 30 },
+    { 3650, 20 },
+    { 3600, 12 },
+    { 3500, 5 },
+    { 3300, 0 },
+};
+
+#define CURVE_POINTS (sizeof(discharge_curve) / sizeof(discharge_curve[0]))
+
+static btstack_timer_source_t battery_timer;
+static battery_monitor_stats_t stats;
+
+// Filtered VSYS, mV << BATTERY_FILTER_SHIFT; 0 before the first reading
+static uint32_t filter_state;
+
+uint8_t battery_monitor_percent(uint16_t mv)
+{
+    if (mv >= discharge_curve[0].mv) return discharge_curve[0].percent;
+    for (unsigned i = 1; i < CURVE_POINTS; i++) {
+        const curve_point_t *upper = &discharge_curve[i - 1];
+        const curve_point_t *lower = &discharge_curve[i];
+        if (mv < lower->mv) continue;
+        uint32_t span = (uint32_t)(upper->percent - lower->percent) * (mv - lower->mv);
+        return (uint8_t)(lower->percent + span / (upper->mv - lower->mv));
+    }
+    return discharge_curve[CURVE_POINTS - 1].percent;
+}
+
+static bool battery_read(void)
+{
+    uint16_t mv;
+    if (!battery_adc_read_mv(&mv)) {
+        stats.failed++;
+        return false;
+    }
+    stats.readings++;
+    stats.vsys_mv = mv;
+    if (!filter_state) {
+        filter_state = (uint32_t)mv << BATTERY_FILTER_SHIFT;
+    } else {
+        filter_state += mv - (filter_state >> BATTERY_FILTER_SHIFT);
+    }
+    stats.filtered_mv = (uint16_t)(filter_state >> BATTERY_FILTER_SHIFT);
+    return true;
+}
+
+// The level only moves once the voltage is past the step by the hysteresis
+static uint8_t battery_level_for(uint16_t mv, uint8_t level)
+{
+    uint8_t lower = battery_monitor_percent(mv + BATTERY_HYSTERESIS_MV);
+    if (lower < level) return lower;
+    uint8_t higher = battery_monitor_percent(mv > BATTERY_HYSTERESIS_MV ? mv - BATTERY_HYSTERESIS_MV : 0);
+    if (higher > level) return higher;
+    return level;
+}
+
+static void battery_timer_handler(btstack_timer_source_t *ts)
+{
+    if (battery_read()) {
+        uint8_t level = battery_level_for(stats.filtered_mv, stats.level);
+        if (level != stats.level) {
+            stats.level = level;
+            stats.updates++;
+            battery_service_server_set_battery_value(level);
+        }
+    }
+    btstack_run_loop_set_timer(ts, BATTERY_SAMPLE_PERIOD_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+void battery_monitor_init(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    filter_state = 0;
+    // Until VSYS can be read, as before
+    stats.level = 100;
+    if (battery_read()) {
+        stats.level = battery_monitor_percent(stats.filtered_mv);
+    }
+
+    battery_timer.process = &battery_timer_handler;
+    btstack_run_loop_set_timer(&battery_timer, BATTERY_SAMPLE_PERIOD_MS);
+    btstack_run_loop_add_timer(&battery_timer);
+}
+
+uint8_t battery_monitor_level(void)
+{
+    return stats.level;
+}
+
+const battery_monitor_stats_t *battery_monitor_get_stats(void)
+{
+    return &stats;
+}
+
+void battery_monitor_reset_stats(void)
+{
+    stats.readings = 0;
+    stats.failed = 0;
+    stats.updates = 0;
+}
+
+void battery_monitor_dump(void)
+{
+    printf("Battery: %u %%, VSYS %u mV (filtered %u mV); %lu readings, %lu failed, %lu level changes\n",
+           stats.level, stats.vsys_mv, stats.filtered_mv, (unsigned long)stats.readings,
+           (unsigned long)stats.failed, (unsigned long)stats.updates);
+}
@@ -0,0 +1,41 @@
+// *****************************************************************************
+// Battery monitor
+//
+// Reads VSYS every BATTERY_SAMPLE_PERIOD_MS (battery_adc.h), smooths it
+// with an exponential filter and maps the result to a percentage through a
+// single-cell LiPo discharge curve. battery_service_server_set_battery_value()
+// is only called when that percentage changes, so subscribed hosts get one
+// notification per step and none in between; the filter and a hysteresis
+// of BATTERY_HYSTERESIS_MV around each step keep ADC noise and load
+// transients from flipping the level back and forth.
+// *****************************************************************************
+
+#ifndef BATTERY_MONITOR_H
+#define BATTERY_MONITOR_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t readings;
+    uint32_t failed;             // Readings the ADC could not take in time
+    uint32_t updates;            // Level changes passed to the Battery Service
+    uint16_t vsys_mv;            // Last reading
+    uint16_t filtered_mv;
+    uint8_t level;               // Percent, as reported
+} battery_monitor_stats_t;
+
+// Take the first reading and start the timer; before
+// battery_service_server_init(battery_monitor_level())
+void battery_monitor_init(void);
+
+uint8_t battery_monitor_level(void);
+
+// Percentage the discharge curve gives for a VSYS voltage
+uint8_t battery_monitor_percent(uint16_t mv);
+
+const battery_monitor_stats_t *battery_monitor_get_stats(void);
+void battery_monitor_reset_stats(void);
+
+void battery_monitor_dump(void);
+
+#endif // BATTERY_MONITOR_H
@@ -0,0 +1,92 @@
+// *****************************************************************************
+// Boot timeline
+// *****************************************************************************
+
+#include <stdio.h>
+
+#include "pico/time.h"
+
+#include "btstack.h"
+#include "boot_timeline.h"
+
+static const char *const mark_names[BOOT_MARK_COUNT] = {
+    "stdio",
+    "cyw43 driver",
+    "gatt/report path",
+    "console/core1",
+    "controller firmware",
+    "hci working",
+    "advertising",
+    "connected",
+    "encrypted",
+    "reporting",
+    "first report",
+};
+
+static uint32_t marks_us[BOOT_MARK_COUNT];
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size)
+{
+    UNUSED(channel);
+    UNUSED(size);
+
+    if (packet_type != HCI_EVENT_PACKET) return;
+
+    switch (hci_event_packet_get_type(packet)) {
+        case BTSTACK_EVENT_STATE:
+            if (btstack_event_state_get_state(packet) == HCI_STATE_WORKING) {
+                boot_timeline_mark(BOOT_MARK_HCI_WORKING);
+            }
+            break;
+
+        case HCI_EVENT_COMMAND_COMPLETE:
+            if (hci_event_command_complete_get_command_opcode(packet) == HCI_OPCODE_HCI_LE_SET_ADVERTISE_ENABLE) {
+                boot_timeline_mark(BOOT_MARK_ADVERTISING);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+void boot_timeline_init(void)
+{
+    hci_event_callback_registration.callback = &hci_event_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+}
+
+void boot_timeline_mark(boot_mark_t mark)
+{
+    if (mark >= BOOT_MARK_COUNT || marks_us[mark]) return;
+    uint32_t now_us = time_us_32();
+    marks_us[mark] = now_us ? now_us : 1;
+    if (mark == BOOT_MARK_FIRST_REPORT) {
+        boot_timeline_dump();
+    }
+}
+
+uint32_t boot_timeline_get(boot_mark_t mark)
+{
+    return mark < BOOT_MARK_COUNT ? marks_us[mark] : 0;
+}
+
+void boot_timeline_dump(void)
+{
+    printf("Boot timeline (ms since power-on, +ms for the phase):\n");
+    uint32_t previous_us = 0;
+    for (int mark = 0; mark < BOOT_MARK_COUNT; mark++) {
+        uint32_t mark_us = marks_us[mark];
+        if (!mark_us) {
+            printf("  %-20s -\n", mark_names[mark]);
+            continue;
+        }
+        uint32_t phase_us = mark_us > previous_us ? mark_us - previous_us : 0;
+        printf("  %-20s %5lu.%01lu  +%lu.%01lu\n", mark_names[mark], (unsigned long)(mark_us / 1000),
+               (unsigned long)(mark_us % 1000 / 100), (unsigned long)(phase_us / 1000),
+               (unsigned long)(phase_us % 1000 / 100));
+        previous_us = mark_us;
+    }
+}
@@ -0,0 +1,42 @@
+// *****************************************************************************
+// Boot timeline
+//
+// Timestamps (time_us_32(), i.e. since power-on) of each startup phase up to
+// the first input report a host receives. main() marks its phases, the HCI
+// events mark the controller's, reconnect.cpp marks the connection's. The
+// timeline is printed once the first report is out and on the console's
+// stats dump.
+// *****************************************************************************
+
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <stdint.h>
+
+typedef enum {
+    BOOT_MARK_STDIO = 0,     // stdio_init_all() done
+    BOOT_MARK_CYW43,         // cyw43_arch_init(): driver, BTstack run loop and TLV
+    BOOT_MARK_SETUP,         // GATT, SM, HIDS and report path set up
+    BOOT_MARK_CORE1,         // Console and core1 sampling started
+    BOOT_MARK_POWER_ON,      // hci_power_control() returned: firmware downloaded
+    BOOT_MARK_HCI_WORKING,   // Controller initialised
+    BOOT_MARK_ADVERTISING,   // Advertising enabled in the controller
+    BOOT_MARK_CONNECTED,
+    BOOT_MARK_ENCRYPTED,
+    BOOT_MARK_REPORTING,     // Input reports enabled, by the host or from the bond
+    BOOT_MARK_FIRST_REPORT,
+    BOOT_MARK_COUNT
+} boot_mark_t;
+
+// Register for the controller's events; call before hci_power_control()
+void boot_timeline_init(void);
+
+// Record the phase as reached now; later marks of the same phase are ignored
+void boot_timeline_mark(boot_mark_t mark);
+
+// Time of a phase, 0 if not reached
+uint32_t boot_timeline_get(boot_mark_t mark);
+
+void boot_timeline_dump(void);
+
+#endif // BOOT_TIMELINE_H
@@ -1,70 +1,58 @@
+// *****************************************************************************
+// BTstack configuration: HID peripheral profile
+//
+// Only what an LE HID gamepad uses: peripheral role, secure connections
+// with bonding, data length extension, no Classic, no LE central, no GATT
+// client, no L2CAP channels beyond the fixed LE ones. Buffers and pools are
+// sized from gamepad_config.h; pools not defined here are empty. The Pico
+// SDK example configuration is kept in btstack_config_generic.h and can be
+// selected with -DGAMEPAD_BTSTACK_PROFILE=generic to compare the two with
+// the memory_budget target.
+// *****************************************************************************
+
+#if GAMEPAD_BTSTACK_GENERIC
+#include "btstack_config_generic.h"
+#else
+
 #ifndef _PICO_BTSTACK_BTSTACK_CONFIG_H
 #define _PICO_BTSTACK_BTSTACK_CONFIG_H
 
-// BTstack features that can be enabled
-#define ENABLE_LOG_INFO
+#include "gamepad_config.h"
+
+// BTstack features that can be enabled; info logs would go out over USB
+// stdio from the report path
 #define ENABLE_LOG_ERROR
-#define ENABLE_PRINTF_HEXDUMP
-#define ENABLE_SCO_OVER_HCI
 
 #ifdef ENABLE_BLE
-#define ENABLE_GATT_CLIENT_PAIRING
-#define ENABLE_L2CAP_LE_CREDIT_BASED_FLOW_CONTROL_MODE
-#define ENABLE_LE_CENTRAL
 #define ENABLE_LE_DATA_LENGTH_EXTENSION
 #define ENABLE_LE_PERIPHERAL
 #define ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
 #define ENABLE_LE_SECURE_CONNECTIONS
 #endif
 
-#ifdef ENABLE_CLASSIC
-#define ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
-#define ENABLE_GOEP_L2CAP
-#endif
-
-#if defined (ENABLE_CLASSIC) && defined(ENABLE_BLE)
-#define ENABLE_CROSS_TRANSPORT_KEY_DERIVATION
-#endif
-
 // BTstack configuration. buffers, sizes, ...
+// One LINK_MAX_TX_OCTETS PDU: ATT MTU up to 247, enough for the motion
+// report (112). The incoming and outgoing packet buffers and each
+// connection's ATT request buffer are this size.
 #define HCI_OUTGOING_PRE_BUFFER_SIZE 4
-#define HCI_ACL_PAYLOAD_SIZE (1691 + 4)
+#define HCI_ACL_PAYLOAD_SIZE (247 + 4)
 #define HCI_ACL_CHUNK_SIZE_ALIGNMENT 4
-#define MAX_NR_AVDTP_CONNECTIONS 1
-#define MAX_NR_AVDTP_STREAM_ENDPOINTS 1
-#define MAX_NR_AVRCP_CONNECTIONS 2
-#define MAX_NR_BNEP_CHANNELS 1
-#define MAX_NR_BNEP_SERVICES 1
-#define MAX_NR_BTSTACK_LINK_KEY_DB_MEMORY_ENTRIES  2
-#define MAX_NR_GATT_CLIENTS 1
-#define MAX_NR_HCI_CONNECTIONS 2
-#define MAX_NR_HID_HOST_CONNECTIONS 1
-#define MAX_NR_HIDS_CLIENTS 1
-#define MAX_NR_HFP_CONNECTIONS 1
-#define MAX_NR_L2CAP_CHANNELS  4
-#define MAX_NR_L2CAP_SERVICES  3
-#define MAX_NR_RFCOMM_CHANNELS 1
-#define MAX_NR_RFCOMM_MULTIPLEXERS 1
-#define MAX_NR_RFCOMM_SERVICES 1
-#define MAX_NR_SERVICE_RECORD_ITEMS 4
+#define MAX_NR_HCI_CONNECTIONS GAMEPAD_MAX_CONNECTIONS
 #define MAX_NR_SM_LOOKUP_ENTRIES 3
-#define MAX_NR_WHITELIST_ENTRIES 16
-#define MAX_NR_LE_DEVICE_DB_ENTRIES 16
 
-// Limit number of ACL/SCO Buffer to use by stack to avoid cyw43 shared bus overrun
+// Limit number of ACL Buffer to use by stack to avoid cyw43 shared bus overrun
 #define MAX_NR_CONTROLLER_ACL_BUFFERS 3
-#define MAX_NR_CONTROLLER_SCO_PACKETS 3
 
-// Enable and configure HCI Controller to Host Flow Control to avoid cyw43 shared bus overrun
+// Enable and configure HCI Controller to Host Flow Control to avoid cyw43 shared bus overrun.
+// Host Buffer Size carries SCO values too; no SCO buffers are allocated.
 #define ENABLE_HCI_CONTROLLER_TO_HOST_FLOW_CONTROL
-#define HCI_HOST_ACL_PACKET_LEN 1024
+#define HCI_HOST_ACL_PACKET_LEN HCI_ACL_PAYLOAD_SIZE
 #define HCI_HOST_ACL_PACKET_NUM 3
 #define HCI_HOST_SCO_PACKET_LEN 120
 #define HCI_HOST_SCO_PACKET_NUM 3
 
-// Link Key DB and LE Device DB using TLV on top of Flash Sector interface
+// LE Device DB using TLV on top of Flash Sector interface
 #define NVM_NUM_DEVICE_DB_ENTRIES 16
-#define NVM_NUM_LINK_KEYS 16
 
 // We don't give btstack a malloc, so use a fixed-size ATT DB.
 #define MAX_ATT_DB_SIZE 512
@@ -75,15 +63,9 @@
 // map btstack_assert onto Pico SDK assert()
 #define HAVE_ASSERT
 
-// Some USB dongles take longer to respond to HCI reset (e.g. BCM20702A).
-#define HCI_RESET_RESEND_TIMEOUT_MS 1000
-
 #define ENABLE_SOFTWARE_AES128
 #define ENABLE_MICRO_ECC_FOR_LE_SECURE_CONNECTIONS
 
-#define HAVE_BTSTACK_STDIN
-
-// To get the audio demos working even with HCI dump at 115200, this truncates long ACL packets
-//#define HCI_DUMP_STDOUT_MAX_SIZE_ACL 100
+#endif // _PICO_BTSTACK_BTSTACK_CONFIG_H
 
-#endif // _PICO_BTSTACK_BTSTACK_CONFIG_H
\ No newline at end of file
+#endif // GAMEPAD_BTSTACK_GENERIC
@@ -0,0 +1,141 @@
+// *****************************************************************************
+// PIO button scanner (RP2040)
+// *****************************************************************************
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/timer.h"
+
+#include "button_scanner.h"
+#include "button_scanner.pio.h"
+#include "gamepad_config.h"
+#include "input_ring.h"
+
+#define BUTTON_COUNT           16
+// Core1's DMA IRQ line, shared with analog_sampler.cpp
+#define BUTTON_DMA_IRQ         1
+#define BUTTON_EVENT_RING_SIZE 16
+// Changes stamped by DMA and not yet taken by the interrupt; 64 changes are
+// well over a second of mashing buttons
+#define BUTTON_CHANGE_RING_SIZE 64
+
+static_assert(BUTTON_GPIO_BASE + BUTTON_COUNT <= ANALOG_MUX_GPIO, "button GPIOs overlap the analog mux, CYW43 or ADC pins");
+static_assert(BUTTON_DEBOUNCE_SAMPLES >= 1 && BUTTON_DEBOUNCE_SAMPLES <= 32, "debounce must be 1..32 samples");
+
+static_assert((BUTTON_CHANGE_RING_SIZE & (BUTTON_CHANGE_RING_SIZE - 1)) == 0, "DMA rings are a power of two");
+
+static PIO scanner_pio;
+static uint scanner_sm;
+
+// One DMA channel copies each state the PIO pushes, a second one chained to
+// it the timer right after, and chains back: a change keeps the time it was
+// pushed at however late the interrupt runs (core1 parked by a flash write).
+// The rings wrap in hardware; more changes than they hold between two
+// interrupts overwrite the oldest unnoticed.
+static uint32_t change_states[BUTTON_CHANGE_RING_SIZE] __attribute__((aligned(BUTTON_CHANGE_RING_SIZE * 4)));
+static uint32_t change_times[BUTTON_CHANGE_RING_SIZE] __attribute__((aligned(BUTTON_CHANGE_RING_SIZE * 4)));
+static int state_channel;
+static int time_channel;
+static uint32_t change_tail;        // Interrupt: next change to take
+
+// Filled by the DMA interrupt, drained by the sampling loop on the same core
+static spsc_ring<button_event_t, BUTTON_EVENT_RING_SIZE> events;
+static uint16_t queued_buttons;     // Interrupt: state of the newest queued event
+static uint16_t current_buttons;    // Sampling loop: state of the newest popped event
+static button_scanner_stats_t stats;
+
+static void button_scanner_irq_handler(void)
+{
+    if (!dma_irqn_get_channel_status(BUTTON_DMA_IRQ, time_channel)) return;
+    dma_irqn_acknowledge_channel(BUTTON_DMA_IRQ, time_channel);
+
+    // Every change before the time channel's write address has its time
+    uint32_t head = (uint32_t)(dma_hw->ch[time_channel].write_addr - (uintptr_t)change_times) / sizeof(uint32_t);
+    while (change_tail != head) {
+        // Buttons close to ground: a low pin is a pressed button
+        uint16_t buttons = (uint16_t)~change_states[change_tail];
+        uint32_t pushed_us = change_times[change_tail];
+        change_tail = (change_tail + 1) & (BUTTON_CHANGE_RING_SIZE - 1);
+        if (buttons == queued_buttons) {
+            stats.repeats++;
+            continue;
+        }
+        button_event_t event;
+        event.timestamp_us = pushed_us - BUTTON_SAMPLE_PERIOD_US * BUTTON_DEBOUNCE_SAMPLES;
+        event.buttons = buttons;
+        if (!events.push(event)) {
+            stats.dropped++;
+            continue;
+        }
+        queued_buttons = buttons;
+        stats.events++;
+    }
+}
+
+void button_scanner_start(void)
+{
+    for (uint pin = BUTTON_GPIO_BASE; pin < BUTTON_GPIO_BASE + BUTTON_COUNT; pin++) {
+        gpio_init(pin);
+        gpio_set_dir(pin, GPIO_IN);
+        gpio_pull_up(pin);
+    }
+
+    uint offset;
+    hard_assert(pio_claim_free_sm_and_add_program(&button_scanner_program, &scanner_pio, &scanner_sm, &offset));
+    for (uint pin = BUTTON_GPIO_BASE; pin < BUTTON_GPIO_BASE + BUTTON_COUNT; pin++) {
+        pio_gpio_init(scanner_pio, pin);
+    }
+    float clkdiv = (float)clock_get_hz(clk_sys) * BUTTON_SAMPLE_PERIOD_US /
+                   (1000000.0f * BUTTON_SCANNER_CYCLES_PER_SAMPLE);
+    button_scanner_program_init(scanner_pio, scanner_sm, offset, BUTTON_GPIO_BASE, clkdiv, BUTTON_DEBOUNCE_SAMPLES);
+
+    state_channel = dma_claim_unused_channel(true);
+    time_channel = dma_claim_unused_channel(true);
+
+    dma_channel_config config = dma_channel_get_default_config(time_channel);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, __builtin_ctz(sizeof(change_times)));
+    channel_config_set_chain_to(&config, state_channel);
+    dma_channel_configure(time_channel, &config, change_times, &timer_hw->timerawl, 1, false);
+    dma_irqn_set_channel_enabled(BUTTON_DMA_IRQ, time_channel, true);
+
+    config = dma_channel_get_default_config(state_channel);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_ring(&config, true, __builtin_ctz(sizeof(change_states)));
+    channel_config_set_dreq(&config, pio_get_dreq(scanner_pio, scanner_sm, false));
+    channel_config_set_chain_to(&config, time_channel);
+    dma_channel_configure(state_channel, &config, change_states, &scanner_pio->rxf[scanner_sm], 1, true);
+
+    irq_add_shared_handler(DMA_IRQ_0 + BUTTON_DMA_IRQ, button_scanner_irq_handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0 + BUTTON_DMA_IRQ, true);
+
+    pio_sm_set_enabled(scanner_pio, scanner_sm, true);
+}
+
+bool button_scanner_pop(button_event_t *event)
+{
+    if (!events.pop(*event)) return false;
+    current_buttons = event->buttons;
+    return true;
+}
+
+bool button_scanner_pending(void)
+{
+    return events.size() != 0;
+}
+
+uint16_t button_scanner_buttons(void)
+{
+    return current_buttons;
+}
+
+const button_scanner_stats_t *button_scanner_get_stats(void)
+{
+    return &stats;
+}
@@ -0,0 +1,46 @@
+// *****************************************************************************
+// PIO button scanner (RP2040)
+//
+// A PIO state machine samples the 16 button GPIOs in parallel every
+// BUTTON_SAMPLE_PERIOD_US, debounces them (BUTTON_DEBOUNCE_SAMPLES equal
+// samples) and pushes the new state to its RX FIFO only when it changes,
+// without any CPU time spent on polling or debouncing. DMA copies each
+// change and the timer next to it, so the timestamp does not depend on when
+// the CPU gets to it; the DMA interrupt queues it as a button event and the
+// input sampler takes events as they come instead of waiting for its next
+// period.
+//
+// Call button_scanner_start() from the core that should take the DMA
+// interrupt (core1, from the input sampler).
+// *****************************************************************************
+
+#ifndef BUTTON_SCANNER_H
+#define BUTTON_SCANNER_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t timestamp_us;     // When the contact settled: pushed by the PIO minus the debounce time
+    uint16_t buttons;          // GAMEPAD_BUTTON_* bits, 1 = pressed
+} button_event_t;
+
+typedef struct {
+    uint32_t events;           // State changes queued
+    uint32_t dropped;          // Event queue full, change lost (a later one carries the state)
+    uint32_t repeats;          // Bounces that settled back to the previous state
+} button_scanner_stats_t;
+
+void button_scanner_start(void);
+
+// Next state change, oldest first; false if there is none
+bool button_scanner_pop(button_event_t *event);
+
+// True if an event is waiting
+bool button_scanner_pending(void);
+
+// Debounced state of the newest event taken with button_scanner_pop()
+uint16_t button_scanner_buttons(void);
+
+const button_scanner_stats_t *button_scanner_get_stats(void);
+
+#endif // BUTTON_SCANNER_H
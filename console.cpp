@@ -0,0 +1,328 @@
+// *****************************************************************************
+// Debug console
+// *****************************************************************************
+
+#include <atomic>
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+
+#include "btstack.h"
+#include "analog_sampler.h"
+#include "axis_profiles.h"
+#include "button_scanner.h"
+#include "console.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "motion_report.h"
+#include "throughput_test.h"
+
+static btstack_data_source_t console_data_source;
+static std::atomic<bool> chars_available;
+
+// Script upload: 'u', length (4 bytes, little-endian), then the script.
+// An upload that stalls this long is dropped.
+#define UPLOAD_TIMEOUT_MS 1000
+
+typedef enum {
+    UPLOAD_IDLE = 0,
+    UPLOAD_LENGTH,
+    UPLOAD_DATA,
+} upload_state_t;
+
+static uint8_t upload_buffer[INPUT_SCRIPT_UPLOAD_SIZE];
+static upload_state_t upload_state;
+static uint32_t upload_size;
+static uint32_t upload_received;
+static btstack_timer_source_t upload_timer;
+
+static const uint16_t script_speeds[] = {100, 200, 400, 1000};
+static int script_speed_index;
+static bool script_loop = true;
+
+#if GAMEPAD_ANALOG_INPUTS
+
+// Range capture: sticks are read every CALIBRATION_PERIOD_MS while the user
+// circles them, then stored as player 1's min/max
+#define CALIBRATION_PERIOD_MS 10
+
+static btstack_timer_source_t calibration_timer;
+static bool calibration_running;
+static axis_profile_t calibration_profile;
+
+// Raw stick readings as they reach axis_process()
+static bool console_read_sticks(int16_t *axes)
+{
+    analog_frame_t frame;
+    gamepad_report_t report;
+    if (!analog_sampler_read(&frame)) return false;
+    analog_frame_apply(&frame, &report);
+    axes[AXIS_LEFT_X] = report.left_x;
+    axes[AXIS_LEFT_Y] = report.left_y;
+    axes[AXIS_RIGHT_X] = report.right_x;
+    axes[AXIS_RIGHT_Y] = report.right_y;
+    return true;
+}
+
+static void calibration_timer_handler(btstack_timer_source_t *ts)
+{
+    int16_t axes[AXIS_STICK_AXES];
+    if (console_read_sticks(axes)) {
+        for (int axis = 0; axis < AXIS_STICK_AXES; axis++) {
+            axis_calibration_t *calibration = &calibration_profile.axes[axis];
+            if (axes[axis] < calibration->min) calibration->min = axes[axis];
+            if (axes[axis] > calibration->max) calibration->max = axes[axis];
+        }
+    }
+    btstack_run_loop_set_timer(ts, CALIBRATION_PERIOD_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+static void console_calibrate_center(void)
+{
+    int16_t axes[AXIS_STICK_AXES];
+    if (!console_read_sticks(axes)) {
+        printf("No analog frame yet\n");
+        return;
+    }
+    axis_profile_t profile = *axis_profiles_get(0);
+    for (int axis = 0; axis < AXIS_STICK_AXES; axis++) {
+        profile.axes[axis].center = axes[axis];
+    }
+    if (axis_profiles_store(0, &profile) == 0) {
+        printf("Centers: %d %d %d %d\n", axes[0], axes[1], axes[2], axes[3]);
+    }
+}
+
+static void console_calibrate_range(void)
+{
+    if (!calibration_running) {
+        calibration_profile = *axis_profiles_get(0);
+        for (int axis = 0; axis < AXIS_STICK_AXES; axis++) {
+            // Start from the center so only what the sticks reach counts
+            calibration_profile.axes[axis].min = calibration_profile.axes[axis].center;
+            calibration_profile.axes[axis].max = calibration_profile.axes[axis].center;
+        }
+        calibration_running = true;
+        calibration_timer.process = &calibration_timer_handler;
+        btstack_run_loop_set_timer(&calibration_timer, CALIBRATION_PERIOD_MS);
+        btstack_run_loop_add_timer(&calibration_timer);
+        printf("Move both sticks to all limits, then press m again\n");
+        return;
+    }
+    calibration_running = false;
+    btstack_run_loop_remove_timer(&calibration_timer);
+    if (axis_profiles_store(0, &calibration_profile) == 0) {
+        for (int axis = 0; axis < AXIS_STICK_AXES; axis++) {
+            const axis_calibration_t *calibration = &calibration_profile.axes[axis];
+            printf("Axis %d: %d .. %d .. %d\n", axis, calibration->min, calibration->center, calibration->max);
+        }
+    }
+}
+
+#endif
+
+static void upload_timer_handler(btstack_timer_source_t *ts)
+{
+    UNUSED(ts);
+    printf("Script upload timed out after %u of %u bytes\n", (unsigned)upload_received, (unsigned)upload_size);
+    upload_state = UPLOAD_IDLE;
+}
+
+static void console_upload_start(void)
+{
+    // The upload buffer may be playing; switch to the built-in demo and
+    // wait until core1 has let go of it
+    gamepad_script_play(NULL, 0);
+    while (gamepad_script_busy()) {
+        tight_loop_contents();
+    }
+    upload_state = UPLOAD_LENGTH;
+    upload_size = 0;
+    upload_received = 0;
+    upload_timer.process = &upload_timer_handler;
+    btstack_run_loop_set_timer(&upload_timer, UPLOAD_TIMEOUT_MS);
+    btstack_run_loop_add_timer(&upload_timer);
+}
+
+static void console_upload_byte(uint8_t byte)
+{
+    if (upload_state == UPLOAD_LENGTH) {
+        upload_size |= (uint32_t)byte << (8 * upload_received);
+        if (++upload_received < 4) return;
+        upload_received = 0;
+        upload_state = UPLOAD_DATA;
+        if (upload_size == 0) {
+            upload_state = UPLOAD_IDLE;
+            btstack_run_loop_remove_timer(&upload_timer);
+        }
+        return;
+    }
+
+    // Oversized scripts are read to the end and dropped
+    if (upload_received < sizeof(upload_buffer)) {
+        upload_buffer[upload_received] = byte;
+    }
+    if (++upload_received < upload_size) return;
+
+    upload_state = UPLOAD_IDLE;
+    btstack_run_loop_remove_timer(&upload_timer);
+    if (upload_size > sizeof(upload_buffer)) {
+        printf("Script of %u bytes exceeds %u byte upload buffer\n", (unsigned)upload_size,
+               (unsigned)sizeof(upload_buffer));
+        return;
+    }
+    if (gamepad_script_play(upload_buffer, upload_size) != 0) {
+        printf("Uploaded data is not an input script\n");
+        return;
+    }
+    printf("Playing uploaded script (%u bytes)\n", (unsigned)upload_size);
+}
+
+#if GAMEPAD_BUTTON_INPUTS
+static void console_button_dump(void)
+{
+    const button_scanner_stats_t *stats = button_scanner_get_stats();
+    printf("Buttons: %lu changes, %lu bounces settled back, %lu lost to a full queue\n",
+           (unsigned long)stats->events, (unsigned long)stats->repeats, (unsigned long)stats->dropped);
+}
+#endif
+
+static void console_help(void)
+{
+    printf("Commands:\n");
+    printf("  s  dump latency histograms and counters\n");
+    printf("  r  reset latency histograms and counters\n");
+    printf("  e  toggle releasing reports on the connection event schedule\n");
+#if GAMEPAD_ANALOG_INPUTS
+    printf("  c  store current stick positions as centers\n");
+    printf("  m  start / finish stick range calibration\n");
+    printf("  d  restore default stick and trigger profile\n");
+#endif
+#if GAMEPAD_THROUGHPUT_TEST
+    printf("  t  start / stop the saturation throughput test\n");
+#endif
+#if GAMEPAD_MOTION
+    printf("  i  start / stop logging IMU samples (host/bench/motion_bench replays them)\n");
+#endif
+    printf("  u  upload an input script (tools/input_script.py send)\n");
+    printf("  b  play the built-in demo script\n");
+    printf("  f  cycle script replay speed\n");
+    printf("  l  toggle script looping\n");
+    printf("  h  this help\n");
+}
+
+static void console_command(int c)
+{
+    switch (c) {
+        case 's':
+            gamepad_stats_dump();
+#if GAMEPAD_BUTTON_INPUTS
+            console_button_dump();
+#endif
+#if GAMEPAD_THROUGHPUT_TEST
+            if (throughput_test_active()) {
+                throughput_test_dump();
+            }
+#endif
+            break;
+        case 'r':
+            gamepad_stats_reset();
+            printf("Statistics reset\n");
+            break;
+        case 'e':
+            gamepad_set_event_schedule(!gamepad_event_schedule());
+            printf("Event schedule %s\n", gamepad_event_schedule() ? "on" : "off");
+            break;
+#if GAMEPAD_ANALOG_INPUTS
+        case 'c':
+            console_calibrate_center();
+            break;
+        case 'm':
+            console_calibrate_range();
+            break;
+        case 'd':
+            axis_profiles_reset(0);
+            printf("Default profile restored\n");
+            break;
+#endif
+#if GAMEPAD_THROUGHPUT_TEST
+        case 't':
+            if (throughput_test_active()) {
+                throughput_test_stop();
+            } else {
+                throughput_test_start();
+                printf("Throughput test started; t again to stop, s for progress\n");
+                break;
+            }
+            throughput_test_dump();
+            break;
+#endif
+#if GAMEPAD_MOTION
+        case 'i':
+            motion_report_set_logging(!motion_report_logging());
+            printf("IMU logging %s\n", motion_report_logging() ? "on" : "off");
+            break;
+#endif
+        case 'u':
+            console_upload_start();
+            break;
+        case 'b':
+            gamepad_script_play(NULL, 0);
+            printf("Playing built-in demo\n");
+            break;
+        case 'f':
+            script_speed_index = (script_speed_index + 1) % (int)(sizeof(script_speeds) / sizeof(script_speeds[0]));
+            gamepad_script_set_speed(script_speeds[script_speed_index]);
+            printf("Script speed %u%%\n", script_speeds[script_speed_index]);
+            break;
+        case 'l':
+            script_loop = !script_loop;
+            gamepad_script_set_loop(script_loop);
+            printf("Script looping %s\n", script_loop ? "on" : "off");
+            break;
+        case 'h':
+        case '?':
+            console_help();
+            break;
+        default:
+            break;
+    }
+}
+
+static void console_data_source_handler(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+    UNUSED(ds);
+    if (callback_type != DATA_SOURCE_CALLBACK_POLL) return;
+    if (!chars_available.exchange(false)) return;
+
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if (upload_state != UPLOAD_IDLE) {
+            console_upload_byte((uint8_t)c);
+        } else {
+            console_command(c);
+        }
+    }
+    if (upload_state != UPLOAD_IDLE) {
+        btstack_run_loop_remove_timer(&upload_timer);
+        btstack_run_loop_set_timer(&upload_timer, UPLOAD_TIMEOUT_MS);
+        btstack_run_loop_add_timer(&upload_timer);
+    }
+}
+
+// Called from the stdio driver's interrupt context
+static void console_chars_available(void *param)
+{
+    UNUSED(param);
+    chars_available.store(true);
+    btstack_run_loop_poll_data_sources_from_irq();
+}
+
+void console_init(void)
+{
+    btstack_run_loop_set_data_source_handler(&console_data_source, &console_data_source_handler);
+    btstack_run_loop_enable_data_source_callbacks(&console_data_source, DATA_SOURCE_CALLBACK_POLL);
+    btstack_run_loop_add_data_source(&console_data_source);
+    stdio_set_chars_available_callback(&console_chars_available, NULL);
+}
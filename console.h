@@ -0,0 +1,14 @@
+// *****************************************************************************
+// Debug console
+//
+// Single-key commands read from USB stdio on the BTstack run loop. Input is
+// only looked at when the stdio driver reports characters, so an idle
+// console costs nothing.
+// *****************************************************************************
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+void console_init(void);
+
+#endif // CONSOLE_H
@@ -0,0 +1,261 @@
+// *****************************************************************************
+// Deferred flash persistence
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "btstack.h"
+#include "btstack_tlv.h"
+#include "ble/le_device_db_tlv.h"
+#include "analog_sampler.h"
+#include "deferred_tlv.h"
+#include "gamepad_config.h"
+#include "power_governor.h"
+#include "trace.h"
+
+// How often waiting values are checked against the idle and deadline rules
+#define DEFERRED_TLV_POLL_MS 10
+
+typedef struct {
+    bool used;
+    bool deleted;              // Staged delete_tag()
+    uint16_t size;
+    uint32_t tag;
+    uint32_t staged_ms;        // First staged; a newer value keeps the deadline
+    uint8_t value[DEFERRED_TLV_VALUE_SIZE];
+} staged_value_t;
+
+static staged_value_t slots[DEFERRED_TLV_SLOTS];
+static const btstack_tlv_t *flash_tlv;
+static void *flash_context;
+static bool staging;
+static btstack_timer_source_t commit_timer;
+static deferred_tlv_stats_t stats;
+
+static staged_value_t *slot_find(uint32_t tag)
+{
+    for (int i = 0; i < DEFERRED_TLV_SLOTS; i++) {
+        if (slots[i].used && slots[i].tag == tag) return &slots[i];
+    }
+    return NULL;
+}
+
+static staged_value_t *slot_oldest(void)
+{
+    staged_value_t *oldest = NULL;
+    for (int i = 0; i < DEFERRED_TLV_SLOTS; i++) {
+        if (!slots[i].used) continue;
+        if (!oldest || (int32_t)(slots[i].staged_ms - oldest->staged_ms) < 0) {
+            oldest = &slots[i];
+        }
+    }
+    return oldest;
+}
+
+static void flash_blocked(uint32_t tag, uint32_t start_us)
+{
+    uint32_t block_us = time_us_32() - start_us;
+    stats.blocks++;
+    stats.block_total_us += block_us;
+    if (block_us > stats.block_max_us) {
+        stats.block_max_us = block_us;
+    }
+    TRACE(FLASH_COMMIT, (uint16_t)(tag >> 16), (uint16_t)tag, (uint16_t)(block_us > 0xffff ? 0xffff : block_us),
+          deferred_tlv_pending());
+}
+
+// The analog sampler's DMA needs core1's interrupt at every block, and the
+// lockout keeps core1 from taking it for as long as the write
+static int flash_store(uint32_t tag, const uint8_t *data, uint32_t data_size)
+{
+    uint32_t start_us = time_us_32();
+    analog_sampler_pause();
+    int status = flash_tlv->store_tag(flash_context, tag, data, data_size);
+    analog_sampler_resume();
+    flash_blocked(tag, start_us);
+    return status;
+}
+
+static void flash_delete(uint32_t tag)
+{
+    uint32_t start_us = time_us_32();
+    analog_sampler_pause();
+    flash_tlv->delete_tag(flash_context, tag);
+    analog_sampler_resume();
+    flash_blocked(tag, start_us);
+}
+
+static void commit(staged_value_t *slot)
+{
+    slot->used = false;
+    stats.commits++;
+    if (slot->deleted) {
+        flash_delete(slot->tag);
+    } else if (flash_store(slot->tag, slot->value, slot->size) != 0) {
+        stats.failed++;
+        printf("Flash write of tag 0x%08lx failed\n", (unsigned long)slot->tag);
+    }
+}
+
+static void commit_timer_arm(void)
+{
+    btstack_run_loop_remove_timer(&commit_timer);
+    if (!slot_oldest()) return;
+    btstack_run_loop_set_timer(&commit_timer, DEFERRED_TLV_POLL_MS);
+    btstack_run_loop_add_timer(&commit_timer);
+}
+
+static void commit_timer_handler(btstack_timer_source_t *ts)
+{
+    UNUSED(ts);
+    staged_value_t *oldest = slot_oldest();
+    if (!oldest) return;
+    if (power_governor_state() != POWER_STATE_ACTIVE) {
+        stats.idle_commits++;
+        commit(oldest);
+    } else if ((int32_t)(btstack_run_loop_get_time_ms() - oldest->staged_ms) >= DEFERRED_TLV_MAX_DELAY_MS) {
+        stats.forced_commits++;
+        commit(oldest);
+    }
+    commit_timer_arm();
+}
+
+// A slot for tag, writing the oldest staged value if none is free
+static staged_value_t *slot_take(uint32_t tag)
+{
+    staged_value_t *slot = slot_find(tag);
+    if (slot) {
+        stats.coalesced++;
+        return slot;
+    }
+    for (int i = 0; i < DEFERRED_TLV_SLOTS; i++) {
+        if (!slots[i].used) {
+            slot = &slots[i];
+            break;
+        }
+    }
+    if (!slot) {
+        slot = slot_oldest();
+        stats.forced_commits++;
+        commit(slot);
+    }
+    slot->used = true;
+    slot->tag = tag;
+    slot->staged_ms = btstack_run_loop_get_time_ms();
+    return slot;
+}
+
+// btstack_tlv_t
+
+static int deferred_get_tag(void *context, uint32_t tag, uint8_t *buffer, uint32_t buffer_size)
+{
+    UNUSED(context);
+    const staged_value_t *slot = slot_find(tag);
+    if (!slot) return flash_tlv->get_tag(flash_context, tag, buffer, buffer_size);
+    if (slot->deleted) return 0;
+    if (buffer) {
+        memcpy(buffer, slot->value, slot->size < buffer_size ? slot->size : buffer_size);
+    }
+    return slot->size;
+}
+
+static int deferred_store_tag(void *context, uint32_t tag, const uint8_t *data, uint32_t data_size)
+{
+    UNUSED(context);
+    if (!staging || data_size > DEFERRED_TLV_VALUE_SIZE) {
+        // An older staged value must not land on top of this one later
+        staged_value_t *slot = slot_find(tag);
+        if (slot) {
+            slot->used = false;
+        }
+        stats.written_through++;
+        return flash_store(tag, data, data_size);
+    }
+    staged_value_t *slot = slot_take(tag);
+    slot->deleted = false;
+    slot->size = (uint16_t)data_size;
+    memcpy(slot->value, data, data_size);
+    stats.staged++;
+    commit_timer_arm();
+    return 0;
+}
+
+static void deferred_delete_tag(void *context, uint32_t tag)
+{
+    UNUSED(context);
+    if (!staging) {
+        stats.written_through++;
+        flash_delete(tag);
+        return;
+    }
+    staged_value_t *slot = slot_take(tag);
+    slot->deleted = true;
+    slot->size = 0;
+    stats.staged++;
+    commit_timer_arm();
+}
+
+static const btstack_tlv_t deferred_tlv_impl = {
+    &deferred_get_tag,
+    &deferred_store_tag,
+    &deferred_delete_tag,
+};
+
+void deferred_tlv_init(bool stage)
+{
+    const btstack_tlv_t *tlv_impl = NULL;
+    void *tlv_context = NULL;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (!tlv_impl || tlv_impl == &deferred_tlv_impl) return;
+
+    flash_tlv = tlv_impl;
+    flash_context = tlv_context;
+    staging = stage;
+    memset(slots, 0, sizeof(slots));
+    memset(&stats, 0, sizeof(stats));
+    commit_timer.process = &commit_timer_handler;
+    btstack_tlv_set_instance(&deferred_tlv_impl, NULL);
+    le_device_db_tlv_configure(&deferred_tlv_impl, NULL);
+}
+
+void deferred_tlv_window(void)
+{
+    staged_value_t *oldest = slot_oldest();
+    if (!oldest) return;
+    stats.window_commits++;
+    commit(oldest);
+    commit_timer_arm();
+}
+
+uint8_t deferred_tlv_pending(void)
+{
+    uint8_t pending = 0;
+    for (int i = 0; i < DEFERRED_TLV_SLOTS; i++) {
+        pending += slots[i].used;
+    }
+    return pending;
+}
+
+const deferred_tlv_stats_t *deferred_tlv_get_stats(void)
+{
+    return &stats;
+}
+
+void deferred_tlv_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void deferred_tlv_dump(void)
+{
+    printf("Flash: %lu staged (%lu coalesced), %lu written (%lu between events, %lu idle, %lu forced), "
+           "%lu written through, %lu failed, %u waiting; blocked max %lu us, mean %lu us\n",
+           (unsigned long)stats.staged, (unsigned long)stats.coalesced, (unsigned long)stats.commits,
+           (unsigned long)stats.window_commits, (unsigned long)stats.idle_commits,
+           (unsigned long)stats.forced_commits, (unsigned long)stats.written_through, (unsigned long)stats.failed,
+           deferred_tlv_pending(), (unsigned long)stats.block_max_us,
+           (unsigned long)(stats.blocks ? stats.block_total_us / stats.blocks : 0));
+}
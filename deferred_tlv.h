@@ -0,0 +1,69 @@
+// *****************************************************************************
+// Deferred flash persistence
+//
+// Everything the firmware keeps across power cycles goes through BTstack's
+// TLV store on flash: bonds (le_device_db, SM), reconnect.cpp's records and
+// axis profiles. Programming flash stops XIP, so both cores stop for it:
+// core1 is parked by the multicore lockout (input_sampler.cpp), core0 runs
+// the write with interrupts off. An entry takes about a millisecond, erasing
+// a sector when the store compacts its bank tens of milliseconds, and a
+// pairing host writes several entries at once, right when it starts
+// listening to reports.
+//
+// deferred_tlv_init() puts this store in front of the flash one, for BTstack
+// (the global TLV instance and the LE device DB) and for the firmware's own
+// tags. Stores and deletes are staged in RAM, one slot per tag holding the
+// newest value; reads see staged values first. Staged values are written
+// one at a time:
+//
+//   - right after a connection event that left nothing queued on any link
+//     (deferred_tlv_window(), from the report path), so the write falls into
+//     the gap before the next event
+//   - while the power governor has the links idle
+//   - DEFERRED_TLV_MAX_DELAY_MS after a value was staged in any case, so a
+//     bond is not lost to a power cut because input never stopped
+//
+// A value larger than DEFERRED_TLV_VALUE_SIZE is written at once, and a
+// store with every slot taken first writes the oldest one. Without staging
+// (GAMEPAD_DEFERRED_FLASH=0) every value is written at once. Either way
+// each flash write pauses the analog sampler (analog_sampler.h), is timed,
+// with the longest and mean times kept, and is traced (FLASH_COMMIT).
+// *****************************************************************************
+
+#ifndef DEFERRED_TLV_H
+#define DEFERRED_TLV_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t staged;           // Stores and deletes taken into RAM
+    uint32_t coalesced;        // ... that replaced a staged value of the same tag
+    uint32_t written_through;  // Too large to stage or staging off: written at once
+    uint32_t commits;          // Staged values written to flash
+    uint32_t window_commits;   // ... right after a connection event
+    uint32_t idle_commits;     // ... while the links were idle
+    uint32_t forced_commits;   // ... at the deadline or to free a slot
+    uint32_t failed;           // Writes the flash store refused
+    uint32_t block_max_us;     // Longest a flash write held the cores
+    uint64_t block_total_us;   // Sum over all flash writes
+    uint32_t blocks;           // Flash writes timed
+} deferred_tlv_stats_t;
+
+// Take every write from now on, staged or written at once; call once the
+// flash TLV store is set up (cyw43_arch_init()) and before BTstack reads
+// from it (sm_init())
+void deferred_tlv_init(bool stage);
+
+// A connection event just ended with nothing left queued: write one value
+void deferred_tlv_window(void);
+
+// Values waiting for flash
+uint8_t deferred_tlv_pending(void);
+
+const deferred_tlv_stats_t *deferred_tlv_get_stats(void);
+void deferred_tlv_reset_stats(void);
+
+void deferred_tlv_dump(void);
+
+#endif // DEFERRED_TLV_H
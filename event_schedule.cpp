@@ -0,0 +1,171 @@
+// *****************************************************************************
+// Connection event schedule
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "event_schedule.h"
+#include "gamepad_config.h"
+
+// Completions this close to the prediction count towards the lock; further
+// than a quarter period off, the phase is taken afresh
+#define SCHEDULE_JITTER_US 250
+
+// The learned period stays within this of the negotiated interval
+#define SCHEDULE_PERIOD_LIMIT_PPM 1000
+
+// A late release grows the lead by this much; SCHEDULE_LEAD_SHRINK_AFTER
+// releases in time shrink it by SCHEDULE_LEAD_SHRINK_US
+#define SCHEDULE_LEAD_GROW_US 250
+#define SCHEDULE_LEAD_SHRINK_US 50
+#define SCHEDULE_LEAD_SHRINK_AFTER 64
+
+static uint32_t period_us(const event_schedule_t *schedule)
+{
+    return (schedule->period_q8 + 128) >> 8;
+}
+
+// Grid point nearest to time_us, and how many periods it lies after the anchor
+static uint32_t nearest_completion(const event_schedule_t *schedule, uint32_t time_us, int32_t *events)
+{
+    int64_t delta = (int32_t)(time_us - schedule->anchor_us);
+    int64_t period_q8 = schedule->period_q8;
+    int64_t count = (delta * 256 + (delta >= 0 ? period_q8 / 2 : -period_q8 / 2)) / period_q8;
+    *events = (int32_t)count;
+    return schedule->anchor_us + (uint32_t)((count * period_q8 + 128) / 256);
+}
+
+void event_schedule_reset(event_schedule_t *schedule)
+{
+    memset(schedule, 0, sizeof(*schedule));
+    schedule->lead_us = SCHEDULE_LEAD_US;
+}
+
+void event_schedule_set_interval(event_schedule_t *schedule, uint32_t interval_us)
+{
+    if (schedule->interval_us == interval_us) return;
+    schedule->interval_us = interval_us;
+    schedule->period_q8 = interval_us << 8;
+    schedule->has_anchor = false;
+    schedule->observations = 0;
+    schedule->released = false;
+    if (schedule->lead_us > interval_us * 3 / 4) {
+        schedule->lead_us = (uint16_t)(interval_us * 3 / 4);
+    }
+}
+
+void event_schedule_completed(event_schedule_t *schedule, uint32_t now_us)
+{
+    schedule->completions++;
+    if (schedule->interval_us == 0) return;
+
+    // Far from the anchor the grid may have slipped by more than it shows
+    int32_t since_anchor = (int32_t)(now_us - schedule->anchor_us);
+    if (!schedule->has_anchor || since_anchor >= (1 << 29) || since_anchor <= -(1 << 29)) {
+        schedule->anchor_us = now_us;
+        schedule->has_anchor = true;
+        schedule->observations = 0;
+        return;
+    }
+
+    int32_t events;
+    uint32_t predicted = nearest_completion(schedule, now_us, &events);
+    int32_t error = (int32_t)(now_us - predicted);
+    int32_t limit = (int32_t)period_us(schedule) / 4;
+    if (error > limit || error < -limit) {
+        schedule->relocks++;
+        schedule->anchor_us = now_us;
+        schedule->observations = 0;
+        return;
+    }
+
+    // Phase: a quarter of the error. Period: the error spread over the
+    // periods since the anchor, a sixteenth of it.
+    schedule->anchor_us = predicted + error / 4;
+    if (events > 0) {
+        int64_t period_q8 = (int64_t)schedule->period_q8 + (int64_t)error * 256 / ((int64_t)events * 16);
+        int64_t nominal_q8 = (int64_t)schedule->interval_us << 8;
+        int64_t bound_q8 = nominal_q8 * SCHEDULE_PERIOD_LIMIT_PPM / 1000000;
+        if (period_q8 > nominal_q8 + bound_q8) period_q8 = nominal_q8 + bound_q8;
+        if (period_q8 < nominal_q8 - bound_q8) period_q8 = nominal_q8 - bound_q8;
+        schedule->period_q8 = (uint32_t)period_q8;
+    }
+
+    if (error <= SCHEDULE_JITTER_US && error >= -SCHEDULE_JITTER_US) {
+        if (schedule->observations < 255) schedule->observations++;
+    } else {
+        schedule->observations = 0;
+    }
+}
+
+bool event_schedule_locked(const event_schedule_t *schedule)
+{
+    return schedule->interval_us && schedule->has_anchor &&
+           schedule->observations >= SCHEDULE_LOCK_OBSERVATIONS;
+}
+
+uint32_t event_schedule_next_release(const event_schedule_t *schedule, uint32_t now_us)
+{
+    int32_t events;
+    uint32_t completion = nearest_completion(schedule, now_us + schedule->lead_us, &events);
+    if ((int32_t)(completion - schedule->lead_us - now_us) < 0) {
+        completion = nearest_completion(schedule, completion + period_us(schedule), &events);
+    }
+    // One report per event: the released one still has this event
+    if (schedule->released) {
+        int32_t after_target = (int32_t)(completion - schedule->release_target_us);
+        if (after_target < (int32_t)period_us(schedule) / 2) {
+            completion = nearest_completion(schedule, schedule->release_target_us + period_us(schedule), &events);
+        }
+    }
+    return completion - schedule->lead_us;
+}
+
+// A released report went out an event later than aimed for
+static void release_late(event_schedule_t *schedule)
+{
+    schedule->late++;
+    schedule->hits = 0;
+    uint32_t lead_us = schedule->lead_us + SCHEDULE_LEAD_GROW_US;
+    if (lead_us > schedule->interval_us * 3 / 4) lead_us = schedule->interval_us * 3 / 4;
+    schedule->lead_us = (uint16_t)lead_us;
+}
+
+void event_schedule_released(event_schedule_t *schedule, uint32_t release_us)
+{
+    // The previous one is still queued, so it missed its event
+    if (schedule->released) {
+        release_late(schedule);
+    }
+    schedule->releases++;
+    schedule->released = true;
+    schedule->release_target_us = release_us + schedule->lead_us;
+}
+
+void event_schedule_report_completed(event_schedule_t *schedule, uint32_t now_us)
+{
+    if (!schedule->released) return;
+    schedule->released = false;
+
+    if ((int32_t)(now_us - schedule->release_target_us) > (int32_t)period_us(schedule) / 2) {
+        release_late(schedule);
+        return;
+    }
+    if (++schedule->hits < SCHEDULE_LEAD_SHRINK_AFTER) return;
+    schedule->hits = 0;
+    if (schedule->lead_us >= SCHEDULE_MIN_LEAD_US + SCHEDULE_LEAD_SHRINK_US) {
+        schedule->lead_us -= SCHEDULE_LEAD_SHRINK_US;
+    }
+}
+
+void event_schedule_dump(const event_schedule_t *schedule, uint16_t con_handle)
+{
+    uint32_t period_ns = (uint32_t)(((uint64_t)schedule->period_q8 * 1000 + 128) >> 8);
+    printf("Schedule 0x%04x: %s, interval %lu us, period %lu.%03lu us, lead %u us, %lu completions, %lu releases, "
+           "%lu late, %lu relocks\n",
+           con_handle, event_schedule_locked(schedule) ? "locked" : "learning", (unsigned long)schedule->interval_us,
+           (unsigned long)(period_ns / 1000), (unsigned long)(period_ns % 1000), schedule->lead_us,
+           (unsigned long)schedule->completions, (unsigned long)schedule->releases, (unsigned long)schedule->late,
+           (unsigned long)schedule->relocks);
+}
@@ -0,0 +1,72 @@
+// *****************************************************************************
+// Connection event schedule
+//
+// Learns when a central's connection events happen, so reports can be
+// released just before one instead of whenever an input changes: a report
+// queued early in the interval waits for the event while newer input piles
+// up behind it, and its input is up to a whole interval old on air.
+//
+// The controller's HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS follows the event
+// that carried the packets by a roughly fixed delay, so completions fall on
+// a grid with the connection interval as period. Each completion pulls the
+// predicted grid towards it (phase) and corrects the period (the drift
+// between the controller's sleep clock and ours). After
+// SCHEDULE_LOCK_OBSERVATIONS completions close to the prediction the
+// schedule is locked and reports are released lead_us before the next
+// predicted completion. The lead covers the completion delay and the time
+// the controller needs to take a packet into the event; it starts at
+// SCHEDULE_LEAD_US, grows when a released report misses its event and
+// slowly shrinks while they make it, down to SCHEDULE_MIN_LEAD_US.
+//
+// Pure computation on microsecond timestamps; the report path owns the
+// timers (gamepad.cpp).
+// *****************************************************************************
+
+#ifndef EVENT_SCHEDULE_H
+#define EVENT_SCHEDULE_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t interval_us;      // Negotiated connection interval, 0 = unknown
+    uint32_t period_q8;        // Learned completion period, 1/256 us
+    uint32_t anchor_us;        // A predicted completion time on the grid
+    uint16_t lead_us;          // Release this long before a predicted completion
+    uint16_t hits;             // Released reports on time since the lead last changed
+    uint8_t observations;      // Consecutive completions close to the prediction
+    bool has_anchor;
+    bool released;             // A released report is on its way
+    uint32_t release_target_us;  // Completion the released report aims for
+
+    // Statistics
+    uint32_t completions;      // Completions observed
+    uint32_t releases;         // Reports released on the schedule
+    uint32_t late;             // Released reports that missed their event
+    uint32_t relocks;          // Completions far off the grid: phase restarted
+} event_schedule_t;
+
+// Forget everything learned (new connection)
+void event_schedule_reset(event_schedule_t *schedule);
+
+// The connection interval in effect; a change restarts the learning
+void event_schedule_set_interval(event_schedule_t *schedule, uint32_t interval_us);
+
+// A completion was reported at now_us
+void event_schedule_completed(event_schedule_t *schedule, uint32_t now_us);
+
+// True once the grid is known well enough to hold reports for it
+bool event_schedule_locked(const event_schedule_t *schedule);
+
+// Next release point at or after now_us, for an event after the one a
+// released report is still aiming for (locked schedules only)
+uint32_t event_schedule_next_release(const event_schedule_t *schedule, uint32_t now_us);
+
+// A report was released for the completion following the release point
+// release_us; event_schedule_report_completed() tells when it was completed
+void event_schedule_released(event_schedule_t *schedule, uint32_t release_us);
+void event_schedule_report_completed(event_schedule_t *schedule, uint32_t now_us);
+
+// Print the learned period, the lead and the counters
+void event_schedule_dump(const event_schedule_t *schedule, uint16_t con_handle);
+
+#endif // EVENT_SCHEDULE_H
@@ -0,0 +1,811 @@
+// *****************************************************************************
+// Generic Bluetooth LE Gamepad - report path
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include <atomic>
+
+#include "btstack.h"
+#include "battery_monitor.h"
+#include "boot_timeline.h"
+#include "pico/time.h"
+#include "ble/gatt-service/hids_device.h"
+#include "deferred_tlv.h"
+#include "demo_script.h"
+#include "event_schedule.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_connection.h"
+#include "gamepad_layout.h"
+#include "input_pipeline.h"
+#include "input_sampler.h"
+#include "input_script.h"
+#include "latency_stats.h"
+#include "link_tuning.h"
+#include "motion_report.h"
+#include "power_governor.h"
+#include "reconnect.h"
+#include "rumble.h"
+#include "report_mailbox.h"
+#include "throughput_test.h"
+#include "trace.h"
+#include "tuning_service.h"
+#include "usb_hid.h"
+
+// Latest input of each player, given in full to centrals as they subscribe
+static gamepad_report_t current_state[GAMEPAD_PLAYERS];
+
+// What the centrals are given while USB carries the player reports
+static const gamepad_report_t neutral_state = {0, 0, 0, 0, 0, 0, 0, DPAD_NEUTRAL};
+
+static const gamepad_report_t *central_state(uint8_t player)
+{
+#if GAMEPAD_USB_HID
+    if (usb_hid_active()) return &neutral_state;
+#endif
+    return &current_state[player];
+}
+
+// Send HID gamepad report; false if it did not reach the controller
+static bool send_gamepad_report(gamepad_connection_t *connection, uint8_t player, gamepad_report_t *report)
+{
+    uint8_t hid_report[GAMEPAD_REPORT_SIZE];
+    gamepad_input_report::pack(*report, hid_report);
+    
+    uint8_t status;
+    if (connection->protocol_mode) {
+        status = hids_device_send_input_report_for_id(connection->con_handle, GAMEPAD_PLAYER_REPORT_ID(player),
+                                                      hid_report, sizeof(hid_report));
+    } else if (player == 0) {
+        status = hids_device_send_boot_keyboard_input_report(connection->con_handle, hid_report, sizeof(hid_report));
+    } else {
+        // Boot protocol has a single keyboard report
+        return false;
+    }
+    if (status != ERROR_CODE_SUCCESS) {
+        TRACE(SEND_FAILED, status);
+        return false;
+    }
+    connection->acl_queued++;
+    connection->report_queued = connection->acl_queued;
+    if (player == 0 && latency_stats_sent()) {
+        connection->report_timed = 1;
+    }
+    reconnect_report_sent(connection->con_handle);
+    TRACE(REPORT_SENT, report->buttons, (uint16_t)report->left_x, (uint16_t)report->left_y,
+          (uint16_t)report->right_x, (uint16_t)report->right_y);
+    return true;
+}
+
+static btstack_timer_source_t keepalive_timer;
+static uint32_t keepalive_ms;
+
+// *****************************************************************************
+// Report release on the connection event schedule
+//
+// A central whose schedule is locked gets its player reports at the release
+// point before its next connection event rather than at once. With core1,
+// the sampler takes a sample at the earliest release point and its hand-off
+// releases the reports (input_pipeline.h); the run loop timer, at 1 ms
+// resolution, is only a backstop. Without core1 the timer releases them, up
+// to a millisecond early rather than late.
+
+// Release points this close ahead count as reached
+#define RELEASE_WINDOW_US 1000
+
+static btstack_timer_source_t release_timer;
+static bool event_schedule_enabled = GAMEPAD_EVENT_SCHEDULE;
+
+static void release_timer_arm(void)
+{
+    bool held = false;
+    uint32_t earliest_us = 0;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        const gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (!connection->reports_held) continue;
+        if (!held || (int32_t)(connection->release_us - earliest_us) < 0) {
+            earliest_us = connection->release_us;
+        }
+        held = true;
+    }
+    btstack_run_loop_remove_timer(&release_timer);
+    if (!held) return;
+
+    int32_t delay_us = (int32_t)(earliest_us - time_us_32());
+    uint32_t delay_ms = delay_us > 0 ? (uint32_t)delay_us / 1000 : 0;
+#if GAMEPAD_DUAL_CORE
+    input_sampler_release_at(earliest_us);
+    delay_ms += 2;
+#endif
+    btstack_run_loop_set_timer(&release_timer, delay_ms);
+    btstack_run_loop_add_timer(&release_timer);
+}
+
+static void release_timer_handler(btstack_timer_source_t *ts)
+{
+    UNUSED(ts);
+    gamepad_release_reports();
+}
+
+void gamepad_release_reports(void)
+{
+    uint32_t now_us = time_us_32();
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (!connection->reports_held) continue;
+        if ((int32_t)(connection->release_us - now_us) > RELEASE_WINDOW_US) continue;
+        connection->reports_held = 0;
+        connection->release_granted = 1;
+        gamepad_connection_request_can_send_now(connection);
+    }
+    release_timer_arm();
+}
+
+void gamepad_set_event_schedule(bool enable)
+{
+    event_schedule_enabled = enable;
+    if (enable) return;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (!connection->reports_held) continue;
+        connection->reports_held = 0;
+        gamepad_connection_request_can_send_now(connection);
+    }
+    release_timer_arm();
+}
+
+bool gamepad_event_schedule(void)
+{
+    return event_schedule_enabled;
+}
+
+// A player report is due: now, or at the next release point
+static void request_player_report(gamepad_connection_t *connection)
+{
+    if (!event_schedule_enabled || !event_schedule_locked(&connection->schedule)) {
+        gamepad_connection_request_can_send_now(connection);
+        return;
+    }
+    if (connection->reports_held) return;
+    connection->reports_held = 1;
+    connection->release_us = event_schedule_next_release(&connection->schedule, time_us_32());
+    release_timer_arm();
+}
+
+void send_player_input(uint8_t player, gamepad_report_t *report)
+{
+    if (player >= GAMEPAD_PLAYERS) return;
+
+    // Age the pending report from its newest content, not from repeats
+    if (!gamepad_report_equal(report, &current_state[player])) {
+        if (player == 0) {
+            latency_stats_input();
+        }
+        power_governor_activity();
+    }
+    current_state[player] = *report;
+
+#if GAMEPAD_USB_HID
+    if (usb_hid_active()) {
+        usb_hid_post(player, report);
+        return;
+    }
+#endif
+
+    // Fan out; each central is paced by its own CAN_SEND_NOW. The starting
+    // central rotates so none is always first in line for a free buffer.
+    static int fan_out_start;
+    fan_out_start = (fan_out_start + 1) % GAMEPAD_MAX_CONNECTIONS;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at((fan_out_start + i) % GAMEPAD_MAX_CONNECTIONS);
+        if (!(connection->input_subscribed & (1u << player))) continue;
+        if (!report_mailbox_post(&connection->mailbox[player], report)) continue;
+        TRACE(REPORT_REQUEST, report->buttons, (uint16_t)(player + 1));
+        request_player_report(connection);
+    }
+}
+
+void send_gamepad_input(gamepad_report_t *report)
+{
+    send_player_input(0, report);
+}
+
+#if GAMEPAD_USB_HID
+void gamepad_usb_changed(bool active)
+{
+    if (active) {
+        if (gamepad_connections_subscribed() == 0) {
+            start_demo();
+        }
+        for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+            usb_hid_post(player, &current_state[player]);
+        }
+    }
+
+    // The centrals get a neutral state while USB carries the players, and
+    // the current one when it is gone
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        bool due = false;
+        for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+            if (!(connection->input_subscribed & (1u << player))) continue;
+            if (report_mailbox_post(&connection->mailbox[player], central_state(player))) {
+                due = true;
+            }
+        }
+        if (due) {
+            request_player_report(connection);
+        }
+    }
+}
+#endif
+
+void send_motion_input(void)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (motion_report_due(connection)) {
+            gamepad_connection_request_can_send_now(connection);
+        }
+    }
+}
+
+static void gamepad_can_send_now(gamepad_connection_t *connection)
+{
+#if GAMEPAD_THROUGHPUT_TEST
+    if (throughput_test_active()) {
+        throughput_test_can_send_now(connection);
+        return;
+    }
+#endif
+
+    // One report per grant. Only players with something due take part, in
+    // turn, so a busy player cannot starve the others. Held reports wait
+    // for their release point, even if a grant comes along for motion.
+    gamepad_report_t report;
+    bool player_sent = false;
+    bool released = connection->release_granted;
+    connection->release_granted = 0;
+    for (int i = 0; i < GAMEPAD_PLAYERS && !connection->reports_held; i++) {
+        uint8_t player = (uint8_t)((connection->next_player + i) % GAMEPAD_PLAYERS);
+        report_mailbox_t *mailbox = &connection->mailbox[player];
+        if (!mailbox->request_outstanding) continue;
+        if (player == 0) {
+            latency_stats_can_send_now();
+        }
+        if (!report_mailbox_take(mailbox, &report, btstack_run_loop_get_time_ms())) continue;
+        player_sent = send_gamepad_report(connection, player, &report);
+        connection->next_player = (uint8_t)((player + 1) % GAMEPAD_PLAYERS);
+        // Only a report the controller had to itself tells whether the
+        // lead is long enough
+        if (player_sent && released && connection->acl_queued == 1) {
+            event_schedule_released(&connection->schedule, connection->release_us);
+            connection->report_released = 1;
+        }
+        break;
+    }
+
+    // Motion only gets grants the players leave
+    if (motion_report_due(connection)) {
+        if (player_sent) {
+            motion_report_deferred();
+        } else {
+            motion_report_send(connection);
+        }
+    }
+
+    // Chain the next grant while players are waiting. BTstack grants it as
+    // soon as the controller has a free buffer, so the changed players fill
+    // the same connection event instead of one event each.
+    bool waiting = motion_report_due(connection);
+    for (int player = 0; player < GAMEPAD_PLAYERS && !waiting && !connection->reports_held; player++) {
+        waiting = connection->mailbox[player].request_outstanding;
+    }
+    if (waiting) {
+        gamepad_connection_request_can_send_now(connection);
+    }
+}
+
+// The controller freed buffers: the completion times teach the central's
+// event schedule, and a central with nothing left queued may be due motion.
+// With every link drained, the gap before the next event takes a flash write.
+static void gamepad_completed_packets(const uint8_t *packet)
+{
+    uint32_t now_us = time_us_32();
+    uint8_t num_handles = packet[2];
+    int offset = 3;
+    for (uint8_t i = 0; i < num_handles; i++) {
+        hci_con_handle_t con_handle = little_endian_read_16(packet, offset) & 0x0fff;
+        uint16_t num_packets = little_endian_read_16(packet, offset + 2);
+        offset += 4;
+        gamepad_connection_t *connection = gamepad_connection_find(con_handle);
+        if (!connection) continue;
+        // Packets the report path did not count (ATT responses, the
+        // throughput test) complete too; the counts only reach zero early
+        uint8_t acl_queued = connection->acl_queued;
+        connection->acl_queued = (uint8_t)(num_packets < acl_queued ? acl_queued - num_packets : 0);
+
+        const link_params_t *link = gamepad_connection_link(connection);
+        event_schedule_set_interval(&connection->schedule, link ? link_params_interval_us(link) : 0);
+        event_schedule_completed(&connection->schedule, now_us);
+        uint8_t report_queued = connection->report_queued;
+        if (report_queued) {
+            connection->report_queued = (uint8_t)(num_packets < report_queued ? report_queued - num_packets : 0);
+            if (!connection->report_queued) {
+                if (connection->report_released) {
+                    connection->report_released = 0;
+                    event_schedule_report_completed(&connection->schedule, now_us);
+                }
+                if (connection->report_timed) {
+                    connection->report_timed = 0;
+                    latency_stats_completed();
+                }
+            }
+        }
+
+        if (motion_report_due(connection)) {
+            gamepad_connection_request_can_send_now(connection);
+        }
+    }
+
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        const gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (connection->con_handle != HCI_CON_HANDLE_INVALID && connection->acl_queued) return;
+    }
+    deferred_tlv_window();
+}
+
+static void keepalive_timer_handler(btstack_timer_source_t *ts)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+            if (!(connection->input_subscribed & (1u << player))) continue;
+            if (report_mailbox_keepalive(&connection->mailbox[player], btstack_run_loop_get_time_ms())) {
+                gamepad_connection_request_can_send_now(connection);
+            }
+        }
+    }
+    btstack_run_loop_set_timer(ts, keepalive_ms);
+    btstack_run_loop_add_timer(ts);
+}
+
+void gamepad_set_keepalive(uint32_t period_ms)
+{
+    keepalive_ms = period_ms;
+    gamepad_connections_set_keepalive(period_ms);
+    btstack_run_loop_remove_timer(&keepalive_timer);
+    if (!period_ms) return;
+    keepalive_timer.process = &keepalive_timer_handler;
+    btstack_run_loop_set_timer(&keepalive_timer, period_ms);
+    btstack_run_loop_add_timer(&keepalive_timer);
+}
+
+uint32_t gamepad_keepalive(void)
+{
+    return keepalive_ms;
+}
+
+void gamepad_init(void)
+{
+    memset(current_state, 0, sizeof(current_state));
+    for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+        current_state[player].dpad = DPAD_NEUTRAL;
+    }
+    gamepad_connections_init(GAMEPAD_KEEPALIVE_MS, &gamepad_can_send_now);
+    latency_stats_reset();
+    link_tuning_init();
+    power_governor_init();
+    reconnect_init();
+    rumble_init();
+    motion_report_init();
+    release_timer.process = &release_timer_handler;
+#if GAMEPAD_USB_HID
+    usb_hid_init();
+#endif
+
+    gamepad_set_keepalive(GAMEPAD_KEEPALIVE_MS);
+}
+
+void gamepad_stats_dump(void)
+{
+    const input_pipeline_stats_t *pipeline = input_pipeline_get_stats();
+
+    latency_stats_dump();
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        const gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (connection->con_handle == HCI_CON_HANDLE_INVALID) continue;
+        for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+            const report_mailbox_t *mailbox = &connection->mailbox[player];
+            printf("Central 0x%04x player %d: %lu posted, %lu coalesced, %lu suppressed, %lu sent, %lu keep-alives\n",
+                   connection->con_handle, player + 1, (unsigned long)mailbox->posted,
+                   (unsigned long)mailbox->coalesced, (unsigned long)mailbox->suppressed,
+                   (unsigned long)mailbox->sent, (unsigned long)mailbox->keepalives);
+        }
+        event_schedule_dump(&connection->schedule, connection->con_handle);
+    }
+    printf("Sampler: %lu pushed, %lu dropped, %lu drained, %lu forwarded\n", (unsigned long)pipeline->pushed,
+           (unsigned long)pipeline->dropped, (unsigned long)pipeline->drained, (unsigned long)pipeline->forwarded);
+    power_governor_dump();
+    reconnect_dump();
+    rumble_dump();
+    motion_report_dump();
+#if GAMEPAD_USB_HID
+    usb_hid_dump();
+#endif
+    deferred_tlv_dump();
+#if GAMEPAD_TUNING_SERVICE
+    tuning_service_dump();
+#endif
+#if GAMEPAD_BATTERY_MONITOR
+    battery_monitor_dump();
+#endif
+    boot_timeline_dump();
+}
+
+void gamepad_stats_reset(void)
+{
+    latency_stats_reset();
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+            report_mailbox_t *mailbox = &gamepad_connection_at(i)->mailbox[player];
+            mailbox->posted = 0;
+            mailbox->coalesced = 0;
+            mailbox->suppressed = 0;
+            mailbox->sent = 0;
+            mailbox->keepalives = 0;
+        }
+        event_schedule_t *schedule = &gamepad_connection_at(i)->schedule;
+        schedule->completions = 0;
+        schedule->releases = 0;
+        schedule->late = 0;
+        schedule->relocks = 0;
+    }
+    input_pipeline_reset_stats();
+    motion_report_reset_stats();
+#if GAMEPAD_USB_HID
+    usb_hid_reset_stats();
+#endif
+    deferred_tlv_reset_stats();
+#if GAMEPAD_TUNING_SERVICE
+    tuning_service_reset_stats();
+#endif
+#if GAMEPAD_BATTERY_MONITOR
+    battery_monitor_reset_stats();
+#endif
+}
+
+// Demo functionality: input scripts replayed as player input. The built-in
+// demo is compiled from demo_script.txt; others come from the console.
+
+// Players of a single-player script run it this far apart
+#define DEMO_PLAYER_OFFSET_MS 1000
+
+// Script to play and how; written by core0
+typedef struct {
+    input_script_t script;
+    uint16_t speed_percent;
+    bool loop;
+} script_request_t;
+
+static script_request_t script_request = {{}, 100, true};
+
+// Replays of the active script: one for a multi-player script, otherwise
+// one per player. Owned by core1 in GAMEPAD_DUAL_CORE builds.
+static input_script_t active_script;
+static input_script_replay_t replays[GAMEPAD_PLAYERS];
+static int replay_count;
+
+static void script_replays_start(const script_request_t *request, uint32_t now_us)
+{
+    active_script = request->script;
+    if (active_script.players > 1) {
+        replay_count = 1;
+        input_script_replay_start(&replays[0], &active_script, now_us, request->speed_percent, request->loop, 0);
+        return;
+    }
+    replay_count = GAMEPAD_PLAYERS;
+    for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+        // Later players start further into the script
+        uint32_t offset_us = (uint32_t)((uint64_t)player * DEMO_PLAYER_OFFSET_MS * 1000 * 100 / request->speed_percent);
+        input_script_replay_start(&replays[player], &active_script, now_us - offset_us, request->speed_percent,
+                                  request->loop, (uint8_t)player);
+    }
+}
+
+// Apply due records; returns a bit per player whose input changed
+static uint32_t script_replays_poll(uint32_t now_us)
+{
+    uint32_t changed = 0;
+    for (int i = 0; i < replay_count; i++) {
+        int marker;
+        changed |= input_script_replay_poll(&replays[i], now_us, &marker);
+        if (i == 0 && marker != INPUT_SCRIPT_NO_MARKER) {
+            TRACE(SCRIPT_MARK, (uint16_t)marker);
+        }
+    }
+    return changed;
+}
+
+static const gamepad_report_t *script_replays_state(uint8_t player)
+{
+    return &replays[replay_count == 1 ? 0 : player].state[player];
+}
+
+#if GAMEPAD_DUAL_CORE
+
+// Core0 bumps the generation after filling script_request; core1 starts the
+// replays and acknowledges
+static std::atomic<uint32_t> script_generation;
+static std::atomic<uint32_t> script_applied;
+
+bool gamepad_script_busy(void)
+{
+    return script_generation.load(std::memory_order_relaxed) != script_applied.load(std::memory_order_acquire);
+}
+
+static void script_submit(const script_request_t *request)
+{
+    // Core1 picks up a request within one sampling period
+    while (gamepad_script_busy()) {
+        tight_loop_contents();
+    }
+    script_request = *request;
+    script_generation.fetch_add(1, std::memory_order_release);
+}
+
+void demo_read(uint8_t player, gamepad_report_t *report, uint32_t now_us)
+{
+    if (player == 0) {
+        uint32_t generation = script_generation.load(std::memory_order_acquire);
+        if (generation != script_applied.load(std::memory_order_relaxed)) {
+            script_replays_start(&script_request, now_us);
+            script_applied.store(generation, std::memory_order_release);
+        }
+        script_replays_poll(now_us);
+    }
+    if (replay_count == 0) {
+        // Neutral until the first central subscribes
+        memset(report, 0, sizeof(*report));
+        report->dpad = DPAD_NEUTRAL;
+        return;
+    }
+    *report = *script_replays_state(player);
+}
+
+#else
+
+static btstack_timer_source_t demo_timer;
+
+bool gamepad_script_busy(void)
+{
+    return false;
+}
+
+static void demo_timer_handler(btstack_timer_source_t *ts)
+{
+    uint32_t now_us = time_us_32();
+    uint32_t changed = script_replays_poll(now_us);
+    for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+        if (!(changed & (1u << player))) continue;
+        gamepad_report_t report = *script_replays_state(player);
+        send_player_input(player, &report);
+    }
+
+    // Sleep until the next record; the run loop timer has 1 ms resolution
+    uint32_t wait_us = UINT32_MAX;
+    for (int i = 0; i < replay_count; i++) {
+        uint32_t replay_wait_us = input_script_replay_wait_us(&replays[i], now_us);
+        if (replay_wait_us < wait_us) wait_us = replay_wait_us;
+    }
+    if (wait_us == UINT32_MAX) return;
+    uint32_t wait_ms = (wait_us + 999) / 1000;
+    btstack_run_loop_set_timer(ts, wait_ms ? wait_ms : 1);
+    btstack_run_loop_add_timer(ts);
+}
+
+static void script_submit(const script_request_t *request)
+{
+    script_request = *request;
+    btstack_run_loop_remove_timer(&demo_timer);
+    script_replays_start(&script_request, time_us_32());
+
+    // Players start from neutral
+    for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+        gamepad_report_t report = *script_replays_state(player);
+        send_player_input(player, &report);
+    }
+    demo_timer.process = &demo_timer_handler;
+    btstack_run_loop_set_timer(&demo_timer, 0);
+    btstack_run_loop_add_timer(&demo_timer);
+}
+
+#endif
+
+int gamepad_script_play(const uint8_t *data, uint32_t size)
+{
+    script_request_t request = script_request;
+    if (!data) {
+        data = demo_script;
+        size = sizeof(demo_script);
+    }
+    if (input_script_open(&request.script, data, size) != 0) return -1;
+    script_submit(&request);
+    return 0;
+}
+
+// New options take effect by replaying the loaded script from its start;
+// before the first script they are only kept
+static void script_restart(const script_request_t *request)
+{
+    if (request->script.data) {
+        script_submit(request);
+    } else {
+        script_request = *request;
+    }
+}
+
+void gamepad_script_set_speed(uint16_t speed_percent)
+{
+    script_request_t request = script_request;
+    request.speed_percent = speed_percent ? speed_percent : 100;
+    script_restart(&request);
+}
+
+void gamepad_script_set_loop(bool loop)
+{
+    script_request_t request = script_request;
+    request.loop = loop;
+    script_restart(&request);
+}
+
+void start_demo(void)
+{
+    printf("Starting gamepad demo...\n");
+    if (!script_request.script.data) {
+        gamepad_script_play(NULL, 0);
+    } else {
+        // Replay whatever script is loaded from its start
+        script_submit(&script_request);
+    }
+}
+
+// Start streaming a player's reports to a central
+static void gamepad_subscribe(gamepad_connection_t *connection, uint8_t player)
+{
+    if (gamepad_connections_subscribed() == 0) {
+        start_demo();
+    }
+    connection->input_subscribed |= (uint8_t)(1u << player);
+
+    // A new subscriber starts from the current state
+    report_mailbox_post(&connection->mailbox[player], central_state(player));
+    if (report_mailbox_link_up(&connection->mailbox[player])) {
+        gamepad_connection_request_can_send_now(connection);
+    }
+    link_tuning_start(connection->con_handle);
+    power_governor_activity();
+}
+
+void gamepad_resume_reports(hci_con_handle_t con_handle, uint8_t input_subscribed)
+{
+    gamepad_connection_t *connection = gamepad_connection_add(con_handle);
+    if (!connection) return;
+    for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+        if (!(input_subscribed & (1u << player)) || (connection->input_subscribed & (1u << player))) continue;
+        gamepad_subscribe(connection, player);
+    }
+    reconnect_subscribed(con_handle, connection->input_subscribed);
+}
+
+void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size)
+{
+    UNUSED(channel);
+    UNUSED(size);
+
+    hci_con_handle_t con_handle;
+    gamepad_connection_t *connection;
+
+    if (packet_type != HCI_EVENT_PACKET) return;
+
+    switch (hci_event_packet_get_type(packet)) {
+        case HCI_EVENT_DISCONNECTION_COMPLETE:
+            // Only this central's state goes; others keep streaming
+            con_handle = hci_event_disconnection_complete_get_connection_handle(packet);
+            link_tuning_stop(con_handle);
+            connection = gamepad_connection_find(con_handle);
+            if (connection) {
+                gamepad_connection_remove(connection);
+            }
+            printf("Disconnected: 0x%04x\n", con_handle);
+            rumble_link_lost(con_handle);
+            reconnect_link_lost(con_handle);
+            break;
+            
+        case HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS:
+            gamepad_completed_packets(packet);
+#if GAMEPAD_THROUGHPUT_TEST
+            throughput_test_completed_packets(packet);
+#endif
+            break;
+            
+        case SM_EVENT_JUST_WORKS_REQUEST:
+            printf("Just Works authentication requested\n");
+            sm_just_works_confirm(sm_event_just_works_request_get_handle(packet));
+            break;
+            
+        case SM_EVENT_NUMERIC_COMPARISON_REQUEST:
+            printf("Numeric comparison: %" PRIu32 "\n", sm_event_numeric_comparison_request_get_passkey(packet));
+            sm_numeric_comparison_confirm(sm_event_passkey_display_number_get_handle(packet));
+            break;
+            
+        case SM_EVENT_PASSKEY_DISPLAY_NUMBER:
+            printf("Display Passkey: %" PRIu32 "\n", sm_event_passkey_display_number_get_passkey(packet));
+            break;
+            
+        case HCI_EVENT_HIDS_META:
+            switch (hci_event_hids_meta_get_subevent_code(packet)) {
+                case HIDS_SUBEVENT_INPUT_REPORT_ENABLE: {
+                    con_handle = hids_subevent_input_report_enable_get_con_handle(packet);
+                    uint8_t report_id = hids_subevent_input_report_enable_get_report_id(packet);
+                    printf("Input report %u subscribed on 0x%04x: %u\n", report_id, con_handle,
+                           hids_subevent_input_report_enable_get_enable(packet));
+                    uint8_t player = (uint8_t)(report_id - GAMEPAD_REPORT_ID);
+                    if (player >= GAMEPAD_PLAYERS && report_id != GAMEPAD_MOTION_REPORT_ID) break;
+                    connection = gamepad_connection_add(con_handle);
+                    if (!connection) {
+                        printf("No room for another central\n");
+                        break;
+                    }
+                    if (report_id == GAMEPAD_MOTION_REPORT_ID) {
+                        motion_report_subscribe(connection, hids_subevent_input_report_enable_get_enable(packet));
+                        break;
+                    }
+                    if (!hids_subevent_input_report_enable_get_enable(packet)) {
+                        connection->input_subscribed &= (uint8_t)~(1u << player);
+                        report_mailbox_link_down(&connection->mailbox[player]);
+                    } else {
+                        gamepad_subscribe(connection, player);
+                    }
+                    reconnect_subscribed(con_handle, connection->input_subscribed);
+                    break;
+                }
+                    
+                case HIDS_SUBEVENT_BOOT_KEYBOARD_INPUT_REPORT_ENABLE:
+                    con_handle = hids_subevent_boot_keyboard_input_report_enable_get_con_handle(packet);
+                    printf("Boot report subscribed on 0x%04x: %u\n", con_handle,
+                           hids_subevent_boot_keyboard_input_report_enable_get_enable(packet));
+                    connection = gamepad_connection_add(con_handle);
+                    if (connection) {
+                        connection->boot_subscribed = hids_subevent_boot_keyboard_input_report_enable_get_enable(packet);
+                    }
+                    break;
+                    
+                case HIDS_SUBEVENT_PROTOCOL_MODE:
+                    con_handle = hids_subevent_protocol_mode_get_con_handle(packet);
+                    connection = gamepad_connection_add(con_handle);
+                    if (!connection) break;
+                    connection->protocol_mode = hids_subevent_protocol_mode_get_protocol_mode(packet);
+                    printf("Protocol mode on 0x%04x: %s\n", con_handle, connection->protocol_mode ? "Report" : "Boot");
+                    break;
+                    
+                case HIDS_SUBEVENT_SET_REPORT:
+                    if (hids_subevent_set_report_get_report_type(packet) != HID_REPORT_TYPE_OUTPUT ||
+                        hids_subevent_set_report_get_report_id(packet) != GAMEPAD_RUMBLE_REPORT_ID) {
+                        break;
+                    }
+                    rumble_set_report(hids_subevent_set_report_get_con_handle(packet),
+                                      hids_subevent_set_report_get_report_data(packet),
+                                      hids_subevent_set_report_get_report_length(packet));
+                    // A game is driving the pad: the next write should not
+                    // wait out peripheral latency
+                    power_governor_activity();
+                    break;
+            }
+            break;
+    }
+}
@@ -0,0 +1,121 @@
+// *****************************************************************************
+// Generic Bluetooth LE Gamepad - report path
+//
+// Report structure, report sending and the BTstack event handler. The HID
+// descriptor and wire format are generated from gamepad_layout.h. Kept free
+// of Pico SDK dependencies so it also builds on the host against the mock
+// BTstack in host/mock.
+// *****************************************************************************
+
+#ifndef GAMEPAD_H
+#define GAMEPAD_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+
+// Generic Gamepad Button Definitions (16 buttons)
+#define GAMEPAD_BUTTON_1       0x0001  // Face Button 1 (A/Cross)
+#define GAMEPAD_BUTTON_2       0x0002  // Face Button 2 (B/Circle)
+#define GAMEPAD_BUTTON_3       0x0004  // Face Button 3 (X/Square)
+#define GAMEPAD_BUTTON_4       0x0008  // Face Button 4 (Y/Triangle)
+#define GAMEPAD_BUTTON_L1      0x0010  // Left Shoulder Button
+#define GAMEPAD_BUTTON_R1      0x0020  // Right Shoulder Button
+#define GAMEPAD_BUTTON_SELECT  0x0040  // Select/Back Button
+#define GAMEPAD_BUTTON_START   0x0080  // Start/Menu Button
+#define GAMEPAD_BUTTON_L3      0x0100  // Left Stick Click
+#define GAMEPAD_BUTTON_R3      0x0200  // Right Stick Click
+#define GAMEPAD_BUTTON_HOME    0x0400  // Home/Guide Button
+#define GAMEPAD_BUTTON_EXTRA1  0x0800  // Extra Button 1
+#define GAMEPAD_BUTTON_EXTRA2  0x1000  // Extra Button 2
+#define GAMEPAD_BUTTON_EXTRA3  0x2000  // Extra Button 3
+#define GAMEPAD_BUTTON_EXTRA4  0x4000  // Extra Button 4
+#define GAMEPAD_BUTTON_EXTRA5  0x8000  // Extra Button 5
+
+// D-Pad directions
+#define DPAD_UP           0
+#define DPAD_UP_RIGHT     1
+#define DPAD_RIGHT        2
+#define DPAD_DOWN_RIGHT   3
+#define DPAD_DOWN         4
+#define DPAD_DOWN_LEFT    5
+#define DPAD_LEFT         6
+#define DPAD_UP_LEFT      7
+#define DPAD_NEUTRAL      8
+
+// Generic Gamepad Report Structure (Windows-compatible)
+typedef struct {
+    uint16_t buttons;     // Button states (16 buttons used)
+    int16_t left_x;       // Left stick X (-32768 to 32767)
+    int16_t left_y;       // Left stick Y (-32768 to 32767)
+    int16_t right_x;      // Right stick X (-32768 to 32767)
+    int16_t right_y;      // Right stick Y (-32768 to 32767)
+    uint8_t left_trigger; // Left trigger (0-255)
+    uint8_t right_trigger;// Right trigger (0-255)
+    uint8_t dpad;         // D-pad direction (0-7, 8=neutral)
+} gamepad_report_t;
+
+// Initialize report state; call once before the first event
+void gamepad_init(void);
+
+// Queue a new input state for the next notification
+void send_gamepad_input(gamepad_report_t *report);
+
+// Same for one player, 0 .. GAMEPAD_PLAYERS - 1 (send_gamepad_input() is player 0)
+void send_player_input(uint8_t player, gamepad_report_t *report);
+
+// New motion samples were fused: offer a motion report to the centrals
+// that are due one (motion_report.h)
+void send_motion_input(void);
+
+// Release the player reports held for connection event release points that
+// have been reached (event_schedule.h); called by the input pipeline when
+// core1 sampled at one, and by the backstop timer
+void gamepad_release_reports(void);
+
+// Hold player reports for the connection event schedule (GAMEPAD_EVENT_SCHEDULE)
+// or send them as soon as inputs change
+void gamepad_set_event_schedule(bool enable);
+bool gamepad_event_schedule(void);
+
+// Resend the last report after this much silence (0 = only on change;
+// GAMEPAD_KEEPALIVE_MS after gamepad_init())
+void gamepad_set_keepalive(uint32_t period_ms);
+uint32_t gamepad_keepalive(void);
+
+// USB took over the player reports from the centrals, or gave them back
+// (usb_hid.h)
+void gamepad_usb_changed(bool active);
+
+// Stream the given players (bit per player) to a central whose bonded host
+// subscribed in an earlier connection and keeps its CCCDs
+void gamepad_resume_reports(hci_con_handle_t con_handle, uint8_t input_subscribed);
+
+// Start the demo: the loaded input script from its start, the built-in
+// one if none was played yet
+void start_demo(void);
+
+// Replay an input script (see input_script.h) as player input, NULL for
+// the built-in demo. data must stay valid while it plays. Returns -1 if it
+// is not a valid script.
+int gamepad_script_play(const uint8_t *data, uint32_t size);
+
+// Replay speed (100 = recorded cadence) and looping; the script restarts
+void gamepad_script_set_speed(uint16_t speed_percent);
+void gamepad_script_set_loop(bool loop);
+
+// True while core1 has not yet switched to the last requested script, so
+// the previous script's data is still in use
+bool gamepad_script_busy(void);
+
+// Print / clear latency histograms and report counters
+void gamepad_stats_dump(void);
+void gamepad_stats_reset(void);
+
+// Current demo input of a player, sampled by core1 (GAMEPAD_DUAL_CORE builds)
+void demo_read(uint8_t player, gamepad_report_t *report, uint32_t now_us);
+
+// HCI, SM and HIDS event handler
+void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+
+#endif // GAMEPAD_H
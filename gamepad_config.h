@@ -0,0 +1,389 @@
+// *****************************************************************************
+// Generic Bluetooth LE Gamepad - tunables
+//
+// Compile-time defaults; override with target_compile_definitions().
+// *****************************************************************************
+
+#ifndef GAMEPAD_CONFIG_H
+#define GAMEPAD_CONFIG_H
+
+// Centrals served at the same time (also sizes BTstack's MAX_NR_HCI_CONNECTIONS)
+#ifndef GAMEPAD_MAX_CONNECTIONS
+#define GAMEPAD_MAX_CONNECTIONS 2
+#endif
+
+// Gamepads exposed by one board, each with its own report ID (1 .. 4; the
+// GATT database declares four input report characteristics)
+#ifndef GAMEPAD_PLAYERS
+#define GAMEPAD_PLAYERS 1
+#endif
+#if GAMEPAD_PLAYERS < 1 || GAMEPAD_PLAYERS > 4
+#error "GAMEPAD_PLAYERS must be 1 .. 4"
+#endif
+
+// Resend the last report after this much silence even if nothing changed
+// (0 = only send on change)
+#ifndef GAMEPAD_KEEPALIVE_MS
+#define GAMEPAD_KEEPALIVE_MS 0
+#endif
+
+// Sample inputs on core1 and hand them to BTstack on core0 (0 = demo timer
+// on the BTstack run loop, as used by the host build)
+#ifndef GAMEPAD_DUAL_CORE
+#define GAMEPAD_DUAL_CORE 1
+#endif
+
+// Input sampling period on core1
+#ifndef GAMEPAD_SAMPLE_PERIOD_US
+#define GAMEPAD_SAMPLE_PERIOD_US 1000
+#endif
+
+// Snapshots buffered between core1 and core0 (power of two)
+#ifndef INPUT_RING_SIZE
+#define INPUT_RING_SIZE 32
+#endif
+
+// Read sticks and triggers from the ADC instead of the demo pattern
+#ifndef GAMEPAD_ANALOG_INPUTS
+#define GAMEPAD_ANALOG_INPUTS 0
+#endif
+
+// ADC oversampling per output value: 2^N rounds, N = 2 (4x) .. 6 (64x)
+#ifndef ANALOG_OVERSAMPLE_LOG2
+#define ANALOG_OVERSAMPLE_LOG2 4
+#endif
+
+// Complete analog frames (all channels) per second
+#ifndef ANALOG_FRAME_RATE_HZ
+#define ANALOG_FRAME_RATE_HZ 1000
+#endif
+
+// GPIO selecting the external analog mux bank (low = A, high = B)
+#ifndef ANALOG_MUX_GPIO
+#define ANALOG_MUX_GPIO 22
+#endif
+
+// Read the 16 buttons from GPIOs through the PIO scanner instead of the demo
+// pattern (player 1)
+#ifndef GAMEPAD_BUTTON_INPUTS
+#define GAMEPAD_BUTTON_INPUTS 0
+#endif
+
+// First of 16 consecutive button GPIOs, GAMEPAD_BUTTON_1 .. GAMEPAD_BUTTON_EXTRA5;
+// buttons close to ground against the internal pull-ups
+#ifndef BUTTON_GPIO_BASE
+#define BUTTON_GPIO_BASE 2
+#endif
+
+// PIO sampling period, and consecutive equal samples that make a new state
+// (1..32): 50 us x 10 accepts an edge 0.5 ms after the contact settles
+#ifndef BUTTON_SAMPLE_PERIOD_US
+#define BUTTON_SAMPLE_PERIOD_US 50
+#endif
+
+#ifndef BUTTON_DEBOUNCE_SAMPLES
+#define BUTTON_DEBOUNCE_SAMPLES 10
+#endif
+
+// Default stick and trigger processing, used until a profile is stored:
+// stick deflection read as centered and per-axis center band (0..32767),
+// and raw trigger values read as released / fully pressed
+#ifndef AXIS_RADIAL_DEADZONE
+#define AXIS_RADIAL_DEADZONE 1600
+#endif
+#ifndef AXIS_AXIAL_DEADZONE
+#define AXIS_AXIAL_DEADZONE 0
+#endif
+#ifndef AXIS_TRIGGER_LOW
+#define AXIS_TRIGGER_LOW 4
+#endif
+#ifndef AXIS_TRIGGER_HIGH
+#define AXIS_TRIGGER_HIGH 251
+#endif
+
+// Connection interval to ask for after subscription (1.25 ms units), as is;
+// rejected requests fall back to those of 11.25, 15 and 15..30 ms not
+// shorter than it
+#ifndef LINK_TARGET_INTERVAL
+#define LINK_TARGET_INTERVAL 6
+#endif
+
+// Peripheral latency to ask for (0 = listen at every connection event)
+#ifndef LINK_TARGET_LATENCY
+#define LINK_TARGET_LATENCY 0
+#endif
+
+// Supervision timeout to ask for (10 ms units)
+#ifndef LINK_SUPERVISION_TIMEOUT
+#define LINK_SUPERVISION_TIMEOUT 200
+#endif
+
+// Treat an unanswered interval request as rejected after this long
+#ifndef LINK_REQUEST_TIMEOUT_MS
+#define LINK_REQUEST_TIMEOUT_MS 5000
+#endif
+
+// Ask for the LE 2M PHY
+#ifndef LINK_PREFER_2M_PHY
+#define LINK_PREFER_2M_PHY 1
+#endif
+
+// LL payload to ask for with data length extension (27..251)
+#ifndef LINK_MAX_TX_OCTETS
+#define LINK_MAX_TX_OCTETS 251
+#endif
+
+// Power governor: with no input change for POWER_IDLE_AFTER_MS the links go
+// to the idle interval and peripheral latency, after POWER_SLEEP_AFTER_MS to
+// the sleep ones (1.25 ms units / events the peripheral may skip). Any input
+// change returns to the LINK_TARGET_* parameters at once; a state is kept at
+// least POWER_MIN_DWELL_MS before stepping down again (0 = governor off)
+#ifndef GAMEPAD_POWER_GOVERNOR
+#define GAMEPAD_POWER_GOVERNOR 1
+#endif
+#ifndef POWER_IDLE_AFTER_MS
+#define POWER_IDLE_AFTER_MS 5000
+#endif
+#ifndef POWER_IDLE_INTERVAL
+#define POWER_IDLE_INTERVAL 12
+#endif
+#ifndef POWER_IDLE_LATENCY
+#define POWER_IDLE_LATENCY 4
+#endif
+#ifndef POWER_SLEEP_AFTER_MS
+#define POWER_SLEEP_AFTER_MS 60000
+#endif
+#ifndef POWER_SLEEP_INTERVAL
+#define POWER_SLEEP_INTERVAL 40
+#endif
+#ifndef POWER_SLEEP_LATENCY
+#define POWER_SLEEP_LATENCY 9
+#endif
+#ifndef POWER_MIN_DWELL_MS
+#define POWER_MIN_DWELL_MS 2000
+#endif
+
+// The central drops a link that stays silent for the supervision timeout;
+// keep it above twice the longest gap peripheral latency allows
+#if (POWER_SLEEP_LATENCY + 1) * POWER_SLEEP_INTERVAL * 125 * 2 >= LINK_SUPERVISION_TIMEOUT * 1000 || \
+    (POWER_IDLE_LATENCY + 1) * POWER_IDLE_INTERVAL * 125 * 2 >= LINK_SUPERVISION_TIMEOUT * 1000
+#error "Peripheral latency too long for LINK_SUPERVISION_TIMEOUT"
+#endif
+
+// Advertising interval (0.625 ms units): fast after boot and disconnects
+// for ADV_FAST_DURATION_MS, then slow until a central connects
+#ifndef ADV_FAST_INTERVAL_MIN
+#define ADV_FAST_INTERVAL_MIN 0x0020
+#endif
+#ifndef ADV_FAST_INTERVAL_MAX
+#define ADV_FAST_INTERVAL_MAX 0x0040
+#endif
+#ifndef ADV_FAST_DURATION_MS
+#define ADV_FAST_DURATION_MS 30000
+#endif
+#ifndef ADV_SLOW_INTERVAL_MIN
+#define ADV_SLOW_INTERVAL_MIN 0x0660
+#endif
+#ifndef ADV_SLOW_INTERVAL_MAX
+#define ADV_SLOW_INTERVAL_MAX 0x0800
+#endif
+
+// After power-on or a link loss, advertise directed at the last bonded host
+// this long before advertising to everyone (0 = never; the controller ends
+// high duty cycle directed advertising after 1.28 s)
+#ifndef RECONNECT_DIRECTED_MS
+#define RECONNECT_DIRECTED_MS 1300
+#endif
+
+// Once a central's connection event timing is learned, hold its player
+// reports until just before the next event, so each carries the newest input
+// (see event_schedule.h; 0 = send as soon as inputs change). The release
+// lead starts at SCHEDULE_LEAD_US and adapts down to SCHEDULE_MIN_LEAD_US;
+// SCHEDULE_LOCK_OBSERVATIONS completions on the predicted grid lock it.
+#ifndef GAMEPAD_EVENT_SCHEDULE
+#define GAMEPAD_EVENT_SCHEDULE 1
+#endif
+#ifndef SCHEDULE_LEAD_US
+#define SCHEDULE_LEAD_US 2000
+#endif
+#ifndef SCHEDULE_MIN_LEAD_US
+#define SCHEDULE_MIN_LEAD_US 500
+#endif
+#ifndef SCHEDULE_LOCK_OBSERVATIONS
+#define SCHEDULE_LOCK_OBSERVATIONS 8
+#endif
+
+// Wired transport: while a USB host has the device configured, player
+// reports go over USB HID instead of Bluetooth (see usb_hid.h; 0 keeps them
+// on Bluetooth and leaves the USB port a serial console only). The host
+// polls the interrupt endpoint every USB_HID_POLL_INTERVAL_MS (1 is the
+// fastest at full speed). 0xCafe is TinyUSB's test vendor ID; a product
+// needs its own IDs.
+#ifndef GAMEPAD_USB_HID
+#define GAMEPAD_USB_HID 1
+#endif
+#ifndef USB_HID_POLL_INTERVAL_MS
+#define USB_HID_POLL_INTERVAL_MS 1
+#endif
+#ifndef GAMEPAD_USB_VID
+#define GAMEPAD_USB_VID 0xCAFE
+#endif
+#ifndef GAMEPAD_USB_PID
+#define GAMEPAD_USB_PID 0x4005
+#endif
+
+// Flash writes (bonds, reconnect records, axis profiles) are staged in RAM
+// and written between connection events or while the links are idle (see
+// deferred_tlv.h; 0 writes them at once): DEFERRED_TLV_SLOTS tags of up to
+// DEFERRED_TLV_VALUE_SIZE bytes, each on flash DEFERRED_TLV_MAX_DELAY_MS
+// after it was staged at the latest
+#ifndef GAMEPAD_DEFERRED_FLASH
+#define GAMEPAD_DEFERRED_FLASH 1
+#endif
+#ifndef DEFERRED_TLV_SLOTS
+#define DEFERRED_TLV_SLOTS 8
+#endif
+#ifndef DEFERRED_TLV_VALUE_SIZE
+#define DEFERRED_TLV_VALUE_SIZE 96
+#endif
+#ifndef DEFERRED_TLV_MAX_DELAY_MS
+#define DEFERRED_TLV_MAX_DELAY_MS 2000
+#endif
+
+// Tuning service (tuning_service.h): report, stick and link settings over
+// GATT at run time, and the report counters notified to a subscribed host
+// every TUNING_STATS_PERIOD_MS
+#ifndef GAMEPAD_TUNING_SERVICE
+#define GAMEPAD_TUNING_SERVICE 1
+#endif
+#ifndef TUNING_STATS_PERIOD_MS
+#define TUNING_STATS_PERIOD_MS 1000
+#endif
+
+// Battery level from VSYS (battery_monitor.h): read every
+// BATTERY_SAMPLE_PERIOD_MS, filtered over 2^BATTERY_FILTER_SHIFT readings
+// and mapped through a discharge curve; the Battery Service only hears of
+// a new percentage, and only once the voltage is BATTERY_HYSTERESIS_MV
+// past the step (0 reports 100 % as before)
+#ifndef GAMEPAD_BATTERY_MONITOR
+#define GAMEPAD_BATTERY_MONITOR 1
+#endif
+#ifndef BATTERY_SAMPLE_PERIOD_MS
+#define BATTERY_SAMPLE_PERIOD_MS 2000
+#endif
+#ifndef BATTERY_FILTER_SHIFT
+#define BATTERY_FILTER_SHIFT 3
+#endif
+#ifndef BATTERY_HYSTERESIS_MV
+#define BATTERY_HYSTERESIS_MV 15
+#endif
+
+// Rumble motors, driven by PWM (both on PWM slice 1 by default)
+#ifndef RUMBLE_STRONG_GPIO
+#define RUMBLE_STRONG_GPIO 18
+#endif
+#ifndef RUMBLE_WEAK_GPIO
+#define RUMBLE_WEAK_GPIO 19
+#endif
+
+// Above hearing, well within what motor drivers switch
+#ifndef RUMBLE_PWM_HZ
+#define RUMBLE_PWM_HZ 20000
+#endif
+
+// A running motor stops after this long without a new report, whatever the
+// report asked for
+#ifndef RUMBLE_MAX_ON_MS
+#define RUMBLE_MAX_ON_MS 5000
+#endif
+
+// Read an LSM6DS3 / LSM6DSO IMU on I2C and stream motion reports; see
+// motion_report.h. The motion report is declared either way.
+#ifndef GAMEPAD_MOTION
+#define GAMEPAD_MOTION 0
+#endif
+
+// IMU wiring: I2C0 data and clock, and the IMU's INT1 (gyro data ready)
+#ifndef IMU_I2C_SDA_GPIO
+#define IMU_I2C_SDA_GPIO 20
+#endif
+#ifndef IMU_I2C_SCL_GPIO
+#define IMU_I2C_SCL_GPIO 21
+#endif
+#ifndef IMU_INT_GPIO
+#define IMU_INT_GPIO 0
+#endif
+#ifndef IMU_I2C_ADDRESS
+#define IMU_I2C_ADDRESS 0x6A
+#endif
+#ifndef IMU_I2C_HZ
+#define IMU_I2C_HZ 400000
+#endif
+
+// Output data rate (104, 208, 416 or 833 Hz) and full scales
+#ifndef IMU_SAMPLE_HZ
+#define IMU_SAMPLE_HZ 416
+#endif
+#ifndef IMU_GYRO_RANGE_DPS
+#define IMU_GYRO_RANGE_DPS 2000
+#endif
+#ifndef IMU_ACCEL_RANGE_G
+#define IMU_ACCEL_RANGE_G 8
+#endif
+
+// How fast the fused orientation is pulled towards the measured gravity
+// direction, in thousandths of a radian per second per radian of error
+#ifndef IMU_FUSION_KP_MILLI
+#define IMU_FUSION_KP_MILLI 1000
+#endif
+
+// Turning the pad faster than this counts as activity for the power
+// governor; slower motion and sensor noise do not keep the link awake
+#ifndef IMU_ACTIVITY_DPS
+#define IMU_ACTIVITY_DPS 30
+#endif
+
+// IMU samples carried by one motion report; sets the report size (8: 109
+// bytes, so the central must have exchanged an ATT MTU of at least 112).
+// One report per connection event covers 15 ms at 416 Hz.
+#ifndef MOTION_BATCH_SAMPLES
+#define MOTION_BATCH_SAMPLES 8
+#endif
+
+// Latency histogram resolution: 2^N us per bucket, LATENCY_BUCKETS buckets
+// plus one for overflow (defaults: 256 us up to 16.4 ms)
+#ifndef LATENCY_BUCKET_SHIFT
+#define LATENCY_BUCKET_SHIFT 8
+#endif
+#ifndef LATENCY_BUCKETS
+#define LATENCY_BUCKETS 64
+#endif
+
+// Single-key commands on USB stdio ('h' lists them)
+#ifndef GAMEPAD_CONSOLE
+#define GAMEPAD_CONSOLE 1
+#endif
+
+// Saturation throughput test on the console ('t'); see throughput_test.h
+#ifndef GAMEPAD_THROUGHPUT_TEST
+#define GAMEPAD_THROUGHPUT_TEST 1
+#endif
+
+// RAM for an input script uploaded over the console ('u')
+#ifndef INPUT_SCRIPT_UPLOAD_SIZE
+#define INPUT_SCRIPT_UPLOAD_SIZE 16384
+#endif
+
+// Trace records buffered per core (power of two), and how often / how many
+// per core the run loop prints
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 128
+#endif
+#ifndef TRACE_DRAIN_PERIOD_MS
+#define TRACE_DRAIN_PERIOD_MS 50
+#endif
+#ifndef TRACE_DRAIN_BATCH
+#define TRACE_DRAIN_BATCH 32
+#endif
+
+#endif // GAMEPAD_CONFIG_H
@@ -0,0 +1,110 @@
+// *****************************************************************************
+// Per-connection gamepad state
+// *****************************************************************************
+
+#include "gamepad_connection.h"
+
+static gamepad_connection_t connections[GAMEPAD_MAX_CONNECTIONS];
+static uint32_t connection_keepalive_ms;
+static gamepad_can_send_now_handler_t can_send_now_handler;
+
+static void gamepad_connection_can_send_now(void *context)
+{
+    gamepad_connection_t *connection = (gamepad_connection_t *)context;
+    if (connection->con_handle == HCI_CON_HANDLE_INVALID) return;
+    connection->can_send_requested = 0;
+    can_send_now_handler(connection);
+}
+
+static void gamepad_connection_reset(gamepad_connection_t *connection)
+{
+    connection->con_handle = HCI_CON_HANDLE_INVALID;
+    connection->protocol_mode = 1;
+    connection->input_subscribed = 0;
+    connection->boot_subscribed = 0;
+    connection->can_send_requested = 0;
+    connection->can_send_request.callback = &gamepad_connection_can_send_now;
+    connection->can_send_request.context = connection;
+    connection->next_player = 0;
+    connection->motion_subscribed = 0;
+    connection->acl_queued = 0;
+    connection->motion_sent = 0;
+    connection->report_queued = 0;
+    connection->report_released = 0;
+    connection->report_timed = 0;
+    connection->reports_held = 0;
+    connection->release_granted = 0;
+    connection->release_us = 0;
+    event_schedule_reset(&connection->schedule);
+    for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+        report_mailbox_init(&connection->mailbox[player], connection_keepalive_ms);
+    }
+}
+
+void gamepad_connections_init(uint32_t keepalive_ms, gamepad_can_send_now_handler_t handler)
+{
+    connection_keepalive_ms = keepalive_ms;
+    can_send_now_handler = handler;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_reset(&connections[i]);
+    }
+}
+
+void gamepad_connections_set_keepalive(uint32_t keepalive_ms)
+{
+    connection_keepalive_ms = keepalive_ms;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+            connections[i].mailbox[player].keepalive_ms = keepalive_ms;
+        }
+    }
+}
+
+void gamepad_connection_request_can_send_now(gamepad_connection_t *connection)
+{
+    if (connection->can_send_requested) return;
+    connection->can_send_requested = 1;
+    att_server_register_can_send_now_callback(&connection->can_send_request, connection->con_handle);
+}
+
+gamepad_connection_t *gamepad_connection_find(hci_con_handle_t con_handle)
+{
+    if (con_handle == HCI_CON_HANDLE_INVALID) return NULL;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (connections[i].con_handle == con_handle) return &connections[i];
+    }
+    return NULL;
+}
+
+gamepad_connection_t *gamepad_connection_add(hci_con_handle_t con_handle)
+{
+    gamepad_connection_t *connection = gamepad_connection_find(con_handle);
+    if (connection) return connection;
+
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (connections[i].con_handle == HCI_CON_HANDLE_INVALID) {
+            connections[i].con_handle = con_handle;
+            return &connections[i];
+        }
+    }
+    return NULL;
+}
+
+void gamepad_connection_remove(gamepad_connection_t *connection)
+{
+    gamepad_connection_reset(connection);
+}
+
+gamepad_connection_t *gamepad_connection_at(int index)
+{
+    return &connections[index];
+}
+
+int gamepad_connections_subscribed(void)
+{
+    int count = 0;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (connections[i].input_subscribed) count++;
+    }
+    return count;
+}
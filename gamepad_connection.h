@@ -0,0 +1,86 @@
+// *****************************************************************************
+// Per-connection gamepad state
+//
+// One entry per connected central: its handle, protocol mode, subscription
+// state and one report mailbox per player. Every subscribed central gets the
+// same input, each paced by its own CAN_SEND_NOW, so a slow host never holds
+// back a fast one. The players of a central share its CAN_SEND_NOW: one
+// request is outstanding at a time and each grant carries one player's
+// report. Each entry registers with att_server itself; BTstack's hids_device
+// has a single registration, which two waiting centrals would link into
+// both connections' lists. (Its CCCD and protocol mode values are single
+// too, so what a central reads back is the last write of any central; the
+// report path goes by the per-central state here.) Negotiated link
+// parameters are kept by link_tuning.
+//
+// Notifications the report path handed to the controller are counted until
+// HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS frees their buffers, so a motion
+// report is only sent once nothing else is queued (motion_report.h), and
+// the completion of the newest player report is noticed. The completions
+// also teach the central's event schedule (event_schedule.h); once it is
+// locked, player reports are held until its next release point.
+// *****************************************************************************
+
+#ifndef GAMEPAD_CONNECTION_H
+#define GAMEPAD_CONNECTION_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+#include "event_schedule.h"
+#include "gamepad_config.h"
+#include "link_tuning.h"
+#include "report_mailbox.h"
+
+typedef struct {
+    hci_con_handle_t con_handle;  // HCI_CON_HANDLE_INVALID = free entry
+    uint8_t protocol_mode;        // 1 = report, 0 = boot
+    uint8_t input_subscribed;     // Bit per player report
+    uint8_t boot_subscribed;
+    uint8_t can_send_requested;   // CAN_SEND_NOW requested, not yet served
+    btstack_context_callback_registration_t can_send_request;
+    uint8_t next_player;          // First player to consider at the next grant
+    uint8_t motion_subscribed;
+    uint8_t acl_queued;           // Notifications in the controller
+    uint32_t motion_sent;         // Sample counter of the newest motion sample sent
+    uint8_t report_queued;        // Position of the newest player report in the controller, 0 = gone
+    uint8_t report_released;      // It was released on the schedule
+    uint8_t report_timed;         // It carries the input latency_stats follows
+    uint8_t reports_held;         // Player reports wait for release_us
+    uint8_t release_granted;      // The next grant serves the release
+    uint32_t release_us;
+    event_schedule_t schedule;
+    report_mailbox_t mailbox[GAMEPAD_PLAYERS];
+} gamepad_connection_t;
+
+typedef void (*gamepad_can_send_now_handler_t)(gamepad_connection_t *connection);
+
+// handler is called with the central whenever its CAN_SEND_NOW is granted
+void gamepad_connections_init(uint32_t keepalive_ms, gamepad_can_send_now_handler_t handler);
+
+// Keep-alive period of every mailbox, now and on later connections
+void gamepad_connections_set_keepalive(uint32_t keepalive_ms);
+
+// Ask att_server for CAN_SEND_NOW; nothing if a request is outstanding
+void gamepad_connection_request_can_send_now(gamepad_connection_t *connection);
+
+// NULL if the connection is unknown
+gamepad_connection_t *gamepad_connection_find(hci_con_handle_t con_handle);
+
+// Find or create the entry; NULL if all GAMEPAD_MAX_CONNECTIONS are in use
+gamepad_connection_t *gamepad_connection_add(hci_con_handle_t con_handle);
+
+void gamepad_connection_remove(gamepad_connection_t *connection);
+
+// Entry by index, 0 .. GAMEPAD_MAX_CONNECTIONS - 1 (may be free)
+gamepad_connection_t *gamepad_connection_at(int index);
+
+// Number of centrals subscribed to at least one input report
+int gamepad_connections_subscribed(void);
+
+static inline const link_params_t *gamepad_connection_link(const gamepad_connection_t *connection)
+{
+    return link_tuning_get_params(connection->con_handle);
+}
+
+#endif // GAMEPAD_CONNECTION_H
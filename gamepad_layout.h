@@ -0,0 +1,148 @@
+// *****************************************************************************
+// Generic Bluetooth LE Gamepad - HID report layout
+//
+// Single source of truth for the HID descriptor and the packed input report.
+// Adding a field is one line in gamepad_player_report plus the struct member.
+// Each of the GAMEPAD_PLAYERS gamepads is its own application collection
+// with report ID GAMEPAD_REPORT_ID + player, so hosts list them separately.
+// Player 1's collection also holds the rumble output report. The motion
+// report has a vendor-defined collection of its own after the players', so
+// hosts do not list it as extra gamepad axes.
+// *****************************************************************************
+
+#ifndef GAMEPAD_LAYOUT_H
+#define GAMEPAD_LAYOUT_H
+
+#include <utility>
+
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "hid_layout.h"
+#include "motion_report.h"
+#include "rumble.h"
+
+#define GAMEPAD_REPORT_ID 1
+
+// Report ID of a player, 0 .. GAMEPAD_PLAYERS - 1
+#define GAMEPAD_PLAYER_REPORT_ID(player) (GAMEPAD_REPORT_ID + (player))
+
+// Rumble output report, in player 1's collection; clear of the player IDs
+#define GAMEPAD_RUMBLE_REPORT_ID 5
+
+// Motion input report, see motion_report.h
+#define GAMEPAD_MOTION_REPORT_ID 6
+
+// Report characteristics in hog_keyboard_demo.gatt (one input report for
+// each possible player, the rumble output report, the motion report)
+#define GAMEPAD_HID_REPORTS 6
+
+// Vendor-defined usages of the motion collection
+enum : uint16_t {
+    usage_motion             = 0x01,
+    usage_motion_sequence    = 0x02,
+    usage_motion_count       = 0x03,
+    usage_motion_timestamp   = 0x04,
+    usage_motion_orientation = 0x05,
+    usage_motion_gyro        = 0x06,
+    usage_motion_accel       = 0x07,
+};
+
+template <uint8_t Id>
+using gamepad_player_report = hid_layout::report<gamepad_report_t, Id,
+    hid_layout::bit_array<&gamepad_report_t::buttons, 16>,                     // 16 buttons
+    hid_layout::axis16<&gamepad_report_t::left_x, hid_layout::usage_x>,        // Left stick X
+    hid_layout::axis16<&gamepad_report_t::left_y, hid_layout::usage_y>,        // Left stick Y
+    hid_layout::axis16<&gamepad_report_t::right_x, hid_layout::usage_z>,       // Right stick X
+    hid_layout::axis16<&gamepad_report_t::right_y, hid_layout::usage_rz>,      // Right stick Y
+    hid_layout::trigger8<&gamepad_report_t::left_trigger, hid_layout::usage_brake>,
+    hid_layout::trigger8<&gamepad_report_t::right_trigger, hid_layout::usage_accelerator>,
+    hid_layout::hat_switch<&gamepad_report_t::dpad>,                          // D-pad
+    hid_layout::padding<4>>;
+
+// All players share one wire format; the report ID travels in the GATT
+// Report Reference, not in the notification
+using gamepad_input_report = gamepad_player_report<GAMEPAD_REPORT_ID>;
+
+// Host -> gamepad, see rumble.h
+using gamepad_rumble_report = hid_layout::report<rumble_report_t, GAMEPAD_RUMBLE_REPORT_ID,
+    hid_layout::variable<&rumble_report_t::strong, hid_layout::page_pid, hid_layout::usage_pid_magnitude, 8, 0, 255,
+                         hid_layout::main_output>,
+    hid_layout::variable<&rumble_report_t::weak, hid_layout::page_pid, hid_layout::usage_pid_magnitude, 8, 0, 255,
+                         hid_layout::main_output>,
+    hid_layout::variable<&rumble_report_t::duration, hid_layout::page_pid, hid_layout::usage_pid_duration, 8, 0, 255,
+                         hid_layout::main_output>,                              // 10 ms units
+    hid_layout::variable<&rumble_report_t::start_delay, hid_layout::page_pid, hid_layout::usage_pid_start_delay, 8, 0,
+                         255, hid_layout::main_output>,                         // 10 ms units
+    hid_layout::variable<&rumble_report_t::loop_count, hid_layout::page_pid, hid_layout::usage_pid_loop_count, 8, 0,
+                         255, hid_layout::main_output>>;
+
+#define GAMEPAD_RUMBLE_REPORT_SIZE gamepad_rumble_report::size
+
+using gamepad_motion_report = hid_layout::report<motion_report_t, GAMEPAD_MOTION_REPORT_ID,
+    hid_layout::variable<&motion_report_t::sequence, hid_layout::page_vendor, usage_motion_sequence, 16, 0, 65535>,
+    hid_layout::variable<&motion_report_t::count, hid_layout::page_vendor, usage_motion_count, 8, 0, 255>,
+    hid_layout::variable<&motion_report_t::timestamp, hid_layout::page_vendor, usage_motion_timestamp, 16, 0,
+                         65535>,                                                // 16 us units
+    hid_layout::variable_array<&motion_report_t::orientation, hid_layout::page_vendor, usage_motion_orientation, 16,
+                               -32768, 32767>,
+    hid_layout::variable_array<&motion_report_t::gyro, hid_layout::page_vendor, usage_motion_gyro, 16, -32768,
+                               32767>,
+    hid_layout::variable_array<&motion_report_t::accel, hid_layout::page_vendor, usage_motion_accel, 16, -32768,
+                               32767>>;
+
+#define GAMEPAD_MOTION_REPORT_SIZE gamepad_motion_report::size
+
+using gamepad_motion_collection = hid_layout::application<hid_layout::page_vendor, usage_motion,
+                                                          gamepad_motion_report>;
+
+// Player 1's collection also carries the rumble output report
+template <size_t Player>
+struct gamepad_player_collection {
+    using type = hid_layout::application<hid_layout::page_generic_desktop, hid_layout::usage_game_pad,
+                                         gamepad_player_report<GAMEPAD_PLAYER_REPORT_ID(Player)>>;
+};
+
+template <>
+struct gamepad_player_collection<0> {
+    using type = hid_layout::application<hid_layout::page_generic_desktop, hid_layout::usage_game_pad,
+                                         gamepad_player_report<GAMEPAD_PLAYER_REPORT_ID(0)>, gamepad_rumble_report>;
+};
+
+template <typename Players>
+struct gamepad_players_descriptor;
+
+template <size_t... Player>
+struct gamepad_players_descriptor<std::index_sequence<Player...>> {
+    using type = hid_layout::descriptor<typename gamepad_player_collection<Player>::type...,
+                                        gamepad_motion_collection>;
+};
+
+using gamepad_descriptor = gamepad_players_descriptor<std::make_index_sequence<GAMEPAD_PLAYERS>>::type;
+
+// Windows-compatible HID Gamepad Descriptor
+inline constexpr auto hid_descriptor_gamepad = gamepad_descriptor::bytes();
+
+#define GAMEPAD_REPORT_SIZE gamepad_input_report::size
+
+// The descriptor the host parses must describe exactly what the packer
+// writes, for every player's report ID
+template <size_t... Player>
+constexpr bool gamepad_players_match_packer(std::index_sequence<Player...>)
+{
+    return ((hid_layout::report_bits(hid_descriptor_gamepad, GAMEPAD_PLAYER_REPORT_ID(Player),
+                                     hid_layout::main_input) == gamepad_input_report::bits) && ...);
+}
+
+static_assert(gamepad_players_match_packer(std::make_index_sequence<GAMEPAD_PLAYERS>()),
+              "HID descriptor and report packer disagree on the report size");
+static_assert(hid_layout::report_bits(hid_descriptor_gamepad, GAMEPAD_RUMBLE_REPORT_ID, hid_layout::main_output) ==
+                  gamepad_rumble_report::bits,
+              "HID descriptor and rumble report unpacker disagree on the report size");
+static_assert(hid_layout::report_bits(hid_descriptor_gamepad, GAMEPAD_MOTION_REPORT_ID, hid_layout::main_input) ==
+                  gamepad_motion_report::bits,
+              "HID descriptor and motion report packer disagree on the report size");
+// The GATT database declares all four players' reports
+static_assert(GAMEPAD_RUMBLE_REPORT_ID > GAMEPAD_PLAYER_REPORT_ID(3), "rumble report ID collides with a player's");
+static_assert(GAMEPAD_MOTION_REPORT_ID > GAMEPAD_RUMBLE_REPORT_ID, "motion report ID collides with another report's");
+
+#endif // GAMEPAD_LAYOUT_H
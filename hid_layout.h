@@ -0,0 +1,572 @@
+// *****************************************************************************
+// Compile-time HID report layout
+//
+// A report is described once as a list of fields bound to struct members.
+// From that list this header generates the HID report descriptor bytes, the
+// packed report size and a packer/unpacker with all bit offsets resolved at
+// compile time. Byte-aligned full-width fields are copied with a single
+// store on little-endian targets; narrower fields become constant shifts and
+// masks, never loops or branches.
+//
+//   using my_report = hid_layout::report<my_state_t, 1,
+//       hid_layout::bit_array<&my_state_t::buttons, 16>,
+//       hid_layout::axis16<&my_state_t::x, hid_layout::usage_x>>;
+//   using my_descriptor = hid_layout::descriptor<
+//       hid_layout::application<hid_layout::page_generic_desktop, hid_layout::usage_game_pad, my_report>>;
+// *****************************************************************************
+
+#ifndef HID_LAYOUT_H
+#define HID_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <array>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace hid_layout {
+
+// Usage pages
+enum : uint16_t {
+    page_generic_desktop = 0x01,
+    page_simulation      = 0x02,
+    page_button          = 0x09,
+    page_pid             = 0x0F,
+    page_vendor          = 0xFF00,
+};
+
+// Generic Desktop / Simulation usages
+enum : uint16_t {
+    usage_game_pad    = 0x05,
+    usage_x           = 0x30,
+    usage_y           = 0x31,
+    usage_z           = 0x32,
+    usage_rx          = 0x33,
+    usage_ry          = 0x34,
+    usage_rz          = 0x35,
+    usage_hat_switch  = 0x39,
+    usage_accelerator = 0xC4,
+    usage_brake       = 0xC5,
+};
+
+// Physical Interface Device usages
+enum : uint16_t {
+    usage_pid_duration    = 0x50,
+    usage_pid_magnitude   = 0x70,
+    usage_pid_loop_count  = 0x7C,
+    usage_pid_start_delay = 0xA7,
+};
+
+// Main item tags
+enum : uint8_t {
+    main_input   = 0x80,
+    main_output  = 0x90,
+    main_feature = 0xB0,
+};
+
+// Main item flags
+enum : uint8_t {
+    flags_data_var_abs  = 0x02,
+    flags_const_var_abs = 0x03,
+};
+
+namespace detail {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+constexpr bool little_endian = true;
+#else
+constexpr bool little_endian = false;
+#endif
+
+template <typename> struct member_traits;
+template <typename C, typename V> struct member_traits<V C::*> {
+    using record_type = C;
+    using value_type = V;
+};
+
+constexpr uint8_t signed_size(int32_t value)
+{
+    return (value >= -128 && value <= 127) ? 1 : (value >= -32768 && value <= 32767) ? 2 : 4;
+}
+
+constexpr uint8_t unsigned_size(uint32_t value)
+{
+    return value <= 0xff ? 1 : value <= 0xffff ? 2 : 4;
+}
+
+// Logical range representable in a field of the given width
+constexpr bool range_fits(int32_t logical_min, int32_t logical_max, uint32_t bits)
+{
+    if (bits >= 32) return true;
+    if (logical_min < 0) {
+        int64_t limit = (int64_t)1 << (bits - 1);
+        return logical_min >= -limit && logical_max < limit;
+    }
+    return (uint64_t)logical_max < ((uint64_t)1 << bits);
+}
+
+// Descriptor writer; global items are only emitted when they change
+struct builder {
+    uint8_t data[512] = {};
+    uint16_t size = 0;
+
+    bool page_valid = false;
+    uint16_t page = 0;
+    bool logical_valid = false;
+    int32_t logical_min = 0;
+    int32_t logical_max = 0;
+    bool physical_set = false;
+    int32_t physical_min = 0;
+    int32_t physical_max = 0;
+    uint32_t unit = 0;
+    uint8_t report_size_value = 0;
+    uint8_t report_count_value = 0;
+
+    constexpr void short_item(uint8_t prefix, uint32_t value, uint8_t length)
+    {
+        data[size++] = (uint8_t)(prefix | (length == 4 ? 3 : length));
+        for (uint8_t i = 0; i < length; i++) {
+            data[size++] = (uint8_t)(value >> (8 * i));
+        }
+    }
+
+    constexpr void usage_page(uint16_t value)
+    {
+        if (page_valid && page == value) return;
+        short_item(0x04, value, unsigned_size(value));
+        page_valid = true;
+        page = value;
+    }
+
+    constexpr void usage(uint16_t value) { short_item(0x08, value, unsigned_size(value)); }
+    constexpr void usage_minimum(uint16_t value) { short_item(0x18, value, unsigned_size(value)); }
+    constexpr void usage_maximum(uint16_t value) { short_item(0x28, value, unsigned_size(value)); }
+
+    constexpr void logical(int32_t minimum, int32_t maximum)
+    {
+        if (!logical_valid || logical_min != minimum) {
+            short_item(0x14, (uint32_t)minimum, signed_size(minimum));
+        }
+        if (!logical_valid || logical_max != maximum) {
+            short_item(0x24, (uint32_t)maximum, signed_size(maximum));
+        }
+        logical_valid = true;
+        logical_min = minimum;
+        logical_max = maximum;
+    }
+
+    constexpr void physical(int32_t minimum, int32_t maximum, uint32_t unit_value)
+    {
+        if (physical_set && physical_min == minimum && physical_max == maximum && unit == unit_value) return;
+        short_item(0x34, (uint32_t)minimum, signed_size(minimum));
+        short_item(0x44, (uint32_t)maximum, signed_size(maximum));
+        short_item(0x64, unit_value, unsigned_size(unit_value));
+        physical_set = true;
+        physical_min = minimum;
+        physical_max = maximum;
+        unit = unit_value;
+    }
+
+    // Physical range and unit are global: clear them after a field that set them
+    constexpr void no_physical()
+    {
+        if (!physical_set) return;
+        short_item(0x34, 0, 1);
+        short_item(0x44, 0, 1);
+        short_item(0x64, 0, 1);
+        physical_set = false;
+        physical_min = 0;
+        physical_max = 0;
+        unit = 0;
+    }
+
+    constexpr void report_size(uint8_t bits)
+    {
+        if (report_size_value == bits) return;
+        short_item(0x74, bits, 1);
+        report_size_value = bits;
+    }
+
+    constexpr void report_count(uint8_t count)
+    {
+        if (report_count_value == count) return;
+        short_item(0x94, count, 1);
+        report_count_value = count;
+    }
+
+    constexpr void report_id(uint8_t id) { short_item(0x84, id, 1); }
+    constexpr void main_item(uint8_t tag, uint8_t flags) { short_item(tag, flags, 1); }
+    constexpr void collection(uint8_t kind) { short_item(0xA0, kind, 1); }
+    constexpr void end_collection() { data[size++] = 0xC0; }
+};
+
+// Bit-level store: the first byte of a field is ORed in only when the field
+// starts mid-byte, every other byte is assigned. Fields are packed in order,
+// so each byte is first assigned and then completed by later fields.
+template <size_t Offset, size_t K>
+inline void store_byte(uint8_t *out, uint64_t shifted)
+{
+    uint8_t value = (uint8_t)(shifted >> (8 * K));
+    if constexpr (K == 0 && Offset % 8 != 0) {
+        out[Offset / 8] |= value;
+    } else {
+        out[Offset / 8 + K] = value;
+    }
+}
+
+template <size_t Offset, size_t... K>
+inline void store_bytes(uint8_t *out, uint64_t shifted, std::index_sequence<K...>)
+{
+    (store_byte<Offset, K>(out, shifted), ...);
+}
+
+template <size_t Offset, size_t Bits, typename V>
+inline void store(uint8_t *out, V value)
+{
+    static_assert(Bits > 0 && Bits <= 32, "fields are 1 to 32 bits wide");
+    if constexpr (little_endian && Offset % 8 == 0 && Bits == 8 * sizeof(V)) {
+        memcpy(out + Offset / 8, &value, sizeof(V));
+    } else {
+        constexpr uint64_t mask = ((uint64_t)1 << Bits) - 1;
+        constexpr size_t bytes = (Offset % 8 + Bits + 7) / 8;
+        uint64_t shifted = ((uint64_t)(std::make_unsigned_t<V>)value & mask) << (Offset % 8);
+        store_bytes<Offset>(out, shifted, std::make_index_sequence<bytes>{});
+    }
+}
+
+template <size_t Offset, size_t... K>
+inline uint64_t load_bytes(const uint8_t *in, std::index_sequence<K...>)
+{
+    return (((uint64_t)in[Offset / 8 + K] << (8 * K)) | ... | 0);
+}
+
+template <size_t Offset, size_t Bits, typename V, bool Signed>
+inline V load(const uint8_t *in)
+{
+    if constexpr (little_endian && Offset % 8 == 0 && Bits == 8 * sizeof(V)) {
+        V value;
+        memcpy(&value, in + Offset / 8, sizeof(V));
+        return value;
+    } else {
+        constexpr uint64_t mask = ((uint64_t)1 << Bits) - 1;
+        constexpr size_t bytes = (Offset % 8 + Bits + 7) / 8;
+        uint64_t raw = (load_bytes<Offset>(in, std::make_index_sequence<bytes>{}) >> (Offset % 8)) & mask;
+        if constexpr (Signed) {
+            // Sign-extend without branching
+            constexpr uint64_t sign = (uint64_t)1 << (Bits - 1);
+            return (V)(int64_t)((raw ^ sign) - sign);
+        } else {
+            return (V)raw;
+        }
+    }
+}
+
+} // namespace detail
+
+// A single variable field (axis, trigger, ...) bound to one struct member
+template <auto Member, uint16_t Page, uint16_t Usage, uint8_t Size, int32_t LogicalMin, int32_t LogicalMax,
+          uint8_t Main = main_input>
+struct variable {
+    using record_type = typename detail::member_traits<decltype(Member)>::record_type;
+    using value_type = typename detail::member_traits<decltype(Member)>::value_type;
+    static constexpr size_t bits = Size;
+
+    static_assert(Size <= 8 * sizeof(value_type), "field is wider than its member");
+    static_assert(LogicalMin <= LogicalMax, "logical minimum above maximum");
+    static_assert(detail::range_fits(LogicalMin, LogicalMax, Size), "logical range does not fit the report size");
+    static_assert(Size != 8 * sizeof(value_type) ||
+                      (LogicalMin == std::numeric_limits<value_type>::min() &&
+                       LogicalMax == std::numeric_limits<value_type>::max()),
+                  "a full-width field must declare the full range of its member type");
+
+    static constexpr void describe(detail::builder &builder)
+    {
+        builder.usage_page(Page);
+        builder.usage(Usage);
+        builder.logical(LogicalMin, LogicalMax);
+        builder.no_physical();
+        builder.report_size(Size);
+        builder.report_count(1);
+        builder.main_item(Main, flags_data_var_abs);
+    }
+
+    template <size_t Offset, typename R>
+    static void pack(const R &record, uint8_t *out)
+    {
+        detail::store<Offset, Size>(out, record.*Member);
+    }
+
+    template <size_t Offset, typename R>
+    static void unpack(const uint8_t *in, R &record)
+    {
+        record.*Member = detail::load<Offset, Size, value_type, (LogicalMin < 0)>(in);
+    }
+};
+
+// Count fields of the same usage held in one array member, element 0 first
+template <auto Member, uint16_t Page, uint16_t Usage, uint8_t Size, int32_t LogicalMin, int32_t LogicalMax,
+          uint8_t Main = main_input>
+struct variable_array {
+    using array_type = typename detail::member_traits<decltype(Member)>::value_type;
+    using value_type = std::remove_extent_t<array_type>;
+    static constexpr size_t count = std::extent_v<array_type>;
+    static constexpr size_t bits = Size * count;
+
+    static_assert(count >= 1 && count <= 255, "member must be an array of 1 to 255 elements");
+    static_assert(Size <= 8 * sizeof(value_type), "field is wider than its elements");
+    static_assert(LogicalMin <= LogicalMax, "logical minimum above maximum");
+    static_assert(detail::range_fits(LogicalMin, LogicalMax, Size), "logical range does not fit the report size");
+    static_assert(Size != 8 * sizeof(value_type) ||
+                      (LogicalMin == std::numeric_limits<value_type>::min() &&
+                       LogicalMax == std::numeric_limits<value_type>::max()),
+                  "a full-width field must declare the full range of its element type");
+
+    // A single usage applies to every element
+    static constexpr void describe(detail::builder &builder)
+    {
+        builder.usage_page(Page);
+        builder.usage(Usage);
+        builder.logical(LogicalMin, LogicalMax);
+        builder.no_physical();
+        builder.report_size(Size);
+        builder.report_count((uint8_t)count);
+        builder.main_item(Main, flags_data_var_abs);
+    }
+
+    template <size_t Offset, typename R>
+    static void pack(const R &record, uint8_t *out)
+    {
+        pack_elements<Offset>(record, out, std::make_index_sequence<count>{});
+    }
+
+    template <size_t Offset, typename R>
+    static void unpack(const uint8_t *in, R &record)
+    {
+        unpack_elements<Offset>(in, record, std::make_index_sequence<count>{});
+    }
+
+private:
+    template <size_t Offset, typename R, size_t... K>
+    static void pack_elements(const R &record, uint8_t *out, std::index_sequence<K...>)
+    {
+        (detail::store<Offset + K * Size, Size>(out, (record.*Member)[K]), ...);
+    }
+
+    template <size_t Offset, typename R, size_t... K>
+    static void unpack_elements(const uint8_t *in, R &record, std::index_sequence<K...>)
+    {
+        (((record.*Member)[K] = detail::load<Offset + K * Size, Size, value_type, (LogicalMin < 0)>(in)), ...);
+    }
+};
+
+template <auto Member, uint16_t Usage, uint16_t Page = page_generic_desktop>
+using axis16 = variable<Member, Page, Usage, 16, -32768, 32767>;
+
+template <auto Member, uint16_t Usage, uint16_t Page = page_simulation>
+using trigger8 = variable<Member, Page, Usage, 8, 0, 255>;
+
+// Count one-bit buttons held in a single integer member, bit 0 = first usage
+template <auto Member, uint8_t Count, uint16_t Page = page_button, uint16_t FirstUsage = 1,
+          uint8_t Main = main_input>
+struct bit_array {
+    using value_type = typename detail::member_traits<decltype(Member)>::value_type;
+    static constexpr size_t bits = Count;
+
+    static_assert(Count <= 8 * sizeof(value_type), "more bits than the member holds");
+
+    static constexpr void describe(detail::builder &builder)
+    {
+        builder.usage_page(Page);
+        builder.usage_minimum(FirstUsage);
+        builder.usage_maximum(FirstUsage + Count - 1);
+        builder.logical(0, 1);
+        builder.no_physical();
+        builder.report_size(1);
+        builder.report_count(Count);
+        builder.main_item(Main, flags_data_var_abs);
+    }
+
+    template <size_t Offset, typename R>
+    static void pack(const R &record, uint8_t *out)
+    {
+        detail::store<Offset, Count>(out, record.*Member);
+    }
+
+    template <size_t Offset, typename R>
+    static void unpack(const uint8_t *in, R &record)
+    {
+        record.*Member = detail::load<Offset, Count, value_type, false>(in);
+    }
+};
+
+// 8-way hat switch, 4 bits; values outside 0..7 read as centered
+template <auto Member>
+struct hat_switch {
+    using value_type = typename detail::member_traits<decltype(Member)>::value_type;
+    static constexpr size_t bits = 4;
+
+    static constexpr void describe(detail::builder &builder)
+    {
+        builder.usage_page(page_generic_desktop);
+        builder.usage(usage_hat_switch);
+        builder.logical(0, 7);
+        builder.physical(0, 315, 0x14);   // English Rotation, degrees
+        builder.report_size(4);
+        builder.report_count(1);
+        builder.main_item(main_input, flags_data_var_abs);
+    }
+
+    template <size_t Offset, typename R>
+    static void pack(const R &record, uint8_t *out)
+    {
+        detail::store<Offset, 4>(out, record.*Member);
+    }
+
+    template <size_t Offset, typename R>
+    static void unpack(const uint8_t *in, R &record)
+    {
+        record.*Member = detail::load<Offset, 4, value_type, false>(in);
+    }
+};
+
+// Constant padding bits
+template <uint8_t Bits, uint8_t Main = main_input>
+struct padding {
+    static constexpr size_t bits = Bits;
+
+    static constexpr void describe(detail::builder &builder)
+    {
+        builder.report_count(1);
+        builder.report_size(Bits);
+        builder.main_item(Main, flags_const_var_abs);
+    }
+
+    template <size_t Offset, typename R>
+    static void pack(const R &record, uint8_t *out)
+    {
+        (void)record;
+        detail::store<Offset, Bits>(out, (uint32_t)0);
+    }
+
+    template <size_t Offset, typename R>
+    static void unpack(const uint8_t *in, R &record)
+    {
+        (void)in;
+        (void)record;
+    }
+};
+
+// One report: a report ID and its fields in wire order
+template <typename Record, uint8_t Id, typename... Fields>
+struct report {
+    using record_type = Record;
+    static constexpr uint8_t id = Id;
+    static constexpr size_t bits = (Fields::bits + ... + 0);
+    static constexpr size_t size = bits / 8;
+
+    static_assert(bits % 8 == 0, "report must be a whole number of bytes");
+
+    static constexpr void describe(detail::builder &builder)
+    {
+        builder.report_id(Id);
+        (Fields::describe(builder), ...);
+    }
+
+    static void pack(const Record &record, uint8_t *out)
+    {
+        pack_fields<0, Fields...>(record, out);
+    }
+
+    static void unpack(const uint8_t *in, Record &record)
+    {
+        unpack_fields<0, Fields...>(in, record);
+    }
+
+private:
+    template <size_t Offset, typename Field, typename... Rest>
+    static void pack_fields(const Record &record, uint8_t *out)
+    {
+        Field::template pack<Offset>(record, out);
+        if constexpr (sizeof...(Rest) > 0) pack_fields<Offset + Field::bits, Rest...>(record, out);
+    }
+
+    template <size_t Offset, typename Field, typename... Rest>
+    static void unpack_fields(const uint8_t *in, Record &record)
+    {
+        Field::template unpack<Offset>(in, record);
+        if constexpr (sizeof...(Rest) > 0) unpack_fields<Offset + Field::bits, Rest...>(in, record);
+    }
+};
+
+// Application collection holding one or more reports
+template <uint16_t Page, uint16_t Usage, typename... Reports>
+struct application {
+    static constexpr void describe(detail::builder &builder)
+    {
+        builder.usage_page(Page);
+        builder.usage(Usage);
+        builder.collection(0x01);
+        (Reports::describe(builder), ...);
+        builder.end_collection();
+    }
+};
+
+template <typename... Collections>
+struct descriptor {
+    static constexpr detail::builder build()
+    {
+        detail::builder builder;
+        (Collections::describe(builder), ...);
+        return builder;
+    }
+
+    static constexpr detail::builder built = build();
+    static constexpr size_t size = built.size;
+
+    static constexpr std::array<uint8_t, size> bytes()
+    {
+        std::array<uint8_t, size> out{};
+        for (size_t i = 0; i < size; i++) {
+            out[i] = built.data[i];
+        }
+        return out;
+    }
+};
+
+// Parse a descriptor and add up the bits of one report's main items. Used to
+// check generated descriptors against the packer independently of the
+// templates that produced both.
+template <size_t N>
+constexpr size_t report_bits(const std::array<uint8_t, N> &bytes, uint8_t report_id, uint8_t main_tag)
+{
+    size_t total = 0;
+    uint32_t size = 0;
+    uint32_t count = 0;
+    uint8_t current_id = 0;
+    size_t i = 0;
+    while (i < N) {
+        uint8_t prefix = bytes[i];
+        uint8_t length = (prefix & 0x03) == 3 ? 4 : (prefix & 0x03);
+        uint32_t value = 0;
+        for (uint8_t k = 0; k < length; k++) {
+            value |= (uint32_t)bytes[i + 1 + k] << (8 * k);
+        }
+        switch (prefix & 0xFC) {
+            case 0x74: size = value; break;
+            case 0x94: count = value; break;
+            case 0x84: current_id = (uint8_t)value; break;
+            default:
+                if ((prefix & 0xFC) == main_tag && current_id == report_id) total += size * count;
+                break;
+        }
+        i += 1 + length;
+    }
+    return total;
+}
+
+} // namespace hid_layout
+
+#endif // HID_LAYOUT_H
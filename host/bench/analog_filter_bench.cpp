@@ -0,0 +1,165 @@
+// *****************************************************************************
+// Analog decimation benchmark and check (host)
+//
+// Without arguments, synthesizes noisy 12-bit ADC blocks in the DMA layout
+// (settle rounds, then interleaved ADC0..ADC2) for every oversampling ratio
+// and reports decimation cost and the residual noise of the 16-bit output.
+// A constant input must decimate to exactly value << 4.
+//
+// With a file argument, decimates a recorded capture instead: raw
+// little-endian uint16 samples, one block per bank, banks back to back, as
+// dumped from the firmware's DMA buffers.
+//
+// usage: analog_filter_bench [capture.bin oversample_log2]
+// Exits non-zero if the constant-input check fails.
+// *****************************************************************************
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "analog_filter.h"
+
+#define BENCH_FRAMES 20000
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+// Roughly gaussian noise in ADC counts (sum of uniforms)
+static double noise(double sigma)
+{
+    double sum = 0;
+    for (int i = 0; i < 4; i++) {
+        sum += (double)(rng_next() & 0xffff) / 65536.0 - 0.5;
+    }
+    return sum * sigma * 1.732;
+}
+
+static uint16_t quantize(double counts)
+{
+    if (counts < 0) return 0;
+    if (counts > 4095) return 4095;
+    return (uint16_t)lround(counts);
+}
+
+static int constant_check(void)
+{
+    int errors = 0;
+    for (uint8_t oversample_log2 = 2; oversample_log2 <= 6; oversample_log2++) {
+        std::vector<uint16_t> block(analog_block_samples(oversample_log2), 0);
+        for (uint32_t i = 0; i < block.size(); i++) {
+            block[i] = (uint16_t)(i < ANALOG_SETTLE_ROUNDS * ANALOG_ADC_CHANNELS ? 4095 : 1000 + i % ANALOG_ADC_CHANNELS);
+        }
+        uint16_t out[ANALOG_ADC_CHANNELS];
+        analog_decimate_block(block.data(), oversample_log2, out);
+        for (int channel = 0; channel < ANALOG_ADC_CHANNELS; channel++) {
+            if (out[channel] != (uint16_t)((1000 + channel) << 4)) errors++;
+        }
+    }
+    printf("constant input: %s\n", errors ? "FAIL" : "ok");
+    return errors == 0;
+}
+
+static void synthetic_run(uint8_t oversample_log2)
+{
+    uint32_t samples = analog_block_samples(oversample_log2);
+    std::vector<uint16_t> blocks((size_t)BENCH_FRAMES * samples);
+    std::vector<double> truth((size_t)BENCH_FRAMES * ANALOG_ADC_CHANNELS);
+
+    // Slow sweeps well inside the range, ~1.5 LSB rms of ADC noise
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+        for (int channel = 0; channel < ANALOG_ADC_CHANNELS; channel++) {
+            double value = 2048 + 1500 * sin(frame * 0.001 + channel);
+            truth[(size_t)frame * ANALOG_ADC_CHANNELS + channel] = value;
+            for (uint32_t round = 0; round < samples / ANALOG_ADC_CHANNELS; round++) {
+                blocks[(size_t)frame * samples + round * ANALOG_ADC_CHANNELS + channel] = quantize(value + noise(1.5));
+            }
+        }
+    }
+
+    std::vector<uint16_t> out((size_t)BENCH_FRAMES * ANALOG_ADC_CHANNELS);
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++) {
+        analog_decimate_block(&blocks[(size_t)frame * samples], oversample_log2, &out[(size_t)frame * ANALOG_ADC_CHANNELS]);
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+
+    // Residual noise in 16-bit LSB against the noiseless value
+    double sum_sq_out = 0;
+    double sum_sq_raw = 0;
+    for (size_t i = 0; i < out.size(); i++) {
+        double expected = truth[i] * 16;
+        double error = out[i] - expected;
+        sum_sq_out += error * error;
+        uint32_t frame = (uint32_t)(i / ANALOG_ADC_CHANNELS);
+        uint32_t channel = (uint32_t)(i % ANALOG_ADC_CHANNELS);
+        double raw = blocks[(size_t)frame * samples + ANALOG_SETTLE_ROUNDS * ANALOG_ADC_CHANNELS + channel] * 16.0;
+        sum_sq_raw += (raw - expected) * (raw - expected);
+    }
+    double rms_out = sqrt(sum_sq_out / out.size());
+    double rms_raw = sqrt(sum_sq_raw / out.size());
+
+    printf("%3ux: %6.1f ns/block, %5.2f ns/sample, noise %6.1f -> %5.1f LSB16 (%.1f effective bits)\n",
+           1u << oversample_log2, ns / BENCH_FRAMES, ns / BENCH_FRAMES / samples, rms_raw, rms_out,
+           16 - log2(rms_out * sqrt(12.0)));
+}
+
+static int capture_run(const char *path, uint8_t oversample_log2)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 0;
+    }
+
+    uint32_t samples = analog_block_samples(oversample_log2);
+    std::vector<uint16_t> frame_samples(samples * ANALOG_BANKS);
+    uint32_t frames = 0;
+    uint16_t minimum[ANALOG_NUM_CHANNELS];
+    uint16_t maximum[ANALOG_NUM_CHANNELS];
+    for (int i = 0; i < ANALOG_NUM_CHANNELS; i++) {
+        minimum[i] = 0xffff;
+        maximum[i] = 0;
+    }
+
+    while (fread(frame_samples.data(), sizeof(uint16_t), frame_samples.size(), file) == frame_samples.size()) {
+        analog_frame_t frame;
+        for (int bank = 0; bank < ANALOG_BANKS; bank++) {
+            analog_decimate_block(&frame_samples[bank * samples], oversample_log2, &frame.value[bank * ANALOG_ADC_CHANNELS]);
+        }
+        for (int i = 0; i < ANALOG_NUM_CHANNELS; i++) {
+            if (frame.value[i] < minimum[i]) minimum[i] = frame.value[i];
+            if (frame.value[i] > maximum[i]) maximum[i] = frame.value[i];
+        }
+        frames++;
+    }
+    fclose(file);
+
+    printf("%s: %u frames at %ux\n", path, frames, 1u << oversample_log2);
+    for (int i = 0; i < ANALOG_NUM_CHANNELS && frames; i++) {
+        printf("  channel %d: %5u .. %5u (span %u)\n", i, minimum[i], maximum[i], maximum[i] - minimum[i]);
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    int ok = constant_check();
+
+    if (argc > 2) {
+        ok &= capture_run(argv[1], (uint8_t)strtoul(argv[2], NULL, 0));
+    } else {
+        for (uint8_t oversample_log2 = 2; oversample_log2 <= 6; oversample_log2++) {
+            synthetic_run(oversample_log2);
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,168 @@
+// *****************************************************************************
+// Stick and trigger processing benchmark and check (host)
+//
+// Checks that a profile without deadzones passes every stick value through
+// within one count and keeps it monotonic, that a noisy stick at rest with
+// a center offset comes out as a constant, and that the stick deflection
+// never exceeds full scale. Then measures processing throughput for each
+// built-in curve on random samples.
+//
+// usage: axis_processing_bench [samples]
+// Exits non-zero if a check fails.
+// *****************************************************************************
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "axis_processing.h"
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng_next(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return rng_state >> 8;
+}
+
+static gamepad_report_t stick_report(int16_t x, int16_t y)
+{
+    gamepad_report_t report = {0};
+    report.left_x = x;
+    report.left_y = y;
+    report.right_x = x;
+    report.right_y = y;
+    report.dpad = DPAD_NEUTRAL;
+    return report;
+}
+
+static int identity_check(void)
+{
+    axis_profile_t profile;
+    axis_profile_default(&profile);
+    profile.radial_deadzone = 0;
+    profile.axial_deadzone = 0;
+    profile.trigger_low[0] = profile.trigger_low[1] = 0;
+    profile.trigger_high[0] = profile.trigger_high[1] = 255;
+    axis_processor_t processor;
+    axis_processor_init(&processor, &profile);
+
+    uint32_t errors = 0;
+    int32_t previous = -32768;
+    for (int32_t value = -32768; value <= 32767; value++) {
+        gamepad_report_t report = stick_report((int16_t)value, 0);
+        axis_process(&processor, &report);
+        int32_t expected = value < -32767 ? -32767 : value;
+        if (report.left_x - expected > 1 || expected - report.left_x > 1 || report.left_x < previous) errors++;
+        previous = report.left_x;
+    }
+    for (int trigger = 0; trigger <= 255; trigger++) {
+        gamepad_report_t report = stick_report(0, 0);
+        report.left_trigger = (uint8_t)trigger;
+        axis_process(&processor, &report);
+        if (report.left_trigger != trigger) errors++;
+    }
+    printf("identity: %u errors\n", errors);
+    return errors == 0;
+}
+
+static int rest_check(void)
+{
+    // Stick resting 700 counts off center with +-400 counts of noise
+    const int16_t offset = 700;
+    axis_profile_t profile;
+    axis_profile_default(&profile);
+    axis_processor_t processor;
+    axis_processor_init(&processor, &profile);
+
+    uint32_t raw_changes = 0;
+    uint32_t changes = 0;
+    gamepad_report_t last_raw = stick_report(offset, offset);
+    gamepad_report_t last = last_raw;
+    axis_process(&processor, &last);
+    for (int i = 0; i < 100000; i++) {
+        int16_t x = (int16_t)(offset + (int32_t)(rng_next() % 801) - 400);
+        int16_t y = (int16_t)(offset + (int32_t)(rng_next() % 801) - 400);
+        gamepad_report_t raw = stick_report(x, y);
+        gamepad_report_t report = raw;
+        axis_process(&processor, &report);
+        if (raw.left_x != last_raw.left_x || raw.left_y != last_raw.left_y) raw_changes++;
+        if (report.left_x != last.left_x || report.left_y != last.left_y) changes++;
+        last_raw = raw;
+        last = report;
+    }
+    printf("at rest: %u raw changes, %u after processing (deadzone %u)\n", raw_changes, changes,
+           profile.radial_deadzone);
+    return changes == 0 && last.left_x == 0 && last.left_y == 0;
+}
+
+static int range_check(void)
+{
+    axis_profile_t profile;
+    axis_profile_default(&profile);
+    profile.axes[AXIS_LEFT_X].min = -20000;
+    profile.axes[AXIS_LEFT_X].center = 500;
+    profile.axes[AXIS_LEFT_X].max = 18000;
+    axis_processor_t processor;
+    axis_processor_init(&processor, &profile);
+
+    uint32_t errors = 0;
+    for (int i = 0; i < 1000000; i++) {
+        gamepad_report_t report = stick_report((int16_t)rng_next(), (int16_t)rng_next());
+        axis_process(&processor, &report);
+        int64_t magnitude_sq = (int64_t)report.left_x * report.left_x + (int64_t)report.left_y * report.left_y;
+        if (magnitude_sq > (int64_t)32768 * 32768) errors++;
+    }
+    gamepad_report_t report = stick_report(18000, 0);
+    axis_process(&processor, &report);
+    if (report.left_x < 32760) errors++;
+    report = stick_report(-20000, 0);
+    axis_process(&processor, &report);
+    if (report.left_x > -32760) errors++;
+    printf("calibrated range: %u errors\n", errors);
+    return errors == 0;
+}
+
+static void throughput_run(axis_curve_t shape, const char *name, uint32_t samples)
+{
+    axis_profile_t profile;
+    axis_profile_default(&profile);
+    axis_curve_fill(profile.curve, shape);
+    axis_processor_t processor;
+    axis_processor_init(&processor, &profile);
+
+    std::vector<gamepad_report_t> reports(4096);
+    for (gamepad_report_t &report : reports) {
+        report = stick_report((int16_t)rng_next(), (int16_t)rng_next());
+        report.right_x = (int16_t)rng_next();
+        report.left_trigger = (uint8_t)rng_next();
+        report.right_trigger = (uint8_t)rng_next();
+    }
+
+    uint32_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < samples; i++) {
+        gamepad_report_t report = reports[i & 4095];
+        axis_process(&processor, &report);
+        checksum += (uint16_t)report.left_x + report.right_trigger;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    printf("%-7s curve: %.1f M reports/s (%.1f ns each, 2 sticks + 2 triggers) [%08x]\n", name,
+           seconds > 0 ? samples / seconds / 1e6 : 0.0, samples ? seconds * 1e9 / samples : 0.0, checksum);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t samples = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 20000000;
+
+    int ok = identity_check();
+    ok &= rest_check();
+    ok &= range_check();
+
+    throughput_run(AXIS_CURVE_LINEAR, "linear", samples);
+    throughput_run(AXIS_CURVE_SQUARE, "square", samples);
+    throughput_run(AXIS_CURVE_CUBE, "cube", samples);
+    return ok ? 0 : 1;
+}
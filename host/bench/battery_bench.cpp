@@ -0,0 +1,200 @@
+// *****************************************************************************
+// Battery monitor benchmark (host)
+//
+// Plays VSYS against the battery monitor: a full discharge of a LiPo cell
+// with ADC noise and a load dip (rumble) every minute, the cell recovering
+// onto a step of the discharge curve and resting there for half an hour,
+// readings that fail, and a charger plugged in. Prints the Battery Service
+// updates each phase caused next to what mapping every raw reading would
+// have sent.
+//
+// Exits non-zero if the level rises while discharging, an update repeats
+// the level, resting on a step changes the level more than twice, the level
+// ends off the curve, failed readings change it, or charging does not
+// bring it to 100 %.
+//
+// usage: battery_bench [discharge_s] [noise_mv]
+// *****************************************************************************
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ble/gatt-service/battery_service_server.h"
+#include "battery_monitor.h"
+#include "btstack_mock.h"
+#include "gamepad_config.h"
+
+#define STEP_MS 100
+
+#define FULL_MV 4180
+#define EMPTY_MV 3400
+#define CHARGER_MV 4900
+
+// Load dips: LOAD_DIP_MV lower for LOAD_DIP_MS every LOAD_DIP_PERIOD_MS
+#define LOAD_DIP_MV 60
+#define LOAD_DIP_MS 1000
+#define LOAD_DIP_PERIOD_MS 60000
+
+#define RECOVER_MS (2 * 60 * 1000)
+#define REST_MS (30 * 60 * 1000)
+#define FAIL_MS 20000
+#define CHARGE_MS (5 * 60 * 1000)
+
+typedef struct {
+    const char *name;
+    uint32_t updates;
+    uint32_t raw_changes;      // Level changes mapping each raw reading would send
+    uint32_t rises;
+    uint32_t repeats;
+    uint8_t first_level;
+    uint8_t last_level;
+} phase_t;
+
+static uint32_t noise_mv;
+static uint32_t random_state = 12345;
+static uint32_t elapsed_ms;
+
+static int32_t noise(void)
+{
+    random_state = random_state * 1103515245u + 12345u;
+    if (!noise_mv) return 0;
+    return (int32_t)((random_state >> 16) % (2 * noise_mv + 1)) - (int32_t)noise_mv;
+}
+
+// Run the phase with VSYS from source(t) every STEP_MS; the Battery
+// Service value is checked after each step
+static void run_phase(phase_t *phase, uint32_t duration_ms, uint16_t (*source)(uint32_t t_ms))
+{
+    const mock_btstack_stats_t *stats = mock_btstack_get_stats();
+    phase->first_level = stats->battery_level;
+    uint8_t level = stats->battery_level;
+    uint32_t updates = stats->battery_updates;
+    uint8_t raw_level = 0;
+    bool raw_valid = false;
+
+    for (uint32_t t_ms = 0; t_ms < duration_ms; t_ms += STEP_MS) {
+        uint16_t mv = source(t_ms);
+        if (mv) {
+            bool dip = elapsed_ms % LOAD_DIP_PERIOD_MS < LOAD_DIP_MS;
+            mv = (uint16_t)(mv + noise() - (dip ? LOAD_DIP_MV : 0));
+        }
+        mock_battery_set_mv(mv);
+        mock_btstack_advance_us(STEP_MS * 1000);
+        elapsed_ms += STEP_MS;
+
+        if (mv && elapsed_ms % BATTERY_SAMPLE_PERIOD_MS == 0) {
+            uint8_t raw = battery_monitor_percent(mv);
+            if (raw_valid && raw != raw_level) {
+                phase->raw_changes++;
+            }
+            raw_level = raw;
+            raw_valid = true;
+        }
+        if (stats->battery_updates != updates) {
+            if (stats->battery_level == level) phase->repeats++;
+            if (stats->battery_level > level) phase->rises++;
+            phase->updates += stats->battery_updates - updates;
+            updates = stats->battery_updates;
+            level = stats->battery_level;
+        }
+    }
+    phase->last_level = stats->battery_level;
+}
+
+static uint32_t discharge_ms;
+
+static uint16_t discharge(uint32_t t_ms)
+{
+    return (uint16_t)(FULL_MV - (uint64_t)(FULL_MV - EMPTY_MV) * t_ms / discharge_ms);
+}
+
+// 3800 mV is a point of the discharge curve
+static uint16_t rest(uint32_t t_ms)
+{
+    (void)t_ms;
+    return 3800;
+}
+
+static uint16_t fail(uint32_t t_ms)
+{
+    (void)t_ms;
+    return 0;
+}
+
+static uint16_t charge(uint32_t t_ms)
+{
+    (void)t_ms;
+    return CHARGER_MV;
+}
+
+int main(int argc, char *argv[])
+{
+    discharge_ms = (argc > 1 ? (uint32_t)atoi(argv[1]) : 4 * 3600) * 1000;
+    noise_mv = argc > 2 ? (uint32_t)atoi(argv[2]) : 25;
+
+    mock_btstack_reset();
+    mock_battery_set_mv(FULL_MV);
+    battery_monitor_init();
+    // As main.cpp does
+    battery_service_server_init(battery_monitor_level());
+
+    phase_t phases[] = {
+        { "discharge", 0, 0, 0, 0, 0, 0 },
+        { "recover", 0, 0, 0, 0, 0, 0 },
+        { "rest", 0, 0, 0, 0, 0, 0 },
+        { "failing", 0, 0, 0, 0, 0, 0 },
+        { "charging", 0, 0, 0, 0, 0, 0 },
+    };
+    run_phase(&phases[0], discharge_ms, &discharge);
+    uint8_t curve_level = battery_monitor_percent(EMPTY_MV);
+    // The load goes away and the cell recovers onto a step, then sits there
+    run_phase(&phases[1], RECOVER_MS, &rest);
+    run_phase(&phases[2], REST_MS, &rest);
+    run_phase(&phases[3], FAIL_MS, &fail);
+    run_phase(&phases[4], CHARGE_MS, &charge);
+
+    const battery_monitor_stats_t *stats = battery_monitor_get_stats();
+    printf("Battery monitor benchmark: %u mV -> %u mV over %u s, +-%u mV noise, %u mV load dips, reading every "
+           "%u ms\n", FULL_MV, EMPTY_MV, discharge_ms / 1000, noise_mv, LOAD_DIP_MV, BATTERY_SAMPLE_PERIOD_MS);
+    printf("  %-10s %7s %7s %8s\n", "phase", "level", "updates", "raw");
+    for (const phase_t &phase : phases) {
+        printf("  %-10s %3u->%-3u %7u %8u   %u rises, %u repeats\n", phase.name, phase.first_level,
+               phase.last_level, phase.updates, phase.raw_changes, phase.rises, phase.repeats);
+    }
+    printf("  %lu readings, %lu failed, VSYS %u mV (filtered %u mV)\n", (unsigned long)stats->readings,
+           (unsigned long)stats->failed, stats->vsys_mv, stats->filtered_mv);
+
+    int failures = 0;
+    if (phases[0].rises) {
+        printf("FAIL: the level rose while discharging\n");
+        failures++;
+    }
+    for (const phase_t &phase : phases) {
+        if (phase.repeats) {
+            printf("FAIL: %s: an update repeated the level\n", phase.name);
+            failures++;
+        }
+    }
+    if (phases[0].updates > (uint32_t)(phases[0].first_level - phases[0].last_level)) {
+        printf("FAIL: more updates than steps while discharging\n");
+        failures++;
+    }
+    int off_curve = (int)phases[0].last_level - curve_level;
+    if (off_curve > 2 || off_curve < -2) {
+        printf("FAIL: discharged to %u %%, the curve says %u %%\n", phases[0].last_level, curve_level);
+        failures++;
+    }
+    if (phases[2].updates > 2) {
+        printf("FAIL: resting on a step changed the level %u times\n", phases[2].updates);
+        failures++;
+    }
+    if (phases[3].updates || stats->failed < FAIL_MS / BATTERY_SAMPLE_PERIOD_MS - 1) {
+        printf("FAIL: failed readings not counted or changed the level\n");
+        failures++;
+    }
+    if (phases[4].last_level != 100) {
+        printf("FAIL: charging ended at %u %%\n", phases[4].last_level);
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
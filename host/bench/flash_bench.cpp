@@ -0,0 +1,261 @@
+// *****************************************************************************
+// Flash persistence benchmark (host)
+//
+// Player 1's stick moves every millisecond on a 7.5 ms link; once the
+// report schedule has locked, a host pairs: the LE device DB entry is
+// written three times, SM's keys and reconnect.cpp's records once each,
+// as BTstack and the firmware do through the TLV store. Every flash write
+// holds both cores for FLASH_WRITE_US while the controller keeps running.
+// The bench pairs once writing through to flash and once through
+// deferred_tlv.h, and prints the longest gap between reports on air and
+// the oldest stick sample a report carried, before and around the pairing.
+//
+// Exits non-zero if pairing through the deferred store makes either worse
+// than before it, if a read while staged does not see the new value, or if
+// a value is not on flash in the end, or if a flash write left the analog
+// sampler running.
+//
+// usage: flash_bench [write_us]
+// *****************************************************************************
+
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "btstack_tlv.h"
+#include "deferred_tlv.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+
+// Bench inputs carry this trigger value; the built-in demo never uses it
+#define BENCH_MARKER 0xA5
+
+#define SETUP_US 300
+#define COMPLETION_DELAY_US 600
+
+// Programming one entry, multicore lockout included
+#define FLASH_WRITE_US 1000
+
+// The schedule has locked by then; pairing starts at PAIRING_STEP
+#define BASELINE_STEP 1000
+#define PAIRING_STEP 2500
+#define STEPS 4000
+
+// Reports on air this long after the pairing writes count as around it
+#define PAIRING_WINDOW_STEPS 500
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+typedef struct {
+    uint32_t tag;
+    uint8_t size;
+    uint8_t fill;
+} bench_write_t;
+
+// What pairing writes: the device DB entry as the keys arrive, SM's ER and
+// IR, the bond and last-host records
+static const bench_write_t pairing_writes[] = {
+    { 0x42544400, 64, 1 },
+    { 0x534d4552, 16, 2 },
+    { 0x534d4952, 16, 3 },
+    { 0x42544400, 64, 4 },
+    { 0x47504200, 12, 5 },
+    { 0x42544400, 64, 6 },
+    { 0x47504c48, 12, 7 },
+};
+
+static std::vector<uint64_t> sample_time_us;
+static uint64_t last_air_us;
+
+typedef struct {
+    uint32_t gap_max_us;
+    uint32_t age_max_us;
+} window_t;
+
+static window_t baseline;
+static window_t pairing;
+
+static window_t *window_at(uint32_t step)
+{
+    if (step >= BASELINE_STEP && step < PAIRING_STEP) return &baseline;
+    if (step >= PAIRING_STEP && step < PAIRING_STEP + PAIRING_WINDOW_STEPS) return &pairing;
+    return NULL;
+}
+
+// Any player report on air ends a gap, the demo's too; only bench reports
+// tell the age of the stick sample
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(queued_us);
+    if (report_id != GAMEPAD_REPORT_ID || report_len != GAMEPAD_REPORT_SIZE || sample_time_us.empty()) return;
+    uint32_t gap_us = last_air_us ? (uint32_t)(air_us - last_air_us) : 0;
+    last_air_us = air_us;
+    window_t *window = window_at((uint32_t)sample_time_us.size() - 1);
+    if (!window) return;
+    window->gap_max_us = std::max(window->gap_max_us, gap_us);
+
+    gamepad_report_t state;
+    gamepad_input_report::unpack(report, state);
+    if (state.right_trigger != BENCH_MARKER) return;
+    uint32_t step = (uint16_t)state.left_x;
+    if (step >= sample_time_us.size()) return;
+    window->age_max_us = std::max(window->age_max_us, (uint32_t)(air_us - sample_time_us[step]));
+}
+
+typedef struct {
+    window_t baseline;
+    window_t pairing;
+    uint32_t flash_writes;
+    bool staged_reads_ok;
+    bool flash_ok;
+    uint32_t writes_sampling;
+    deferred_tlv_stats_t stats;
+} run_result_t;
+
+static void write_value(const bench_write_t *write, uint8_t *value)
+{
+    memset(value, write->fill, write->size);
+}
+
+static run_result_t run(bool deferred, uint32_t write_us)
+{
+    sample_time_us.clear();
+    last_air_us = 0;
+    memset(&baseline, 0, sizeof(baseline));
+    memset(&pairing, 0, sizeof(pairing));
+
+    mock_btstack_reset();
+    mock_btstack_set_controller_timing(SETUP_US, COMPLETION_DELAY_US, 0);
+    mock_btstack_set_notification_handler(&notification_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+
+    const btstack_tlv_t *flash_tlv;
+    void *flash_context;
+    btstack_tlv_get_instance(&flash_tlv, &flash_context);
+    for (const bench_write_t &write : pairing_writes) {
+        flash_tlv->delete_tag(flash_context, write.tag);
+    }
+    deferred_tlv_init(deferred);
+    gamepad_init();
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+    mock_btstack_advance_us(200000);
+    mock_tlv_set_write_us(write_us);
+    uint32_t stores_before = mock_btstack_get_stats()->tlv_stores;
+    uint32_t sampling_before = mock_btstack_get_stats()->tlv_writes_sampling;
+
+    run_result_t result = {};
+    result.staged_reads_ok = true;
+    for (uint32_t step = 0; step < STEPS; step++) {
+        sample_time_us.push_back(mock_btstack_now_us());
+        gamepad_report_t report = {};
+        report.left_x = (int16_t)step;
+        report.right_trigger = BENCH_MARKER;
+        report.dpad = DPAD_NEUTRAL;
+        send_gamepad_input(&report);
+
+        if (step == PAIRING_STEP) {
+            const btstack_tlv_t *tlv;
+            void *tlv_context;
+            btstack_tlv_get_instance(&tlv, &tlv_context);
+            for (const bench_write_t &write : pairing_writes) {
+                uint8_t value[64];
+                uint8_t read[64];
+                write_value(&write, value);
+                tlv->store_tag(tlv_context, write.tag, value, write.size);
+                if (tlv->get_tag(tlv_context, write.tag, read, sizeof(read)) != write.size ||
+                    memcmp(read, value, write.size) != 0) {
+                    result.staged_reads_ok = false;
+                }
+            }
+        }
+        mock_btstack_advance_us(1000);
+    }
+    // Past the deadline, however busy the link
+    mock_btstack_advance_us(DEFERRED_TLV_MAX_DELAY_MS * 1000 + 100000);
+
+    result.flash_ok = true;
+    for (const bench_write_t &write : pairing_writes) {
+        // The last write of each tag is what flash must hold
+        const bench_write_t *last = &write;
+        for (const bench_write_t &later : pairing_writes) {
+            if (later.tag == write.tag) last = &later;
+        }
+        uint8_t value[64];
+        uint8_t read[64];
+        write_value(last, value);
+        if (flash_tlv->get_tag(flash_context, write.tag, read, sizeof(read)) != last->size ||
+            memcmp(read, value, last->size) != 0) {
+            result.flash_ok = false;
+        }
+    }
+    result.baseline = baseline;
+    result.pairing = pairing;
+    result.flash_writes = mock_btstack_get_stats()->tlv_stores - stores_before;
+    result.writes_sampling = mock_btstack_get_stats()->tlv_writes_sampling - sampling_before;
+    result.stats = *deferred_tlv_get_stats();
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t write_us = argc > 1 ? (uint32_t)atoi(argv[1]) : FLASH_WRITE_US;
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    run_result_t direct = run(false, write_us);
+    run_result_t deferred = run(true, write_us);
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    printf("Flash persistence benchmark: 7.5 ms link, stick every 1 ms, %u stores while pairing, %u us per flash "
+           "write\n", (unsigned)(sizeof(pairing_writes) / sizeof(pairing_writes[0])), write_us);
+    printf("  %-9s %7s   %8s %8s   %8s %8s\n", "store", "writes", "gap max", "age max", "pairing", "age max");
+    const run_result_t *runs[] = { &direct, &deferred };
+    for (int i = 0; i < 2; i++) {
+        const run_result_t *r = runs[i];
+        printf("  %-9s %7u   %8u %8u   %8u %8u\n", i ? "deferred" : "direct", r->flash_writes,
+               r->baseline.gap_max_us, r->baseline.age_max_us, r->pairing.gap_max_us, r->pairing.age_max_us);
+    }
+    printf("  deferred: %u between events, %u idle, %u forced, %u coalesced; longest write %u us\n",
+           deferred.stats.window_commits, deferred.stats.idle_commits, deferred.stats.forced_commits,
+           deferred.stats.coalesced, deferred.stats.block_max_us);
+
+    int failures = 0;
+    if (deferred.pairing.gap_max_us > deferred.baseline.gap_max_us ||
+        deferred.pairing.age_max_us > deferred.baseline.age_max_us) {
+        printf("FAIL: pairing through the deferred store held up reports\n");
+        failures++;
+    }
+    if (!deferred.staged_reads_ok) {
+        printf("FAIL: a read while staged did not return the newest value\n");
+        failures++;
+    }
+    if (!direct.flash_ok || !deferred.flash_ok) {
+        printf("FAIL: flash does not hold the last value of every tag\n");
+        failures++;
+    }
+    if (direct.writes_sampling || deferred.writes_sampling) {
+        printf("FAIL: %u flash writes with the analog sampler running\n",
+               direct.writes_sampling + deferred.writes_sampling);
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
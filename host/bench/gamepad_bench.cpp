@@ -0,0 +1,190 @@
+// *****************************************************************************
+// Gamepad report path benchmark (host)
+//
+// Drives send_gamepad_input() at a fixed input rate against the mock BTstack
+// and reports per-report CPU cost and input-to-air latency. With
+// change_every > 1 the input only changes every Nth sample, like a real
+// controller sampled faster than the user moves. With centrals > 1 the same
+// input fans out to several subscribed connections sharing the controller.
+// With players > 1 every input changes that many players at once, the worst
+// case for the per-central slot scheduler. Exits non-zero if a CAN_SEND_NOW
+// registration was queued while it was already waiting.
+//
+// usage: gamepad_bench [inputs] [input_period_us] [connection_interval_us] [change_every]
+//                      [central_min_interval_us] [centrals] [players]
+// *****************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "link_tuning.h"
+
+// Bench inputs carry this trigger value; the built-in demo never uses it
+#define BENCH_MARKER 0xA5
+
+#define BENCH_MAX_CENTRALS GAMEPAD_MAX_CONNECTIONS
+#define BENCH_MAX_PLAYERS GAMEPAD_PLAYERS
+
+// Centrals use consecutive handles from here
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+static std::vector<uint64_t> input_time_us;
+static std::vector<uint32_t> queue_latency_us[BENCH_MAX_CENTRALS][BENCH_MAX_PLAYERS];
+static std::vector<uint32_t> air_latency_us[BENCH_MAX_CENTRALS][BENCH_MAX_PLAYERS];
+static uint32_t demo_notifications;
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    uint32_t central = (uint32_t)(con_handle - bench_con_handle);
+    uint32_t player = (uint32_t)(report_id - GAMEPAD_REPORT_ID);
+    gamepad_report_t state;
+    if (report_len != GAMEPAD_REPORT_SIZE || central >= BENCH_MAX_CENTRALS || player >= BENCH_MAX_PLAYERS) return;
+    gamepad_input_report::unpack(report, state);
+    if (state.right_trigger != BENCH_MARKER) {
+        demo_notifications++;
+        return;
+    }
+    // Sequence number travels in left_x/left_y
+    uint32_t seq = (uint16_t)state.left_x | ((uint32_t)(uint16_t)state.left_y << 16);
+    if (seq >= input_time_us.size()) return;
+    queue_latency_us[central][player].push_back((uint32_t)(queued_us - input_time_us[seq]));
+    air_latency_us[central][player].push_back((uint32_t)(air_us - input_time_us[seq]));
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, unsigned int pct)
+{
+    if (values.empty()) return 0;
+    size_t index = (values.size() - 1) * pct / 100;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static void print_latency(const char *name, std::vector<uint32_t> &values)
+{
+    uint32_t max = values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+    printf("  %-16s p50 %6u us  p90 %6u us  p99 %6u us  max %6u us\n", name,
+           percentile(values, 50), percentile(values, 90), percentile(values, 99), max);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t inputs = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 100000;
+    uint32_t input_period_us = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1000;
+    uint32_t connection_interval_us = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 7500;
+    uint32_t change_every = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 1;
+    if (change_every == 0) change_every = 1;
+    uint32_t central_min_interval_us = argc > 5 ? (uint32_t)strtoul(argv[5], NULL, 0) : connection_interval_us;
+    uint32_t centrals = argc > 6 ? (uint32_t)strtoul(argv[6], NULL, 0) : 1;
+    if (centrals < 1) centrals = 1;
+    if (centrals > BENCH_MAX_CENTRALS) centrals = BENCH_MAX_CENTRALS;
+    uint32_t players = argc > 7 ? (uint32_t)strtoul(argv[7], NULL, 0) : 1;
+    if (players < 1) players = 1;
+    if (players > BENCH_MAX_PLAYERS) players = BENCH_MAX_PLAYERS;
+
+    mock_btstack_reset();
+    mock_btstack_set_connection_interval_us(connection_interval_us);
+    mock_btstack_set_central_min_interval_us(central_min_interval_us);
+    mock_btstack_set_notification_handler(&notification_handler);
+
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    gamepad_init();
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    for (uint32_t central = 0; central < centrals; central++) {
+        for (uint32_t player = 0; player < players; player++) {
+            mock_hids_emit_input_report_enable((hci_con_handle_t)(bench_con_handle + central),
+                                               (uint8_t)GAMEPAD_PLAYER_REPORT_ID(player), 1);
+        }
+    }
+
+    input_time_us.reserve(inputs);
+    uint64_t input_ns = 0;
+    for (uint32_t i = 0; i < inputs; i++) {
+        uint32_t seq = i - i % change_every;
+        gamepad_report_t report = {0};
+        report.left_x = (int16_t)(seq & 0xffff);
+        report.left_y = (int16_t)(seq >> 16);
+        report.right_trigger = BENCH_MARKER;
+        report.dpad = DPAD_NEUTRAL;
+
+        if (seq == i) {
+            input_time_us.resize(seq + 1);
+            input_time_us[seq] = mock_btstack_now_us();
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t player = 0; player < players; player++) {
+            send_player_input((uint8_t)player, &report);
+        }
+        auto stop = std::chrono::steady_clock::now();
+        input_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+
+        mock_btstack_advance_us(input_period_us);
+    }
+    // Let the controller drain
+    mock_btstack_advance_us(4 * connection_interval_us);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    const mock_btstack_stats_t *stats = mock_btstack_get_stats();
+    uint32_t sent = stats->notifications_sent ? stats->notifications_sent : 1;
+    uint32_t states = (inputs + change_every - 1) / change_every;
+
+    printf("Gamepad report path benchmark\n");
+    printf("  inputs           %u every %u us, changing every %u, connection interval %u us, %u central(s), "
+           "%u player(s)\n", inputs, input_period_us, change_every, connection_interval_us, centrals, players);
+    printf("  can-send-now     %u requests, %u events, %u duplicate registrations\n", stats->can_send_now_requests,
+           stats->can_send_now_events, stats->can_send_now_duplicates);
+    printf("  notifications    %u sent (%u demo)\n", stats->notifications_sent, demo_notifications);
+    printf("  connection evts  %u, %.2f notifications per event\n", stats->connection_events,
+           stats->connection_events ? (double)stats->notifications_sent / stats->connection_events : 0.0);
+    printf("  cpu per input    %.1f ns (send_player_input, all players)\n", inputs ? (double)input_ns / inputs : 0.0);
+    printf("  cpu per report   %.1f ns (CAN_SEND_NOW handler)\n", (double)stats->handler_ns / sent);
+    for (uint32_t central = 0; central < centrals; central++) {
+        hci_con_handle_t con_handle = (hci_con_handle_t)(bench_con_handle + central);
+        const link_params_t *link = link_tuning_get_params(con_handle);
+        printf("Central 0x%04x\n", con_handle);
+        if (link) {
+            printf("  link             %u.%02u ms interval, %u requests rejected, PHY %u, %u octets\n",
+                   link->conn_interval * 125 / 100, link->conn_interval * 125 % 100, link->interval_rejections,
+                   link->tx_phy, link->max_tx_octets);
+        }
+        for (uint32_t player = 0; player < players; player++) {
+            uint32_t delivered = (uint32_t)air_latency_us[central][player].size();
+            printf(" Player %u\n", player + 1);
+            printf("  bench states     %u delivered, %u never sent\n", delivered, states - delivered);
+            printf("  input-to-notification latency\n");
+            print_latency("queued", queue_latency_us[central][player]);
+            print_latency("on air", air_latency_us[central][player]);
+        }
+    }
+    printf("Firmware statistics\n");
+    gamepad_stats_dump();
+    if (stats->can_send_now_duplicates) {
+        printf("FAIL: a CAN_SEND_NOW registration was queued twice\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+// *****************************************************************************
+// Input pipeline benchmark and check (host, two threads)
+//
+// 1. Raw spsc_ring throughput with one producer and one consumer thread,
+//    verifying every item arrives once and in order.
+// 2. The full pipeline: a producer thread stands in for the core1 sampler
+//    and pushes sequence-numbered snapshots; the main thread runs the mock
+//    run loop, whose data source drains into the report path. Notifications
+//    must never go backwards in sequence.
+// 3. A button release lost to a full ring while core0 is busy: queued as
+//    changes only, as the sampler does, the release must still reach the
+//    host once the sampler samples the same inputs again.
+//
+// usage: input_pipeline_bench [ring_items] [snapshots] [snapshot_period_ns]
+// Exits non-zero if an ordering or loss violation is detected, or if the
+// host is left holding the button.
+// *****************************************************************************
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "input_pipeline.h"
+#include "input_ring.h"
+
+#define BENCH_MARKER 0xA5
+
+static int64_t last_seq = -1;
+static uint32_t order_violations;
+static uint32_t bench_notifications;
+static gamepad_report_t on_air;
+
+static uint64_t now_ns(void)
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int ring_check(uint32_t items)
+{
+    static spsc_ring<uint32_t, 1024> ring;
+    uint32_t errors = 0;
+
+    uint64_t start = now_ns();
+    std::thread producer([items]() {
+        for (uint32_t i = 0; i < items; i++) {
+            while (!ring.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (uint32_t expected = 0; expected < items;) {
+        uint32_t value;
+        if (!ring.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        if (value != expected) errors++;
+        expected++;
+    }
+    producer.join();
+    uint64_t elapsed = now_ns() - start;
+
+    printf("spsc_ring: %u items, %.1f ns/item, %u out-of-order\n", items,
+           items ? (double)elapsed / items : 0.0, errors);
+    return errors == 0;
+}
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(report_id);
+    UNUSED(queued_us);
+    UNUSED(air_us);
+    gamepad_report_t state;
+    if (report_len != GAMEPAD_REPORT_SIZE) return;
+    gamepad_input_report::unpack(report, state);
+    if (state.right_trigger != BENCH_MARKER) return;
+
+    int64_t seq = (uint16_t)state.left_x | ((int64_t)(uint16_t)state.left_y << 16);
+    if (seq <= last_seq) order_violations++;
+    last_seq = seq;
+    bench_notifications++;
+}
+
+static int pipeline_check(uint32_t snapshots, uint32_t period_ns)
+{
+    mock_btstack_reset();
+    mock_btstack_set_notification_handler(&notification_handler);
+
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    gamepad_init();
+    input_pipeline_init();
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    mock_hids_emit_input_report_enable(0x0040, GAMEPAD_REPORT_ID, 1);
+
+    std::atomic<bool> producer_done(false);
+    int64_t last_pushed = -1;
+    std::thread producer([snapshots, period_ns, &producer_done, &last_pushed]() {
+        uint64_t next = now_ns();
+        for (uint32_t seq = 0; seq < snapshots; seq++) {
+            gamepad_report_t report = {0};
+            report.left_x = (int16_t)(seq & 0xffff);
+            report.left_y = (int16_t)(seq >> 16);
+            report.right_trigger = BENCH_MARKER;
+            report.dpad = DPAD_NEUTRAL;
+            if (input_pipeline_push(0, &report, (uint32_t)(now_ns() / 1000))) {
+                last_pushed = seq;
+            }
+            next += period_ns;
+            while (now_ns() < next) {
+                std::this_thread::yield();
+            }
+        }
+        producer_done.store(true);
+    });
+
+    // Consumer: the run loop, in 250 us virtual steps
+    while (!producer_done.load()) {
+        mock_btstack_advance_us(250);
+        std::this_thread::yield();
+    }
+    producer.join();
+    btstack_run_loop_poll_data_sources_from_irq();
+    mock_btstack_advance_us(100000);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    const input_pipeline_stats_t *stats = input_pipeline_get_stats();
+    printf("pipeline: %u snapshots every %u ns: %u pushed, %u dropped, %u drained, %u forwarded\n",
+           snapshots, period_ns, stats->pushed, stats->dropped, stats->drained, stats->forwarded);
+    printf("          %u notifications, last sequence %lld, %u ordering violations\n",
+           bench_notifications, (long long)last_seq, order_violations);
+
+    // Drops are allowed when the consumer is descheduled, but the newest
+    // queued snapshot must always reach the host
+    int ok = order_violations == 0 && stats->pushed == stats->drained && last_seq == last_pushed;
+    return ok;
+}
+
+static void state_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                          uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(report_id);
+    UNUSED(queued_us);
+    UNUSED(air_us);
+    gamepad_report_t state;
+    if (report_len != GAMEPAD_REPORT_SIZE) return;
+    gamepad_input_report::unpack(report, state);
+    if (state.right_trigger != BENCH_MARKER) return;
+    on_air = state;
+}
+
+static int full_ring_check(void)
+{
+    mock_btstack_reset();
+    mock_btstack_set_notification_handler(&state_handler);
+
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    gamepad_init();
+    input_pipeline_init();
+    input_pipeline_reset_stats();
+
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    mock_hids_emit_input_report_enable(0x0040, GAMEPAD_REPORT_ID, 1);
+    mock_btstack_advance_us(100000);
+
+    // Core0 drains nothing meanwhile: the press and stick moves fill the
+    // ring and the release is dropped
+    gamepad_report_t report = {};
+    report.right_trigger = BENCH_MARKER;
+    report.dpad = DPAD_NEUTRAL;
+    report.buttons = GAMEPAD_BUTTON_1;
+    uint32_t timestamp_us = 0;
+    for (int16_t i = 0; i < INPUT_RING_SIZE; i++) {
+        report.left_x = i;
+        input_pipeline_push_changed(0, &report, timestamp_us++);
+    }
+    report.buttons = 0;
+    int release_queued = input_pipeline_push_changed(0, &report, timestamp_us++);
+
+    // Core0 catches up, then the sampler sees the same inputs again
+    mock_btstack_advance_us(100000);
+    input_pipeline_push_changed(0, &report, timestamp_us++);
+    mock_btstack_advance_us(100000);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    const input_pipeline_stats_t *stats = input_pipeline_get_stats();
+    printf("full ring: %u pushed, %u dropped; release %s, host holds buttons 0x%04x, stick %d\n", stats->pushed,
+           stats->dropped, release_queued ? "queued" : "dropped", on_air.buttons, on_air.left_x);
+    return !release_queued && stats->dropped == 1 && on_air.buttons == 0 && on_air.left_x == INPUT_RING_SIZE - 1;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t ring_items = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 1000000;
+    uint32_t snapshots = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 100000;
+    uint32_t period_ns = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 10000;
+
+    int ok = ring_check(ring_items);
+    ok &= pipeline_check(snapshots, period_ns);
+    ok &= full_ring_check();
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// *****************************************************************************
+// Input script replay benchmark (host)
+//
+// Measures how fast a script is decoded, then replays it through the demo
+// timer and the mock report path for a number of passes and compares each
+// notification's air time with the time its state was due in the script.
+// Without a file argument the built-in demo is used.
+//
+// usage: input_script_bench [script.bin] [speed_percent] [passes] [connection_interval_us]
+// Exits non-zero if the script does not open or replay loses passes.
+// *****************************************************************************
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "demo_script.h"
+#include "gamepad.h"
+#include "gamepad_layout.h"
+#include "input_script.h"
+#include "report_mailbox.h"
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+typedef struct {
+    uint32_t due_us;
+    gamepad_report_t report;
+} expected_state_t;
+
+static std::vector<expected_state_t> expected;
+static size_t expected_next;
+static uint64_t expected_end_us;    // Due time of the first change after the last pass
+static std::vector<uint32_t> lateness_us;
+static uint32_t unmatched;
+static uint32_t coalesced;
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(queued_us);
+    if (con_handle != bench_con_handle || report_id != GAMEPAD_REPORT_ID || report_len != GAMEPAD_REPORT_SIZE) return;
+    gamepad_report_t state;
+    gamepad_input_report::unpack(report, state);
+
+    // Newest expected state equal to this one that was due by now; states
+    // replaced within one connection interval are coalesced, not missing
+    size_t match = SIZE_MAX;
+    for (size_t i = expected_next; i < expected.size() && expected[i].due_us <= air_us; i++) {
+        if (gamepad_report_equal(&expected[i].report, &state)) match = i;
+    }
+    if (match == SIZE_MAX) {
+        // The script keeps looping past the measured passes
+        if (air_us < expected_end_us) unmatched++;
+        return;
+    }
+    lateness_us.push_back((uint32_t)(air_us - expected[match].due_us));
+    coalesced += (uint32_t)(match - expected_next);
+    expected_next = match + 1;
+}
+
+static uint32_t percentile(std::vector<uint32_t> &values, unsigned int pct)
+{
+    if (values.empty()) return 0;
+    size_t index = (values.size() - 1) * pct / 100;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static std::vector<uint8_t> read_file(const char *path)
+{
+    std::vector<uint8_t> data;
+    FILE *file = fopen(path, "rb");
+    if (!file) return data;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    return data;
+}
+
+// Records per second through input_script_replay_poll(), all due at once
+static void decode_run(const input_script_t *script)
+{
+    uint64_t records = 0;
+    uint32_t checksum = 0;
+    input_script_replay_t replay;
+    auto start = std::chrono::steady_clock::now();
+    auto stop = start;
+    do {
+        for (int pass = 0; pass < 1000; pass++) {
+            input_script_replay_start(&replay, script, 0, 100, false, 0);
+            int marker;
+            checksum += input_script_replay_poll(&replay, script->duration_us, &marker);
+            checksum += replay.state[0].buttons;
+            records += script->records;
+        }
+        stop = std::chrono::steady_clock::now();
+    } while (stop - start < std::chrono::milliseconds(500));
+    double seconds = std::chrono::duration<double>(stop - start).count();
+    printf("  decode           %.1f M records/s (%.1f ns each) [%08x]\n", records / seconds / 1e6,
+           seconds * 1e9 / records, checksum);
+}
+
+// Due time and state of player 1 for every change over the given passes,
+// stepping a reference replay exactly from record to record
+static void expected_build(const input_script_t *script, uint32_t start_us, uint16_t speed_percent, uint32_t passes)
+{
+    uint32_t replay_us = (uint32_t)((uint64_t)script->duration_us * passes * 100 / speed_percent);
+    input_script_replay_t replay;
+    input_script_replay_start(&replay, script, start_us, speed_percent, true, 0);
+    uint32_t now_us = start_us;
+    expected.push_back({now_us, replay.state[0]});
+    expected_end_us = UINT64_MAX;
+    while (true) {
+        int marker;
+        if (input_script_replay_poll(&replay, now_us, &marker) & 1) {
+            if (replay.loops >= passes && now_us != start_us + replay_us) {
+                expected_end_us = now_us;
+                break;
+            }
+            expected.push_back({now_us, replay.state[0]});
+        }
+        uint32_t wait_us = input_script_replay_wait_us(&replay, now_us);
+        if (wait_us == UINT32_MAX) break;
+        now_us += wait_us ? wait_us : 1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<uint8_t> file;
+    const uint8_t *data = demo_script;
+    uint32_t size = sizeof(demo_script);
+    if (argc > 1 && argv[1][0] != '-') {
+        file = read_file(argv[1]);
+        data = file.data();
+        size = (uint32_t)file.size();
+    }
+    uint16_t speed_percent = argc > 2 ? (uint16_t)strtoul(argv[2], NULL, 0) : 100;
+    if (speed_percent == 0) speed_percent = 100;
+    uint32_t passes = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 10;
+    uint32_t connection_interval_us = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 7500;
+
+    input_script_t script;
+    if (input_script_open(&script, data, size) != 0) {
+        printf("%s: not a valid input script\n", argc > 1 ? argv[1] : "built-in demo");
+        return 1;
+    }
+    printf("Input script replay benchmark\n");
+    printf("  script           %u bytes, %u records, %u player(s), %u.%03u s per pass\n", size, script.records,
+           script.players, script.duration_us / 1000000, script.duration_us / 1000 % 1000);
+    decode_run(&script);
+
+    mock_btstack_reset();
+    mock_btstack_set_connection_interval_us(connection_interval_us);
+    mock_btstack_set_notification_handler(&notification_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    gamepad_init();
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    gamepad_script_set_speed(speed_percent);
+    if (data != demo_script) {
+        gamepad_script_play(data, size);
+    }
+    // Subscribing starts the demo, i.e. the loaded script, at this instant
+    uint32_t start_us = (uint32_t)mock_btstack_now_us();
+    expected_build(&script, start_us, speed_percent, passes);
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+
+    uint64_t replay_us = (uint64_t)script.duration_us * passes * 100 / speed_percent;
+    uint64_t end_us = mock_btstack_now_us() + replay_us + 4 * connection_interval_us;
+    while (mock_btstack_now_us() < end_us) {
+        mock_btstack_advance_us(100);
+    }
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    uint32_t missed = (uint32_t)(expected.size() - std::min(expected.size(), expected_next));
+    uint32_t max = lateness_us.empty() ? 0 : *std::max_element(lateness_us.begin(), lateness_us.end());
+    printf("  replay           %u passes at %u%%, connection interval %u us\n", passes, speed_percent,
+           connection_interval_us);
+    printf("  player 1 states  %u due, %u sent, %u coalesced, %u never sent, %u unexpected\n",
+           (uint32_t)expected.size(), (uint32_t)lateness_us.size(), coalesced, missed, unmatched);
+    printf("  due-to-air       p50 %6u us  p90 %6u us  p99 %6u us  max %6u us\n", percentile(lateness_us, 50),
+           percentile(lateness_us, 90), percentile(lateness_us, 99), max);
+    return missed <= 1 && unmatched == 0 ? 0 : 1;
+}
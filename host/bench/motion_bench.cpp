@@ -0,0 +1,498 @@
+// *****************************************************************************
+// Motion benchmark (host)
+//
+// Fusion: runs IMU samples through imu_fusion and compares the orientation
+// with a double-precision run of the same filter, and for the built-in
+// synthetic recording with the true orientation. Only tilt is compared with
+// the truth; without a magnetometer nothing observes yaw.
+//
+// Batching: replays the same samples at their timestamps through the mock
+// to a central subscribed to player 1 and to the motion report, while bench
+// inputs change player 1 every 20..30 ms. Checks that every motion sample
+// the central gets is the recorded one, in order, and compares player 1's
+// input-to-air latency with and without the motion subscription, on a
+// normal link and on a saturated one carrying a single packet per
+// connection event.
+//
+// usage: motion_bench [recording]
+//
+// A recording is the firmware's motion log ('i' on the console): lines
+// "imu,<time us>,<gx>,<gy>,<gz>,<ax>,<ay>,<az>". Other lines are skipped, so
+// a raw terminal capture works.
+// *****************************************************************************
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "imu_fusion.h"
+#include "motion_report.h"
+
+#define BENCH_MARKER 0xA5
+#define SAMPLE_PERIOD_US (1000000.0 / IMU_SAMPLE_HZ)
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+typedef struct {
+    imu_sample_t sample;
+    bool has_truth;
+    double up[3];               // True gravity direction in sensor axes
+} recorded_sample_t;
+
+static std::vector<recorded_sample_t> recording;
+
+// *****************************************************************************
+// Recordings
+
+static bool load_recording(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) return false;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long time_us;
+        int v[6];
+        if (sscanf(line, "imu,%lu,%d,%d,%d,%d,%d,%d", &time_us, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5]) != 7) {
+            continue;
+        }
+        recorded_sample_t entry = {};
+        entry.sample.timestamp_us = (uint32_t)time_us;
+        for (int axis = 0; axis < 3; axis++) {
+            entry.sample.gyro[axis] = (int16_t)v[axis];
+            entry.sample.accel[axis] = (int16_t)v[3 + axis];
+        }
+        recording.push_back(entry);
+    }
+    fclose(file);
+    return true;
+}
+
+static void quat_multiply(const double *a, const double *b, double *out)
+{
+    double r[4] = {
+        a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3],
+        a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2],
+        a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1],
+        a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0],
+    };
+    for (int i = 0; i < 4; i++) out[i] = r[i];
+}
+
+// World up in sensor axes for a sensor-to-world quaternion
+static void quat_up(const double *q, double *up)
+{
+    up[0] = 2 * (q[1] * q[3] - q[0] * q[2]);
+    up[1] = 2 * (q[0] * q[1] + q[2] * q[3]);
+    up[2] = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+}
+
+static double noise(uint32_t *seed, double amplitude)
+{
+    // Sum of uniforms, roughly normal with this standard deviation
+    double sum = 0;
+    for (int i = 0; i < 4; i++) {
+        *seed = *seed * 1103515245u + 12345u;
+        sum += ((*seed >> 8) & 0xffff) / 65536.0 - 0.5;
+    }
+    return sum * amplitude * 1.732;
+}
+
+static int16_t saturate(double value)
+{
+    return (int16_t)std::max(-32768.0, std::min(32767.0, round(value)));
+}
+
+// 20 s of play: held still and tilted, slow sweeps on two axes, a yaw spin,
+// a fast flick and a shake, with gyro bias, sensor noise and timestamp jitter
+static void synthesize(void)
+{
+    const double pi = 3.14159265358979323846;
+    const double rad_per_count = IMU_GYRO_RANGE_DPS * pi / 180.0 / 32768.0;
+    const double counts_per_g = 32768.0 / IMU_ACCEL_RANGE_G;
+    const double bias[3] = {0.8 * pi / 180, -0.5 * pi / 180, 0.3 * pi / 180};
+    double q[4] = {cos(10 * pi / 180), sin(10 * pi / 180), 0, 0};
+    uint32_t seed = 1;
+
+    int samples = (int)(20.0 * IMU_SAMPLE_HZ);
+    for (int n = 0; n < samples; n++) {
+        double t = n * SAMPLE_PERIOD_US / 1e6;
+        double rate[3] = {0, 0, 0};
+        double linear[3] = {0, 0, 0};
+        if (t >= 2 && t < 8) {
+            rate[0] = 2.0 * sin(2 * pi * 0.5 * (t - 2));
+            rate[1] = 1.5 * sin(2 * pi * 0.3 * (t - 2));
+        } else if (t >= 8 && t < 12) {
+            rate[2] = 3.0;
+            rate[0] = 1.0 * sin(2 * pi * 0.25 * (t - 8));
+        } else if (t >= 12 && t < 12.5) {
+            rate[1] = 15.0 * sin(2 * pi * (t - 12));
+        } else if (t >= 14 && t < 16) {
+            linear[0] = 1.5 * sin(2 * pi * 4 * t);
+        }
+
+        recorded_sample_t entry = {};
+        entry.has_truth = true;
+        quat_up(q, entry.up);
+        entry.sample.timestamp_us = (uint32_t)(1000000 + n * SAMPLE_PERIOD_US + noise(&seed, 10));
+        for (int axis = 0; axis < 3; axis++) {
+            entry.sample.gyro[axis] = saturate((rate[axis] + bias[axis]) / rad_per_count + noise(&seed, 2));
+            entry.sample.accel[axis] = saturate((entry.up[axis] + linear[axis]) * counts_per_g +
+                                                noise(&seed, 0.01 * counts_per_g));
+        }
+        recording.push_back(entry);
+
+        // Exact rotation over the sample period at the constant rate
+        double dt = SAMPLE_PERIOD_US / 1e6;
+        double magnitude = sqrt(rate[0] * rate[0] + rate[1] * rate[1] + rate[2] * rate[2]);
+        if (magnitude > 0) {
+            double half = magnitude * dt / 2;
+            double step[4] = {cos(half), sin(half) * rate[0] / magnitude, sin(half) * rate[1] / magnitude,
+                              sin(half) * rate[2] / magnitude};
+            quat_multiply(q, step, q);
+        }
+    }
+}
+
+// *****************************************************************************
+// Fusion
+
+// The fixed-point filter's algorithm in double precision
+typedef struct {
+    double q[4];
+    bool aligned;
+    uint32_t shaken_us;
+} reference_fusion_t;
+
+static void reference_update(reference_fusion_t *fusion, const imu_sample_t *sample, uint32_t dt_us)
+{
+    const double pi = 3.14159265358979323846;
+    const double rad_per_count = IMU_GYRO_RANGE_DPS * pi / 180.0 / 32768.0;
+    const double one_g = 32768.0 / IMU_ACCEL_RANGE_G;
+    const double kp = IMU_FUSION_KP_MILLI / 1000.0;
+    double *q = fusion->q;
+    double dt = dt_us / 1e6;
+
+    double half[3];
+    for (int axis = 0; axis < 3; axis++) {
+        half[axis] = sample->gyro[axis] * rad_per_count * dt / 2;
+    }
+    double accel[3] = {sample->accel[0] / one_g, sample->accel[1] / one_g, sample->accel[2] / one_g};
+    double magnitude = sqrt(accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2]);
+    bool gravity = magnitude >= 0.75 && magnitude <= 1.25;
+    if (!gravity) {
+        fusion->shaken_us = 200000;
+    } else if (fusion->shaken_us) {
+        fusion->shaken_us = dt_us < fusion->shaken_us ? fusion->shaken_us - dt_us : 0;
+        gravity = !fusion->aligned;
+    }
+    if (gravity) {
+        double up[3] = {accel[0] / magnitude, accel[1] / magnitude, accel[2] / magnitude};
+        if (!fusion->aligned) {
+            fusion->aligned = true;
+            if (up[2] < -16000 / 16384.0) {
+                q[0] = 0, q[1] = 1, q[2] = 0, q[3] = 0;
+            } else {
+                double w = sqrt((1 + up[2]) / 2);
+                q[0] = w, q[1] = up[1] / (2 * w), q[2] = -up[0] / (2 * w), q[3] = 0;
+            }
+            return;
+        }
+        double estimated[3];
+        quat_up(q, estimated);
+        double error[3] = {up[1] * estimated[2] - up[2] * estimated[1], up[2] * estimated[0] - up[0] * estimated[2],
+                           up[0] * estimated[1] - up[1] * estimated[0]};
+        for (int axis = 0; axis < 3; axis++) {
+            half[axis] += kp * error[axis] * dt / 2;
+        }
+    }
+    double step[4] = {1, half[0], half[1], half[2]};
+    quat_multiply(q, step, q);
+    double length = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    for (int i = 0; i < 4; i++) q[i] /= length;
+}
+
+// As motion_report.cpp derives dt
+static uint32_t sample_dt_us(size_t index)
+{
+    const uint32_t period_us = 1000000 / IMU_SAMPLE_HZ;
+    if (index == 0) return period_us;
+    uint32_t dt_us = recording[index].sample.timestamp_us - recording[index - 1].sample.timestamp_us;
+    return (dt_us == 0 || dt_us > 4 * period_us) ? period_us : dt_us;
+}
+
+static double angle_deg(const double *a, const double *b)
+{
+    double dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+    return acos(std::max(-1.0, std::min(1.0, dot))) * 180.0 / 3.14159265358979323846;
+}
+
+static int run_fusion(void)
+{
+    imu_fusion_t fusion;
+    imu_fusion_init(&fusion, IMU_GYRO_RANGE_DPS, IMU_ACCEL_RANGE_G, IMU_FUSION_KP_MILLI);
+    reference_fusion_t reference = {{1, 0, 0, 0}, false, 0};
+
+    double max_difference = 0;
+    double tilt_sum_sq = 0, tilt_max = 0;
+    uint32_t tilt_count = 0;
+    for (size_t i = 0; i < recording.size(); i++) {
+        const recorded_sample_t *entry = &recording[i];
+        uint32_t dt_us = sample_dt_us(i);
+        imu_fusion_update(&fusion, entry->sample.gyro, entry->sample.accel, dt_us);
+        reference_update(&reference, &entry->sample, dt_us);
+
+        double q[4];
+        for (int k = 0; k < 4; k++) {
+            q[k] = fusion.q[k] / 1073741824.0;
+            max_difference = std::max(max_difference, fabs(q[k] - reference.q[k]));
+        }
+        if (entry->has_truth && i >= (size_t)IMU_SAMPLE_HZ) {
+            // The truth's up is one sample behind the sample's rotation
+            double up[3];
+            quat_up(q, up);
+            double truth[3];
+            const double *next = i + 1 < recording.size() ? recording[i + 1].up : entry->up;
+            for (int axis = 0; axis < 3; axis++) truth[axis] = next[axis];
+            double tilt = angle_deg(up, truth);
+            tilt_sum_sq += tilt * tilt;
+            tilt_max = std::max(tilt_max, tilt);
+            tilt_count++;
+        }
+    }
+
+    int failures = 0;
+    printf("Fusion: %zu samples, %lu corrected by gravity\n", recording.size(), (unsigned long)fusion.corrections);
+    printf("  fixed point vs double: max component difference %.5f\n", max_difference);
+    if (max_difference > 0.005) {
+        printf("FAIL: fixed-point fusion strays from the double-precision filter\n");
+        failures++;
+    }
+    if (tilt_count) {
+        double tilt_rms = sqrt(tilt_sum_sq / tilt_count);
+        printf("  tilt error vs truth: rms %.2f deg, max %.2f deg\n", tilt_rms, tilt_max);
+        if (tilt_rms > 2.0 || tilt_max > 5.0) {
+            printf("FAIL: tilt error\n");
+            failures++;
+        }
+    }
+    return failures;
+}
+
+// *****************************************************************************
+// Batching
+
+typedef struct {
+    uint32_t reports;
+    uint32_t samples;
+    uint32_t gaps;              // Samples skipped between reports
+    uint32_t mismatches;        // Samples differing from the recording
+    uint32_t max_batch;
+    std::vector<uint32_t> player_latency_us;
+} link_result_t;
+
+static link_result_t result;
+static std::vector<uint64_t> input_time_us;
+static uint32_t last_sequence;  // Counter of the newest sample received, 32 bits
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(queued_us);
+    if (report_id == GAMEPAD_MOTION_REPORT_ID && report_len == GAMEPAD_MOTION_REPORT_SIZE) {
+        motion_report_t motion;
+        gamepad_motion_report::unpack(report, motion);
+        uint32_t newest = last_sequence + (uint16_t)(motion.sequence - (uint16_t)last_sequence);
+        uint32_t first = newest - motion.count + 1;
+        result.reports++;
+        result.samples += motion.count;
+        result.gaps += first - last_sequence - 1;
+        result.max_batch = std::max<uint32_t>(result.max_batch, motion.count);
+        for (uint32_t i = 0; i < motion.count; i++) {
+            uint32_t index = first + i - 1;
+            if (index >= recording.size()) {
+                result.mismatches++;
+                continue;
+            }
+            const imu_sample_t *expected = &recording[index].sample;
+            for (int axis = 0; axis < 3; axis++) {
+                if (motion.gyro[3 * i + axis] != expected->gyro[axis] ||
+                    motion.accel[3 * i + axis] != expected->accel[axis]) {
+                    result.mismatches++;
+                    break;
+                }
+            }
+        }
+        last_sequence = newest;
+        return;
+    }
+    if (report_id != GAMEPAD_REPORT_ID || report_len != GAMEPAD_REPORT_SIZE) return;
+    gamepad_report_t state;
+    gamepad_input_report::unpack(report, state);
+    if (state.right_trigger != BENCH_MARKER) return;
+    uint32_t seq = (uint16_t)state.left_x;
+    if (seq < input_time_us.size()) {
+        result.player_latency_us.push_back((uint32_t)(air_us - input_time_us[seq]));
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> values, unsigned int pct)
+{
+    if (values.empty()) return 0;
+    size_t index = (values.size() - 1) * pct / 100;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Replay the recording over a link; motion subscribed or not
+static void run_link(bool motion, uint32_t interval_us, uint8_t packets_per_event)
+{
+    result = link_result_t();
+    input_time_us.clear();
+    last_sequence = 0;
+
+    mock_btstack_reset();
+    mock_btstack_set_connection_interval_us(interval_us);
+    mock_btstack_set_central_min_interval_us(interval_us);
+    mock_btstack_set_packets_per_event(packets_per_event);
+    mock_btstack_set_notification_handler(&notification_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    gamepad_init();
+    // Player reports go out as inputs change; schedule_bench covers holding
+    // them for the connection event schedule
+    gamepad_set_event_schedule(false);
+
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+    if (motion) {
+        mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_MOTION_REPORT_ID, 1);
+    }
+    mock_btstack_advance_us(100000);
+
+    // Samples keep their spacing, starting now
+    uint64_t start_us = mock_btstack_now_us();
+    uint32_t first_us = recording.empty() ? 0 : recording[0].sample.timestamp_us;
+    uint64_t next_input_us = start_us + 10000;
+    uint32_t jitter = 12345;
+    for (size_t i = 0; i < recording.size(); i++) {
+        uint64_t sample_us = start_us + (uint32_t)(recording[i].sample.timestamp_us - first_us);
+        while (next_input_us <= sample_us) {
+            mock_btstack_advance_us((uint32_t)(next_input_us - mock_btstack_now_us()));
+            gamepad_report_t report = {};
+            report.left_x = (int16_t)input_time_us.size();
+            report.right_trigger = BENCH_MARKER;
+            report.dpad = DPAD_NEUTRAL;
+            input_time_us.push_back(mock_btstack_now_us());
+            send_gamepad_input(&report);
+            jitter = jitter * 1103515245u + 12345u;
+            next_input_us += 20000 + (jitter >> 16) % 10000;
+        }
+        mock_btstack_advance_us((uint32_t)(sample_us - mock_btstack_now_us()));
+        imu_sample_t sample = recording[i].sample;
+        sample.timestamp_us = (uint32_t)mock_btstack_now_us();
+        mock_imu_push_sample(&sample);
+    }
+    mock_btstack_advance_us(100000);
+}
+
+static void print_link(const char *name, bool motion, uint32_t duration_us)
+{
+    std::vector<uint32_t> &latency = result.player_latency_us;
+    uint32_t max = latency.empty() ? 0 : *std::max_element(latency.begin(), latency.end());
+    printf("  %-22s %-4s %6u/%-6u %6u %6.2f %7.1f   %6u %6u %6u\n", name, motion ? "on" : "off", result.samples,
+           motion ? (uint32_t)recording.size() : 0, result.gaps,
+           result.reports ? (double)result.samples / result.reports : 0.0, result.reports * 1e6 / duration_us,
+           percentile(latency, 50), percentile(latency, 99), max);
+}
+
+int main(int argc, char *argv[])
+{
+    int failures = 0;
+    if (argc > 1) {
+        if (!load_recording(argv[1])) {
+            printf("Cannot read %s\n", argv[1]);
+            return 1;
+        }
+        printf("Motion benchmark: %zu samples from %s\n", recording.size(), argv[1]);
+    } else {
+        synthesize();
+        printf("Motion benchmark: %zu synthetic samples at %u Hz\n", recording.size(), IMU_SAMPLE_HZ);
+    }
+    if (recording.size() < 2) {
+        printf("Not enough samples\n");
+        return 1;
+    }
+    failures += run_fusion();
+    uint32_t duration_us = recording.back().sample.timestamp_us - recording.front().sample.timestamp_us;
+
+    struct {
+        const char *name;
+        uint32_t interval_us;
+        uint8_t packets_per_event;
+        bool motion;
+    } links[] = {
+        {"7.5 ms", 7500, 4, false},
+        {"7.5 ms", 7500, 4, true},
+        {"7.5 ms, 1 packet/event", 7500, 1, false},
+        {"7.5 ms, 1 packet/event", 7500, 1, true},
+        {"15 ms", 15000, 4, true},
+        {"30 ms", 30000, 4, true},
+    };
+    const int link_count = (int)(sizeof(links) / sizeof(links[0]));
+    link_result_t results[link_count];
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    for (int i = 0; i < link_count; i++) {
+        run_link(links[i].motion, links[i].interval_us, links[i].packets_per_event);
+        results[i] = result;
+    }
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    printf("Batching (%u samples per report, %u-byte report), player 1 input -> air in us:\n", MOTION_BATCH_SAMPLES,
+           (unsigned)GAMEPAD_MOTION_REPORT_SIZE);
+    printf("  %-22s %-4s %13s %6s %6s %7s   %6s %6s %6s\n", "link", "mot", "samples", "skip", "batch", "rep/s",
+           "p50", "p99", "max");
+    for (int i = 0; i < link_count; i++) {
+        result = results[i];
+        print_link(links[i].name, links[i].motion, duration_us);
+        if (result.mismatches) {
+            printf("FAIL: %u motion samples differ from the recording\n", result.mismatches);
+            failures++;
+        }
+    }
+
+    // Every sample on a link that keeps up; player 1 no more than one
+    // connection event later for sharing the link with motion
+    if (results[1].samples != recording.size() || results[1].gaps) {
+        printf("FAIL: samples lost on the 7.5 ms link\n");
+        failures++;
+    }
+    for (int i = 0; i < 4; i += 2) {
+        uint32_t without = percentile(results[i].player_latency_us, 99);
+        uint32_t with = percentile(results[i + 1].player_latency_us, 99);
+        if (with > without + links[i].interval_us) {
+            printf("FAIL: motion delays player reports on the %s link\n", links[i].name);
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
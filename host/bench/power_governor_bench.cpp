@@ -0,0 +1,219 @@
+// *****************************************************************************
+// Power governor benchmark (host)
+//
+// Plays one scenario against the virtual controller and central: advertise
+// with nobody connecting, a central subscribes and the built-in demo plays
+// once, the pad lies untouched, a button press wakes it and the central
+// disconnects. Prints the governor's transitions, the connection events the
+// peripheral attended per second in each state (the radio's share of the
+// power budget), the latency of the waking press and the advertising
+// schedule.
+//
+// Exits non-zero if the pad untouched for long enough never reaches idle or
+// sleep, the waking press takes longer than one sleep interval to go on
+// air, or the link does not return to its active parameters.
+//
+// usage: power_governor_bench [quiet_s] [central_min_interval_us]
+// *****************************************************************************
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "link_tuning.h"
+#include "power_governor.h"
+
+// The waking press carries this trigger value; the built-in demo never uses it
+#define BENCH_MARKER 0xA5
+
+// The built-in demo, played once after subscribing, is over by then
+#define DEMO_MS_MAX 15000
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+static uint64_t press_air_us;
+
+// Attended and skipped connection events per governor state
+static uint64_t state_us[POWER_STATE_COUNT];
+static uint32_t state_attended[POWER_STATE_COUNT];
+static uint32_t state_skipped[POWER_STATE_COUNT];
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(report_id);
+    UNUSED(queued_us);
+    gamepad_report_t state;
+    if (report_len != GAMEPAD_REPORT_SIZE) return;
+    gamepad_input_report::unpack(report, state);
+    if (state.right_trigger == BENCH_MARKER && !press_air_us) {
+        press_air_us = air_us;
+    }
+}
+
+typedef struct {
+    uint64_t time_us;
+    power_state_t from;
+    power_state_t to;
+} transition_t;
+
+static transition_t transitions[32];
+static int transition_count;
+
+static power_state_t noted_state;
+
+static void note_state(void)
+{
+    power_state_t state = power_governor_state();
+    if (state == noted_state) return;
+    if (transition_count < 32) {
+        transition_t *transition = &transitions[transition_count++];
+        transition->time_us = mock_btstack_now_us();
+        transition->from = noted_state;
+        transition->to = state;
+    }
+    noted_state = state;
+}
+
+// Advance in 1 ms steps, charging events to the state they happened in
+static void run_ms(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        power_state_t state = power_governor_state();
+        const mock_btstack_stats_t *before = mock_btstack_get_stats();
+        uint32_t events = before->connection_events;
+        uint32_t skipped = before->events_skipped;
+        mock_btstack_advance_us(1000);
+        const mock_btstack_stats_t *after = mock_btstack_get_stats();
+        state_us[state] += 1000;
+        state_skipped[state] += after->events_skipped - skipped;
+        state_attended[state] += (after->connection_events - events) - (after->events_skipped - skipped);
+        note_state();
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t quiet_s = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 90;
+    uint32_t central_min_interval_us = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 7500;
+
+    mock_btstack_reset();
+    mock_btstack_set_central_min_interval_us(central_min_interval_us);
+    mock_btstack_set_notification_handler(&notification_handler);
+
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    gamepad_init();
+    gamepad_script_set_loop(false);
+
+    // Nobody connects for a while
+    uint16_t adv_fast_max = mock_btstack_get_stats()->advertising_interval_max;
+    uint64_t adv_slow_us = 0;
+    for (uint32_t ms = 0; ms < ADV_FAST_DURATION_MS + 5000; ms++) {
+        mock_btstack_advance_us(1000);
+        if (!adv_slow_us && mock_btstack_get_stats()->advertising_interval_max != adv_fast_max) {
+            adv_slow_us = mock_btstack_now_us();
+        }
+    }
+    uint16_t adv_slow_max = mock_btstack_get_stats()->advertising_interval_max;
+
+    // Demo once, then untouched
+    uint64_t connect_us = mock_btstack_now_us();
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+    run_ms(quiet_s * 1000);
+
+    // Wake with a press, release it, play for a bit
+    gamepad_report_t report = {};
+    report.dpad = DPAD_NEUTRAL;
+    report.buttons = 1;
+    report.right_trigger = BENCH_MARKER;
+    uint64_t press_us = mock_btstack_now_us();
+    send_gamepad_input(&report);
+    note_state();
+    uint64_t active_params_us = 0;
+    for (uint32_t ms = 0; ms < 10000; ms += 10) {
+        run_ms(10);
+        const link_params_t *params = link_tuning_get_params(bench_con_handle);
+        if (!active_params_us && params && params->conn_latency == LINK_TARGET_LATENCY &&
+            params->conn_interval <= (central_min_interval_us + 1249) / 1250) {
+            active_params_us = mock_btstack_now_us();
+        }
+        if (ms == 100) {
+            report.buttons = 0;
+            report.right_trigger = 0;
+            send_gamepad_input(&report);
+        }
+    }
+
+    mock_hci_emit_disconnection_complete(bench_con_handle);
+    mock_btstack_advance_us(1000);
+    uint16_t adv_after_disconnect_max = mock_btstack_get_stats()->advertising_interval_max;
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    printf("Power governor benchmark: %u s untouched, central accepts %u us\n", quiet_s, central_min_interval_us);
+    printf("Advertising: max %u units, slow (max %u units) after %llu ms, max %u units after disconnect\n",
+           adv_fast_max, adv_slow_max, (unsigned long long)(adv_slow_us / 1000), adv_after_disconnect_max);
+    printf("Transitions (time since subscription):\n");
+    for (int i = 0; i < transition_count; i++) {
+        printf("  %8.3f s  %-6s -> %s\n", (double)(transitions[i].time_us - connect_us) / 1e6,
+               power_state_name(transitions[i].from), power_state_name(transitions[i].to));
+    }
+    printf("State   time s   attended/s  skipped\n");
+    for (int state = 0; state < POWER_STATE_COUNT; state++) {
+        if (!state_us[state]) continue;
+        uint32_t events = state_attended[state] + state_skipped[state];
+        printf("%-6s %7.1f %12.1f %7.1f%%\n", power_state_name((power_state_t)state), (double)state_us[state] / 1e6,
+               state_attended[state] * 1e6 / (double)state_us[state],
+               events ? 100.0 * state_skipped[state] / events : 0.0);
+    }
+    if (press_air_us) {
+        printf("Waking press on air after %.2f ms", (double)(press_air_us - press_us) / 1000);
+    } else {
+        printf("Waking press never went on air");
+    }
+    if (active_params_us) {
+        printf(", active link parameters after %.1f ms\n", (double)(active_params_us - press_us) / 1000);
+    } else {
+        printf(", active link parameters not restored\n");
+    }
+
+    int failures = 0;
+    if (quiet_s * 1000 >= DEMO_MS_MAX + POWER_IDLE_AFTER_MS && !state_us[POWER_STATE_IDLE]) {
+        printf("FAIL: never went idle\n");
+        failures++;
+    }
+    if (quiet_s * 1000 >= DEMO_MS_MAX + POWER_SLEEP_AFTER_MS && !state_us[POWER_STATE_SLEEP]) {
+        printf("FAIL: never went to sleep\n");
+        failures++;
+    }
+    // Queued data goes out at the next anchor whatever the latency
+    if (!press_air_us || press_air_us - press_us > (uint64_t)POWER_SLEEP_INTERVAL * 1250) {
+        printf("FAIL: the waking press took longer than one sleep interval\n");
+        failures++;
+    }
+    if (!active_params_us) {
+        printf("FAIL: active link parameters not restored\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
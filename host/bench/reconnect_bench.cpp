@@ -0,0 +1,171 @@
+// *****************************************************************************
+// Fast reconnect benchmark (host)
+//
+// Pairs a virtual host, then replays what a bonded host does after a link
+// loss and after the gamepad is power cycled: it answers the directed
+// advertising, encrypts with the stored keys and, keeping its CCCDs, never
+// writes them again. Prints the firmware's time to first report for both
+// and checks that a host which does not answer gets undirected advertising.
+//
+// usage: reconnect_bench [connect_ms] [encrypt_ms]
+//   connect_ms   directed advertising to connection complete (default 5)
+//   encrypt_ms   connection to encryption change (default 30)
+// *****************************************************************************
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "boot_timeline.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "reconnect.h"
+
+static const bd_addr_t host_addr = { 0xC0, 0xFF, 0xEE, 0x00, 0x00, 0x01 };
+static const int host_device_index = 0;
+
+static uint32_t notifications;
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(report_id);
+    UNUSED(report);
+    UNUSED(report_len);
+    UNUSED(queued_us);
+    UNUSED(air_us);
+    notifications++;
+}
+
+// Power-on: fresh RAM, flash (bonds, TLV) kept
+static void boot(void)
+{
+    mock_btstack_reset();
+    mock_btstack_set_notification_handler(&notification_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    static btstack_packet_callback_registration_t sm_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    sm_event_callback_registration.callback = &packet_handler;
+    sm_add_event_handler(&sm_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    boot_timeline_init();
+    gamepad_init();
+    gap_advertisements_enable(1);
+    mock_hci_emit_state(HCI_STATE_WORKING);
+    mock_hci_emit_command_complete(HCI_OPCODE_HCI_LE_SET_ADVERTISE_ENABLE);
+}
+
+// The bonded host answers the advertising and encrypts; returns true once
+// a report went on air without the host writing a CCCD
+static bool host_reconnects(hci_con_handle_t con_handle, uint32_t connect_ms, uint32_t encrypt_ms)
+{
+    mock_btstack_advance_us(connect_ms * 1000);
+    mock_sm_set_device_index(con_handle, host_device_index);
+    mock_hci_emit_le_connection_complete(con_handle, ERROR_CODE_SUCCESS);
+    mock_btstack_advance_us(encrypt_ms * 1000);
+    uint32_t before = notifications;
+    mock_hci_emit_encryption_change(con_handle);
+    for (int ms = 0; ms < 100 && notifications == before; ms++) {
+        mock_btstack_advance_us(1000);
+    }
+    return notifications != before;
+}
+
+static void print_timing(const char *what, const reconnect_timing_t *timing)
+{
+    if (!timing) {
+        printf("  %-10s no first report\n", what);
+        return;
+    }
+    printf("  %-10s %s, %s: connected %6.2f ms, encrypted %6.2f ms, reporting %6.2f ms, first report %6.2f ms\n",
+           what, timing->directed ? "directed" : "undirected", timing->resumed ? "resumed from bond" : "host subscribed",
+           timing->connected_us / 1000.0, timing->encrypted_us / 1000.0, timing->reporting_us / 1000.0,
+           timing->first_report_us / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t connect_ms = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 5;
+    uint32_t encrypt_ms = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 30;
+    int failures = 0;
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    // First connection: pair and subscribe, as a new host does
+    boot();
+    uint8_t first_type = mock_btstack_get_stats()->advertising_type;
+    mock_btstack_advance_us(200000);    // Host notices the advertising
+    mock_hci_emit_le_connection_complete(0x0040, ERROR_CODE_SUCCESS);
+    mock_hci_emit_encryption_change(0x0040);
+    mock_le_device_db_set(host_device_index, 0, host_addr);
+    mock_sm_set_device_index(0x0040, host_device_index);
+    mock_sm_emit_pairing_complete(0x0040);
+    mock_hids_emit_input_report_enable(0x0040, GAMEPAD_REPORT_ID, 1);
+    mock_btstack_advance_us(1000000);
+    uint32_t stores_after_pairing = mock_btstack_get_stats()->tlv_stores;
+
+    // Link loss, host answers the directed advertising
+    mock_hci_emit_disconnection_complete(0x0040);
+    uint8_t link_loss_type = mock_btstack_get_stats()->advertising_type;
+    bool link_loss_ok = host_reconnects(0x0041, connect_ms, encrypt_ms);
+    uint8_t after_connect_type = mock_btstack_get_stats()->advertising_type;
+    reconnect_timing_t link_loss = {};
+    if (reconnect_get_timing()) link_loss = *reconnect_get_timing();
+    mock_btstack_advance_us(1000000);
+    uint32_t stores_after_reconnect = mock_btstack_get_stats()->tlv_stores;
+
+    // Link loss, host gone
+    mock_hci_emit_disconnection_complete(0x0041);
+    mock_btstack_advance_us((RECONNECT_DIRECTED_MS + 100) * 1000);
+    const mock_btstack_stats_t *gone = mock_btstack_get_stats();
+    uint8_t gone_type = gone->advertising_type;
+    uint8_t gone_enabled = gone->advertising_enabled;
+    uint16_t gone_interval = gone->advertising_interval_max;
+
+    // Power cycle, host answers
+    boot();
+    uint8_t boot_type = mock_btstack_get_stats()->advertising_type;
+    mock_btstack_advance_us(200000);    // Host notices the advertising
+    bool boot_ok = host_reconnects(0x0042, connect_ms, encrypt_ms);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    printf("Reconnect benchmark: host connects %u ms after advertising starts, encrypts %u ms later\n", connect_ms,
+           encrypt_ms);
+    printf("Advertising: first boot %s, link loss %s, after reconnect %s, host gone %s (%s, max %u units), "
+           "bonded boot %s\n",
+           first_type ? "directed" : "undirected", link_loss_type ? "directed" : "undirected",
+           after_connect_type ? "directed" : "undirected", gone_type ? "directed" : "undirected",
+           gone_enabled ? "on" : "off", gone_interval, boot_type ? "directed" : "undirected");
+    printf("Time to first report:\n");
+    print_timing("link loss", &link_loss);
+    print_timing("power-on", reconnect_get_timing());
+    printf("First boot, pairing a new host (main()'s phases are only marked on target):\n");
+    boot_timeline_dump();
+    printf("TLV writes: %u while pairing, %u more over a reconnect and 1 s of reports\n", stores_after_pairing,
+           stores_after_reconnect - stores_after_pairing);
+
+    if (first_type != 0 || link_loss_type != 1 || after_connect_type != 0 || gone_type != 0 || !gone_enabled ||
+        boot_type != 1) {
+        printf("FAIL: advertising schedule\n");
+        failures++;
+    }
+    if (!link_loss_ok || !boot_ok || !link_loss.resumed) {
+        printf("FAIL: reports did not resume without CCCD writes\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+// *****************************************************************************
+// Rumble benchmark (host)
+//
+// A virtual central writes rumble output reports; they reach the firmware
+// at the next connection event the peripheral listens to. Checks that the
+// envelope (start delay, on time, repetitions) comes out exact on the alarm,
+// that a report without duration runs until the next report or the safety
+// stop, and that a link loss stops the motors. Then measures the time from
+// the central's write to the motors changing while the link is active, idle
+// and asleep (peripheral latency), the first write waking the link.
+//
+// usage: rumble_bench [cycles]
+// *****************************************************************************
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "latency_stats.h"
+#include "power_governor.h"
+#include "rumble.h"
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t strong;
+    uint8_t weak;
+} motor_change_t;
+
+static motor_change_t changes[64];
+static int change_count;
+static uint8_t motor_strong;
+static uint8_t motor_weak;
+
+static void motor_handler(uint8_t strong, uint8_t weak, uint64_t now_us)
+{
+    if (strong == motor_strong && weak == motor_weak) return;
+    motor_strong = strong;
+    motor_weak = weak;
+    if (change_count < 64) {
+        changes[change_count++] = { now_us, strong, weak };
+    }
+}
+
+static void write_rumble(hci_con_handle_t con_handle, uint8_t strong, uint8_t weak, uint8_t duration,
+                         uint8_t start_delay, uint8_t loop_count)
+{
+    rumble_report_t effect = { strong, weak, duration, start_delay, loop_count };
+    uint8_t report[GAMEPAD_RUMBLE_REPORT_SIZE];
+    gamepad_rumble_report::pack(effect, report);
+    mock_central_write_report(con_handle, GAMEPAD_RUMBLE_REPORT_ID, report, sizeof(report));
+}
+
+static void run_ms(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        mock_btstack_advance_us(1000);
+    }
+}
+
+// Central write to motor change, in us; 0 if the motors did not change
+static uint64_t timed_write(hci_con_handle_t con_handle, uint8_t strong)
+{
+    int before = change_count;
+    uint64_t write_us = mock_btstack_now_us();
+    write_rumble(con_handle, strong, 0, 0, 0, 0);
+    for (int us = 0; us < 500000 && change_count == before; us += 100) {
+        mock_btstack_advance_us(100);
+    }
+    return change_count != before ? changes[before].time_us - write_us : 0;
+}
+
+typedef struct {
+    uint32_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+} latency_t;
+
+static void latency_add(latency_t *latency, uint64_t value_us)
+{
+    latency->count++;
+    latency->sum_us += value_us;
+    if (value_us > latency->max_us) latency->max_us = value_us;
+}
+
+static void latency_print(const char *what, const latency_t *latency)
+{
+    if (!latency->count) {
+        printf("  %-22s no writes\n", what);
+        return;
+    }
+    printf("  %-22s n %3u  avg %7.2f ms  max %7.2f ms\n", what, latency->count,
+           latency->sum_us / 1000.0 / latency->count, latency->max_us / 1000.0);
+}
+
+// Wait with the pad untouched until the governor reaches the state
+static bool wait_for_state(power_state_t state, uint32_t limit_ms)
+{
+    for (uint32_t ms = 0; ms < limit_ms && power_governor_state() != state; ms++) {
+        mock_btstack_advance_us(1000);
+    }
+    return power_governor_state() == state;
+}
+
+int main(int argc, char *argv[])
+{
+    int cycles = argc > 1 ? atoi(argv[1]) : 3;
+    int failures = 0;
+
+    mock_btstack_reset();
+    mock_rumble_motors_set_handler(&motor_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    gamepad_init();
+    gamepad_script_set_loop(false);
+    hci_con_handle_t con_handle = 0x0040;
+    mock_hids_emit_input_report_enable(con_handle, GAMEPAD_REPORT_ID, 1);
+    run_ms(100);
+
+    // Envelope: 50 ms delay, 100 ms on, three times
+    change_count = 0;
+    write_rumble(con_handle, 200, 100, 10, 5, 2);
+    run_ms(1000);
+    const int envelope_changes = change_count;
+    motor_change_t envelope[8] = {};
+    for (int i = 0; i < envelope_changes && i < 8; i++) envelope[i] = changes[i];
+
+    // Until the next report, and the safety stop
+    change_count = 0;
+    write_rumble(con_handle, 255, 255, 0, 0, 0);
+    run_ms(1000);
+    write_rumble(con_handle, 0, 0, 0, 0, 0);
+    run_ms(100);
+    write_rumble(con_handle, 255, 255, 0, 0, 0);
+    run_ms(RUMBLE_MAX_ON_MS + 500);
+    const int hold_changes = change_count;
+    motor_change_t hold[4] = {};
+    for (int i = 0; i < hold_changes && i < 4; i++) hold[i] = changes[i];
+    uint32_t safety_stops = rumble_get_stats()->safety_stops;
+
+    // Link loss
+    write_rumble(con_handle, 128, 128, 0, 0, 0);
+    run_ms(100);
+    uint8_t before_loss = motor_strong;
+    mock_hci_emit_disconnection_complete(con_handle);
+    uint8_t after_loss = motor_strong;
+
+    // Write latency, from the central's write to the motors changing
+    con_handle = 0x0041;
+    mock_hids_emit_input_report_enable(con_handle, GAMEPAD_REPORT_ID, 1);
+    latency_t active = {}, idle = {}, sleep = {};
+    uint32_t jitter = 12345;
+    bool states_reached = true;
+    for (int cycle = 0; cycle < cycles; cycle++) {
+        if (wait_for_state(POWER_STATE_IDLE, 120000)) {
+            latency_add(&idle, timed_write(con_handle, 100));
+        } else {
+            states_reached = false;
+        }
+        for (int i = 0; i < 20; i++) {
+            // Writes land anywhere between connection events
+            jitter = jitter * 1103515245u + 12345u;
+            mock_btstack_advance_us(20000 + (jitter >> 16) % 10000);
+            latency_add(&active, timed_write(con_handle, (uint8_t)(i & 1 ? 100 : 0)));
+        }
+        timed_write(con_handle, 0);
+        if (wait_for_state(POWER_STATE_SLEEP, 120000)) {
+            latency_add(&sleep, timed_write(con_handle, 100));
+        } else {
+            states_reached = false;
+        }
+        timed_write(con_handle, 0);
+    }
+    const latency_histogram_t *handler = latency_stats_get(LATENCY_WRITE_TO_MOTOR);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    printf("Rumble benchmark: %d cycles, safety stop after %u ms\n", cycles, RUMBLE_MAX_ON_MS);
+    printf("Envelope (50 ms delay, 100 ms on, 2 loops), ms after the first change:\n ");
+    for (int i = 0; i < envelope_changes && i < 8; i++) {
+        printf(" %s@%.1f", envelope[i].strong ? "on" : "off", (envelope[i].time_us - envelope[0].time_us) / 1000.0);
+    }
+    printf("\n");
+    bool envelope_ok = envelope_changes == 6;
+    for (int i = 1; envelope_ok && i < envelope_changes; i++) {
+        uint64_t expected_us = (i % 2) ? 100000 : 50000;
+        envelope_ok = envelope[i].time_us - envelope[i - 1].time_us == expected_us &&
+                      (envelope[i - 1].strong == 200) == (i % 2 == 1);
+    }
+    if (!envelope_ok) {
+        printf("FAIL: envelope timing\n");
+        failures++;
+    }
+
+    printf("Without duration: on for %.1f ms until the stop report, then %.1f ms until the safety stop (%u)\n",
+           hold_changes >= 2 ? (hold[1].time_us - hold[0].time_us) / 1000.0 : 0.0,
+           hold_changes >= 4 ? (hold[3].time_us - hold[2].time_us) / 1000.0 : 0.0, safety_stops);
+    if (hold_changes != 4 || hold[3].time_us - hold[2].time_us != RUMBLE_MAX_ON_MS * 1000ull || safety_stops != 1) {
+        printf("FAIL: hold and safety stop\n");
+        failures++;
+    }
+
+    printf("Link loss: motors %u before, %u after\n", before_loss, after_loss);
+    if (!before_loss || after_loss) {
+        printf("FAIL: motors kept running after link loss\n");
+        failures++;
+    }
+
+    printf("Central write -> motors:\n");
+    latency_print("active", &active);
+    latency_print("idle (waking write)", &idle);
+    latency_print("sleep (waking write)", &sleep);
+    printf("  report handler -> motor: n %lu, max %lu us (alarm interrupt)\n", (unsigned long)handler->count,
+           (unsigned long)handler->max_us);
+    if (!states_reached) {
+        printf("FAIL: governor did not reach idle and sleep\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+// *****************************************************************************
+// Connection event schedule benchmark (host)
+//
+// Player 1's stick moves every millisecond, as when core1 samples a stick
+// in motion, and a button toggles every 50..100 ms. For each link the bench
+// runs once sending reports as soon as inputs change and once on the
+// connection event schedule (event_schedule.h), and prints:
+//
+//   age     how old the carried stick sample is when the report goes on air
+//   press   button toggle until a report carrying it goes on air
+//
+// The virtual controller takes packets SETUP_US before an anchor, reports
+// completions COMPLETION_DELAY_US after the event, and its clock drifts
+// against ours. Exits non-zero if the schedule does not lock, misses events
+// more than rarely, leaves the age spread wide, or makes presses later than
+// sending at once by more than the initial release lead.
+//
+// usage: schedule_bench [seconds]
+// *****************************************************************************
+
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_connection.h"
+#include "gamepad_layout.h"
+
+// Bench inputs carry this trigger value; the built-in demo never uses it
+#define BENCH_MARKER 0xA5
+
+#define SETUP_US 300
+#define COMPLETION_DELAY_US 600
+
+// Reports from the first second, while the schedule is learning, are not
+// measured
+#define WARMUP_STEPS 1000
+
+// Spread of the input age allowed on the schedule: stick samples are a
+// millisecond apart and the release timer has millisecond resolution
+#define AGE_SPREAD_LIMIT_US 2000
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+static std::vector<uint64_t> sample_time_us;     // Per step
+static std::vector<uint32_t> toggles_at;         // Button toggles up to each step
+static std::vector<uint64_t> toggle_time_us;
+static uint32_t toggles_seen;
+static std::vector<uint32_t> age_us;
+static std::vector<uint32_t> press_us;
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(queued_us);
+    if (report_id != GAMEPAD_REPORT_ID || report_len != GAMEPAD_REPORT_SIZE) return;
+    gamepad_report_t state;
+    gamepad_input_report::unpack(report, state);
+    if (state.right_trigger != BENCH_MARKER) return;
+    uint32_t step = (uint16_t)state.left_x | ((uint32_t)(uint16_t)state.left_y << 16);
+    if (step < WARMUP_STEPS || step >= sample_time_us.size()) return;
+    age_us.push_back((uint32_t)(air_us - sample_time_us[step]));
+    if (toggles_at[step] > toggles_seen) {
+        toggles_seen = toggles_at[step];
+        uint64_t toggle_us = toggle_time_us[toggles_seen - 1];
+        if (toggle_us >= sample_time_us[WARMUP_STEPS]) {
+            press_us.push_back((uint32_t)(air_us - toggle_us));
+        }
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> values, unsigned int pct)
+{
+    if (values.empty()) return 0;
+    size_t index = (values.size() - 1) * pct / 100;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+typedef struct {
+    uint32_t interval_us;
+    int32_t clock_ppm;
+} link_t;
+
+typedef struct {
+    uint32_t age_p1, age_p50, age_p99;
+    uint32_t press_p50, press_p99;
+    uint32_t reports;
+    event_schedule_t schedule;
+} run_result_t;
+
+static run_result_t run(const link_t *link, bool scheduled, uint32_t seconds)
+{
+    sample_time_us.clear();
+    toggles_at.clear();
+    toggle_time_us.clear();
+    toggles_seen = 0;
+    age_us.clear();
+    press_us.clear();
+
+    mock_btstack_reset();
+    mock_btstack_set_connection_interval_us(link->interval_us);
+    mock_btstack_set_central_min_interval_us(link->interval_us);
+    mock_btstack_set_controller_timing(SETUP_US, COMPLETION_DELAY_US, link->clock_ppm);
+    mock_btstack_set_notification_handler(&notification_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    gamepad_init();
+    gamepad_set_event_schedule(scheduled);
+
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+    mock_btstack_advance_us(200000);
+
+    uint32_t jitter = 12345;
+    uint64_t next_toggle_us = mock_btstack_now_us() + 50000;
+    uint16_t buttons = 0;
+    uint32_t steps = seconds * 1000;
+    for (uint32_t step = 0; step < steps; step++) {
+        uint64_t now_us = mock_btstack_now_us();
+        if (now_us >= next_toggle_us) {
+            buttons ^= GAMEPAD_BUTTON_1;
+            toggle_time_us.push_back(now_us);
+            jitter = jitter * 1103515245u + 12345u;
+            next_toggle_us = now_us + 50000 + (jitter >> 16) % 50000;
+        }
+        sample_time_us.push_back(now_us);
+        toggles_at.push_back((uint32_t)toggle_time_us.size());
+
+        gamepad_report_t report = {};
+        report.left_x = (int16_t)(step & 0xffff);
+        report.left_y = (int16_t)(step >> 16);
+        report.buttons = buttons;
+        report.right_trigger = BENCH_MARKER;
+        report.dpad = DPAD_NEUTRAL;
+        send_gamepad_input(&report);
+        mock_btstack_advance_us(1000);
+    }
+    mock_btstack_advance_us(100000);
+
+    run_result_t result;
+    result.age_p1 = percentile(age_us, 1);
+    result.age_p50 = percentile(age_us, 50);
+    result.age_p99 = percentile(age_us, 99);
+    result.press_p50 = percentile(press_us, 50);
+    result.press_p99 = percentile(press_us, 99);
+    result.reports = (uint32_t)age_us.size();
+    result.schedule = gamepad_connection_find(bench_con_handle)->schedule;
+    return result;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seconds = argc > 1 ? (uint32_t)atoi(argv[1]) : 20;
+    const link_t links[] = {
+        {7500, 150},
+        {7500, -500},
+        {11250, 0},
+        {15000, 250},
+        {30000, -100},
+    };
+    const int link_count = (int)(sizeof(links) / sizeof(links[0]));
+    run_result_t results[link_count][2];
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    for (int i = 0; i < link_count; i++) {
+        results[i][0] = run(&links[i], false, seconds);
+        results[i][1] = run(&links[i], true, seconds);
+    }
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    printf("Event schedule benchmark: %u s per run, controller setup %u us, completion delay %u us\n", seconds,
+           SETUP_US, COMPLETION_DELAY_US);
+    printf("  %-8s %6s %-5s %7s %6s %6s %6s %7s   %6s %6s   %5s %5s %4s\n", "interval", "ppm", "sched", "reports",
+           "age p1", "p50", "p99", "spread", "press", "p99", "lead", "late", "lock");
+    int failures = 0;
+    for (int i = 0; i < link_count; i++) {
+        for (int scheduled = 0; scheduled < 2; scheduled++) {
+            const run_result_t *r = &results[i][scheduled];
+            printf("  %8u %6d %-5s %7u %6u %6u %6u %7u   %6u %6u   %5u %5u %4s\n", links[i].interval_us,
+                   links[i].clock_ppm, scheduled ? "on" : "off", r->reports, r->age_p1, r->age_p50, r->age_p99,
+                   r->age_p99 - r->age_p1, r->press_p50, r->press_p99, scheduled ? r->schedule.lead_us : 0,
+                   scheduled ? r->schedule.late : 0,
+                   scheduled ? (event_schedule_locked(&r->schedule) ? "yes" : "no") : "-");
+        }
+
+        const run_result_t *off = &results[i][0];
+        const run_result_t *on = &results[i][1];
+        if (!event_schedule_locked(&on->schedule) || on->schedule.releases == 0) {
+            printf("FAIL: %u us link: schedule never locked\n", links[i].interval_us);
+            failures++;
+            continue;
+        }
+        if (on->schedule.late * 50 > on->schedule.releases) {
+            printf("FAIL: %u us link: %u of %u releases late\n", links[i].interval_us, on->schedule.late,
+                   on->schedule.releases);
+            failures++;
+        }
+        if (on->age_p99 - on->age_p1 > AGE_SPREAD_LIMIT_US) {
+            printf("FAIL: %u us link: input age still spreads over %u us\n", links[i].interval_us,
+                   on->age_p99 - on->age_p1);
+            failures++;
+        }
+        if (on->press_p99 > off->press_p99 + SCHEDULE_LEAD_US) {
+            printf("FAIL: %u us link: presses later than sending at once\n", links[i].interval_us);
+            failures++;
+        }
+    }
+    return failures ? 1 : 0;
+}
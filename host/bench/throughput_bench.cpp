@@ -0,0 +1,115 @@
+// *****************************************************************************
+// Saturation throughput benchmark (host)
+//
+// Runs the firmware's throughput test (throughput_test.h) against the
+// virtual controller and prints what the console would, so controller
+// settings (ACL buffers, packets per event, connection interval, centrals)
+// can be compared before trying them on hardware. With a log path, every
+// notification that goes on air is written as a text line
+//
+//     <air_us> <con_handle> <report bytes in hex>
+//
+// which tools/seq_check.py reads like a capture from the receiving side.
+//
+// usage: throughput_bench [seconds] [connection_interval_us] [acl_buffers] [packets_per_event]
+//                         [centrals] [log]
+// *****************************************************************************
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "throughput_test.h"
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+static FILE *log_file;
+static uint32_t test_notifications;
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(report_id);
+    UNUSED(queued_us);
+    gamepad_report_t state;
+    if (report_len == GAMEPAD_REPORT_SIZE) {
+        gamepad_input_report::unpack(report, state);
+        if (state.left_trigger == THROUGHPUT_TEST_MARKER && state.right_trigger == THROUGHPUT_TEST_MARKER) {
+            test_notifications++;
+        }
+    }
+    if (!log_file) return;
+    fprintf(log_file, "%llu 0x%04x", (unsigned long long)air_us, con_handle);
+    for (uint16_t i = 0; i < report_len; i++) {
+        fprintf(log_file, " %02x", report[i]);
+    }
+    fputc('\n', log_file);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seconds = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 10;
+    uint32_t connection_interval_us = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 7500;
+    uint8_t acl_buffers = argc > 3 ? (uint8_t)strtoul(argv[3], NULL, 0) : 3;
+    uint8_t packets_per_event = argc > 4 ? (uint8_t)strtoul(argv[4], NULL, 0) : 4;
+    uint32_t centrals = argc > 5 ? (uint32_t)strtoul(argv[5], NULL, 0) : 1;
+    if (centrals < 1) centrals = 1;
+    if (centrals > GAMEPAD_MAX_CONNECTIONS) centrals = GAMEPAD_MAX_CONNECTIONS;
+    if (argc > 6) {
+        log_file = fopen(argv[6], "w");
+        if (!log_file) {
+            perror(argv[6]);
+            return 1;
+        }
+    }
+
+    mock_btstack_reset();
+    mock_btstack_set_connection_interval_us(connection_interval_us);
+    mock_btstack_set_central_min_interval_us(connection_interval_us);
+    mock_btstack_set_acl_buffers(acl_buffers);
+    mock_btstack_set_packets_per_event(packets_per_event);
+    mock_btstack_set_notification_handler(&notification_handler);
+
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+    gamepad_init();
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    for (uint32_t central = 0; central < centrals; central++) {
+        mock_hids_emit_input_report_enable((hci_con_handle_t)(bench_con_handle + central), GAMEPAD_REPORT_ID, 1);
+    }
+    // Let the demo's first reports and link tuning settle
+    mock_btstack_advance_us(100000);
+
+    throughput_test_start();
+    for (uint32_t ms = 0; ms < seconds * 1000; ms++) {
+        mock_btstack_advance_us(1000);
+    }
+    throughput_test_stop();
+    mock_btstack_advance_us(4 * connection_interval_us);
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+    if (log_file) fclose(log_file);
+
+    printf("Throughput benchmark: %u s, connection interval %u us, %u ACL buffers, %u packets per event, "
+           "%u central(s)\n", seconds, connection_interval_us, acl_buffers, packets_per_event, centrals);
+    throughput_test_dump();
+    printf("  %u test reports went on air\n", test_notifications);
+    return 0;
+}
@@ -0,0 +1,312 @@
+// *****************************************************************************
+// Tuning service benchmark (host)
+//
+// A virtual central connects, subscribes to player 1's reports and then
+// works the tuning service as a tuning app would: reads every
+// characteristic, writes new report, stick and link settings, writes that
+// are out of range or the wrong length, and subscribes to the counters
+// for a few seconds while the stick moves every millisecond. Then it drops
+// the link while a counter notification waits for its grant, reconnects
+// and subscribes again. Prints what each step read back and how many
+// counter notifications arrived.
+//
+// Exits non-zero if a valid write does not take effect (keep-alive, event
+// schedule, stick profile, link parameters the central applied), an
+// invalid write is accepted or changes anything, counter notifications do
+// not arrive every TUNING_STATS_PERIOD_MS with rising counts, they keep
+// coming after the central unsubscribed, or they do not come back after
+// it reconnected.
+// *****************************************************************************
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "axis_profiles.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "link_tuning.h"
+#include "tuning_service.h"
+
+#define TUNING_UUID(x) { 0x7A, 0x3E, 0x00, (x), 0x5D, 0x2B, 0x4C, 0x8E, \
+                         0x9F, 0x61, 0x0B, 0x4D, 0x8C, 0x2A, 0x1E, 0x57 }
+
+static const uint8_t service_uuid[16] = TUNING_UUID(0x01);
+static const uint8_t report_uuid[16] = TUNING_UUID(0x02);
+static const uint8_t stick_uuid[16] = TUNING_UUID(0x03);
+static const uint8_t link_uuid[16] = TUNING_UUID(0x04);
+static const uint8_t counters_uuid[16] = TUNING_UUID(0x05);
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+// Counters subscription, in stats periods
+#define SUBSCRIBED_PERIODS 4
+
+static uint16_t report_handle;
+static uint16_t stick_handle;
+static uint16_t link_handle;
+static uint16_t counters_handle;
+static uint16_t counters_configuration_handle;
+
+static uint32_t counter_notifications;
+static uint32_t counters_sent_last;
+static bool counters_rising = true;
+static uint16_t counters_p99_last;
+
+static int failures;
+
+static void check(bool ok, const char *what)
+{
+    if (ok) return;
+    printf("FAIL: %s\n", what);
+    failures++;
+}
+
+static void att_notification_handler(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value,
+                                     uint16_t value_len, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(air_us);
+    if (attribute_handle != counters_handle || value_len != 18) return;
+    uint32_t sent = little_endian_read_32(value, 0);
+    if (counter_notifications && sent <= counters_sent_last) {
+        counters_rising = false;
+    }
+    counters_sent_last = sent;
+    counters_p99_last = little_endian_read_16(value, 16);
+    counter_notifications++;
+}
+
+// One stick move per millisecond, so reports and counters keep changing
+static void run_ms(uint32_t ms)
+{
+    static uint16_t step;
+    for (uint32_t i = 0; i < ms; i++) {
+        gamepad_report_t report = {};
+        report.left_x = (int16_t)(step++ * 16);
+        report.dpad = DPAD_NEUTRAL;
+        send_gamepad_input(&report);
+        mock_btstack_advance_us(1000);
+    }
+}
+
+static uint8_t write_report(uint16_t period_us, uint16_t keepalive_ms, uint8_t flags)
+{
+    uint8_t value[5];
+    little_endian_store_16(value, 0, period_us);
+    little_endian_store_16(value, 2, keepalive_ms);
+    value[4] = flags;
+    return mock_att_write(bench_con_handle, report_handle, value, sizeof(value));
+}
+
+static uint8_t write_link(uint16_t interval, uint16_t latency, uint16_t timeout)
+{
+    uint8_t value[6];
+    little_endian_store_16(value, 0, interval);
+    little_endian_store_16(value, 2, latency);
+    little_endian_store_16(value, 4, timeout);
+    return mock_att_write(bench_con_handle, link_handle, value, sizeof(value));
+}
+
+static uint8_t write_stick(uint8_t player, uint16_t radial, uint16_t axial, uint8_t low, uint8_t high)
+{
+    uint8_t value[1 + 4 + 2 * AXIS_TRIGGERS];
+    value[0] = player;
+    little_endian_store_16(value, 1, radial);
+    little_endian_store_16(value, 3, axial);
+    for (int trigger = 0; trigger < AXIS_TRIGGERS; trigger++) {
+        value[5 + trigger] = low;
+        value[5 + AXIS_TRIGGERS + trigger] = high;
+    }
+    return mock_att_write(bench_con_handle, stick_handle, value, sizeof(value));
+}
+
+static uint8_t write_configuration(uint16_t configuration)
+{
+    uint8_t value[2];
+    little_endian_store_16(value, 0, configuration);
+    return mock_att_write(bench_con_handle, counters_configuration_handle, value, sizeof(value));
+}
+
+static void lookup_handles(void)
+{
+    uint16_t start_handle = 0;
+    uint16_t end_handle = 0;
+    gatt_server_get_handle_range_for_service_with_uuid128(service_uuid, &start_handle, &end_handle);
+    report_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                                report_uuid);
+    stick_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                               stick_uuid);
+    link_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle, link_uuid);
+    counters_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                                  counters_uuid);
+    counters_configuration_handle =
+        gatt_server_get_client_configuration_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                                    counters_uuid);
+}
+
+int main(void)
+{
+    mock_btstack_reset();
+    mock_att_set_notification_handler(&att_notification_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    // As main.cpp sets up the firmware
+    tuning_service_init();
+    axis_profiles_init();
+    gamepad_init();
+    gamepad_script_set_loop(false);
+    lookup_handles();
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+    run_ms(500);
+
+    // Report settings
+    uint8_t value[32];
+    int report_size = mock_att_read(bench_con_handle, report_handle, value, sizeof(value));
+    uint16_t period_before = little_endian_read_16(value, 0);
+    uint16_t keepalive_before = little_endian_read_16(value, 2);
+    uint8_t flags_before = value[4];
+    uint8_t flags = flags_before ^ 0x01;
+    uint8_t report_status = write_report(period_before, 50, flags);
+    bool report_applied = gamepad_keepalive() == 50 && gamepad_event_schedule() == ((flags & 0x01) != 0);
+    uint8_t report_rejects[] = {
+        write_report(100, 50, flags),                           // Sample period too short
+        write_report(period_before, 5, flags),                  // Keep-alive too short
+        write_report(period_before, 50, 0x80),                  // Unknown flag
+        write_report((uint16_t)(period_before * 2), 50, flags), // No sampler period to change on the host
+        mock_att_write(bench_con_handle, report_handle, value, 4),
+    };
+    bool report_unchanged = gamepad_keepalive() == 50 && gamepad_event_schedule() == ((flags & 0x01) != 0);
+    int report_after_size = mock_att_read(bench_con_handle, report_handle, value, sizeof(value));
+    uint16_t keepalive_after = little_endian_read_16(value, 2);
+
+    // Stick profile of player 2
+    uint8_t stick_status = write_stick(1, 3000, 1200, 12, 240);
+    const axis_profile_t *profile = axis_profiles_get(1);
+    bool stick_applied = profile->radial_deadzone == 3000 && profile->axial_deadzone == 1200 &&
+                         profile->trigger_low[0] == 12 && profile->trigger_high[AXIS_TRIGGERS - 1] == 240;
+    uint8_t select = 0;
+    mock_att_write(bench_con_handle, stick_handle, &select, 1);
+    mock_att_read(bench_con_handle, stick_handle, value, sizeof(value));
+    bool stick_selects = value[0] == 0 && little_endian_read_16(value, 1) == axis_profiles_get(0)->radial_deadzone;
+    select = 1;
+    mock_att_write(bench_con_handle, stick_handle, &select, 1);
+    int stick_size = mock_att_read(bench_con_handle, stick_handle, value, sizeof(value));
+    bool stick_reads = value[0] == 1 && little_endian_read_16(value, 1) == 3000;
+    uint8_t stick_rejects[] = {
+        write_stick(GAMEPAD_PLAYERS, 3000, 1200, 12, 240),      // No such player
+        write_stick(1, 3000, 1200, 240, 12),                    // Trigger range inverted
+        write_stick(1, 40000, 1200, 12, 240),                   // Deadzone past full scale
+    };
+    bool stick_unchanged = profile->radial_deadzone == 3000 && profile->trigger_low[0] == 12;
+
+    // Link targets
+    const link_params_t *params = link_tuning_get_params(bench_con_handle);
+    uint16_t interval_before = params ? params->conn_interval : 0;
+    // 12.5 ms is between two ladder steps
+    uint8_t link_status = write_link(10, 2, 300);
+    run_ms(500);
+    params = link_tuning_get_params(bench_con_handle);
+    bool link_applied = params && params->conn_interval == 10 && params->conn_latency == 2 &&
+                        params->supervision_timeout == 300;
+    uint8_t link_rejects[] = {
+        write_link(4, 0, 300),                                  // Interval below 7.5 ms
+        write_link(12, 500, 3200),                              // Latency past the limit
+        write_link(40, 10, 20),                                 // Timeout shorter than the skipped events
+    };
+    mock_att_read(bench_con_handle, link_handle, value, sizeof(value));
+    bool link_unchanged = little_endian_read_16(value, 0) == 10 && little_endian_read_16(value, 2) == 2 &&
+                          little_endian_read_16(value, 4) == 300;
+
+    // Counters, subscribed and then not
+    int counters_size = mock_att_read(bench_con_handle, counters_handle, value, sizeof(value));
+    uint8_t subscribe_status = write_configuration(GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION);
+    run_ms(SUBSCRIBED_PERIODS * TUNING_STATS_PERIOD_MS + TUNING_STATS_PERIOD_MS / 2);
+    uint32_t subscribed_notifications = counter_notifications;
+    write_configuration(0);
+    run_ms(3 * TUNING_STATS_PERIOD_MS);
+    uint32_t late_notifications = counter_notifications - subscribed_notifications;
+
+    // Disconnected with a notification waiting for a buffer, then back in
+    // the same subscriber slot
+    write_configuration(GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION);
+    mock_btstack_set_acl_buffers(0);
+    run_ms(TUNING_STATS_PERIOD_MS + TUNING_STATS_PERIOD_MS / 2);
+    mock_hci_emit_disconnection_complete(bench_con_handle);
+    mock_btstack_set_acl_buffers(3);
+    mock_hci_emit_le_connection_complete(bench_con_handle, ERROR_CODE_SUCCESS);
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+    uint8_t resubscribe_status = write_configuration(GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION);
+    // The new connection counts from zero
+    counters_sent_last = 0;
+    uint32_t reconnect_before = counter_notifications;
+    run_ms(SUBSCRIBED_PERIODS * TUNING_STATS_PERIOD_MS + TUNING_STATS_PERIOD_MS / 2);
+    uint32_t reconnected_notifications = counter_notifications - reconnect_before;
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    const tuning_service_stats_t *stats = tuning_service_get_stats();
+    printf("Tuning service benchmark: one central, stick every 1 ms, counters every %u ms\n",
+           (unsigned)TUNING_STATS_PERIOD_MS);
+    printf("  report   %d bytes: %u us sampling, keep-alive %u -> %u ms, flags 0x%02x -> 0x%02x (status 0x%02x)\n",
+           report_size, period_before, keepalive_before, keepalive_after, flags_before, flags, report_status);
+    printf("  stick    %d bytes: player 2 deadzones %u / %u, triggers %u..%u (status 0x%02x)\n", stick_size,
+           profile->radial_deadzone, profile->axial_deadzone, profile->trigger_low[0], profile->trigger_high[0],
+           stick_status);
+    printf("  link     interval %u -> %u, latency %u, timeout %u (status 0x%02x)\n", interval_before,
+           params ? params->conn_interval : 0, params ? params->conn_latency : 0,
+           params ? params->supervision_timeout : 0, link_status);
+    printf("  counters %d bytes: %u notifications in %u periods, last %u sent, p99 %u us; %u after unsubscribing\n",
+           counters_size, subscribed_notifications, SUBSCRIBED_PERIODS, counters_sent_last, counters_p99_last,
+           late_notifications);
+    printf("  reconnected with a notification pending: %u notifications in %u periods\n", reconnected_notifications,
+           SUBSCRIBED_PERIODS);
+    printf("  service: %u reads, %u writes, %u rejected, %u notifications\n", stats->reads, stats->writes,
+           stats->rejected, stats->notifications);
+
+    check(report_size == 5 && stick_size == 9 && counters_size == 18, "characteristic sizes");
+    check(report_status == 0 && report_applied && keepalive_after == 50, "report settings not applied");
+    for (uint8_t status : report_rejects) {
+        check(status == ATT_ERROR_VALUE_NOT_ALLOWED || status == ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH,
+              "invalid report settings accepted");
+    }
+    check(report_rejects[4] == ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH, "short report write not refused by length");
+    check(report_unchanged && report_after_size == 5, "refused report settings changed something");
+    check(stick_status == 0 && stick_applied, "stick profile not applied");
+    check(stick_selects && stick_reads, "stick player selection");
+    for (uint8_t status : stick_rejects) {
+        check(status == ATT_ERROR_VALUE_NOT_ALLOWED, "invalid stick profile accepted");
+    }
+    check(stick_unchanged, "refused stick profile changed something");
+    check(link_status == 0 && link_applied, "link targets not applied by the central");
+    for (uint8_t status : link_rejects) {
+        check(status == ATT_ERROR_VALUE_NOT_ALLOWED, "invalid link targets accepted");
+    }
+    check(link_unchanged, "refused link targets changed something");
+    check(subscribe_status == 0 && subscribed_notifications >= SUBSCRIBED_PERIODS &&
+          subscribed_notifications <= SUBSCRIBED_PERIODS + 1, "counter notifications not periodic");
+    check(counters_rising && counters_sent_last > 0, "counters not rising");
+    check(late_notifications == 0, "counter notifications after unsubscribing");
+    check(resubscribe_status == 0 && reconnected_notifications >= SUBSCRIBED_PERIODS,
+          "counter notifications did not resume after reconnecting");
+    check(stats->rejected == sizeof(report_rejects) + sizeof(stick_rejects) + sizeof(link_rejects),
+          "rejected writes not counted");
+    return failures ? 1 : 0;
+}
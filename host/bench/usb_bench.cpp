@@ -0,0 +1,241 @@
+// *****************************************************************************
+// USB transport benchmark (host)
+//
+// Player 1's stick moves every millisecond and a button toggles every
+// 50..100 ms, first with only a Bluetooth central, then with a USB host
+// attached too; prints the press-to-host latency on each transport. Then
+// plugs and unplugs the cable while a button is held and checks that the
+// host taking over has the current state at once and that the central sees
+// a neutral pad while USB carries the players, and that a rumble effect
+// written over USB stops when the cable goes.
+//
+// usage: usb_bench [seconds]
+// *****************************************************************************
+
+#include <algorithm>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "ble/gatt-service/hids_device.h"
+#include "btstack_mock.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "report_mailbox.h"
+#include "rumble.h"
+
+static const hci_con_handle_t bench_con_handle = 0x0040;
+
+// Newest player 1 state each host has, and when the button last changed
+typedef struct {
+    gamepad_report_t state;
+    bool seen;
+    uint32_t reports;
+    std::vector<uint32_t> press_us;
+} host_view_t;
+
+static host_view_t ble_host;
+static host_view_t usb_host;
+static std::vector<uint64_t> toggle_time_us;
+static uint8_t motor_strong;
+
+static void host_report(host_view_t *host, const uint8_t *report, uint64_t air_us)
+{
+    gamepad_report_t state;
+    gamepad_input_report::unpack(report, state);
+    if (host->seen && state.buttons != host->state.buttons && !toggle_time_us.empty()) {
+        host->press_us.push_back((uint32_t)(air_us - toggle_time_us.back()));
+    }
+    host->state = state;
+    host->seen = true;
+    host->reports++;
+}
+
+static void notification_handler(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                 uint16_t report_len, uint64_t queued_us, uint64_t air_us)
+{
+    UNUSED(con_handle);
+    UNUSED(queued_us);
+    if (report_id != GAMEPAD_REPORT_ID || report_len != GAMEPAD_REPORT_SIZE) return;
+    host_report(&ble_host, report, air_us);
+}
+
+static void usb_report_handler(uint8_t report_id, const uint8_t *report, uint16_t report_len, uint64_t queued_us,
+                               uint64_t poll_us)
+{
+    UNUSED(queued_us);
+    if (report_id != GAMEPAD_REPORT_ID || report_len != GAMEPAD_REPORT_SIZE) return;
+    host_report(&usb_host, report, poll_us);
+}
+
+static void motor_handler(uint8_t strong, uint8_t weak, uint64_t now_us)
+{
+    UNUSED(weak);
+    UNUSED(now_us);
+    motor_strong = strong;
+}
+
+static uint32_t percentile(std::vector<uint32_t> values, unsigned int pct)
+{
+    if (values.empty()) return 0;
+    size_t index = (values.size() - 1) * pct / 100;
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+static gamepad_report_t current;
+static uint32_t step;
+
+// One millisecond of input: the stick moves, the button sometimes toggles
+static void input_ms(bool toggle)
+{
+    if (toggle) {
+        current.buttons ^= GAMEPAD_BUTTON_1;
+        toggle_time_us.push_back(mock_btstack_now_us());
+    }
+    current.left_x = (int16_t)(step++ & 0x7fff);
+    send_gamepad_input(&current);
+    mock_btstack_advance_us(1000);
+}
+
+static void play(uint32_t seconds)
+{
+    static uint32_t jitter = 12345;
+    uint32_t next_toggle = 50;
+    for (uint32_t ms = 0; ms < seconds * 1000; ms++) {
+        bool toggle = ms == next_toggle;
+        if (toggle) {
+            jitter = jitter * 1103515245u + 12345u;
+            next_toggle = ms + 50 + (jitter >> 16) % 50;
+        }
+        input_ms(toggle);
+    }
+}
+
+static void hold_ms(uint32_t ms)
+{
+    for (uint32_t i = 0; i < ms; i++) {
+        mock_btstack_advance_us(1000);
+    }
+}
+
+static bool host_has(const host_view_t *host, const gamepad_report_t *state)
+{
+    return host->seen && gamepad_report_equal(&host->state, state);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t seconds = argc > 1 ? (uint32_t)atoi(argv[1]) : 10;
+    int failures = 0;
+
+    mock_btstack_reset();
+    mock_btstack_set_notification_handler(&notification_handler);
+    mock_usb_set_report_handler(&usb_report_handler);
+    mock_rumble_motors_set_handler(&motor_handler);
+    static btstack_packet_callback_registration_t hci_event_callback_registration;
+    hci_event_callback_registration.callback = &packet_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    hids_device_register_packet_handler(packet_handler);
+
+    // The firmware logs every report; keep that out of the results
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+
+    gamepad_init();
+    gamepad_script_set_loop(false);
+    mock_hids_emit_input_report_enable(bench_con_handle, GAMEPAD_REPORT_ID, 1);
+    // Let the built-in demo play out
+    hold_ms(10000);
+    current.dpad = DPAD_NEUTRAL;
+
+    // Bluetooth only, then with the cable
+    play(seconds);
+    std::vector<uint32_t> ble_press = ble_host.press_us;
+    uint32_t ble_reports = ble_host.reports;
+
+    mock_usb_set_attached(1);
+    hold_ms(5);
+    play(seconds);
+    std::vector<uint32_t> usb_press = usb_host.press_us;
+    uint32_t usb_reports = usb_host.reports;
+    uint32_t ble_reports_on_usb = ble_host.reports - ble_reports;
+    gamepad_report_t neutral = {};
+    neutral.dpad = DPAD_NEUTRAL;
+    bool attach_neutral_ble = host_has(&ble_host, &neutral);
+
+    // Plug and unplug with a button held: the host taking over has it at once
+    int switch_misses = 0;
+    mock_usb_set_attached(0);
+    for (int cycle = 0; cycle < 20; cycle++) {
+        current.buttons = (uint16_t)(GAMEPAD_BUTTON_1 << (cycle % 4));
+        input_ms(false);
+        hold_ms(30);
+
+        mock_usb_set_attached(1);
+        hold_ms(2);
+        if (!host_has(&usb_host, &current)) switch_misses++;
+        hold_ms(30);
+        if (!host_has(&ble_host, &neutral)) switch_misses++;
+
+        current.buttons = 0;
+        input_ms(false);
+        current.buttons = GAMEPAD_BUTTON_2;
+        input_ms(false);
+        mock_usb_set_attached(0);
+        hold_ms(3 * 7500 / 1000 + 1);
+        if (!host_has(&ble_host, &current)) switch_misses++;
+    }
+
+    // Rumble written over USB stops with the cable
+    mock_usb_set_attached(1);
+    rumble_report_t effect = { 200, 0, 0, 0, 0 };
+    uint8_t rumble[GAMEPAD_RUMBLE_REPORT_SIZE];
+    gamepad_rumble_report::pack(effect, rumble);
+    mock_usb_write_report(GAMEPAD_RUMBLE_REPORT_ID, rumble, sizeof(rumble));
+    hold_ms(2);
+    uint8_t rumble_on = motor_strong;
+    mock_usb_set_attached(0);
+    hold_ms(2);
+    uint8_t rumble_after = motor_strong;
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(null_fd);
+    close(saved_stdout);
+
+    printf("USB transport benchmark: %u s per transport, stick every 1 ms, USB polled every %u ms\n", seconds,
+           USB_HID_POLL_INTERVAL_MS);
+    printf("  %-10s %8s %7s %7s %7s\n", "transport", "reports", "presses", "p50 us", "p99 us");
+    printf("  %-10s %8u %7u %7u %7u\n", "bluetooth", ble_reports, (uint32_t)ble_press.size(),
+           percentile(ble_press, 50), percentile(ble_press, 99));
+    printf("  %-10s %8u %7u %7u %7u\n", "usb", usb_reports, (uint32_t)usb_press.size(), percentile(usb_press, 50),
+           percentile(usb_press, 99));
+    printf("  central while on USB: %u reports, %s\n", ble_reports_on_usb, attach_neutral_ble ? "neutral" : "NOT neutral");
+    printf("  switches with a button held: %d of 60 checks missed\n", switch_misses);
+    printf("  rumble over USB: %u, after unplugging: %u\n", rumble_on, rumble_after);
+
+    if (usb_press.empty() || percentile(usb_press, 99) > 2 * USB_HID_POLL_INTERVAL_MS * 1000) {
+        printf("FAIL: presses take longer than two USB polls\n");
+        failures++;
+    }
+    if (!attach_neutral_ble || ble_reports_on_usb > 2) {
+        printf("FAIL: the central kept getting input while USB carried the players\n");
+        failures++;
+    }
+    if (switch_misses) {
+        printf("FAIL: state lost across a switch\n");
+        failures++;
+    }
+    if (!rumble_on || rumble_after) {
+        printf("FAIL: rumble over USB did not start or did not stop with the cable\n");
+        failures++;
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,21 @@
+// *****************************************************************************
+// Host mock of ble/gatt-service/battery_service_server.h
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_BATTERY_SERVICE_SERVER_H
+#define BTSTACK_MOCK_BATTERY_SERVICE_SERVER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void battery_service_server_init(uint8_t battery_value);
+void battery_service_server_set_battery_value(uint8_t battery_value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSTACK_MOCK_BATTERY_SERVICE_SERVER_H
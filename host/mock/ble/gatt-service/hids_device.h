@@ -0,0 +1,80 @@
+// *****************************************************************************
+// Host mock of ble/gatt-service/hids_device.h
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_HIDS_DEVICE_H
+#define BTSTACK_MOCK_HIDS_DEVICE_H
+
+#include "btstack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint16_t value_handle;
+    uint16_t client_configuration_descriptor_handle;
+    uint16_t client_configuration_value;
+    uint8_t type;
+    uint16_t id;
+} hids_device_report_t;
+
+void hids_device_init(uint8_t hid_country_code, const uint8_t *hid_descriptor, uint16_t hid_descriptor_size);
+void hids_device_init_with_storage(uint8_t hid_country_code, const uint8_t *hid_descriptor,
+                                   uint16_t hid_descriptor_size, uint16_t num_reports,
+                                   hids_device_report_t *report_storage);
+void hids_device_register_packet_handler(btstack_packet_handler_t callback);
+void hids_device_request_can_send_now_event(hci_con_handle_t con_handle);
+uint8_t hids_device_send_input_report(hci_con_handle_t con_handle, const uint8_t *report, uint16_t report_len);
+uint8_t hids_device_send_input_report_for_id(hci_con_handle_t con_handle, uint16_t report_id, const uint8_t *report,
+                                             uint16_t report_len);
+uint8_t hids_device_send_boot_keyboard_input_report(hci_con_handle_t con_handle, const uint8_t *report, uint16_t report_len);
+
+static inline uint8_t hci_event_hids_meta_get_subevent_code(const uint8_t *event) {
+    return event[2];
+}
+static inline hci_con_handle_t hids_subevent_can_send_now_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline hci_con_handle_t hids_subevent_input_report_enable_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hids_subevent_input_report_enable_get_report_id(const uint8_t *event) {
+    return event[5];
+}
+static inline uint8_t hids_subevent_input_report_enable_get_enable(const uint8_t *event) {
+    return event[6];
+}
+static inline hci_con_handle_t hids_subevent_boot_keyboard_input_report_enable_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hids_subevent_boot_keyboard_input_report_enable_get_enable(const uint8_t *event) {
+    return event[5];
+}
+static inline hci_con_handle_t hids_subevent_protocol_mode_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hids_subevent_protocol_mode_get_protocol_mode(const uint8_t *event) {
+    return event[5];
+}
+static inline hci_con_handle_t hids_subevent_set_report_get_con_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hids_subevent_set_report_get_report_id(const uint8_t *event) {
+    return event[5];
+}
+static inline uint8_t hids_subevent_set_report_get_report_type(const uint8_t *event) {
+    return event[6];
+}
+static inline uint8_t hids_subevent_set_report_get_report_length(const uint8_t *event) {
+    return event[7];
+}
+static inline const uint8_t *hids_subevent_set_report_get_report_data(const uint8_t *event) {
+    return &event[8];
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSTACK_MOCK_HIDS_DEVICE_H
@@ -0,0 +1,20 @@
+// *****************************************************************************
+// Host mock of ble/le_device_db_tlv.h
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_LE_DEVICE_DB_TLV_H
+#define BTSTACK_MOCK_LE_DEVICE_DB_TLV_H
+
+#include "btstack_tlv.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void le_device_db_tlv_configure(const btstack_tlv_t *btstack_tlv_impl, void *btstack_tlv_context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSTACK_MOCK_LE_DEVICE_DB_TLV_H
@@ -0,0 +1,344 @@
+// *****************************************************************************
+// Host mock of the BTstack API subset used by the gamepad report path
+//
+// Declarations follow the real BTstack headers so gamepad.cpp compiles
+// unchanged. Events are encoded the way BTstack does (event code, length,
+// subevent code, little-endian fields) so the real getter semantics hold.
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_BTSTACK_H
+#define BTSTACK_MOCK_BTSTACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNUSED(x) (void)(sizeof(x))
+
+typedef uint16_t hci_con_handle_t;
+typedef uint8_t bd_addr_t[6];
+
+#define HCI_CON_HANDLE_INVALID 0xffff
+
+#define ERROR_CODE_SUCCESS                   0x00
+#define ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER 0x02
+#define ERROR_CODE_COMMAND_DISALLOWED        0x0C
+#define ERROR_CODE_ADVERTISING_TIMEOUT       0x3C
+
+#define BD_ADDR_TYPE_UNKNOWN 0xfe
+
+// Packet types
+#define HCI_EVENT_PACKET 0x04
+
+// Events
+#define HCI_EVENT_DISCONNECTION_COMPLETE     0x05
+#define HCI_EVENT_ENCRYPTION_CHANGE          0x08
+#define HCI_EVENT_COMMAND_COMPLETE           0x0E
+#define HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS 0x13
+#define HCI_EVENT_LE_META                    0x3E
+#define L2CAP_EVENT_CONNECTION_PARAMETER_UPDATE_RESPONSE 0x77
+#define HCI_EVENT_HIDS_META                  0xEF
+#define BTSTACK_EVENT_STATE                  0x60
+#define SM_EVENT_JUST_WORKS_REQUEST          0xC8
+#define SM_EVENT_PASSKEY_DISPLAY_NUMBER      0xC9
+#define SM_EVENT_NUMERIC_COMPARISON_REQUEST  0xCC
+#define SM_EVENT_PAIRING_COMPLETE            0xD5
+
+// HCI states (BTSTACK_EVENT_STATE)
+#define HCI_STATE_OFF      0
+#define HCI_STATE_WORKING  2
+
+// Command opcodes
+#define HCI_OPCODE_HCI_LE_SET_ADVERTISE_ENABLE 0x200A
+
+// LE meta subevents
+#define HCI_SUBEVENT_LE_CONNECTION_COMPLETE         0x01
+#define HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE  0x03
+#define HCI_SUBEVENT_LE_DATA_LENGTH_CHANGE          0x07
+#define HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE         0x0C
+
+// HIDS subevents
+#define HIDS_SUBEVENT_CAN_SEND_NOW                       0x01
+#define HIDS_SUBEVENT_PROTOCOL_MODE                      0x02
+#define HIDS_SUBEVENT_BOOT_MOUSE_INPUT_REPORT_ENABLE     0x03
+#define HIDS_SUBEVENT_BOOT_KEYBOARD_INPUT_REPORT_ENABLE  0x04
+#define HIDS_SUBEVENT_INPUT_REPORT_ENABLE                0x05
+#define HIDS_SUBEVENT_SET_REPORT                         0x0A
+
+// HID report types (btstack_hid.h)
+#define HID_REPORT_TYPE_INPUT   1
+#define HID_REPORT_TYPE_OUTPUT  2
+#define HID_REPORT_TYPE_FEATURE 3
+
+// Linked list / packet handler plumbing
+typedef struct btstack_linked_item {
+    struct btstack_linked_item *next;
+} btstack_linked_item_t;
+
+typedef void (*btstack_packet_handler_t)(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+
+typedef struct {
+    btstack_linked_item_t item;
+    btstack_packet_handler_t callback;
+} btstack_packet_callback_registration_t;
+
+void hci_add_event_handler(btstack_packet_callback_registration_t *callback_handler);
+void l2cap_add_event_handler(btstack_packet_callback_registration_t *callback_handler);
+
+// HCI commands
+typedef struct {
+    uint16_t opcode;
+    const char *format;
+} hci_cmd_t;
+
+extern const hci_cmd_t hci_le_set_data_length;
+
+int hci_can_send_command_packet_now(void);
+int hci_number_free_acl_slots_for_handle(hci_con_handle_t con_handle);
+uint8_t hci_send_cmd(const hci_cmd_t *cmd, ...);
+
+// ATT server
+#define ATT_TRANSACTION_MODE_NONE 0x00
+
+#define ATT_ERROR_WRITE_NOT_PERMITTED            0x03
+#define ATT_ERROR_INVALID_OFFSET                 0x07
+#define ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH 0x0D
+#define ATT_ERROR_UNLIKELY_ERROR                 0x0E
+#define ATT_ERROR_VALUE_NOT_ALLOWED              0x13
+
+#define GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION 1
+
+typedef uint16_t (*att_read_callback_t)(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t offset,
+                                        uint8_t *buffer, uint16_t buffer_size);
+typedef int (*att_write_callback_t)(hci_con_handle_t con_handle, uint16_t attribute_handle,
+                                    uint16_t transaction_mode, uint16_t offset, uint8_t *buffer,
+                                    uint16_t buffer_size);
+
+typedef struct {
+    btstack_linked_item_t item;
+    uint16_t start_handle;
+    uint16_t end_handle;
+    att_read_callback_t read_callback;
+    att_write_callback_t write_callback;
+    btstack_packet_handler_t packet_handler;
+} att_service_handler_t;
+
+typedef struct {
+    btstack_linked_item_t item;
+    void (*callback)(void *context);
+    void *context;
+} btstack_context_callback_registration_t;
+
+uint16_t att_server_get_mtu(hci_con_handle_t con_handle);
+void att_server_register_service_handler(att_service_handler_t *handler);
+uint8_t att_server_register_can_send_now_callback(btstack_context_callback_registration_t *callback_registration,
+                                                  hci_con_handle_t con_handle);
+uint8_t att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value,
+                          uint16_t value_len);
+uint16_t att_read_callback_handle_blob(const uint8_t *blob, uint16_t blob_size, uint16_t offset, uint8_t *buffer,
+                                       uint16_t buffer_size);
+
+// GATT database lookups (128-bit UUIDs in big-endian order, as written in
+// the .gatt file)
+int gatt_server_get_handle_range_for_service_with_uuid128(const uint8_t *uuid128, uint16_t *start_handle,
+                                                          uint16_t *end_handle);
+uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid128(uint16_t start_handle, uint16_t end_handle,
+                                                                     const uint8_t *uuid128);
+uint16_t gatt_server_get_client_configuration_handle_for_characteristic_with_uuid128(uint16_t start_handle,
+                                                                                      uint16_t end_handle,
+                                                                                      const uint8_t *uuid128);
+
+// GAP
+int gap_request_connection_parameter_update(hci_con_handle_t con_handle, uint16_t conn_interval_min,
+                                            uint16_t conn_interval_max, uint16_t conn_latency,
+                                            uint16_t supervision_timeout);
+uint8_t gap_le_set_phy(hci_con_handle_t con_handle, uint8_t all_phys, uint8_t tx_phys, uint8_t rx_phys,
+                       uint8_t phy_options);
+void gap_advertisements_enable(int enabled);
+void gap_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
+                                   uint8_t direct_address_typ, bd_addr_t direct_address, uint8_t channel_map,
+                                   uint8_t filter_policy);
+
+// Run loop timers
+typedef struct btstack_timer_source {
+    btstack_linked_item_t item;
+    uint32_t timeout;
+    void (*process)(struct btstack_timer_source *ts);
+    void *context;
+} btstack_timer_source_t;
+
+void btstack_run_loop_set_timer(btstack_timer_source_t *ts, uint32_t timeout_in_ms);
+void btstack_run_loop_add_timer(btstack_timer_source_t *ts);
+int btstack_run_loop_remove_timer(btstack_timer_source_t *ts);
+uint32_t btstack_run_loop_get_time_ms(void);
+
+// Run loop data sources
+typedef enum {
+    DATA_SOURCE_CALLBACK_POLL  = 1 << 0,
+    DATA_SOURCE_CALLBACK_READ  = 1 << 1,
+    DATA_SOURCE_CALLBACK_WRITE = 1 << 2,
+} btstack_data_source_callback_type_t;
+
+typedef struct btstack_data_source {
+    btstack_linked_item_t item;
+    union {
+        int fd;
+        void *handle;
+    } source;
+    uint16_t flags;
+    void (*process)(struct btstack_data_source *ds, btstack_data_source_callback_type_t callback_type);
+} btstack_data_source_t;
+
+void btstack_run_loop_set_data_source_handler(btstack_data_source_t *data_source,
+                                              void (*process)(btstack_data_source_t *data_source,
+                                                              btstack_data_source_callback_type_t callback_type));
+void btstack_run_loop_enable_data_source_callbacks(btstack_data_source_t *data_source, uint16_t callbacks);
+void btstack_run_loop_add_data_source(btstack_data_source_t *data_source);
+int btstack_run_loop_remove_data_source(btstack_data_source_t *data_source);
+
+// Thread/IRQ-safe request to run the poll callbacks from the run loop
+void btstack_run_loop_poll_data_sources_from_irq(void);
+
+// Little-endian helpers
+static inline uint16_t little_endian_read_16(const uint8_t *buffer, int position) {
+    return (uint16_t)(buffer[position] | (buffer[position + 1] << 8));
+}
+static inline uint32_t little_endian_read_32(const uint8_t *buffer, int position) {
+    return (uint32_t)buffer[position] | ((uint32_t)buffer[position + 1] << 8) |
+           ((uint32_t)buffer[position + 2] << 16) | ((uint32_t)buffer[position + 3] << 24);
+}
+static inline void little_endian_store_16(uint8_t *buffer, uint16_t position, uint16_t value) {
+    buffer[position] = (uint8_t)value;
+    buffer[position + 1] = (uint8_t)(value >> 8);
+}
+static inline void little_endian_store_32(uint8_t *buffer, uint16_t position, uint32_t value) {
+    buffer[position] = (uint8_t)value;
+    buffer[position + 1] = (uint8_t)(value >> 8);
+    buffer[position + 2] = (uint8_t)(value >> 16);
+    buffer[position + 3] = (uint8_t)(value >> 24);
+}
+
+// Event getters
+static inline uint8_t hci_event_packet_get_type(const uint8_t *event) {
+    return event[0];
+}
+
+static inline uint8_t btstack_event_state_get_state(const uint8_t *event) {
+    return event[2];
+}
+static inline uint16_t hci_event_command_complete_get_command_opcode(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hci_event_le_meta_get_subevent_code(const uint8_t *event) {
+    return event[2];
+}
+static inline hci_con_handle_t hci_event_disconnection_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hci_event_encryption_change_get_status(const uint8_t *event) {
+    return event[2];
+}
+static inline hci_con_handle_t hci_event_encryption_change_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint8_t hci_event_encryption_change_get_encryption_enabled(const uint8_t *event) {
+    return event[5];
+}
+static inline uint8_t hci_subevent_le_connection_complete_get_status(const uint8_t *event) {
+    return event[3];
+}
+static inline hci_con_handle_t hci_subevent_le_connection_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+static inline uint16_t hci_subevent_le_connection_complete_get_conn_interval(const uint8_t *event) {
+    return little_endian_read_16(event, 14);
+}
+static inline uint16_t hci_subevent_le_connection_complete_get_conn_latency(const uint8_t *event) {
+    return little_endian_read_16(event, 16);
+}
+static inline uint16_t hci_subevent_le_connection_complete_get_supervision_timeout(const uint8_t *event) {
+    return little_endian_read_16(event, 18);
+}
+static inline uint8_t hci_subevent_le_connection_update_complete_get_status(const uint8_t *event) {
+    return event[3];
+}
+static inline hci_con_handle_t hci_subevent_le_connection_update_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+static inline uint16_t hci_subevent_le_connection_update_complete_get_conn_interval(const uint8_t *event) {
+    return little_endian_read_16(event, 6);
+}
+static inline uint16_t hci_subevent_le_connection_update_complete_get_conn_latency(const uint8_t *event) {
+    return little_endian_read_16(event, 8);
+}
+static inline uint16_t hci_subevent_le_connection_update_complete_get_supervision_timeout(const uint8_t *event) {
+    return little_endian_read_16(event, 10);
+}
+static inline hci_con_handle_t hci_subevent_le_data_length_change_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 3);
+}
+static inline uint16_t hci_subevent_le_data_length_change_get_max_tx_octets(const uint8_t *event) {
+    return little_endian_read_16(event, 5);
+}
+static inline uint16_t hci_subevent_le_data_length_change_get_max_rx_octets(const uint8_t *event) {
+    return little_endian_read_16(event, 9);
+}
+static inline uint8_t hci_subevent_le_phy_update_complete_get_status(const uint8_t *event) {
+    return event[3];
+}
+static inline hci_con_handle_t hci_subevent_le_phy_update_complete_get_connection_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+static inline uint8_t hci_subevent_le_phy_update_complete_get_tx_phy(const uint8_t *event) {
+    return event[6];
+}
+static inline uint8_t hci_subevent_le_phy_update_complete_get_rx_phy(const uint8_t *event) {
+    return event[7];
+}
+static inline hci_con_handle_t l2cap_event_connection_parameter_update_response_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline uint16_t l2cap_event_connection_parameter_update_response_get_result(const uint8_t *event) {
+    return little_endian_read_16(event, 4);
+}
+
+// Security Manager and LE device DB
+typedef uint8_t sm_key_t[16];
+
+void sm_add_event_handler(btstack_packet_callback_registration_t *callback_handler);
+int sm_le_device_index(hci_con_handle_t con_handle);
+int le_device_db_max_count(void);
+void le_device_db_info(int index, int *addr_type, bd_addr_t addr, sm_key_t irk);
+void sm_just_works_confirm(hci_con_handle_t con_handle);
+void sm_numeric_comparison_confirm(hci_con_handle_t con_handle);
+
+static inline hci_con_handle_t sm_event_just_works_request_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline hci_con_handle_t sm_event_passkey_display_number_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline uint32_t sm_event_passkey_display_number_get_passkey(const uint8_t *event) {
+    return little_endian_read_32(event, 11);
+}
+static inline uint32_t sm_event_numeric_comparison_request_get_passkey(const uint8_t *event) {
+    return little_endian_read_32(event, 11);
+}
+static inline hci_con_handle_t sm_event_pairing_complete_get_handle(const uint8_t *event) {
+    return little_endian_read_16(event, 2);
+}
+static inline uint8_t sm_event_pairing_complete_get_status(const uint8_t *event) {
+    return event[11];
+}
+
+// Utilities
+char *bd_addr_to_str(const bd_addr_t addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSTACK_MOCK_BTSTACK_H
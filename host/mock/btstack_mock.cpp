@@ -0,0 +1,1204 @@
+// *****************************************************************************
+// Host BTstack mock - virtual run loop, HIDS device and controller
+// *****************************************************************************
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "btstack.h"
+#include "ble/gatt-service/battery_service_server.h"
+#include "ble/gatt-service/hids_device.h"
+#include "analog_sampler.h"
+#include "battery_adc.h"
+#include "btstack_mock.h"
+#include "btstack_tlv.h"
+#include "gamepad_config.h"
+#include "imu_sampler.h"
+#include "pico/time.h"
+#include "rumble_motors.h"
+#include "usb_device.h"
+
+namespace {
+
+struct queued_notification {
+    hci_con_handle_t con_handle;
+    uint16_t attribute_handle;      // att_server_notify(); 0 = HIDS report
+    uint8_t report_id;
+    uint8_t report[128];
+    uint16_t report_len;
+    uint64_t queued_us;
+};
+
+struct central_write {
+    hci_con_handle_t con_handle;
+    uint8_t report_id;
+    std::vector<uint8_t> report;
+};
+
+// A CAN_SEND_NOW request: HIDS (no registration) or an ATT service's
+// callback, served in the order they were made like att_server does
+struct can_send_request {
+    hci_con_handle_t con_handle;
+    btstack_context_callback_registration_t *registration;
+};
+
+struct connection_update {
+    hci_con_handle_t con_handle;
+    uint16_t interval;
+    uint16_t latency;
+    uint16_t timeout;
+};
+
+struct mock_state {
+    uint64_t now_us = 0;
+    uint32_t connection_interval_us = 7500;
+    uint8_t acl_buffers = 3;
+    uint8_t packets_per_event = 4;
+    uint64_t next_anchor_us = 7500;
+    uint16_t peripheral_latency = 0;
+    uint16_t events_since_listen = 0;
+    uint16_t att_mtu = 247;
+
+    // Controller timing: packets queued less than tx_setup_us before an
+    // anchor wait for the next one, completions are reported
+    // completion_delay_us after the event, and the controller's clock runs
+    // clock_ppm fast (anchors drift against the host's microseconds)
+    uint32_t tx_setup_us = 0;
+    uint32_t completion_delay_us = 0;
+    int32_t clock_ppm = 0;
+    int64_t anchor_drift_pus = 0;   // Accumulated drift, 1e-6 us
+    std::deque<std::pair<uint64_t, std::vector<uint8_t>>> pending_completions;
+    uint16_t uncompleted = 0;       // Sent, buffer not yet freed by a completion
+
+    std::vector<btstack_timer_source_t *> timers;
+    std::vector<btstack_data_source_t *> data_sources;
+    std::vector<btstack_packet_handler_t> hci_handlers;
+    std::vector<btstack_packet_handler_t> sm_handlers;
+    std::vector<btstack_packet_handler_t> l2cap_handlers;
+    btstack_packet_handler_t hids_handler = nullptr;
+    mock_notification_handler_t notification_handler = nullptr;
+
+    // ATT services and the handles the GATT lookups gave out: every service
+    // gets a range of 0x40 handles, each characteristic three (declaration,
+    // value, client configuration) in the order it was first looked up
+    std::vector<att_service_handler_t *> att_services;
+    std::map<std::vector<uint8_t>, uint16_t> gatt_services;
+    std::map<std::pair<uint16_t, std::vector<uint8_t>>, uint16_t> gatt_characteristics;
+    std::map<uint16_t, uint16_t> gatt_next_handle;
+    uint16_t gatt_next_service = 0x0100;
+    mock_att_notification_handler_t att_notification_handler = nullptr;
+
+    std::vector<hci_con_handle_t> connections;
+    std::vector<can_send_request> can_send_now_pending;
+    std::deque<queued_notification> controller_queue;
+
+    // Virtual central
+    uint16_t central_min_interval = 6;
+    uint8_t central_2m_phy = 1;
+    std::deque<std::vector<uint8_t>> hci_events;
+    std::deque<std::vector<uint8_t>> l2cap_events;
+    std::vector<connection_update> connection_updates;
+    std::map<hci_con_handle_t, int> sm_device_index;
+    std::deque<central_write> central_writes;
+
+    // Hardware alarm and motor outputs
+    uint64_t alarm_us = UINT64_MAX;
+    void (*alarm_handler)(void) = nullptr;
+    mock_motor_handler_t motor_handler = nullptr;
+
+    // VSYS for battery readings
+    uint16_t vsys_mv = 4000;
+
+    // IMU samples waiting for the run loop
+    std::deque<imu_sample_t> imu_samples;
+    imu_sampler_stats_t imu_stats = {};
+
+    // USB device and the virtual host polling its HID endpoint
+    const usb_device_handlers_t *usb_handlers = nullptr;
+    bool usb_ready = false;
+    bool usb_pending = false;
+    uint8_t usb_report_id = 0;
+    std::vector<uint8_t> usb_report;
+    uint64_t usb_queued_us = 0;
+    uint64_t usb_poll_us = UINT64_MAX;
+    mock_usb_report_handler_t usb_report_handler = nullptr;
+
+    // TLV instance the firmware registered (nullptr: the flash store), and
+    // how long each flash write holds both cores
+    const btstack_tlv_t *tlv_instance = nullptr;
+    void *tlv_instance_context = nullptr;
+    uint32_t tlv_write_us = 0;
+    bool analog_paused = false;
+    bool stalled = false;
+    uint64_t stall_until_us = 0;
+
+    mock_btstack_stats_t stats = {};
+};
+
+mock_state state;
+
+// Set from other threads, outside of the resettable state
+std::atomic<bool> poll_data_sources_requested;
+
+// Flash: TLV tags and the LE device DB outlive mock_btstack_reset()
+std::map<uint32_t, std::vector<uint8_t>> tlv_tags;
+
+struct device_db_entry {
+    int addr_type = BD_ADDR_TYPE_UNKNOWN;
+    bd_addr_t addr = {};
+};
+const int device_db_size = 16;
+device_db_entry device_db[device_db_size];
+
+void stall(uint32_t stall_us);
+
+int tlv_get_tag(void *context, uint32_t tag, uint8_t *buffer, uint32_t buffer_size)
+{
+    UNUSED(context);
+    auto it = tlv_tags.find(tag);
+    if (it == tlv_tags.end()) return 0;
+    uint32_t size = std::min<uint32_t>(buffer_size, (uint32_t)it->second.size());
+    memcpy(buffer, it->second.data(), size);
+    return (int)it->second.size();
+}
+
+int tlv_store_tag(void *context, uint32_t tag, const uint8_t *data, uint32_t data_size)
+{
+    UNUSED(context);
+    state.stats.tlv_stores++;
+    if (!state.analog_paused) state.stats.tlv_writes_sampling++;
+    tlv_tags[tag] = std::vector<uint8_t>(data, data + data_size);
+    stall(state.tlv_write_us);
+    return 0;
+}
+
+void tlv_delete_tag(void *context, uint32_t tag)
+{
+    UNUSED(context);
+    if (!state.analog_paused) state.stats.tlv_writes_sampling++;
+    tlv_tags.erase(tag);
+    stall(state.tlv_write_us);
+}
+
+const btstack_tlv_t tlv_impl = { &tlv_get_tag, &tlv_store_tag, &tlv_delete_tag };
+
+void poll_data_sources(void)
+{
+    if (!poll_data_sources_requested.exchange(false)) return;
+    for (btstack_data_source_t *ds : state.data_sources) {
+        if (ds->flags & DATA_SOURCE_CALLBACK_POLL) {
+            ds->process(ds, DATA_SOURCE_CALLBACK_POLL);
+        }
+    }
+}
+
+void emit(const std::vector<btstack_packet_handler_t> &handlers, uint8_t *event, uint16_t size)
+{
+    for (btstack_packet_handler_t handler : handlers) {
+        handler(HCI_EVENT_PACKET, 0, event, size);
+    }
+}
+
+void emit_hids(uint8_t *event, uint16_t size)
+{
+    if (state.hids_handler) {
+        state.hids_handler(HCI_EVENT_PACKET, 0, event, size);
+    }
+}
+
+void deliver_events(void)
+{
+    while (!state.hci_events.empty()) {
+        std::vector<uint8_t> event = state.hci_events.front();
+        state.hci_events.pop_front();
+        emit(state.hci_handlers, event.data(), (uint16_t)event.size());
+    }
+    while (!state.l2cap_events.empty()) {
+        std::vector<uint8_t> event = state.l2cap_events.front();
+        state.l2cap_events.pop_front();
+        emit(state.l2cap_handlers, event.data(), (uint16_t)event.size());
+    }
+}
+
+// Accepted parameter updates take effect at a connection event anchor. The
+// virtual controller runs a single schedule, so the last update sets the
+// interval for all connections.
+void apply_connection_updates(void)
+{
+    for (const connection_update &update : state.connection_updates) {
+        state.connection_interval_us = update.interval * 1250u;
+        state.peripheral_latency = update.latency;
+        std::vector<uint8_t> event = { HCI_EVENT_LE_META, 10, HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE, 0x00,
+                                       (uint8_t)(update.con_handle & 0xff), (uint8_t)(update.con_handle >> 8),
+                                       (uint8_t)(update.interval & 0xff), (uint8_t)(update.interval >> 8),
+                                       (uint8_t)(update.latency & 0xff), (uint8_t)(update.latency >> 8),
+                                       (uint8_t)(update.timeout & 0xff), (uint8_t)(update.timeout >> 8) };
+        emit(state.hci_handlers, event.data(), (uint16_t)event.size());
+    }
+    state.connection_updates.clear();
+}
+
+size_t buffers_in_use(void)
+{
+    return state.controller_queue.size() + state.uncompleted;
+}
+
+bool is_connected(hci_con_handle_t con_handle)
+{
+    return std::find(state.connections.begin(), state.connections.end(), con_handle) != state.connections.end();
+}
+
+void deliver_can_send_now(void)
+{
+    // One CAN_SEND_NOW per request, while the controller has a free buffer
+    while (!state.can_send_now_pending.empty() && buffers_in_use() < state.acl_buffers) {
+        can_send_request request = state.can_send_now_pending.front();
+        state.can_send_now_pending.erase(state.can_send_now_pending.begin());
+        hci_con_handle_t con_handle = request.con_handle;
+
+        uint8_t event[5] = { HCI_EVENT_HIDS_META, 3, HIDS_SUBEVENT_CAN_SEND_NOW,
+                             (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8) };
+        state.stats.can_send_now_events++;
+        auto start = std::chrono::steady_clock::now();
+        if (request.registration) {
+            request.registration->callback(request.registration->context);
+        } else {
+            emit_hids(event, sizeof(event));
+        }
+        auto stop = std::chrono::steady_clock::now();
+        state.stats.handler_ns += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+    }
+}
+
+void connection_event(void)
+{
+    if (state.connections.empty()) return;
+    state.stats.connection_events++;
+    if (state.controller_queue.empty() && state.events_since_listen < state.peripheral_latency) {
+        state.events_since_listen++;
+        state.stats.events_skipped++;
+        return;
+    }
+    state.events_since_listen = 0;
+
+    // Writes the central queued go out at the first event the peripheral
+    // listens to
+    while (!state.stalled && !state.central_writes.empty()) {
+        central_write write = state.central_writes.front();
+        state.central_writes.pop_front();
+        if (is_connected(write.con_handle)) {
+            mock_hids_emit_set_report(write.con_handle, write.report_id, HID_REPORT_TYPE_OUTPUT, write.report.data(),
+                                      (uint16_t)write.report.size());
+        }
+    }
+
+    std::vector<std::pair<hci_con_handle_t, uint16_t>> completed;
+    for (uint8_t i = 0; i < state.packets_per_event && !state.controller_queue.empty(); i++) {
+        if (state.controller_queue.front().queued_us + state.tx_setup_us > state.now_us) break;
+        queued_notification notification = state.controller_queue.front();
+        state.controller_queue.pop_front();
+        state.stats.notifications_sent++;
+        if (notification.attribute_handle) {
+            state.stats.att_notifications_sent++;
+            if (state.att_notification_handler) {
+                state.att_notification_handler(notification.con_handle, notification.attribute_handle,
+                                               notification.report, notification.report_len, state.now_us);
+            }
+        } else if (state.notification_handler) {
+            state.notification_handler(notification.con_handle, notification.report_id, notification.report,
+                                       notification.report_len, notification.queued_us, state.now_us);
+        }
+        auto it = std::find_if(completed.begin(), completed.end(),
+                               [&](const std::pair<hci_con_handle_t, uint16_t> &entry) {
+                                   return entry.first == notification.con_handle;
+                               });
+        if (it == completed.end()) {
+            completed.push_back({notification.con_handle, 1});
+        } else {
+            it->second++;
+        }
+    }
+
+    // The controller reports freed buffers after the event
+    if (completed.empty()) return;
+    std::vector<uint8_t> event = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, (uint8_t)(1 + 4 * completed.size()),
+                                   (uint8_t)completed.size() };
+    for (const auto &entry : completed) {
+        event.push_back((uint8_t)(entry.first & 0xff));
+        event.push_back((uint8_t)(entry.first >> 8));
+        event.push_back((uint8_t)(entry.second & 0xff));
+        event.push_back((uint8_t)(entry.second >> 8));
+    }
+    if (state.completion_delay_us || state.stalled) {
+        for (const auto &entry : completed) {
+            state.uncompleted += entry.second;
+        }
+        state.pending_completions.push_back(
+            { std::max(state.now_us + state.completion_delay_us, state.stall_until_us), event });
+        return;
+    }
+    emit(state.hci_handlers, event.data(), (uint16_t)event.size());
+}
+
+// The host polls the IN endpoint at frame starts, every poll interval
+void usb_poll(void)
+{
+    state.usb_pending = false;
+    state.usb_poll_us = UINT64_MAX;
+    state.stats.usb_reports++;
+    if (state.usb_report_handler) {
+        state.usb_report_handler(state.usb_report_id, state.usb_report.data(), (uint16_t)state.usb_report.size(),
+                                 state.usb_queued_us, state.now_us);
+    }
+    if (state.usb_handlers) {
+        state.usb_handlers->sent();
+    }
+}
+
+uint64_t next_completion_us(void)
+{
+    return state.pending_completions.empty() ? UINT64_MAX : state.pending_completions.front().first;
+}
+
+// Where the next anchor falls after this one, on the controller's clock
+void advance_anchor(void)
+{
+    state.anchor_drift_pus -= (int64_t)state.connection_interval_us * state.clock_ppm;
+    int64_t correction_us = state.anchor_drift_pus / 1000000;
+    state.anchor_drift_pus -= correction_us * 1000000;
+    state.next_anchor_us += (uint64_t)((int64_t)state.connection_interval_us + correction_us);
+}
+
+// A flash write: both cores wait for it. The controller keeps its schedule
+// and sends what was queued; what it has for the host, the USB host's poll
+// and the alarm interrupt wait until the write is done.
+void stall(uint32_t stall_us)
+{
+    if (!stall_us) return;
+    state.stall_until_us = state.now_us + stall_us;
+    state.stalled = true;
+    while (state.next_anchor_us <= state.stall_until_us) {
+        state.now_us = state.next_anchor_us;
+        connection_event();
+        advance_anchor();
+    }
+    state.stalled = false;
+    state.now_us = state.stall_until_us;
+    for (auto &completion : state.pending_completions) {
+        completion.first = std::max(completion.first, state.now_us);
+    }
+    state.usb_poll_us = std::max(state.usb_poll_us, state.now_us);
+    state.alarm_us = std::max(state.alarm_us, state.now_us);
+}
+
+bool fire_next_timer(void)
+{
+    uint32_t now_ms = (uint32_t)(state.now_us / 1000);
+    for (size_t i = 0; i < state.timers.size(); i++) {
+        btstack_timer_source_t *ts = state.timers[i];
+        if ((int32_t)(now_ms - ts->timeout) >= 0) {
+            state.timers.erase(state.timers.begin() + i);
+            ts->process(ts);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t queue_notification(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report, uint16_t report_len,
+                           uint16_t attribute_handle = 0)
+{
+    if (buffers_in_use() >= state.acl_buffers) return ERROR_CODE_COMMAND_DISALLOWED;
+    queued_notification notification;
+    notification.con_handle = con_handle;
+    notification.attribute_handle = attribute_handle;
+    notification.report_id = report_id;
+    notification.report_len = std::min<uint16_t>(report_len, sizeof(notification.report));
+    memcpy(notification.report, report, notification.report_len);
+    notification.queued_us = state.now_us;
+    state.controller_queue.push_back(notification);
+    state.stats.notifications_queued++;
+    return ERROR_CODE_SUCCESS;
+}
+
+att_service_handler_t *att_service_for(uint16_t attribute_handle)
+{
+    for (att_service_handler_t *handler : state.att_services) {
+        if (attribute_handle >= handler->start_handle && attribute_handle <= handler->end_handle) return handler;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+// BTstack API
+
+extern "C" void hci_add_event_handler(btstack_packet_callback_registration_t *callback_handler)
+{
+    state.hci_handlers.push_back(callback_handler->callback);
+}
+
+extern "C" void l2cap_add_event_handler(btstack_packet_callback_registration_t *callback_handler)
+{
+    state.l2cap_handlers.push_back(callback_handler->callback);
+}
+
+extern "C" const hci_cmd_t hci_le_set_data_length = { 0x2022, "H22" };
+
+extern "C" int hci_can_send_command_packet_now(void)
+{
+    return 1;
+}
+
+extern "C" int hci_number_free_acl_slots_for_handle(hci_con_handle_t con_handle)
+{
+    UNUSED(con_handle);
+    return (int)state.acl_buffers - (int)buffers_in_use();
+}
+
+extern "C" uint8_t hci_send_cmd(const hci_cmd_t *cmd, ...)
+{
+    if (cmd != &hci_le_set_data_length) return ERROR_CODE_SUCCESS;
+
+    va_list args;
+    va_start(args, cmd);
+    hci_con_handle_t con_handle = (hci_con_handle_t)va_arg(args, int);
+    uint16_t tx_octets = (uint16_t)std::min(va_arg(args, int), 251);
+    uint16_t tx_time = (uint16_t)va_arg(args, int);
+    va_end(args);
+    if (!is_connected(con_handle)) return ERROR_CODE_SUCCESS;
+
+    state.hci_events.push_back({ HCI_EVENT_LE_META, 11, HCI_SUBEVENT_LE_DATA_LENGTH_CHANGE,
+                                 (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8),
+                                 (uint8_t)(tx_octets & 0xff), (uint8_t)(tx_octets >> 8),
+                                 (uint8_t)(tx_time & 0xff), (uint8_t)(tx_time >> 8),
+                                 (uint8_t)(tx_octets & 0xff), (uint8_t)(tx_octets >> 8),
+                                 (uint8_t)(tx_time & 0xff), (uint8_t)(tx_time >> 8) });
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" uint16_t att_server_get_mtu(hci_con_handle_t con_handle)
+{
+    return is_connected(con_handle) ? state.att_mtu : 0;
+}
+
+extern "C" void att_server_register_service_handler(att_service_handler_t *handler)
+{
+    state.att_services.push_back(handler);
+}
+
+extern "C" uint8_t att_server_register_can_send_now_callback(
+    btstack_context_callback_registration_t *callback_registration, hci_con_handle_t con_handle)
+{
+    state.stats.can_send_now_requests++;
+    if (!is_connected(con_handle)) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    // att_server links the registration into the connection's list; queued
+    // twice, here or for another connection, it would corrupt both lists
+    for (const can_send_request &pending : state.can_send_now_pending) {
+        if (pending.registration == callback_registration) {
+            state.stats.can_send_now_duplicates++;
+            fprintf(stderr, "mock: CAN_SEND_NOW registration %p already queued for 0x%04x\n",
+                    (void *)callback_registration, pending.con_handle);
+            return ERROR_CODE_COMMAND_DISALLOWED;
+        }
+    }
+    state.can_send_now_pending.push_back({ con_handle, callback_registration });
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" uint8_t att_server_notify(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value,
+                                     uint16_t value_len)
+{
+    if (!is_connected(con_handle)) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    return queue_notification(con_handle, 0, value, std::min<uint16_t>(value_len, state.att_mtu - 3),
+                              attribute_handle);
+}
+
+extern "C" uint16_t att_read_callback_handle_blob(const uint8_t *blob, uint16_t blob_size, uint16_t offset,
+                                                  uint8_t *buffer, uint16_t buffer_size)
+{
+    if (offset > blob_size) return 0;
+    uint16_t size = (uint16_t)(blob_size - offset);
+    if (!buffer) return size;
+    size = std::min(size, buffer_size);
+    memcpy(buffer, blob + offset, size);
+    return size;
+}
+
+extern "C" int gatt_server_get_handle_range_for_service_with_uuid128(const uint8_t *uuid128, uint16_t *start_handle,
+                                                                     uint16_t *end_handle)
+{
+    std::vector<uint8_t> uuid(uuid128, uuid128 + 16);
+    auto it = state.gatt_services.find(uuid);
+    if (it == state.gatt_services.end()) {
+        it = state.gatt_services.insert({ uuid, state.gatt_next_service }).first;
+        state.gatt_next_handle[state.gatt_next_service] = (uint16_t)(state.gatt_next_service + 1);
+        state.gatt_next_service += 0x40;
+    }
+    *start_handle = it->second;
+    *end_handle = (uint16_t)(it->second + 0x3f);
+    return 1;
+}
+
+extern "C" uint16_t gatt_server_get_value_handle_for_characteristic_with_uuid128(uint16_t start_handle,
+                                                                                uint16_t end_handle,
+                                                                                const uint8_t *uuid128)
+{
+    auto service = state.gatt_next_handle.find(start_handle);
+    if (service == state.gatt_next_handle.end()) return 0;
+    std::pair<uint16_t, std::vector<uint8_t>> key(start_handle, std::vector<uint8_t>(uuid128, uuid128 + 16));
+    auto it = state.gatt_characteristics.find(key);
+    if (it != state.gatt_characteristics.end()) return it->second;
+    if (service->second + 2 > end_handle) return 0;
+    uint16_t value_handle = (uint16_t)(service->second + 1);
+    service->second += 3;
+    state.gatt_characteristics[key] = value_handle;
+    return value_handle;
+}
+
+extern "C" uint16_t gatt_server_get_client_configuration_handle_for_characteristic_with_uuid128(
+    uint16_t start_handle, uint16_t end_handle, const uint8_t *uuid128)
+{
+    uint16_t value_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                                         uuid128);
+    return value_handle ? (uint16_t)(value_handle + 1) : 0;
+}
+
+extern "C" int gap_request_connection_parameter_update(hci_con_handle_t con_handle, uint16_t conn_interval_min,
+                                                       uint16_t conn_interval_max, uint16_t conn_latency,
+                                                       uint16_t supervision_timeout)
+{
+    state.stats.parameter_requests++;
+    if (!is_connected(con_handle)) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+
+    uint16_t result = conn_interval_max < state.central_min_interval ? 1 : 0;
+    if (result) {
+        state.stats.parameter_rejections++;
+    } else {
+        connection_update update;
+        update.con_handle = con_handle;
+        update.interval = std::max(conn_interval_min, state.central_min_interval);
+        update.latency = conn_latency;
+        update.timeout = supervision_timeout;
+        state.connection_updates.push_back(update);
+    }
+    state.l2cap_events.push_back({ L2CAP_EVENT_CONNECTION_PARAMETER_UPDATE_RESPONSE, 4,
+                                   (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8),
+                                   (uint8_t)(result & 0xff), (uint8_t)(result >> 8) });
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" uint8_t gap_le_set_phy(hci_con_handle_t con_handle, uint8_t all_phys, uint8_t tx_phys, uint8_t rx_phys,
+                                  uint8_t phy_options)
+{
+    UNUSED(all_phys);
+    UNUSED(phy_options);
+    if (!is_connected(con_handle)) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+
+    uint8_t tx_phy = (state.central_2m_phy && (tx_phys & 0x02)) ? 2 : 1;
+    uint8_t rx_phy = (state.central_2m_phy && (rx_phys & 0x02)) ? 2 : 1;
+    state.hci_events.push_back({ HCI_EVENT_LE_META, 6, HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE, 0x00,
+                                 (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8), tx_phy, rx_phy });
+    return ERROR_CODE_SUCCESS;
+}
+
+extern "C" void gap_advertisements_set_params(uint16_t adv_int_min, uint16_t adv_int_max, uint8_t adv_type,
+                                              uint8_t direct_address_typ, bd_addr_t direct_address, uint8_t channel_map,
+                                              uint8_t filter_policy)
+{
+    UNUSED(direct_address_typ);
+    (void)direct_address;
+    UNUSED(channel_map);
+    UNUSED(filter_policy);
+    state.stats.advertising_updates++;
+    state.stats.advertising_interval_min = adv_int_min;
+    state.stats.advertising_interval_max = adv_int_max;
+    state.stats.advertising_type = adv_type;
+}
+
+extern "C" void gap_advertisements_enable(int enabled)
+{
+    state.stats.advertising_enabled = (uint8_t)(enabled != 0);
+}
+
+extern "C" int sm_le_device_index(hci_con_handle_t con_handle)
+{
+    auto it = state.sm_device_index.find(con_handle);
+    return it == state.sm_device_index.end() ? -1 : it->second;
+}
+
+extern "C" int le_device_db_max_count(void)
+{
+    return device_db_size;
+}
+
+extern "C" void le_device_db_info(int index, int *addr_type, bd_addr_t addr, sm_key_t irk)
+{
+    if (index < 0 || index >= device_db_size) {
+        if (addr_type) *addr_type = BD_ADDR_TYPE_UNKNOWN;
+        return;
+    }
+    if (addr_type) *addr_type = device_db[index].addr_type;
+    if (addr) memcpy(addr, device_db[index].addr, sizeof(bd_addr_t));
+    if (irk) memset(irk, 0, sizeof(sm_key_t));
+}
+
+extern "C" void btstack_tlv_get_instance(const btstack_tlv_t **tlv, void **tlv_context)
+{
+    *tlv = state.tlv_instance ? state.tlv_instance : &tlv_impl;
+    *tlv_context = state.tlv_instance ? state.tlv_instance_context : nullptr;
+}
+
+extern "C" void btstack_tlv_set_instance(const btstack_tlv_t *tlv, void *tlv_context)
+{
+    state.tlv_instance = tlv;
+    state.tlv_instance_context = tlv_context;
+}
+
+extern "C" void le_device_db_tlv_configure(const btstack_tlv_t *tlv, void *tlv_context)
+{
+    // The mock's device DB is set directly (mock_le_device_db_set)
+    UNUSED(tlv);
+    UNUSED(tlv_context);
+}
+
+extern "C" void mock_tlv_set_write_us(uint32_t write_us)
+{
+    state.tlv_write_us = write_us;
+}
+
+extern "C" char *bd_addr_to_str(const bd_addr_t addr)
+{
+    static char buffer[18];
+    snprintf(buffer, sizeof(buffer), "%02X:%02X:%02X:%02X:%02X:%02X", addr[0], addr[1], addr[2], addr[3], addr[4],
+             addr[5]);
+    return buffer;
+}
+
+extern "C" void sm_add_event_handler(btstack_packet_callback_registration_t *callback_handler)
+{
+    state.sm_handlers.push_back(callback_handler->callback);
+}
+
+extern "C" void sm_just_works_confirm(hci_con_handle_t con_handle)
+{
+    UNUSED(con_handle);
+}
+
+extern "C" void sm_numeric_comparison_confirm(hci_con_handle_t con_handle)
+{
+    UNUSED(con_handle);
+}
+
+extern "C" void btstack_run_loop_set_timer(btstack_timer_source_t *ts, uint32_t timeout_in_ms)
+{
+    ts->timeout = btstack_run_loop_get_time_ms() + timeout_in_ms;
+}
+
+extern "C" void btstack_run_loop_add_timer(btstack_timer_source_t *ts)
+{
+    btstack_run_loop_remove_timer(ts);
+    state.timers.push_back(ts);
+}
+
+extern "C" int btstack_run_loop_remove_timer(btstack_timer_source_t *ts)
+{
+    auto it = std::find(state.timers.begin(), state.timers.end(), ts);
+    if (it == state.timers.end()) return 0;
+    state.timers.erase(it);
+    return 1;
+}
+
+extern "C" void btstack_run_loop_set_data_source_handler(btstack_data_source_t *data_source,
+                                                         void (*process)(btstack_data_source_t *data_source,
+                                                                         btstack_data_source_callback_type_t callback_type))
+{
+    data_source->process = process;
+}
+
+extern "C" void btstack_run_loop_enable_data_source_callbacks(btstack_data_source_t *data_source, uint16_t callbacks)
+{
+    data_source->flags |= callbacks;
+}
+
+extern "C" void btstack_run_loop_add_data_source(btstack_data_source_t *data_source)
+{
+    btstack_run_loop_remove_data_source(data_source);
+    state.data_sources.push_back(data_source);
+}
+
+extern "C" int btstack_run_loop_remove_data_source(btstack_data_source_t *data_source)
+{
+    auto it = std::find(state.data_sources.begin(), state.data_sources.end(), data_source);
+    if (it == state.data_sources.end()) return 0;
+    state.data_sources.erase(it);
+    return 1;
+}
+
+extern "C" void btstack_run_loop_poll_data_sources_from_irq(void)
+{
+    poll_data_sources_requested.store(true);
+}
+
+extern "C" uint32_t btstack_run_loop_get_time_ms(void)
+{
+    return (uint32_t)(state.now_us / 1000);
+}
+
+extern "C" uint32_t time_us_32(void)
+{
+    return (uint32_t)state.now_us;
+}
+
+extern "C" void hids_device_init(uint8_t hid_country_code, const uint8_t *hid_descriptor, uint16_t hid_descriptor_size)
+{
+    UNUSED(hid_country_code);
+    UNUSED(hid_descriptor);
+    UNUSED(hid_descriptor_size);
+}
+
+extern "C" void hids_device_init_with_storage(uint8_t hid_country_code, const uint8_t *hid_descriptor,
+                                              uint16_t hid_descriptor_size, uint16_t num_reports,
+                                              hids_device_report_t *report_storage)
+{
+    UNUSED(hid_country_code);
+    UNUSED(hid_descriptor);
+    UNUSED(hid_descriptor_size);
+    UNUSED(num_reports);
+    UNUSED(report_storage);
+}
+
+extern "C" void hids_device_register_packet_handler(btstack_packet_handler_t callback)
+{
+    state.hids_handler = callback;
+}
+
+extern "C" void hids_device_request_can_send_now_event(hci_con_handle_t con_handle)
+{
+    state.stats.can_send_now_requests++;
+    if (!is_connected(con_handle)) return;
+    state.can_send_now_pending.push_back({ con_handle, nullptr });
+}
+
+extern "C" uint8_t hids_device_send_input_report(hci_con_handle_t con_handle, const uint8_t *report, uint16_t report_len)
+{
+    // BTstack uses the first input report of the GATT database
+    return queue_notification(con_handle, 1, report, report_len);
+}
+
+extern "C" uint8_t hids_device_send_input_report_for_id(hci_con_handle_t con_handle, uint16_t report_id,
+                                                        const uint8_t *report, uint16_t report_len)
+{
+    return queue_notification(con_handle, (uint8_t)report_id, report, report_len);
+}
+
+extern "C" uint8_t hids_device_send_boot_keyboard_input_report(hci_con_handle_t con_handle, const uint8_t *report,
+                                                               uint16_t report_len)
+{
+    return queue_notification(con_handle, 0, report, report_len);
+}
+
+// Mock control
+
+extern "C" void mock_btstack_reset(void)
+{
+    state = mock_state();
+    poll_data_sources_requested.store(false);
+}
+
+extern "C" void mock_btstack_set_connection_interval_us(uint32_t interval_us)
+{
+    state.connection_interval_us = interval_us;
+    state.next_anchor_us = state.now_us + interval_us;
+}
+
+extern "C" void mock_btstack_set_controller_timing(uint32_t tx_setup_us, uint32_t completion_delay_us,
+                                                  int32_t clock_ppm)
+{
+    state.tx_setup_us = tx_setup_us;
+    state.completion_delay_us = completion_delay_us;
+    state.clock_ppm = clock_ppm;
+}
+
+extern "C" void mock_btstack_set_acl_buffers(uint8_t num_buffers)
+{
+    state.acl_buffers = num_buffers;
+}
+
+extern "C" void mock_btstack_set_packets_per_event(uint8_t num_packets)
+{
+    state.packets_per_event = num_packets;
+}
+
+extern "C" void mock_btstack_set_central_min_interval_us(uint32_t interval_us)
+{
+    state.central_min_interval = (uint16_t)((interval_us + 1249) / 1250);
+}
+
+extern "C" void mock_btstack_set_central_2m_phy(uint8_t supported)
+{
+    state.central_2m_phy = supported;
+}
+
+extern "C" void mock_btstack_set_att_mtu(uint16_t mtu)
+{
+    state.att_mtu = mtu;
+}
+
+extern "C" void mock_btstack_set_notification_handler(mock_notification_handler_t handler)
+{
+    state.notification_handler = handler;
+}
+
+extern "C" uint64_t mock_btstack_now_us(void)
+{
+    return state.now_us;
+}
+
+extern "C" void mock_btstack_run_pending(void)
+{
+    while (fire_next_timer()) {
+    }
+    deliver_events();
+    poll_data_sources();
+    deliver_can_send_now();
+}
+
+extern "C" void mock_btstack_advance_us(uint32_t delta_us)
+{
+    uint64_t target_us = state.now_us + delta_us;
+    mock_btstack_run_pending();
+    while (state.next_anchor_us <= target_us || state.alarm_us <= target_us || next_completion_us() <= target_us ||
+           state.usb_poll_us <= target_us) {
+        if (state.usb_poll_us < state.next_anchor_us && state.usb_poll_us < state.alarm_us &&
+            state.usb_poll_us < next_completion_us()) {
+            state.now_us = state.usb_poll_us;
+            mock_btstack_run_pending();
+            usb_poll();
+            mock_btstack_run_pending();
+            continue;
+        }
+        if (next_completion_us() < state.next_anchor_us && next_completion_us() <= state.alarm_us) {
+            state.now_us = next_completion_us();
+            std::vector<uint8_t> event = state.pending_completions.front().second;
+            state.pending_completions.pop_front();
+            mock_btstack_run_pending();
+            for (uint8_t i = 0; i < event[2]; i++) {
+                state.uncompleted -= little_endian_read_16(event.data(), 3 + 4 * i + 2);
+            }
+            emit(state.hci_handlers, event.data(), (uint16_t)event.size());
+            mock_btstack_run_pending();
+            continue;
+        }
+        if (state.alarm_us < state.next_anchor_us) {
+            // The alarm interrupt preempts whatever runs
+            state.now_us = state.alarm_us;
+            state.alarm_us = UINT64_MAX;
+            state.alarm_handler();
+            mock_btstack_run_pending();
+            continue;
+        }
+        state.now_us = state.next_anchor_us;
+        mock_btstack_run_pending();
+        apply_connection_updates();
+        // Past this anchor before the host sees the event: a flash write in
+        // its handlers runs into the following ones
+        advance_anchor();
+        connection_event();
+        deliver_can_send_now();
+    }
+    // A flash write may have run past the target
+    state.now_us = std::max(state.now_us, target_us);
+    mock_btstack_run_pending();
+}
+
+extern "C" void mock_hids_emit_input_report_enable(hci_con_handle_t con_handle, uint8_t report_id, uint8_t enable)
+{
+    if (enable && !is_connected(con_handle)) {
+        state.connections.push_back(con_handle);
+    }
+    uint8_t event[7] = { HCI_EVENT_HIDS_META, 5, HIDS_SUBEVENT_INPUT_REPORT_ENABLE,
+                         (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8), report_id, enable };
+    emit_hids(event, sizeof(event));
+}
+
+extern "C" void mock_hids_emit_protocol_mode(hci_con_handle_t con_handle, uint8_t protocol_mode)
+{
+    uint8_t event[6] = { HCI_EVENT_HIDS_META, 4, HIDS_SUBEVENT_PROTOCOL_MODE,
+                         (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8), protocol_mode };
+    emit_hids(event, sizeof(event));
+}
+
+extern "C" void mock_hids_emit_set_report(hci_con_handle_t con_handle, uint8_t report_id, uint8_t report_type,
+                                          const uint8_t *report, uint16_t report_len)
+{
+    std::vector<uint8_t> event = { HCI_EVENT_HIDS_META, (uint8_t)(6 + report_len), HIDS_SUBEVENT_SET_REPORT,
+                                   (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8), report_id, report_type,
+                                   (uint8_t)report_len };
+    event.insert(event.end(), report, report + report_len);
+    emit_hids(event.data(), (uint16_t)event.size());
+}
+
+extern "C" void mock_central_write_report(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                          uint16_t report_len)
+{
+    state.central_writes.push_back({ con_handle, report_id, std::vector<uint8_t>(report, report + report_len) });
+}
+
+extern "C" int mock_att_read(hci_con_handle_t con_handle, uint16_t attribute_handle, uint8_t *buffer,
+                             uint16_t buffer_size)
+{
+    att_service_handler_t *handler = att_service_for(attribute_handle);
+    if (!handler || !handler->read_callback || !is_connected(con_handle)) return -1;
+    int size = handler->read_callback(con_handle, attribute_handle, 0, buffer,
+                                      std::min<uint16_t>(buffer_size, state.att_mtu - 1));
+    mock_btstack_run_pending();
+    return size;
+}
+
+extern "C" uint8_t mock_att_write(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value,
+                                  uint16_t value_len)
+{
+    att_service_handler_t *handler = att_service_for(attribute_handle);
+    if (!handler || !handler->write_callback) return ATT_ERROR_WRITE_NOT_PERMITTED;
+    if (!is_connected(con_handle)) return ATT_ERROR_UNLIKELY_ERROR;
+    std::vector<uint8_t> data(value, value + value_len);
+    int status = handler->write_callback(con_handle, attribute_handle, ATT_TRANSACTION_MODE_NONE, 0, data.data(),
+                                         value_len);
+    mock_btstack_run_pending();
+    return (uint8_t)status;
+}
+
+extern "C" void mock_att_set_notification_handler(mock_att_notification_handler_t handler)
+{
+    state.att_notification_handler = handler;
+}
+
+extern "C" void mock_rumble_motors_set_handler(mock_motor_handler_t handler)
+{
+    state.motor_handler = handler;
+}
+
+// Rumble motors: the PWM outputs and the hardware alarm on the virtual clock
+void rumble_motors_init(void (*handler)(void))
+{
+    state.alarm_handler = handler;
+    state.alarm_us = UINT64_MAX;
+}
+
+void rumble_motors_set(uint8_t strong, uint8_t weak)
+{
+    if (state.motor_handler) {
+        state.motor_handler(strong, weak, state.now_us);
+    }
+}
+
+void rumble_motors_alarm_at(uint32_t target_us)
+{
+    int32_t delta_us = (int32_t)(target_us - time_us_32());
+    if (delta_us > 0) {
+        state.alarm_us = state.now_us + (uint32_t)delta_us;
+        return;
+    }
+    // Already due: the interrupt is taken at once
+    state.alarm_us = UINT64_MAX;
+    state.alarm_handler();
+}
+
+extern "C" void mock_usb_set_report_handler(mock_usb_report_handler_t handler)
+{
+    state.usb_report_handler = handler;
+}
+
+extern "C" void mock_usb_set_attached(uint8_t attached)
+{
+    bool ready = attached != 0;
+    if (ready == state.usb_ready) return;
+    state.usb_ready = ready;
+    // A report the host did not poll is lost with it
+    state.usb_pending = false;
+    state.usb_poll_us = UINT64_MAX;
+    if (state.usb_handlers) {
+        state.usb_handlers->changed(ready);
+    }
+    mock_btstack_run_pending();
+}
+
+extern "C" void mock_usb_write_report(uint8_t report_id, const uint8_t *report, uint16_t report_len)
+{
+    if (!state.usb_ready || !state.usb_handlers) return;
+    state.usb_handlers->output(report_id, report, report_len);
+    mock_btstack_run_pending();
+}
+
+// USB device: the virtual host from mock_usb_set_attached()
+void usb_device_init(void)
+{
+}
+
+void usb_device_start(void)
+{
+}
+
+void usb_device_set_handlers(const usb_device_handlers_t *handlers)
+{
+    state.usb_handlers = handlers;
+}
+
+bool usb_device_ready(void)
+{
+    return state.usb_ready;
+}
+
+bool usb_device_send(uint8_t report_id, const uint8_t *report, uint16_t report_len)
+{
+    if (!state.usb_ready || state.usb_pending) return false;
+    state.usb_pending = true;
+    state.usb_report_id = report_id;
+    state.usb_report.assign(report, report + report_len);
+    state.usb_queued_us = state.now_us;
+    uint64_t poll_period_us = (uint64_t)USB_HID_POLL_INTERVAL_MS * 1000;
+    state.usb_poll_us = (state.now_us / poll_period_us + 1) * poll_period_us;
+    return true;
+}
+
+extern "C" void mock_imu_push_sample(const imu_sample_t *sample)
+{
+    state.imu_samples.push_back(*sample);
+    state.imu_stats.samples++;
+    poll_data_sources_requested.store(true);
+}
+
+extern "C" void mock_battery_set_mv(uint16_t mv)
+{
+    state.vsys_mv = mv;
+}
+
+// VSYS: what mock_battery_set_mv() set, converted at once
+bool battery_adc_read_mv(uint16_t *mv)
+{
+    if (!state.vsys_mv) return false;
+    *mv = state.vsys_mv;
+    return true;
+}
+
+extern "C" void battery_service_server_init(uint8_t battery_value)
+{
+    state.stats.battery_level = battery_value;
+}
+
+extern "C" void battery_service_server_set_battery_value(uint8_t battery_value)
+{
+    state.stats.battery_updates++;
+    state.stats.battery_level = battery_value;
+}
+
+// Analog sampler: only whether flash writes pause it
+void analog_sampler_pause(void)
+{
+    state.analog_paused = true;
+}
+
+void analog_sampler_resume(void)
+{
+    state.analog_paused = false;
+}
+
+// IMU sampler: samples come from mock_imu_push_sample()
+bool imu_sampler_start(void)
+{
+    return true;
+}
+
+bool imu_sampler_pop(imu_sample_t *sample)
+{
+    if (state.imu_samples.empty()) return false;
+    *sample = state.imu_samples.front();
+    state.imu_samples.pop_front();
+    return true;
+}
+
+const imu_sampler_stats_t *imu_sampler_get_stats(void)
+{
+    return &state.imu_stats;
+}
+
+extern "C" void mock_hci_emit_state(uint8_t hci_state)
+{
+    uint8_t event[3] = { BTSTACK_EVENT_STATE, 1, hci_state };
+    emit(state.hci_handlers, event, sizeof(event));
+}
+
+extern "C" void mock_hci_emit_command_complete(uint16_t opcode)
+{
+    uint8_t event[6] = { HCI_EVENT_COMMAND_COMPLETE, 4, 1, (uint8_t)(opcode & 0xff), (uint8_t)(opcode >> 8),
+                         ERROR_CODE_SUCCESS };
+    emit(state.hci_handlers, event, sizeof(event));
+}
+
+extern "C" void mock_hci_emit_disconnection_complete(hci_con_handle_t con_handle)
+{
+    state.connections.erase(std::remove(state.connections.begin(), state.connections.end(), con_handle),
+                            state.connections.end());
+    state.can_send_now_pending.erase(std::remove_if(state.can_send_now_pending.begin(),
+                                                    state.can_send_now_pending.end(),
+                                                    [&](const can_send_request &request) {
+                                                        return request.con_handle == con_handle;
+                                                    }),
+                                     state.can_send_now_pending.end());
+    uint8_t event[6] = { HCI_EVENT_DISCONNECTION_COMPLETE, 4, 0x00,
+                         (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8), 0x13 };
+    emit(state.hci_handlers, event, sizeof(event));
+}
+
+extern "C" void mock_hci_emit_le_connection_complete(hci_con_handle_t con_handle, uint8_t status)
+{
+    if (status == ERROR_CODE_SUCCESS && !is_connected(con_handle)) {
+        state.connections.push_back(con_handle);
+    }
+    uint16_t interval = (uint16_t)(state.connection_interval_us / 1250);
+    uint8_t event[21] = { HCI_EVENT_LE_META, 19, HCI_SUBEVENT_LE_CONNECTION_COMPLETE, status,
+                          (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8), 0x01, 0x00 };
+    event[14] = (uint8_t)(interval & 0xff);
+    event[15] = (uint8_t)(interval >> 8);
+    event[18] = 200;    // Supervision timeout, 2 s
+    emit(state.hci_handlers, event, sizeof(event));
+}
+
+extern "C" void mock_hci_emit_encryption_change(hci_con_handle_t con_handle)
+{
+    uint8_t event[6] = { HCI_EVENT_ENCRYPTION_CHANGE, 4, 0x00,
+                         (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8), 0x01 };
+    emit(state.hci_handlers, event, sizeof(event));
+}
+
+extern "C" void mock_sm_emit_pairing_complete(hci_con_handle_t con_handle)
+{
+    uint8_t event[13] = { SM_EVENT_PAIRING_COMPLETE, 11, (uint8_t)(con_handle & 0xff), (uint8_t)(con_handle >> 8) };
+    emit(state.sm_handlers, event, sizeof(event));
+}
+
+extern "C" void mock_le_device_db_set(int index, int addr_type, const bd_addr_t addr)
+{
+    if (index < 0 || index >= device_db_size) return;
+    device_db[index].addr_type = addr_type;
+    memcpy(device_db[index].addr, addr, sizeof(bd_addr_t));
+}
+
+extern "C" void mock_sm_set_device_index(hci_con_handle_t con_handle, int index)
+{
+    state.sm_device_index[con_handle] = index;
+}
+
+extern "C" const mock_btstack_stats_t *mock_btstack_get_stats(void)
+{
+    return &state.stats;
+}
@@ -0,0 +1,158 @@
+// *****************************************************************************
+// Control interface of the host BTstack mock
+//
+// The mock runs on a virtual microsecond clock. A virtual controller owns a
+// small pool of ACL buffers: hids_device_send_input_report() occupies one,
+// and at every connection event anchor queued notifications go on air and
+// free their buffers, reported by HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS. CAN_SEND_NOW is granted as soon as a buffer is free,
+// which matches how att_server paces HIDS notifications on real hardware.
+// A virtual central answers connection parameter, PHY and data length
+// requests; accepted intervals take effect at the next connection event.
+// Every connection has the same ATT MTU, as if the central had exchanged it
+// right after connecting.
+// With peripheral latency the peripheral skips anchors that have nothing
+// queued, up to the latency in a row, and counts them in events_skipped.
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_H
+#define BTSTACK_MOCK_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+#include "imu_sampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Called when a queued notification is transmitted at a connection event.
+// report_id is 0 for boot keyboard reports.
+typedef void (*mock_notification_handler_t)(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                                            uint16_t report_len, uint64_t queued_us, uint64_t air_us);
+
+typedef struct {
+    uint32_t can_send_now_requests;  // hids_device and att_server CAN_SEND_NOW requests
+    uint32_t can_send_now_events;    // HIDS_SUBEVENT_CAN_SEND_NOW and att_server callbacks delivered
+    uint32_t can_send_now_duplicates; // att_server registrations refused: already queued
+    uint32_t notifications_queued;   // hids_device_send_*_input_report() calls
+    uint32_t notifications_sent;     // notifications that went on air
+    uint32_t connection_events;      // anchors passed while connected
+    uint32_t events_skipped;         // anchors the peripheral slept through (peripheral latency)
+    uint32_t parameter_requests;     // gap_request_connection_parameter_update() calls
+    uint32_t parameter_rejections;   // requests the virtual central refused
+    uint64_t handler_ns;             // wall time spent inside CAN_SEND_NOW handlers
+    uint32_t advertising_updates;    // gap_advertisements_set_params() calls
+    uint16_t advertising_interval_min;  // Current advertising interval (0.625 ms units)
+    uint16_t advertising_interval_max;
+    uint8_t advertising_type;        // 0 = undirected, 1 = directed high duty cycle
+    uint8_t advertising_enabled;
+    uint32_t tlv_stores;             // btstack_tlv store_tag() calls
+    uint32_t tlv_writes_sampling;    // TLV stores and deletes with the analog sampler not paused
+    uint32_t usb_reports;            // HID input reports the virtual USB host polled
+    uint32_t att_notifications_sent; // att_server_notify() notifications that went on air
+    uint32_t battery_updates;        // battery_service_server_set_battery_value() calls
+    uint8_t battery_level;           // Battery Service value
+} mock_btstack_stats_t;
+
+// Reset clock, timers, handlers, controller state and statistics
+void mock_btstack_reset(void);
+
+// Virtual controller configuration (defaults: 7500 us, 3 buffers, 4 packets per event)
+void mock_btstack_set_connection_interval_us(uint32_t interval_us);
+void mock_btstack_set_acl_buffers(uint8_t num_buffers);
+void mock_btstack_set_packets_per_event(uint8_t num_packets);
+
+// Controller timing (defaults all 0): notifications queued less than
+// tx_setup_us before an anchor go at the next one, completions are reported
+// completion_delay_us after the event, and anchors drift by clock_ppm
+// against the virtual clock
+void mock_btstack_set_controller_timing(uint32_t tx_setup_us, uint32_t completion_delay_us, int32_t clock_ppm);
+
+// Virtual central: shortest interval it accepts in a connection parameter
+// update request (default 7500 us), and whether it supports the LE 2M PHY
+void mock_btstack_set_central_min_interval_us(uint32_t interval_us);
+void mock_btstack_set_central_2m_phy(uint8_t supported);
+
+// ATT MTU of every connection (default 247)
+void mock_btstack_set_att_mtu(uint16_t mtu);
+
+void mock_btstack_set_notification_handler(mock_notification_handler_t handler);
+
+// Virtual time
+uint64_t mock_btstack_now_us(void);
+
+// Advance virtual time, firing timers, connection events and pending events
+void mock_btstack_advance_us(uint32_t delta_us);
+
+// Deliver events that are due at the current virtual time
+void mock_btstack_run_pending(void);
+
+// Inject events towards the registered packet handlers
+void mock_hids_emit_input_report_enable(hci_con_handle_t con_handle, uint8_t report_id, uint8_t enable);
+void mock_hids_emit_protocol_mode(hci_con_handle_t con_handle, uint8_t protocol_mode);
+void mock_hids_emit_set_report(hci_con_handle_t con_handle, uint8_t report_id, uint8_t report_type,
+                               const uint8_t *report, uint16_t report_len);
+void mock_hci_emit_state(uint8_t hci_state);
+void mock_hci_emit_command_complete(uint16_t opcode);
+void mock_hci_emit_disconnection_complete(hci_con_handle_t con_handle);
+void mock_hci_emit_le_connection_complete(hci_con_handle_t con_handle, uint8_t status);
+void mock_hci_emit_encryption_change(hci_con_handle_t con_handle);
+void mock_sm_emit_pairing_complete(hci_con_handle_t con_handle);
+
+// Virtual central writes an output report; it reaches the peripheral (as
+// HIDS_SUBEVENT_SET_REPORT) at the next connection event it listens to
+void mock_central_write_report(hci_con_handle_t con_handle, uint8_t report_id, const uint8_t *report,
+                               uint16_t report_len);
+
+// Virtual central as ATT client of the services registered with
+// att_server_register_service_handler(), using the handles the GATT
+// lookups gave out. Reads and writes are served at once; a read returns the
+// value length or -1, a write the ATT error code (0 = success).
+// Notifications (att_server_notify()) take an ACL buffer like HIDS reports
+// and reach the handler when they go on air.
+typedef void (*mock_att_notification_handler_t)(hci_con_handle_t con_handle, uint16_t attribute_handle,
+                                                const uint8_t *value, uint16_t value_len, uint64_t air_us);
+int mock_att_read(hci_con_handle_t con_handle, uint16_t attribute_handle, uint8_t *buffer, uint16_t buffer_size);
+uint8_t mock_att_write(hci_con_handle_t con_handle, uint16_t attribute_handle, const uint8_t *value,
+                       uint16_t value_len);
+void mock_att_set_notification_handler(mock_att_notification_handler_t handler);
+
+// Rumble motors (rumble_motors.h): called whenever the firmware sets them.
+// Their alarm runs on the virtual clock, preempting the run loop.
+typedef void (*mock_motor_handler_t)(uint8_t strong, uint8_t weak, uint64_t now_us);
+void mock_rumble_motors_set_handler(mock_motor_handler_t handler);
+
+// IMU (imu_sampler.h): queue a sample as if its DMA read had just completed;
+// the firmware takes it from the run loop like on hardware
+void mock_imu_push_sample(const imu_sample_t *sample);
+
+// USB device (usb_device.h): a virtual host configures the device (or is
+// unplugged), polls the HID IN endpoint at every USB_HID_POLL_INTERVAL_MS
+// frame start and writes output reports, which arrive at once
+typedef void (*mock_usb_report_handler_t)(uint8_t report_id, const uint8_t *report, uint16_t report_len,
+                                          uint64_t queued_us, uint64_t poll_us);
+void mock_usb_set_report_handler(mock_usb_report_handler_t handler);
+void mock_usb_set_attached(uint8_t attached);
+void mock_usb_write_report(uint8_t report_id, const uint8_t *report, uint16_t report_len);
+
+// Battery (battery_adc.h): VSYS as the next reading will see it (default
+// 4000 mV); 0 makes readings fail
+void mock_battery_set_mv(uint16_t mv);
+
+// Flash: every TLV store or delete holds both cores for write_us (default
+// 0); the controller keeps running its connection events meanwhile
+void mock_tlv_set_write_us(uint32_t write_us);
+
+// Bonds: LE device DB entries and the entry SM found for a connection.
+// Like the TLV store, the device DB survives mock_btstack_reset().
+void mock_le_device_db_set(int index, int addr_type, const bd_addr_t addr);
+void mock_sm_set_device_index(hci_con_handle_t con_handle, int index);
+
+const mock_btstack_stats_t *mock_btstack_get_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSTACK_MOCK_H
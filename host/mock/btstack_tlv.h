@@ -0,0 +1,28 @@
+// *****************************************************************************
+// Host mock of btstack_tlv.h: tag-value storage kept in memory; like flash
+// it survives mock_btstack_reset()
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_BTSTACK_TLV_H
+#define BTSTACK_MOCK_BTSTACK_TLV_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int (*get_tag)(void *context, uint32_t tag, uint8_t *buffer, uint32_t buffer_size);
+    int (*store_tag)(void *context, uint32_t tag, const uint8_t *data, uint32_t data_size);
+    void (*delete_tag)(void *context, uint32_t tag);
+} btstack_tlv_t;
+
+void btstack_tlv_get_instance(const btstack_tlv_t **tlv_impl, void **tlv_context);
+void btstack_tlv_set_instance(const btstack_tlv_t *tlv_impl, void *tlv_context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSTACK_MOCK_BTSTACK_TLV_H
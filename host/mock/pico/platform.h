@@ -0,0 +1,13 @@
+// *****************************************************************************
+// Host mock of pico/platform.h: everything runs as core 0
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_PICO_PLATFORM_H
+#define BTSTACK_MOCK_PICO_PLATFORM_H
+
+static inline unsigned int get_core_num(void)
+{
+    return 0;
+}
+
+#endif // BTSTACK_MOCK_PICO_PLATFORM_H
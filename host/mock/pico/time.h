@@ -0,0 +1,21 @@
+// *****************************************************************************
+// Host mock of pico/time.h: the microsecond timer follows the mock's
+// virtual clock
+// *****************************************************************************
+
+#ifndef BTSTACK_MOCK_PICO_TIME_H
+#define BTSTACK_MOCK_PICO_TIME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t time_us_32(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BTSTACK_MOCK_PICO_TIME_H
@@ -0,0 +1,169 @@
+// *****************************************************************************
+// IMU orientation fusion
+// *****************************************************************************
+
+#include "imu_fusion.h"
+
+#define Q30_ONE ((int32_t)1 << 30)
+
+// pi in Q29
+#define PI_Q29 1686629713ll
+
+// Accelerometer magnitudes within this band, in 1/8 g, are taken as gravity
+#define GRAVITY_MIN_EIGHTHS 6
+#define GRAVITY_MAX_EIGHTHS 10
+
+// Corrections paused after a sample outside that band
+#define SHAKE_HOLDOFF_US 200000
+
+static uint32_t isqrt32(uint32_t value)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1u << 30;
+    while (bit > value) bit >>= 2;
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+static inline int32_t mul_q30(int32_t a, int32_t b)
+{
+    return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+// One Newton step towards unit length; enough when the quaternion is
+// already close to it, as after every gyro step
+static void normalize(int32_t *q)
+{
+    int64_t length_sq = 0;
+    for (int i = 0; i < 4; i++) {
+        length_sq += (int64_t)q[i] * q[i];
+    }
+    int64_t factor = (3 * (int64_t)Q30_ONE - (length_sq >> 30)) / 2;
+    for (int i = 0; i < 4; i++) {
+        q[i] = (int32_t)(((int64_t)q[i] * factor) >> 30);
+    }
+}
+
+// Shortest rotation taking the world's up to the measured one (Q14 unit
+// vector in sensor axes), no yaw
+static void align(imu_fusion_t *fusion, const int32_t *up)
+{
+    int32_t *q = fusion->q;
+    if (up[2] < -16000) {
+        // Upside down: half a turn about x
+        q[0] = 0;
+        q[1] = Q30_ONE;
+        q[2] = 0;
+        q[3] = 0;
+    } else {
+        // w = sqrt((1 + z) / 2), x = y / (2 w), y = -x / (2 w)
+        int32_t w_q15 = (int32_t)isqrt32((uint32_t)(16384 + up[2]) << 15);
+        q[0] = w_q15 << 15;
+        q[1] = (int32_t)(((int64_t)up[1] << 30) / w_q15);
+        q[2] = (int32_t)(((int64_t)-up[0] << 30) / w_q15);
+        q[3] = 0;
+    }
+    for (int i = 0; i < 3; i++) {
+        normalize(q);
+    }
+    fusion->aligned = true;
+}
+
+void imu_fusion_init(imu_fusion_t *fusion, uint32_t gyro_range_dps, uint32_t accel_range_g, uint32_t kp_milli)
+{
+    fusion->q[0] = Q30_ONE;
+    fusion->q[1] = 0;
+    fusion->q[2] = 0;
+    fusion->q[3] = 0;
+    fusion->aligned = false;
+
+    // Full scale is 32768 counts; half of rate * 1e-6 s, in Q48 radians
+    int64_t denominator = 180ll * 32768 * 2 * 1000000;
+    fusion->gyro_scale = ((int64_t)gyro_range_dps * PI_Q29 * (1 << 19) + denominator / 2) / denominator;
+
+    // Half of kp * error * 1e-6 s; a Q14 error unit is 2^-14 radians
+    fusion->kp_scale = (int64_t)kp_milli * ((int64_t)1 << 40) / 2000000000ll;
+
+    uint32_t one_g = 32768 / accel_range_g;
+    fusion->gravity_min_sq = (one_g * GRAVITY_MIN_EIGHTHS / 8) * (one_g * GRAVITY_MIN_EIGHTHS / 8);
+    fusion->gravity_max_sq = (one_g * GRAVITY_MAX_EIGHTHS / 8) * (one_g * GRAVITY_MAX_EIGHTHS / 8);
+    fusion->shaken_us = 0;
+    fusion->updates = 0;
+    fusion->corrections = 0;
+}
+
+void imu_fusion_update(imu_fusion_t *fusion, const int16_t *gyro, const int16_t *accel, uint32_t dt_us)
+{
+    int32_t *q = fusion->q;
+    fusion->updates++;
+
+    // Half the angle turned about each axis during dt, Q30 radians
+    int32_t half[3];
+    for (int axis = 0; axis < 3; axis++) {
+        half[axis] = (int32_t)(((int64_t)gyro[axis] * fusion->gyro_scale * dt_us) >> 18);
+    }
+
+    uint32_t accel_sq = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        accel_sq += (uint32_t)((int32_t)accel[axis] * accel[axis]);
+    }
+    bool gravity = accel_sq >= fusion->gravity_min_sq && accel_sq <= fusion->gravity_max_sq;
+    if (!gravity) {
+        fusion->shaken_us = SHAKE_HOLDOFF_US;
+    } else if (fusion->shaken_us) {
+        fusion->shaken_us = dt_us < fusion->shaken_us ? fusion->shaken_us - dt_us : 0;
+        gravity = !fusion->aligned;
+    }
+    if (gravity) {
+        int32_t magnitude = (int32_t)isqrt32(accel_sq);
+        int32_t up[3];
+        for (int axis = 0; axis < 3; axis++) {
+            up[axis] = ((int32_t)accel[axis] << 14) / magnitude;
+        }
+        if (!fusion->aligned) {
+            align(fusion, up);
+            return;
+        }
+
+        // Up as the quaternion sees it, Q14
+        int32_t estimated[3];
+        estimated[0] = (int32_t)(((int64_t)q[1] * q[3] - (int64_t)q[0] * q[2]) >> 45);
+        estimated[1] = (int32_t)(((int64_t)q[0] * q[1] + (int64_t)q[2] * q[3]) >> 45);
+        estimated[2] = (int32_t)(((int64_t)q[0] * q[0] - (int64_t)q[1] * q[1] - (int64_t)q[2] * q[2] +
+                                  (int64_t)q[3] * q[3]) >> 46);
+
+        // Error: the rotation axis from estimated to measured, Q14
+        int32_t error[3];
+        error[0] = (up[1] * estimated[2] - up[2] * estimated[1]) >> 14;
+        error[1] = (up[2] * estimated[0] - up[0] * estimated[2]) >> 14;
+        error[2] = (up[0] * estimated[1] - up[1] * estimated[0]) >> 14;
+        for (int axis = 0; axis < 3; axis++) {
+            half[axis] += (int32_t)(((int64_t)error[axis] * fusion->kp_scale * dt_us) >> 24);
+        }
+        fusion->corrections++;
+    }
+
+    // q += q * (0, half)
+    int32_t w = q[0], x = q[1], y = q[2], z = q[3];
+    q[0] = w - mul_q30(x, half[0]) - mul_q30(y, half[1]) - mul_q30(z, half[2]);
+    q[1] = x + mul_q30(w, half[0]) + mul_q30(y, half[2]) - mul_q30(z, half[1]);
+    q[2] = y + mul_q30(w, half[1]) - mul_q30(x, half[2]) + mul_q30(z, half[0]);
+    q[3] = z + mul_q30(w, half[2]) + mul_q30(x, half[1]) - mul_q30(y, half[0]);
+    normalize(q);
+}
+
+void imu_fusion_orientation(const imu_fusion_t *fusion, int16_t *q14)
+{
+    for (int i = 0; i < 4; i++) {
+        int32_t value = (fusion->q[i] + (1 << 15)) >> 16;
+        q14[i] = (int16_t)(value > 32767 ? 32767 : value);
+    }
+}
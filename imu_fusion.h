@@ -0,0 +1,45 @@
+// *****************************************************************************
+// IMU orientation fusion
+//
+// Mahony-style complementary filter in fixed point. The gyro rates are
+// integrated into a Q30 unit quaternion every sample; while the measured
+// acceleration is close to 1 g it is taken as the gravity direction and the
+// cross product with the estimated one turns the quaternion towards it at
+// kp_milli / 1000 rad/s per radian of error. A sample outside that band
+// marks the pad as shaken, and no sample corrects for the next 200 ms: in a
+// shake the few samples that pass through 1 g point anywhere. The first
+// usable sample sets the tilt directly. Without a magnetometer nothing
+// corrects yaw, which drifts with the gyro bias.
+//
+// Pure integer code (32x32->64 multiplies, one 32-bit square root and three
+// 32-bit divides per corrected sample) with no hardware access, so it runs
+// on the host against recorded samples.
+// *****************************************************************************
+
+#ifndef IMU_FUSION_H
+#define IMU_FUSION_H
+
+#include <stdint.h>
+
+typedef struct {
+    int32_t q[4];              // w x y z, Q30 unit quaternion (sensor to world)
+    bool aligned;              // Tilt set from the first usable gravity sample
+    int64_t gyro_scale;        // Half angle per gyro count and us, Q48 radians
+    int64_t kp_scale;          // Correction half angle per Q14 error and us, Q54 radians
+    uint32_t gravity_min_sq;   // Squared accelerometer magnitudes taken as gravity
+    uint32_t gravity_max_sq;
+    uint32_t shaken_us;        // Left of the hold-off after a sample off 1 g
+    uint32_t updates;
+    uint32_t corrections;      // Updates pulled towards gravity
+} imu_fusion_t;
+
+// Identity orientation; full scales as configured on the IMU
+void imu_fusion_init(imu_fusion_t *fusion, uint32_t gyro_range_dps, uint32_t accel_range_g, uint32_t kp_milli);
+
+// One sample, dt_us after the previous one
+void imu_fusion_update(imu_fusion_t *fusion, const int16_t *gyro, const int16_t *accel, uint32_t dt_us);
+
+// Orientation as w x y z, 16384 = 1.0
+void imu_fusion_orientation(const imu_fusion_t *fusion, int16_t *q14);
+
+#endif // IMU_FUSION_H
@@ -0,0 +1,233 @@
+// *****************************************************************************
+// IMU sampler (RP2040)
+// *****************************************************************************
+
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+
+#include "btstack.h"
+#include "gamepad_config.h"
+#include "imu_sampler.h"
+#include "input_ring.h"
+
+#define IMU_I2C          i2c0
+// Core0 takes this one; DMA_IRQ_1 belongs to core1 (analog_sampler.cpp).
+// A DMA IRQ line enabled on both cores runs every shared handler on both.
+#define IMU_DMA_IRQ      0
+#define IMU_RING_SIZE    32
+#define IMU_READ_BYTES   12
+
+// A read still running this long after it started is not coming back
+#define IMU_READ_TIMEOUT_US 5000
+
+// LSM6DS3, LSM6DS3TR-C and LSM6DSO share these registers
+#define LSM6_DRDY_PULSE_CFG 0x0B
+#define LSM6_INT1_CTRL      0x0D
+#define LSM6_WHO_AM_I       0x0F
+#define LSM6_CTRL1_XL       0x10
+#define LSM6_CTRL2_G        0x11
+#define LSM6_CTRL3_C        0x12
+#define LSM6_OUTX_L_G       0x22
+
+static constexpr uint8_t lsm6_odr(uint32_t hz)
+{
+    return hz == 104 ? 0x4 : hz == 208 ? 0x5 : hz == 416 ? 0x6 : hz == 833 ? 0x7 : 0xFF;
+}
+
+static constexpr uint8_t lsm6_gyro_scale(uint32_t dps)
+{
+    return dps == 250 ? 0x0 : dps == 500 ? 0x1 : dps == 1000 ? 0x2 : dps == 2000 ? 0x3 : 0xFF;
+}
+
+static constexpr uint8_t lsm6_accel_scale(uint32_t g)
+{
+    return g == 2 ? 0x0 : g == 16 ? 0x1 : g == 4 ? 0x2 : g == 8 ? 0x3 : 0xFF;
+}
+
+static_assert(lsm6_odr(IMU_SAMPLE_HZ) != 0xFF, "IMU_SAMPLE_HZ must be 104, 208, 416 or 833");
+static_assert(lsm6_gyro_scale(IMU_GYRO_RANGE_DPS) != 0xFF, "IMU_GYRO_RANGE_DPS must be 250, 500, 1000 or 2000");
+static_assert(lsm6_accel_scale(IMU_ACCEL_RANGE_G) != 0xFF, "IMU_ACCEL_RANGE_G must be 2, 4, 8 or 16");
+
+// Register address, then a read command per byte: DMA feeds these to the
+// I2C data/command register while a second channel collects the bytes
+static uint32_t read_commands[1 + IMU_READ_BYTES];
+static uint8_t read_buffer[IMU_READ_BYTES];
+static int tx_channel = -1;
+static int rx_channel = -1;
+
+// Interrupts only
+static bool reading;
+static uint32_t sample_us;
+
+static spsc_ring<imu_sample_t, IMU_RING_SIZE> samples;
+static imu_sampler_stats_t stats;
+
+static bool imu_write_register(uint8_t reg, uint8_t value)
+{
+    uint8_t data[2] = {reg, value};
+    return i2c_write_blocking(IMU_I2C, IMU_I2C_ADDRESS, data, 2, false) == 2;
+}
+
+static bool imu_read_register(uint8_t reg, uint8_t *value)
+{
+    if (i2c_write_blocking(IMU_I2C, IMU_I2C_ADDRESS, &reg, 1, true) != 1) return false;
+    return i2c_read_blocking(IMU_I2C, IMU_I2C_ADDRESS, value, 1, false) == 1;
+}
+
+static void imu_start_read(void)
+{
+    dma_channel_transfer_to_buffer_now(rx_channel, read_buffer, IMU_READ_BYTES);
+    dma_channel_transfer_from_buffer_now(tx_channel, read_commands, 1 + IMU_READ_BYTES);
+}
+
+// Give up on a read the IMU did not answer (NACK, bus stuck)
+static void imu_abort_read(void)
+{
+    // Aborting can raise the completion interrupt (RP2040-E13)
+    dma_irqn_set_channel_enabled(IMU_DMA_IRQ, rx_channel, false);
+    dma_channel_abort(tx_channel);
+    dma_channel_abort(rx_channel);
+    dma_irqn_acknowledge_channel(IMU_DMA_IRQ, rx_channel);
+    dma_irqn_set_channel_enabled(IMU_DMA_IRQ, rx_channel, true);
+
+    i2c_hw_t *hw = i2c_get_hw(IMU_I2C);
+    (void)hw->clr_tx_abrt;
+    while (i2c_get_read_available(IMU_I2C)) {
+        (void)hw->data_cmd;
+    }
+}
+
+static void imu_data_ready_irq(void)
+{
+    if (!(gpio_get_irq_event_mask(IMU_INT_GPIO) & GPIO_IRQ_EDGE_RISE)) return;
+    gpio_acknowledge_irq(IMU_INT_GPIO, GPIO_IRQ_EDGE_RISE);
+
+    uint32_t now_us = time_us_32();
+    if (reading) {
+        stats.overruns++;
+        if (now_us - sample_us < IMU_READ_TIMEOUT_US) return;
+        imu_abort_read();
+        stats.bus_errors++;
+    }
+    sample_us = now_us;
+    reading = true;
+    imu_start_read();
+}
+
+static inline int16_t imu_le16(const uint8_t *data)
+{
+    return (int16_t)(data[0] | (data[1] << 8));
+}
+
+static void imu_dma_irq(void)
+{
+    if (!dma_irqn_get_channel_status(IMU_DMA_IRQ, rx_channel)) return;
+    dma_irqn_acknowledge_channel(IMU_DMA_IRQ, rx_channel);
+    reading = false;
+
+    imu_sample_t sample;
+    sample.timestamp_us = sample_us;
+    for (int axis = 0; axis < 3; axis++) {
+        sample.gyro[axis] = imu_le16(&read_buffer[2 * axis]);
+        sample.accel[axis] = imu_le16(&read_buffer[6 + 2 * axis]);
+    }
+    if (!samples.push(sample)) {
+        stats.dropped++;
+        return;
+    }
+    stats.samples++;
+    btstack_run_loop_poll_data_sources_from_irq();
+}
+
+static void imu_dma_init(void)
+{
+    i2c_hw_t *hw = i2c_get_hw(IMU_I2C);
+
+    // Gyro x y z then accel x y z, one burst from OUTX_L_G
+    read_commands[0] = LSM6_OUTX_L_G;
+    for (int i = 1; i <= IMU_READ_BYTES; i++) {
+        read_commands[i] = I2C_IC_DATA_CMD_CMD_BITS;
+    }
+    read_commands[1] |= I2C_IC_DATA_CMD_RESTART_BITS;
+    read_commands[IMU_READ_BYTES] |= I2C_IC_DATA_CMD_STOP_BITS;
+
+    tx_channel = dma_claim_unused_channel(true);
+    dma_channel_config config = dma_channel_get_default_config(tx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_dreq(&config, i2c_get_dreq(IMU_I2C, true));
+    dma_channel_configure(tx_channel, &config, &hw->data_cmd, read_commands, 1 + IMU_READ_BYTES, false);
+
+    rx_channel = dma_claim_unused_channel(true);
+    config = dma_channel_get_default_config(rx_channel);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, false);
+    channel_config_set_write_increment(&config, true);
+    channel_config_set_dreq(&config, i2c_get_dreq(IMU_I2C, false));
+    dma_channel_configure(rx_channel, &config, read_buffer, &hw->data_cmd, IMU_READ_BYTES, false);
+
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+
+    dma_irqn_set_channel_enabled(IMU_DMA_IRQ, rx_channel, true);
+    irq_add_shared_handler(dma_get_irq_num(IMU_DMA_IRQ), imu_dma_irq, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(dma_get_irq_num(IMU_DMA_IRQ), true);
+}
+
+bool imu_sampler_start(void)
+{
+    i2c_init(IMU_I2C, IMU_I2C_HZ);
+    gpio_set_function(IMU_I2C_SDA_GPIO, GPIO_FUNC_I2C);
+    gpio_set_function(IMU_I2C_SCL_GPIO, GPIO_FUNC_I2C);
+    gpio_pull_up(IMU_I2C_SDA_GPIO);
+    gpio_pull_up(IMU_I2C_SCL_GPIO);
+
+    // LSM6DS3 0x69, LSM6DS3TR-C 0x6A, LSM6DSO 0x6C
+    uint8_t id = 0;
+    if (!imu_read_register(LSM6_WHO_AM_I, &id) || (id != 0x69 && id != 0x6A && id != 0x6C)) {
+        printf("IMU: none at 0x%02x (id 0x%02x)\n", IMU_I2C_ADDRESS, id);
+        return false;
+    }
+
+    // Software reset, done within 50 us
+    uint8_t ctrl3 = 0x01;
+    imu_write_register(LSM6_CTRL3_C, ctrl3);
+    for (int i = 0; i < 10 && (ctrl3 & 0x01); i++) {
+        sleep_us(50);
+        imu_read_register(LSM6_CTRL3_C, &ctrl3);
+    }
+    // Block data update and address auto-increment for the burst read
+    imu_write_register(LSM6_CTRL3_C, 0x44);
+    // Data ready as a 75 us pulse, not a level held until read: a skipped
+    // read cannot leave INT1 stuck high
+    imu_write_register(LSM6_DRDY_PULSE_CFG, 0x80);
+    imu_write_register(LSM6_INT1_CTRL, 0x02);
+    imu_write_register(LSM6_CTRL1_XL, (uint8_t)(lsm6_odr(IMU_SAMPLE_HZ) << 4 | lsm6_accel_scale(IMU_ACCEL_RANGE_G) << 2));
+    imu_write_register(LSM6_CTRL2_G, (uint8_t)(lsm6_odr(IMU_SAMPLE_HZ) << 4 | lsm6_gyro_scale(IMU_GYRO_RANGE_DPS) << 2));
+
+    imu_dma_init();
+
+    gpio_init(IMU_INT_GPIO);
+    gpio_set_dir(IMU_INT_GPIO, GPIO_IN);
+    gpio_add_raw_irq_handler(IMU_INT_GPIO, imu_data_ready_irq);
+    gpio_set_irq_enabled(IMU_INT_GPIO, GPIO_IRQ_EDGE_RISE, true);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+    printf("IMU: id 0x%02x, %u Hz, %u dps, %u g\n", id, IMU_SAMPLE_HZ, IMU_GYRO_RANGE_DPS, IMU_ACCEL_RANGE_G);
+    return true;
+}
+
+bool imu_sampler_pop(imu_sample_t *sample)
+{
+    return samples.pop(*sample);
+}
+
+const imu_sampler_stats_t *imu_sampler_get_stats(void)
+{
+    return &stats;
+}
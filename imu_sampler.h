@@ -0,0 +1,38 @@
+// *****************************************************************************
+// IMU sampler (RP2040)
+//
+// An LSM6DS3 / LSM6DSO on I2C0 samples gyro and accelerometer at
+// IMU_SAMPLE_HZ and pulses INT1 when a new sample is ready. The pulse
+// interrupt timestamps the sample and starts a DMA burst read of the twelve
+// output registers; the DMA completion interrupt queues the sample and wakes
+// the BTstack run loop. The CPU never waits on the I2C bus. The host build
+// replaces this with a mock fed from recorded samples.
+// *****************************************************************************
+
+#ifndef IMU_SAMPLER_H
+#define IMU_SAMPLER_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t timestamp_us;     // Data-ready pulse
+    int16_t gyro[3];           // x y z, +-IMU_GYRO_RANGE_DPS full scale
+    int16_t accel[3];          // x y z, +-IMU_ACCEL_RANGE_G full scale
+} imu_sample_t;
+
+typedef struct {
+    uint32_t samples;          // Samples queued
+    uint32_t dropped;          // Queue full, sample lost
+    uint32_t overruns;         // Data ready while the previous read still ran
+    uint32_t bus_errors;       // Reads the IMU never answered, abandoned
+} imu_sampler_stats_t;
+
+// Configure the IMU and start sampling; false if no IMU answers
+bool imu_sampler_start(void);
+
+// Next sample, oldest first; false if there is none (BTstack core)
+bool imu_sampler_pop(imu_sample_t *sample);
+
+const imu_sampler_stats_t *imu_sampler_get_stats(void);
+
+#endif // IMU_SAMPLER_H
@@ -0,0 +1,145 @@
+// *****************************************************************************
+// Input pipeline: sampler core -> BTstack core
+// *****************************************************************************
+
+#include <atomic>
+
+#include <string.h>
+
+#include "btstack.h"
+#include "gamepad_config.h"
+#include "input_pipeline.h"
+#include "input_ring.h"
+#include "latency_stats.h"
+#include "report_mailbox.h"
+
+static spsc_ring<input_sample_t, INPUT_RING_SIZE> input_ring;
+static btstack_data_source_t input_data_source;
+static input_pipeline_stats_t input_stats;
+
+// Every counter has one writer and no core does read-modify-write on the
+// other's: the sampler core counts pushes and drops, and a reset on the
+// BTstack core takes them as a baseline instead of writing them
+static std::atomic<uint32_t> pushed;
+static std::atomic<uint32_t> dropped;
+static uint32_t pushed_base;
+static uint32_t dropped_base;
+
+// Sampler core: what core0 was last given of each player
+static gamepad_report_t last_pushed[GAMEPAD_PLAYERS];
+static bool have_last_pushed[GAMEPAD_PLAYERS];
+
+static void counter_increment(std::atomic<uint32_t> &counter)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void input_pipeline_drain(void)
+{
+    input_sample_t sample;
+    input_sample_t latest[GAMEPAD_PLAYERS];
+    uint8_t have_latest = 0;
+    bool release = false;
+    uint32_t count = 0;
+
+    // Only the newest snapshot of each player matters to the report path
+    while (input_ring.pop(sample)) {
+        count++;
+        if (sample.player == INPUT_RELEASE_MARKER) release = true;
+        if (sample.player >= GAMEPAD_PLAYERS) continue;
+        latest[sample.player] = sample;
+        have_latest |= (uint8_t)(1u << sample.player);
+    }
+    if (count == 0) return;
+    input_stats.drained += count;
+
+    for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+        if (!(have_latest & (1u << player))) continue;
+        input_stats.forwarded++;
+        if (player == 0) {
+            latency_stats_sampled(latest[player].timestamp_us);
+        }
+        send_player_input(player, &latest[player].report);
+    }
+    if (release) {
+        gamepad_release_reports();
+    }
+}
+
+static void input_data_source_handler(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+    UNUSED(ds);
+    if (callback_type != DATA_SOURCE_CALLBACK_POLL) return;
+    input_pipeline_drain();
+}
+
+void input_pipeline_init(void)
+{
+    btstack_run_loop_set_data_source_handler(&input_data_source, &input_data_source_handler);
+    btstack_run_loop_enable_data_source_callbacks(&input_data_source, DATA_SOURCE_CALLBACK_POLL);
+    btstack_run_loop_add_data_source(&input_data_source);
+}
+
+static int input_pipeline_queue(const input_sample_t &sample)
+{
+    if (!input_ring.push(sample)) {
+        counter_increment(dropped);
+        return 0;
+    }
+    counter_increment(pushed);
+    btstack_run_loop_poll_data_sources_from_irq();
+    return 1;
+}
+
+int input_pipeline_push(uint8_t player, const gamepad_report_t *report, uint32_t timestamp_us)
+{
+    input_sample_t sample;
+    sample.timestamp_us = timestamp_us;
+    sample.player = player;
+    sample.report = *report;
+    return input_pipeline_queue(sample);
+}
+
+int input_pipeline_push_changed(uint8_t player, const gamepad_report_t *report, uint32_t timestamp_us)
+{
+    // Unchanged snapshots carry no information; don't wake core0 for them
+    if (have_last_pushed[player] && gamepad_report_equal(report, &last_pushed[player])) return 1;
+    // A dropped snapshot is not remembered, so the change is retried
+    if (!input_pipeline_push(player, report, timestamp_us)) return 0;
+    last_pushed[player] = *report;
+    have_last_pushed[player] = true;
+    return 1;
+}
+
+bool input_pipeline_last_pushed(uint8_t player, gamepad_report_t *report)
+{
+    if (!have_last_pushed[player]) return false;
+    *report = last_pushed[player];
+    return true;
+}
+
+int input_pipeline_push_release(uint32_t timestamp_us)
+{
+    input_sample_t sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.timestamp_us = timestamp_us;
+    sample.player = INPUT_RELEASE_MARKER;
+    return input_pipeline_queue(sample);
+}
+
+const input_pipeline_stats_t *input_pipeline_get_stats(void)
+{
+    input_stats.pushed = pushed.load(std::memory_order_relaxed) - pushed_base;
+    input_stats.dropped = dropped.load(std::memory_order_relaxed) - dropped_base;
+    return &input_stats;
+}
+
+void input_pipeline_reset_stats(void)
+{
+    pushed_base = pushed.load(std::memory_order_relaxed);
+    dropped_base = dropped.load(std::memory_order_relaxed);
+    input_stats.pushed = 0;
+    input_stats.dropped = 0;
+    input_stats.drained = 0;
+    input_stats.forwarded = 0;
+}
@@ -0,0 +1,59 @@
+// *****************************************************************************
+// Input pipeline: sampler core -> BTstack core
+//
+// The sampler pushes timestamped snapshots into an SPSC ring and wakes the
+// BTstack run loop. A run loop data source on the BTstack core drains the
+// ring and forwards the newest snapshot of each player into the report path,
+// so neither side ever waits for the other. A release marker, queued after
+// the snapshots taken at a report release point, releases the held reports
+// (gamepad_release_reports()) once they are forwarded.
+// *****************************************************************************
+
+#ifndef INPUT_PIPELINE_H
+#define INPUT_PIPELINE_H
+
+#include <stdint.h>
+
+#include "gamepad.h"
+
+// input_sample_t.player of a release marker
+#define INPUT_RELEASE_MARKER 0xff
+
+typedef struct {
+    uint32_t timestamp_us;     // When the inputs were sampled
+    uint8_t player;            // 0 .. GAMEPAD_PLAYERS - 1, or INPUT_RELEASE_MARKER
+    gamepad_report_t report;
+} input_sample_t;
+
+typedef struct {
+    uint32_t pushed;           // Producer: snapshots queued
+    uint32_t dropped;          // Producer: ring full, snapshot lost
+    uint32_t drained;          // Consumer: snapshots popped
+    uint32_t forwarded;        // Consumer: snapshots passed to the report path
+} input_pipeline_stats_t;
+
+// BTstack core: register the draining data source with the run loop
+void input_pipeline_init(void);
+
+// Sampler core: queue a snapshot and wake the run loop. Returns 0 if dropped.
+int input_pipeline_push(uint8_t player, const gamepad_report_t *report, uint32_t timestamp_us);
+
+// Sampler core: queue a snapshot unless it equals the last one queued for
+// the player. Returns 0 if dropped; the change is then still pending and
+// the next call with the same inputs queues it.
+int input_pipeline_push_changed(uint8_t player, const gamepad_report_t *report, uint32_t timestamp_us);
+
+// Sampler core: the last snapshot queued for the player; false before any
+bool input_pipeline_last_pushed(uint8_t player, gamepad_report_t *report);
+
+// Sampler core: queue a release marker. Returns 0 if dropped.
+int input_pipeline_push_release(uint32_t timestamp_us);
+
+// BTstack core: drain now (also called by the data source)
+void input_pipeline_drain(void);
+
+// BTstack core: producer counts as of this call, consumer counts as they go
+const input_pipeline_stats_t *input_pipeline_get_stats(void);
+void input_pipeline_reset_stats(void);
+
+#endif // INPUT_PIPELINE_H
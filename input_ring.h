@@ -0,0 +1,56 @@
+// *****************************************************************************
+// Lock-free single-producer / single-consumer ring
+//
+// One core pushes, the other pops. Only aligned 32-bit loads and stores with
+// acquire/release ordering are used, which the Cortex-M0+ provides without
+// exclusive-access instructions. N must be a power of two.
+// *****************************************************************************
+
+#ifndef INPUT_RING_H
+#define INPUT_RING_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+template <typename T, uint32_t N>
+class spsc_ring {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    // Producer side. Returns false if the ring is full.
+    bool push(const T &item)
+    {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t tail = tail_.load(std::memory_order_acquire);
+        if (head - tail == N) return false;
+        items_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false if the ring is empty.
+    bool pop(T &item)
+    {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        if (head == tail) return false;
+        item = items_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint32_t size() const
+    {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    static constexpr uint32_t capacity() { return N; }
+
+private:
+    T items_[N];
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+};
+
+#endif // INPUT_RING_H
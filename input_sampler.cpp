@@ -0,0 +1,169 @@
+// *****************************************************************************
+// Core1 input sampler
+// *****************************************************************************
+
+#include <atomic>
+
+#include "pico/stdlib.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
+
+#include "analog_sampler.h"
+#include "axis_profiles.h"
+#include "button_scanner.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "input_pipeline.h"
+#include "input_sampler.h"
+#include "report_mailbox.h"
+#include "trace.h"
+
+// Read all inputs of one player into report
+static void input_sampler_read(uint8_t player, gamepad_report_t *report, uint32_t now_us)
+{
+    demo_read(player, report, now_us);
+
+#if GAMEPAD_BUTTON_INPUTS
+    // Buttons of player 1 are the debounced state of the newest event
+    if (player == 0) {
+        report->buttons = button_scanner_buttons();
+    }
+#endif
+
+#if GAMEPAD_ANALOG_INPUTS
+    // Sticks and triggers of player 1 come from the newest ADC frame
+    analog_frame_t frame;
+    if (player == 0 && analog_sampler_read(&frame)) {
+        analog_frame_apply(&frame, report);
+    }
+#endif
+
+    // Calibration, deadzones and curves; noise at rest comes out unchanged
+    axis_process(axis_profiles_processor(player), report);
+}
+
+static std::atomic<uint32_t> sample_period_us(GAMEPAD_SAMPLE_PERIOD_US);
+
+// Release point named by core0
+static std::atomic<uint32_t> release_at_us;
+static std::atomic<bool> release_armed;
+
+// Only changes are queued; one lost to a full ring goes again next sample
+static void input_sampler_push(uint8_t player, const gamepad_report_t *report, uint32_t timestamp_us)
+{
+    if (!input_pipeline_push_changed(player, report, timestamp_us)) {
+        TRACE(INPUT_DROPPED, (uint16_t)(player + 1));
+    }
+}
+
+#if GAMEPAD_BUTTON_INPUTS
+// Each button change goes out as its own snapshot, stamped with the time the
+// contact settled, rather than waiting for the next sampling period
+static void input_sampler_take_buttons(void)
+{
+    button_event_t event;
+    while (button_scanner_pop(&event)) {
+        TRACE(BUTTON_EVENT, event.buttons, (uint16_t)(time_us_32() - event.timestamp_us));
+        // On top of what core0 has; the rest of a dropped change follows
+        // with the next sample
+        gamepad_report_t report = {};
+        if (!input_pipeline_last_pushed(0, &report)) report.dpad = DPAD_NEUTRAL;
+        report.buttons = event.buttons;
+        input_sampler_push(0, &report, event.timestamp_us);
+    }
+}
+#endif
+
+static void input_sampler_sample(uint32_t now_us)
+{
+    for (uint8_t player = 0; player < GAMEPAD_PLAYERS; player++) {
+        gamepad_report_t report;
+        input_sampler_read(player, &report, now_us);
+        input_sampler_push(player, &report, now_us);
+    }
+}
+
+// Busy-wait, taking button changes as soon as the scanner queues them
+static void input_sampler_wait(absolute_time_t until)
+{
+#if GAMEPAD_BUTTON_INPUTS
+    while (!time_reached(until)) {
+        if (button_scanner_pending()) input_sampler_take_buttons();
+    }
+#else
+    busy_wait_until(until);
+#endif
+}
+
+// A release point falling before the next periodic sample is sampled on
+// its own; the marker goes after the snapshots so they are forwarded first
+static void input_sampler_release(absolute_time_t next)
+{
+    if (!release_armed.load(std::memory_order_acquire)) return;
+    int32_t delay_us = (int32_t)(release_at_us.load(std::memory_order_relaxed) - time_us_32());
+    if (delay_us >= absolute_time_diff_us(get_absolute_time(), next)) return;
+    if (delay_us > 0) {
+        input_sampler_wait(delayed_by_us(get_absolute_time(), (uint64_t)delay_us));
+    }
+    release_armed.store(false, std::memory_order_relaxed);
+    uint32_t now_us = time_us_32();
+#if GAMEPAD_BUTTON_INPUTS
+    input_sampler_take_buttons();
+#endif
+    input_sampler_sample(now_us);
+    if (!input_pipeline_push_release(now_us)) {
+        TRACE(INPUT_DROPPED, 0);
+    }
+}
+
+void input_sampler_release_at(uint32_t release_us)
+{
+    release_at_us.store(release_us, std::memory_order_relaxed);
+    release_armed.store(true, std::memory_order_release);
+}
+
+void input_sampler_set_period_us(uint32_t period_us)
+{
+    sample_period_us.store(period_us, std::memory_order_relaxed);
+}
+
+uint32_t input_sampler_period_us(void)
+{
+    return sample_period_us.load(std::memory_order_relaxed);
+}
+
+static void core1_entry(void)
+{
+    // Flash writes on core0 (bonds, profiles; see deferred_tlv.h) park this
+    // core in RAM for their duration instead of failing or faulting on XIP
+    flash_safe_execute_core_init();
+#if GAMEPAD_ANALOG_INPUTS
+    // DMA completion interrupts are taken here, off the radio core
+    analog_sampler_start();
+#endif
+#if GAMEPAD_BUTTON_INPUTS
+    // So is the button one
+    button_scanner_start();
+#endif
+
+    absolute_time_t next = get_absolute_time();
+
+    while (true) {
+        uint32_t now_us = time_us_32();
+#if GAMEPAD_BUTTON_INPUTS
+        input_sampler_take_buttons();
+#endif
+        input_sampler_sample(now_us);
+
+        // Fixed-rate schedule; a late iteration does not shift later ones.
+        // Report release points are sampled in between.
+        next = delayed_by_us(next, sample_period_us.load(std::memory_order_relaxed));
+        input_sampler_release(next);
+        input_sampler_wait(next);
+    }
+}
+
+void input_sampler_start(void)
+{
+    multicore_launch_core1(core1_entry);
+}
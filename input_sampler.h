@@ -0,0 +1,28 @@
+// *****************************************************************************
+// Core1 input sampler
+//
+// Samples the gamepad inputs every sampling period on core1,
+// independent of radio activity on core0, and feeds the input pipeline.
+// Button changes from the PIO scanner are fed in as soon as they arrive.
+// When core0 holds reports for a connection event (event_schedule.h), it
+// names the release point and core1 takes an extra sample right at it,
+// followed by a release marker.
+// *****************************************************************************
+
+#ifndef INPUT_SAMPLER_H
+#define INPUT_SAMPLER_H
+
+#include <stdint.h>
+
+// Launch the sampling loop on core1
+void input_sampler_start(void);
+
+// Sampling period from the next sample on (GAMEPAD_SAMPLE_PERIOD_US at start)
+void input_sampler_set_period_us(uint32_t period_us);
+uint32_t input_sampler_period_us(void);
+
+// Core0: sample at release_us (time_us_32()) and queue a release marker;
+// replaces an earlier release point not yet reached
+void input_sampler_release_at(uint32_t release_us);
+
+#endif // INPUT_SAMPLER_H
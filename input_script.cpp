@@ -0,0 +1,219 @@
+// *****************************************************************************
+// Input scripts
+// *****************************************************************************
+
+#include <string.h>
+
+#include "input_script.h"
+
+typedef struct {
+    uint32_t delta_us;
+    uint8_t mask;
+    uint8_t player;
+    uint8_t marker;
+    gamepad_report_t fields;
+} input_script_record_t;
+
+// LEB128, at most five bytes for 32 bits. Returns 0 past the end.
+static int script_read_varint(const uint8_t *data, uint32_t size, uint32_t *offset, uint32_t *value)
+{
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*offset >= size) return 0;
+        uint8_t byte = data[(*offset)++];
+        result |= (uint32_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint32_t script_field_bytes(uint8_t mask)
+{
+    uint32_t bytes = 0;
+    for (int bit = 0; bit < 5; bit++) {
+        if (mask & (1u << bit)) bytes += 2;
+    }
+    for (int bit = 5; bit < 8; bit++) {
+        if (mask & (1u << bit)) bytes += 1;
+    }
+    return bytes;
+}
+
+static uint16_t script_read_16(const uint8_t *data, uint32_t *offset)
+{
+    uint16_t value = (uint16_t)(data[*offset] | (data[*offset + 1] << 8));
+    *offset += 2;
+    return value;
+}
+
+// Returns 0 if the record is truncated
+static int script_read_record(const uint8_t *data, uint32_t size, uint8_t players, uint32_t *offset,
+                              input_script_record_t *record)
+{
+    if (!script_read_varint(data, size, offset, &record->delta_us)) return 0;
+    if (*offset >= size) return 0;
+    record->mask = data[(*offset)++];
+    record->player = 0;
+
+    if (record->mask == 0) {
+        if (*offset >= size) return 0;
+        record->marker = data[(*offset)++];
+        return 1;
+    }
+    if (players > 1) {
+        if (*offset >= size) return 0;
+        record->player = data[(*offset)++];
+    }
+    if (size - *offset < script_field_bytes(record->mask)) return 0;
+
+    gamepad_report_t *fields = &record->fields;
+    if (record->mask & INPUT_SCRIPT_BUTTONS) fields->buttons = script_read_16(data, offset);
+    if (record->mask & INPUT_SCRIPT_LEFT_X) fields->left_x = (int16_t)script_read_16(data, offset);
+    if (record->mask & INPUT_SCRIPT_LEFT_Y) fields->left_y = (int16_t)script_read_16(data, offset);
+    if (record->mask & INPUT_SCRIPT_RIGHT_X) fields->right_x = (int16_t)script_read_16(data, offset);
+    if (record->mask & INPUT_SCRIPT_RIGHT_Y) fields->right_y = (int16_t)script_read_16(data, offset);
+    if (record->mask & INPUT_SCRIPT_LEFT_TRIGGER) fields->left_trigger = data[(*offset)++];
+    if (record->mask & INPUT_SCRIPT_RIGHT_TRIGGER) fields->right_trigger = data[(*offset)++];
+    if (record->mask & INPUT_SCRIPT_DPAD) fields->dpad = data[(*offset)++];
+    return 1;
+}
+
+// Only the delta of the record at offset
+static int script_peek_delta(const input_script_t *script, uint32_t offset, uint32_t *delta_us)
+{
+    return script_read_varint(script->data, script->size, &offset, delta_us);
+}
+
+int input_script_open(input_script_t *script, const uint8_t *data, uint32_t size)
+{
+    if (size < INPUT_SCRIPT_HEADER_SIZE) return -1;
+    if (data[0] != 'G' || data[1] != 'P' || data[2] != 'S' || data[3] != INPUT_SCRIPT_VERSION) return -1;
+    if (data[4] == 0) return -1;
+
+    script->data = data;
+    script->size = size;
+    script->players = data[4];
+    script->records = 0;
+    script->duration_us = 0;
+
+    uint32_t offset = INPUT_SCRIPT_HEADER_SIZE;
+    while (offset < size) {
+        input_script_record_t record = {};
+        if (!script_read_record(data, size, script->players, &offset, &record)) return -1;
+        script->records++;
+        script->duration_us += record.delta_us;
+    }
+    return 0;
+}
+
+// Replay time of script time, at the replay's speed
+static uint32_t replay_scaled_us(const input_script_replay_t *replay, uint32_t script_us)
+{
+    return (uint32_t)((uint64_t)script_us * 100 / replay->speed_percent);
+}
+
+void input_script_replay_start(input_script_replay_t *replay, const input_script_t *script, uint32_t now_us,
+                               uint16_t speed_percent, bool loop, uint8_t player_base)
+{
+    replay->script = script;
+    replay->offset = INPUT_SCRIPT_HEADER_SIZE;
+    replay->origin_us = now_us;
+    replay->script_us = 0;
+    replay->speed_percent = speed_percent ? speed_percent : 100;
+    replay->loop = loop;
+    replay->player_base = player_base;
+    replay->finished = script->records == 0;
+    replay->loops = 0;
+    memset(replay->state, 0, sizeof(replay->state));
+    for (int player = 0; player < GAMEPAD_PLAYERS; player++) {
+        replay->state[player].dpad = DPAD_NEUTRAL;
+    }
+}
+
+// Back to the first record; the new pass starts where this one ended
+static void replay_rewind(input_script_replay_t *replay)
+{
+    replay->origin_us += replay_scaled_us(replay, replay->script_us);
+    replay->script_us = 0;
+    replay->offset = INPUT_SCRIPT_HEADER_SIZE;
+    replay->loops++;
+}
+
+static void replay_apply(input_script_replay_t *replay, const input_script_record_t *record, uint32_t *changed)
+{
+    uint32_t player = (uint32_t)record->player + replay->player_base;
+    if (player >= GAMEPAD_PLAYERS) return;
+
+    gamepad_report_t *state = &replay->state[player];
+    const gamepad_report_t *fields = &record->fields;
+    if (record->mask & INPUT_SCRIPT_BUTTONS) state->buttons = fields->buttons;
+    if (record->mask & INPUT_SCRIPT_LEFT_X) state->left_x = fields->left_x;
+    if (record->mask & INPUT_SCRIPT_LEFT_Y) state->left_y = fields->left_y;
+    if (record->mask & INPUT_SCRIPT_RIGHT_X) state->right_x = fields->right_x;
+    if (record->mask & INPUT_SCRIPT_RIGHT_Y) state->right_y = fields->right_y;
+    if (record->mask & INPUT_SCRIPT_LEFT_TRIGGER) state->left_trigger = fields->left_trigger;
+    if (record->mask & INPUT_SCRIPT_RIGHT_TRIGGER) state->right_trigger = fields->right_trigger;
+    if (record->mask & INPUT_SCRIPT_DPAD) state->dpad = fields->dpad;
+    *changed |= 1u << player;
+}
+
+uint32_t input_script_replay_poll(input_script_replay_t *replay, uint32_t now_us, int *marker)
+{
+    const input_script_t *script = replay->script;
+    uint32_t changed = 0;
+    bool rewound = false;
+    *marker = INPUT_SCRIPT_NO_MARKER;
+
+    while (!replay->finished) {
+        if (replay->offset >= script->size) {
+            // At most one pass per poll, so a script of zero duration
+            // cannot keep the caller here
+            if (!replay->loop) {
+                replay->finished = 1;
+                break;
+            }
+            if (rewound) break;
+            replay_rewind(replay);
+            rewound = true;
+        }
+
+        uint32_t delta_us = 0;
+        script_peek_delta(script, replay->offset, &delta_us);
+        uint32_t due_us = replay->origin_us + replay_scaled_us(replay, replay->script_us + delta_us);
+        if ((int32_t)(now_us - due_us) < 0) break;
+
+        input_script_record_t record = {};
+        script_read_record(script->data, script->size, script->players, &replay->offset, &record);
+        replay->script_us += record.delta_us;
+        if (record.mask == 0) {
+            *marker = record.marker;
+        } else {
+            replay_apply(replay, &record, &changed);
+        }
+    }
+    return changed;
+}
+
+uint32_t input_script_replay_wait_us(const input_script_replay_t *replay, uint32_t now_us)
+{
+    if (replay->finished) return UINT32_MAX;
+
+    const input_script_t *script = replay->script;
+    uint32_t origin_us = replay->origin_us;
+    uint32_t script_us = replay->script_us;
+    uint32_t offset = replay->offset;
+    if (offset >= script->size) {
+        if (!replay->loop) return UINT32_MAX;
+        origin_us += replay_scaled_us(replay, script_us);
+        script_us = 0;
+        offset = INPUT_SCRIPT_HEADER_SIZE;
+    }
+
+    uint32_t delta_us = 0;
+    script_peek_delta(script, offset, &delta_us);
+    uint32_t due_us = origin_us + replay_scaled_us(replay, script_us + delta_us);
+    return (int32_t)(due_us - now_us) <= 0 ? 0 : due_us - now_us;
+}
@@ -0,0 +1,84 @@
+// *****************************************************************************
+// Input scripts
+//
+// A compact binary recording of gamepad input: timestamped deltas that
+// only carry the fields that changed. The built-in demo is one (compiled
+// from demo_script.txt into flash), and captured play sessions can be
+// streamed in over USB and replayed into the host at their recorded
+// cadence, faster, and in a loop. tools/input_script.py compiles, decodes
+// and sends scripts.
+//
+//   header  'G' 'P' 'S' version players 0 0 0                     (8 bytes)
+//   record  delta_us (LEB128) mask [player] fields...
+//
+// delta_us is the time since the previous record. mask has one bit per
+// field in gamepad_report_t order (buttons, left_x, left_y, right_x,
+// right_y, left_trigger, right_trigger, dpad); the fields follow in that
+// order, little-endian, at their natural width. The player byte is present
+// when the header declares more than one player. A mask of 0 is a marker
+// record carrying a single marker number instead, traced as SCRIPT_MARK.
+//
+// Pure byte parsing with no hardware access; it runs on the host too.
+// *****************************************************************************
+
+#ifndef INPUT_SCRIPT_H
+#define INPUT_SCRIPT_H
+
+#include <stdint.h>
+
+#include "gamepad.h"
+#include "gamepad_config.h"
+
+#define INPUT_SCRIPT_VERSION     1
+#define INPUT_SCRIPT_HEADER_SIZE 8
+
+// Field mask bits
+#define INPUT_SCRIPT_BUTTONS        0x01
+#define INPUT_SCRIPT_LEFT_X         0x02
+#define INPUT_SCRIPT_LEFT_Y         0x04
+#define INPUT_SCRIPT_RIGHT_X        0x08
+#define INPUT_SCRIPT_RIGHT_Y        0x10
+#define INPUT_SCRIPT_LEFT_TRIGGER   0x20
+#define INPUT_SCRIPT_RIGHT_TRIGGER  0x40
+#define INPUT_SCRIPT_DPAD           0x80
+
+#define INPUT_SCRIPT_NO_MARKER      -1
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+    uint8_t players;             // Players addressed by the records
+    uint32_t records;
+    uint32_t duration_us;        // Sum of all deltas
+} input_script_t;
+
+typedef struct {
+    const input_script_t *script;
+    uint32_t offset;             // Next record
+    uint32_t origin_us;          // Replay time of script time 0 (this loop)
+    uint32_t script_us;          // Script time of the next record
+    uint16_t speed_percent;      // 100 = recorded cadence
+    uint8_t loop;
+    uint8_t player_base;         // Added to the records' player numbers
+    uint8_t finished;
+    uint32_t loops;              // Completed passes
+    gamepad_report_t state[GAMEPAD_PLAYERS];
+} input_script_replay_t;
+
+// Check the header and every record. Returns 0 and fills script, or -1 if
+// the data is not a complete script of this version.
+int input_script_open(input_script_t *script, const uint8_t *data, uint32_t size);
+
+// Start replaying at now_us; all players start neutral. Players of a
+// single-player script are offset by player_base.
+void input_script_replay_start(input_script_replay_t *replay, const input_script_t *script, uint32_t now_us,
+                               uint16_t speed_percent, bool loop, uint8_t player_base);
+
+// Apply every record due at now_us. Returns a bit per player whose state
+// changed; *marker is the last marker passed or INPUT_SCRIPT_NO_MARKER.
+uint32_t input_script_replay_poll(input_script_replay_t *replay, uint32_t now_us, int *marker);
+
+// Time until the next record is due: 0 if overdue, UINT32_MAX when finished
+uint32_t input_script_replay_wait_us(const input_script_replay_t *replay, uint32_t now_us);
+
+#endif // INPUT_SCRIPT_H
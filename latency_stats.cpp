@@ -0,0 +1,157 @@
+// *****************************************************************************
+// Input latency histograms
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "latency_stats.h"
+
+static const char *const stage_names[LATENCY_STAGE_COUNT] = {
+    "sample->input",
+    "input->can-send",
+    "can-send->sent",
+    "total",
+    "sample->done",
+    "write->motor",
+};
+
+static latency_histogram_t histograms[LATENCY_STAGE_COUNT];
+
+// Timestamps of the newest input not yet sent
+static uint32_t sample_us;
+static uint32_t input_us;
+static uint32_t can_send_us;
+static uint8_t sample_valid;
+static uint8_t input_valid;
+
+// Sample of the report on its way through the controller
+static uint32_t queued_sample_us;
+static uint8_t queued_valid;
+
+static void histogram_add(latency_histogram_t *histogram, uint32_t value_us)
+{
+    uint32_t bucket = value_us >> LATENCY_BUCKET_SHIFT;
+    if (bucket > LATENCY_BUCKETS) bucket = LATENCY_BUCKETS;
+    histogram->buckets[bucket]++;
+    histogram->count++;
+    histogram->sum_us += value_us;
+    if (value_us < histogram->min_us) histogram->min_us = value_us;
+    if (value_us > histogram->max_us) histogram->max_us = value_us;
+}
+
+// Upper edge of the bucket holding the given percentile
+static uint32_t histogram_percentile(const latency_histogram_t *histogram, uint32_t percent)
+{
+    uint32_t target = (uint32_t)(((uint64_t)histogram->count * percent + 99) / 100);
+    uint32_t seen = 0;
+    for (uint32_t bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += histogram->buckets[bucket];
+        if (seen >= target) return (bucket + 1) << LATENCY_BUCKET_SHIFT;
+    }
+    return histogram->max_us;
+}
+
+void latency_stats_sampled(uint32_t timestamp_us)
+{
+    sample_us = timestamp_us;
+    sample_valid = 1;
+}
+
+void latency_stats_input(void)
+{
+    input_us = time_us_32();
+    if (!sample_valid) {
+        // No sampler stage (single core build): the input is the sample
+        sample_us = input_us;
+    }
+    sample_valid = 0;
+    input_valid = 1;
+}
+
+void latency_stats_can_send_now(void)
+{
+    can_send_us = time_us_32();
+}
+
+bool latency_stats_sent(void)
+{
+    // Keep-alives and resends after reconnect carry no new input
+    if (!input_valid) return false;
+    input_valid = 0;
+
+    uint32_t sent_us = time_us_32();
+    histogram_add(&histograms[LATENCY_SAMPLE_TO_INPUT], input_us - sample_us);
+    histogram_add(&histograms[LATENCY_INPUT_TO_CAN_SEND], can_send_us - input_us);
+    histogram_add(&histograms[LATENCY_CAN_SEND_TO_SENT], sent_us - can_send_us);
+    histogram_add(&histograms[LATENCY_TOTAL], sent_us - sample_us);
+    queued_sample_us = sample_us;
+    queued_valid = 1;
+    return true;
+}
+
+void latency_stats_completed(void)
+{
+    if (!queued_valid) return;
+    queued_valid = 0;
+    histogram_add(&histograms[LATENCY_SAMPLE_TO_DONE], time_us_32() - queued_sample_us);
+}
+
+void latency_stats_motor(uint32_t write_us)
+{
+    histogram_add(&histograms[LATENCY_WRITE_TO_MOTOR], time_us_32() - write_us);
+}
+
+void latency_stats_reset(void)
+{
+    memset(histograms, 0, sizeof(histograms));
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        histograms[stage].min_us = UINT32_MAX;
+    }
+    sample_valid = 0;
+    input_valid = 0;
+    queued_valid = 0;
+}
+
+const latency_histogram_t *latency_stats_get(latency_stage_t stage)
+{
+    return &histograms[stage];
+}
+
+uint32_t latency_stats_percentile(latency_stage_t stage, uint32_t percent)
+{
+    const latency_histogram_t *histogram = &histograms[stage];
+    return histogram->count ? histogram_percentile(histogram, percent) : 0;
+}
+
+void latency_stats_dump(void)
+{
+    printf("Latency (us, %u us buckets)\n", 1u << LATENCY_BUCKET_SHIFT);
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+        const latency_histogram_t *histogram = &histograms[stage];
+        if (histogram->count == 0) {
+            printf("  %-16s no reports\n", stage_names[stage]);
+            continue;
+        }
+        printf("  %-16s n %lu  min %lu  avg %lu  p50 <%lu  p90 <%lu  p99 <%lu  max %lu\n", stage_names[stage],
+               (unsigned long)histogram->count, (unsigned long)histogram->min_us,
+               (unsigned long)(histogram->sum_us / histogram->count),
+               (unsigned long)histogram_percentile(histogram, 50), (unsigned long)histogram_percentile(histogram, 90),
+               (unsigned long)histogram_percentile(histogram, 99), (unsigned long)histogram->max_us);
+    }
+
+    // Total distribution, non-empty buckets only
+    const latency_histogram_t *total = &histograms[LATENCY_TOTAL];
+    for (uint32_t bucket = 0; bucket <= LATENCY_BUCKETS; bucket++) {
+        if (total->buckets[bucket] == 0) continue;
+        if (bucket == LATENCY_BUCKETS) {
+            printf("    >=%6lu: %lu\n", (unsigned long)(bucket << LATENCY_BUCKET_SHIFT),
+                   (unsigned long)total->buckets[bucket]);
+        } else {
+            printf("    %6lu..: %lu\n", (unsigned long)(bucket << LATENCY_BUCKET_SHIFT),
+                   (unsigned long)total->buckets[bucket]);
+        }
+    }
+}
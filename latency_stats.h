@@ -0,0 +1,81 @@
+// *****************************************************************************
+// Input latency histograms
+//
+// Follows the newest input through the report path and, when its report
+// has been handed to the controller, adds the time spent in each stage to
+// a fixed-bucket histogram:
+//
+//   sample -> input      core1 sample until send_gamepad_input() (ring hand-off)
+//   input -> can-send    waiting for att_server's CAN_SEND_NOW
+//   can-send -> sent     packing and hids_device_send_input_report()
+//   total                sample until the report is with the controller
+//   sample -> done       sample until the controller reports the packet sent
+//                        (NUMBER_OF_COMPLETED_PACKETS): the input's age on
+//                        air, plus the controller's reporting delay
+//
+// and, the other way, for rumble output reports:
+//
+//   write -> motor       report handler until the motors change
+//
+// All input marks run on the BTstack core and only store timestamps or bump
+// a bucket; the rumble stage is recorded from the rumble alarm interrupt.
+// Printing happens in latency_stats_dump(). With several players the input
+// histograms follow player 1.
+// *****************************************************************************
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+
+#include "gamepad_config.h"
+
+typedef enum {
+    LATENCY_SAMPLE_TO_INPUT = 0,
+    LATENCY_INPUT_TO_CAN_SEND,
+    LATENCY_CAN_SEND_TO_SENT,
+    LATENCY_TOTAL,
+    LATENCY_SAMPLE_TO_DONE,
+    LATENCY_WRITE_TO_MOTOR,
+    LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+typedef struct {
+    uint32_t buckets[LATENCY_BUCKETS + 1];  // Last bucket collects overflow
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+} latency_histogram_t;
+
+// Timestamp of the sample about to be passed to send_gamepad_input()
+void latency_stats_sampled(uint32_t sample_us);
+
+// send_gamepad_input() accepted a new state
+void latency_stats_input(void);
+
+// CAN_SEND_NOW is being served
+void latency_stats_can_send_now(void);
+
+// The report was handed to the controller; records the stages up to total.
+// Returns true if it carries the followed input.
+bool latency_stats_sent(void);
+
+// The controller sent the report latency_stats_sent() returned true for
+void latency_stats_completed(void);
+
+// The motors changed for an output report handled at write_us
+void latency_stats_motor(uint32_t write_us);
+
+void latency_stats_reset(void);
+
+const latency_histogram_t *latency_stats_get(latency_stage_t stage);
+
+// Upper edge of the bucket holding the given percentile of a stage, the
+// maximum if it lies in the overflow bucket; 0 while the stage is empty
+uint32_t latency_stats_percentile(latency_stage_t stage, uint32_t percent);
+
+// Print all histograms to stdio
+void latency_stats_dump(void);
+
+#endif // LATENCY_STATS_H
@@ -0,0 +1,392 @@
+// *****************************************************************************
+// Connection tuning
+// *****************************************************************************
+
+#include <stdio.h>
+
+#include "btstack.h"
+#include "gamepad_config.h"
+#include "link_tuning.h"
+
+// Interval ranges to fall back on after the target interval was refused,
+// shortest first (1.25 ms units); only those never shorter than the target
+// are tried. The last one fits the 15 ms minimum and 15 ms range that some
+// centrals insist on.
+typedef struct {
+    uint16_t min;
+    uint16_t max;
+} interval_range_t;
+
+static const interval_range_t interval_ladder[] = {
+    {  6,  6 },     // 7.5 ms
+    {  9,  9 },     // 11.25 ms
+    { 12, 12 },     // 15 ms
+    { 12, 24 },     // 15..30 ms
+};
+#define INTERVAL_LADDER_SIZE (sizeof(interval_ladder) / sizeof(interval_ladder[0]))
+
+// gap_le_set_phy() preference bits
+#define LINK_PHY_2M_MASK 0x02
+
+// Max TX time for LINK_MAX_TX_OCTETS on the 1M PHY: (payload + 14) * 8 us
+#define LINK_MAX_TX_TIME_US ((LINK_MAX_TX_OCTETS + 14) * 8)
+
+// Negotiation state of one connection
+typedef struct {
+    link_params_t params;
+    uint8_t ladder_step;            // 0 = targets.interval, then the ladder ranges it allows
+    uint16_t requested_min;         // Last request, logged next to what the central applies
+    uint16_t requested_max;
+    uint16_t requested_latency;
+    bool started;                   // Host subscribed, tuning requested
+    bool interval_request_pending;
+    bool power_request;             // The pending request is for power_interval
+    bool parameters_changed;        // New targets or power parameters while a request was pending
+    uint16_t power_interval;        // 0 = the negotiated ladder step, latency targets.latency
+    uint16_t power_latency;
+    bool data_length_pending;
+    btstack_timer_source_t response_timer;
+} link_state_t;
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static btstack_packet_callback_registration_t l2cap_event_callback_registration;
+
+static link_state_t links[GAMEPAD_MAX_CONNECTIONS];
+
+static link_targets_t targets;
+
+static void link_reset(link_state_t *link)
+{
+    link->params.con_handle = HCI_CON_HANDLE_INVALID;
+    link->params.conn_interval = 0;
+    link->params.conn_latency = 0;
+    link->params.supervision_timeout = 0;
+    link->params.tx_phy = 1;
+    link->params.rx_phy = 1;
+    link->params.max_tx_octets = 27;
+    link->params.max_rx_octets = 27;
+    link->params.interval_rejections = 0;
+    link->ladder_step = 0;
+    link->requested_min = 0;
+    link->requested_max = 0;
+    link->requested_latency = 0;
+    link->started = false;
+    link->interval_request_pending = false;
+    link->power_request = false;
+    link->parameters_changed = false;
+    link->power_interval = 0;
+    link->power_latency = 0;
+    link->data_length_pending = false;
+}
+
+static link_state_t *link_find(hci_con_handle_t con_handle)
+{
+    if (con_handle == HCI_CON_HANDLE_INVALID) return NULL;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (links[i].params.con_handle == con_handle) return &links[i];
+    }
+    return NULL;
+}
+
+static link_state_t *link_find_free(void)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (links[i].params.con_handle == HCI_CON_HANDLE_INVALID) return &links[i];
+    }
+    return NULL;
+}
+
+// Find or allocate the entry for a connection
+static link_state_t *link_add(hci_con_handle_t con_handle)
+{
+    link_state_t *link = link_find(con_handle);
+    if (link) return link;
+    link = link_find_free();
+    if (!link) return NULL;
+    link->params.con_handle = con_handle;
+    return link;
+}
+
+static void link_tuning_log(const link_state_t *link, const char *what)
+{
+    const link_params_t *params = &link->params;
+    printf("Link 0x%04x %s: interval %u.%02u ms, latency %u, timeout %u ms, PHY %u/%u, octets %u/%u\n",
+           params->con_handle, what, params->conn_interval * 125 / 100, params->conn_interval * 125 % 100,
+           params->conn_latency, params->supervision_timeout * 10, params->tx_phy, params->rx_phy,
+           params->max_tx_octets, params->max_rx_octets);
+}
+
+// Fallback ranges are ladder entries not shorter than the target and not
+// the target itself
+static bool link_tuning_fallback(const interval_range_t *range)
+{
+    return range->min >= targets.interval && !(range->min == targets.interval && range->max == targets.interval);
+}
+
+// Interval range of a negotiation step; false past the last one
+static bool link_tuning_step_range(uint8_t step, interval_range_t *range)
+{
+    if (step == 0) {
+        range->min = range->max = targets.interval;
+        return true;
+    }
+    for (unsigned i = 0; i < INTERVAL_LADDER_SIZE; i++) {
+        if (!link_tuning_fallback(&interval_ladder[i])) continue;
+        if (--step == 0) {
+            *range = interval_ladder[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static void link_tuning_request_interval(link_state_t *link)
+{
+    interval_range_t range = { targets.interval, targets.interval };
+    link_tuning_step_range(link->ladder_step, &range);
+    uint16_t min = range.min;
+    uint16_t max = range.max;
+    uint16_t latency = targets.latency;
+    link->power_request = link->power_interval != 0;
+    if (link->power_request) {
+        min = max = link->power_interval;
+        latency = link->power_latency;
+    }
+    printf("Link 0x%04x: requesting connection interval %u..%u (1.25 ms units), latency %u\n",
+           link->params.con_handle, min, max, latency);
+    gap_request_connection_parameter_update(link->params.con_handle, min, max, latency, targets.supervision_timeout);
+    link->requested_min = min;
+    link->requested_max = max;
+    link->requested_latency = latency;
+    link->interval_request_pending = true;
+
+    // Centrals may ignore the request instead of answering it
+    btstack_run_loop_set_timer(&link->response_timer, LINK_REQUEST_TIMEOUT_MS);
+    btstack_run_loop_add_timer(&link->response_timer);
+}
+
+// A request finished; ask again if the parameters changed meanwhile
+static void link_tuning_request_done(link_state_t *link)
+{
+    btstack_run_loop_remove_timer(&link->response_timer);
+    link->interval_request_pending = false;
+    if (link->parameters_changed) {
+        link->parameters_changed = false;
+        link_tuning_request_interval(link);
+    }
+}
+
+static void link_tuning_fall_back(link_state_t *link, const char *reason)
+{
+    btstack_run_loop_remove_timer(&link->response_timer);
+    link->interval_request_pending = false;
+    link->params.interval_rejections++;
+
+    // Power requests have no ladder; the link stays as it is
+    if (link->power_request || link->parameters_changed) {
+        printf("Link 0x%04x: power parameters %s, keeping current ones\n", link->params.con_handle, reason);
+        link_tuning_request_done(link);
+        return;
+    }
+
+    interval_range_t range;
+    if (!link_tuning_step_range(link->ladder_step + 1, &range)) {
+        printf("Link 0x%04x: connection interval %s, keeping central's choice\n", link->params.con_handle, reason);
+        return;
+    }
+    printf("Link 0x%04x: connection interval %s, falling back\n", link->params.con_handle, reason);
+    link->ladder_step++;
+    link_tuning_request_interval(link);
+}
+
+static void response_timeout_handler(btstack_timer_source_t *ts)
+{
+    link_state_t *link = (link_state_t *)ts->context;
+    if (!link->interval_request_pending) return;
+    link_tuning_fall_back(link, "request unanswered");
+}
+
+// Send controller commands that could not be sent earlier
+static void link_tuning_run(void)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        link_state_t *link = &links[i];
+        if (!link->data_length_pending) continue;
+        if (!hci_can_send_command_packet_now()) return;
+        link->data_length_pending = false;
+        hci_send_cmd(&hci_le_set_data_length, link->params.con_handle, LINK_MAX_TX_OCTETS, LINK_MAX_TX_TIME_US);
+    }
+}
+
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size)
+{
+    UNUSED(channel);
+    UNUSED(size);
+
+    if (packet_type != HCI_EVENT_PACKET) return;
+
+    if (hci_event_packet_get_type(packet) == HCI_EVENT_LE_META) {
+        link_state_t *link;
+        switch (hci_event_le_meta_get_subevent_code(packet)) {
+            case HCI_SUBEVENT_LE_CONNECTION_COMPLETE:
+                if (hci_subevent_le_connection_complete_get_status(packet)) break;
+                link = link_add(hci_subevent_le_connection_complete_get_connection_handle(packet));
+                if (!link) break;
+                link->params.conn_interval = hci_subevent_le_connection_complete_get_conn_interval(packet);
+                link->params.conn_latency = hci_subevent_le_connection_complete_get_conn_latency(packet);
+                link->params.supervision_timeout = hci_subevent_le_connection_complete_get_supervision_timeout(packet);
+                break;
+
+            case HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE:
+                link = link_find(hci_subevent_le_connection_update_complete_get_connection_handle(packet));
+                if (!link) break;
+                if (hci_subevent_le_connection_update_complete_get_status(packet)) break;
+                link->params.conn_interval = hci_subevent_le_connection_update_complete_get_conn_interval(packet);
+                link->params.conn_latency = hci_subevent_le_connection_update_complete_get_conn_latency(packet);
+                link->params.supervision_timeout =
+                    hci_subevent_le_connection_update_complete_get_supervision_timeout(packet);
+                link_tuning_log(link, "updated");
+                if (link->requested_max) {
+                    printf("Link 0x%04x: requested interval %u..%u, latency %u; negotiated %u, latency %u\n",
+                           link->params.con_handle, link->requested_min, link->requested_max,
+                           link->requested_latency, link->params.conn_interval, link->params.conn_latency);
+                }
+                break;
+
+            case HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE:
+                link = link_find(hci_subevent_le_phy_update_complete_get_connection_handle(packet));
+                if (!link) break;
+                if (hci_subevent_le_phy_update_complete_get_status(packet)) {
+                    printf("Link 0x%04x: PHY update failed: 0x%02x\n", link->params.con_handle,
+                           hci_subevent_le_phy_update_complete_get_status(packet));
+                    break;
+                }
+                link->params.tx_phy = hci_subevent_le_phy_update_complete_get_tx_phy(packet);
+                link->params.rx_phy = hci_subevent_le_phy_update_complete_get_rx_phy(packet);
+                link_tuning_log(link, "PHY");
+                break;
+
+            case HCI_SUBEVENT_LE_DATA_LENGTH_CHANGE:
+                link = link_find(hci_subevent_le_data_length_change_get_connection_handle(packet));
+                if (!link) break;
+                link->params.max_tx_octets = hci_subevent_le_data_length_change_get_max_tx_octets(packet);
+                link->params.max_rx_octets = hci_subevent_le_data_length_change_get_max_rx_octets(packet);
+                link_tuning_log(link, "data length");
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    link_tuning_run();
+}
+
+static void l2cap_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size)
+{
+    UNUSED(channel);
+    UNUSED(size);
+
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != L2CAP_EVENT_CONNECTION_PARAMETER_UPDATE_RESPONSE) return;
+    link_state_t *link = link_find(l2cap_event_connection_parameter_update_response_get_handle(packet));
+    if (!link || !link->interval_request_pending) return;
+
+    if (l2cap_event_connection_parameter_update_response_get_result(packet) == 0) {
+        // Accepted; the values arrive with the connection update complete event
+        link_tuning_request_done(link);
+        return;
+    }
+    link_tuning_fall_back(link, "rejected");
+}
+
+void link_tuning_init(void)
+{
+    targets.interval = LINK_TARGET_INTERVAL;
+    targets.latency = LINK_TARGET_LATENCY;
+    targets.supervision_timeout = LINK_SUPERVISION_TIMEOUT;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        link_reset(&links[i]);
+        links[i].response_timer.process = &response_timeout_handler;
+        links[i].response_timer.context = &links[i];
+    }
+
+    hci_event_callback_registration.callback = &hci_event_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    l2cap_event_callback_registration.callback = &l2cap_event_handler;
+    l2cap_add_event_handler(&l2cap_event_callback_registration);
+}
+
+void link_tuning_start(hci_con_handle_t con_handle)
+{
+    link_state_t *link = link_add(con_handle);
+    if (!link) return;
+
+    // Re-subscription on the same link: nothing new to negotiate
+    if (link->started) return;
+    link->started = true;
+
+    // The targets as configured first; the ladder only after a refusal
+    link->ladder_step = 0;
+    link_tuning_log(link, "initial");
+
+#if LINK_PREFER_2M_PHY
+    gap_le_set_phy(con_handle, 0, LINK_PHY_2M_MASK, LINK_PHY_2M_MASK, 0);
+#endif
+    link->data_length_pending = true;
+    link_tuning_run();
+
+    if (link->params.conn_interval == targets.interval && link->params.conn_latency == targets.latency) {
+        return;
+    }
+    link_tuning_request_interval(link);
+}
+
+void link_tuning_stop(hci_con_handle_t con_handle)
+{
+    link_state_t *link = link_find(con_handle);
+    if (!link) return;
+    btstack_run_loop_remove_timer(&link->response_timer);
+    link_reset(link);
+}
+
+void link_tuning_set_power(hci_con_handle_t con_handle, uint16_t interval, uint16_t latency)
+{
+    link_state_t *link = link_find(con_handle);
+    if (!link || !link->started) return;
+    if (link->power_interval == interval && link->power_latency == latency) return;
+    link->power_interval = interval;
+    link->power_latency = latency;
+    if (link->interval_request_pending) {
+        link->parameters_changed = true;
+        return;
+    }
+    link_tuning_request_interval(link);
+}
+
+void link_tuning_set_targets(const link_targets_t *new_targets)
+{
+    targets = *new_targets;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        link_state_t *link = &links[i];
+        if (link->params.con_handle == HCI_CON_HANDLE_INVALID || !link->started) continue;
+        link->ladder_step = 0;
+        if (link->power_interval) continue;
+        if (link->interval_request_pending) {
+            link->parameters_changed = true;
+            continue;
+        }
+        link_tuning_request_interval(link);
+    }
+}
+
+const link_targets_t *link_tuning_get_targets(void)
+{
+    return &targets;
+}
+
+const link_params_t *link_tuning_get_params(hci_con_handle_t con_handle)
+{
+    link_state_t *link = link_find(con_handle);
+    return link ? &link->params : NULL;
+}
@@ -0,0 +1,72 @@
+// *****************************************************************************
+// Connection tuning
+//
+// Once the host subscribes to input reports, asks the central for a short
+// connection interval with zero peripheral latency, the LE 2M PHY and the
+// maximum data length. The first request is the target interval and latency
+// exactly; a rejected or unanswered one falls back to the next, longer
+// interval on a fixed ladder, never shorter than the target. What was
+// requested and what the central finally applies are logged, and the
+// latter is kept in link_params_t for the rest of the firmware. Each
+// connection (up to GAMEPAD_MAX_CONNECTIONS) is negotiated independently.
+// The power governor later trades interval and latency for power through
+// link_tuning_set_power().
+// *****************************************************************************
+
+#ifndef LINK_TUNING_H
+#define LINK_TUNING_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+
+typedef struct {
+    hci_con_handle_t con_handle;
+    uint16_t conn_interval;        // 1.25 ms units
+    uint16_t conn_latency;         // Connection events the peripheral may skip
+    uint16_t supervision_timeout;  // 10 ms units
+    uint8_t tx_phy;                // 1 = 1M, 2 = 2M, 3 = Coded
+    uint8_t rx_phy;
+    uint16_t max_tx_octets;        // LL payload, 27 without data length extension
+    uint16_t max_rx_octets;
+    uint8_t interval_rejections;   // Requests the central refused or ignored
+} link_params_t;
+
+// What the tuning stage asks for once a host subscribes
+typedef struct {
+    uint16_t interval;             // Shortest connection interval, 1.25 ms units
+    uint16_t latency;              // Peripheral latency
+    uint16_t supervision_timeout;  // 10 ms units
+} link_targets_t;
+
+// Register for the HCI and L2CAP events the tuning stage needs
+void link_tuning_init(void);
+
+// Start negotiating on a connection whose host has subscribed to reports
+void link_tuning_start(hci_con_handle_t con_handle);
+
+// Ask for a longer interval with peripheral latency to save power, or with
+// interval 0 return to the shortest interval negotiated at start. Rejected
+// requests keep the current parameters.
+void link_tuning_set_power(hci_con_handle_t con_handle, uint16_t interval, uint16_t latency);
+
+// New targets (LINK_TARGET_INTERVAL, LINK_TARGET_LATENCY and
+// LINK_SUPERVISION_TIMEOUT after link_tuning_init()). Links on their
+// negotiated interval ask again at once for the new target interval; links
+// the power governor slowed down keep their parameters until it returns
+// them.
+void link_tuning_set_targets(const link_targets_t *targets);
+const link_targets_t *link_tuning_get_targets(void);
+
+// Forget the connection (disconnect)
+void link_tuning_stop(hci_con_handle_t con_handle);
+
+// Parameters currently in effect, NULL for an unknown connection
+const link_params_t *link_tuning_get_params(hci_con_handle_t con_handle);
+
+static inline uint32_t link_params_interval_us(const link_params_t *params)
+{
+    return (uint32_t)params->conn_interval * 1250;
+}
+
+#endif // LINK_TUNING_H
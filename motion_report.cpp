@@ -0,0 +1,200 @@
+// *****************************************************************************
+// Motion report
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "btstack.h"
+#include "ble/gatt-service/hids_device.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "imu_fusion.h"
+#include "imu_sampler.h"
+#include "motion_report.h"
+#include "power_governor.h"
+#include "trace.h"
+
+// Samples kept for centrals that fell behind; a power of two
+#define MOTION_HISTORY_SAMPLES 16
+
+#define MOTION_SAMPLE_PERIOD_US (1000000 / IMU_SAMPLE_HZ)
+
+// Gyro counts above IMU_ACTIVITY_DPS
+#define MOTION_ACTIVITY_COUNTS (IMU_ACTIVITY_DPS * 32768 / IMU_GYRO_RANGE_DPS)
+
+static_assert(MOTION_HISTORY_SAMPLES >= MOTION_BATCH_SAMPLES &&
+                  (MOTION_HISTORY_SAMPLES & (MOTION_HISTORY_SAMPLES - 1)) == 0,
+              "history must be a power of two holding a batch");
+
+static btstack_data_source_t motion_data_source;
+static imu_fusion_t fusion;
+
+// Sample with counter n is history[n % MOTION_HISTORY_SAMPLES]; counters
+// start at 1, sample_count is the newest
+static imu_sample_t history[MOTION_HISTORY_SAMPLES];
+static uint32_t sample_count;
+static uint32_t previous_us;
+static int16_t orientation[4];
+
+static bool logging;
+static motion_report_stats_t stats;
+
+static bool motion_mtu_fits(hci_con_handle_t con_handle)
+{
+    // Notification: opcode and handle, then the report
+    return att_server_get_mtu(con_handle) >= GAMEPAD_MOTION_REPORT_SIZE + 3;
+}
+
+void motion_report_drain(void)
+{
+    imu_sample_t sample;
+    uint32_t taken = 0;
+    bool active = false;
+    while (imu_sampler_pop(&sample)) {
+        uint32_t dt_us = sample.timestamp_us - previous_us;
+        if (sample_count == 0 || dt_us == 0 || dt_us > 4 * MOTION_SAMPLE_PERIOD_US) {
+            // First sample, or the clock cannot be trusted across the gap
+            dt_us = MOTION_SAMPLE_PERIOD_US;
+        }
+        previous_us = sample.timestamp_us;
+        imu_fusion_update(&fusion, sample.gyro, sample.accel, dt_us);
+        sample_count++;
+        history[sample_count & (MOTION_HISTORY_SAMPLES - 1)] = sample;
+        for (int axis = 0; axis < 3; axis++) {
+            if (sample.gyro[axis] > MOTION_ACTIVITY_COUNTS || sample.gyro[axis] < -MOTION_ACTIVITY_COUNTS) {
+                active = true;
+            }
+        }
+        if (logging) {
+            printf("imu,%lu,%d,%d,%d,%d,%d,%d\n", (unsigned long)sample.timestamp_us, sample.gyro[0],
+                   sample.gyro[1], sample.gyro[2], sample.accel[0], sample.accel[1], sample.accel[2]);
+        }
+        taken++;
+    }
+    if (taken == 0) return;
+    stats.samples += taken;
+    imu_fusion_orientation(&fusion, orientation);
+    if (active) {
+        power_governor_activity();
+    }
+
+    // Nothing piles up for a central the report does not fit
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (!connection->motion_subscribed || motion_mtu_fits(connection->con_handle)) continue;
+        stats.mtu_too_small += sample_count - connection->motion_sent;
+        connection->motion_sent = sample_count;
+    }
+    send_motion_input();
+}
+
+static void motion_data_source_handler(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+    UNUSED(ds);
+    if (callback_type != DATA_SOURCE_CALLBACK_POLL) return;
+    motion_report_drain();
+}
+
+void motion_report_init(void)
+{
+    imu_fusion_init(&fusion, IMU_GYRO_RANGE_DPS, IMU_ACCEL_RANGE_G, IMU_FUSION_KP_MILLI);
+    imu_fusion_orientation(&fusion, orientation);
+    sample_count = 0;
+    motion_report_reset_stats();
+
+    btstack_run_loop_set_data_source_handler(&motion_data_source, &motion_data_source_handler);
+    btstack_run_loop_enable_data_source_callbacks(&motion_data_source, DATA_SOURCE_CALLBACK_POLL);
+    btstack_run_loop_add_data_source(&motion_data_source);
+#if GAMEPAD_MOTION
+    imu_sampler_start();
+#endif
+}
+
+void motion_report_subscribe(gamepad_connection_t *connection, bool enable)
+{
+    connection->motion_subscribed = enable;
+    connection->motion_sent = sample_count;
+}
+
+bool motion_report_due(const gamepad_connection_t *connection)
+{
+    return connection->motion_subscribed && connection->protocol_mode && !connection->acl_queued &&
+           connection->motion_sent != sample_count;
+}
+
+void motion_report_send(gamepad_connection_t *connection)
+{
+    uint32_t pending = sample_count - connection->motion_sent;
+    uint32_t count = pending < MOTION_BATCH_SAMPLES ? pending : MOTION_BATCH_SAMPLES;
+
+    motion_report_t report;
+    memset(&report, 0, sizeof(report));
+    report.sequence = (uint16_t)sample_count;
+    report.count = (uint8_t)count;
+    report.timestamp = (uint16_t)(history[sample_count & (MOTION_HISTORY_SAMPLES - 1)].timestamp_us >> 4);
+    memcpy(report.orientation, orientation, sizeof(report.orientation));
+    for (uint32_t i = 0; i < count; i++) {
+        const imu_sample_t *sample = &history[(sample_count - count + 1 + i) & (MOTION_HISTORY_SAMPLES - 1)];
+        memcpy(&report.gyro[3 * i], sample->gyro, sizeof(sample->gyro));
+        memcpy(&report.accel[3 * i], sample->accel, sizeof(sample->accel));
+    }
+
+    uint8_t hid_report[GAMEPAD_MOTION_REPORT_SIZE];
+    gamepad_motion_report::pack(report, hid_report);
+    uint8_t status = hids_device_send_input_report_for_id(connection->con_handle, GAMEPAD_MOTION_REPORT_ID,
+                                                          hid_report, sizeof(hid_report));
+    if (status != ERROR_CODE_SUCCESS) {
+        stats.send_failures++;
+        TRACE(SEND_FAILED, status);
+        return;
+    }
+    stats.reports++;
+    stats.samples_sent += count;
+    stats.samples_skipped += pending - count;
+    connection->motion_sent = sample_count;
+    connection->acl_queued++;
+}
+
+void motion_report_deferred(void)
+{
+    stats.deferred++;
+}
+
+void motion_report_set_logging(bool enable)
+{
+    logging = enable;
+}
+
+bool motion_report_logging(void)
+{
+    return logging;
+}
+
+const motion_report_stats_t *motion_report_get_stats(void)
+{
+    return &stats;
+}
+
+void motion_report_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void motion_report_dump(void)
+{
+    printf("Motion: %lu samples, %lu reports carrying %lu samples (%lu skipped, %lu over MTU), %lu deferred, "
+           "%lu send failures\n",
+           (unsigned long)stats.samples, (unsigned long)stats.reports, (unsigned long)stats.samples_sent,
+           (unsigned long)stats.samples_skipped, (unsigned long)stats.mtu_too_small, (unsigned long)stats.deferred,
+           (unsigned long)stats.send_failures);
+    printf("Motion: orientation w %d x %d y %d z %d (/16384), %lu of %lu samples corrected by gravity\n",
+           orientation[0], orientation[1], orientation[2], orientation[3], (unsigned long)fusion.corrections,
+           (unsigned long)fusion.updates);
+#if GAMEPAD_MOTION
+    const imu_sampler_stats_t *sampler = imu_sampler_get_stats();
+    printf("IMU: %lu samples, %lu dropped, %lu overruns, %lu bus errors\n", (unsigned long)sampler->samples,
+           (unsigned long)sampler->dropped, (unsigned long)sampler->overruns, (unsigned long)sampler->bus_errors);
+#endif
+}
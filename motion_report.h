@@ -0,0 +1,84 @@
+// *****************************************************************************
+// Motion report
+//
+// IMU samples (imu_sampler.h) are fused into an orientation (imu_fusion.h)
+// on the BTstack core as they arrive and kept in a short history. A central
+// that subscribes to the motion input report (GAMEPAD_MOTION_REPORT_ID, in
+// its own vendor-defined collection) is sent the samples it has not seen,
+// up to MOTION_BATCH_SAMPLES per report:
+//
+//   sequence      sample counter of the newest sample
+//   count         valid samples, oldest first; the rest are zero
+//   timestamp     of the newest sample, 16 us units
+//   orientation   fused w x y z of the newest sample, 16384 = 1.0
+//   gyro          x y z per sample, raw counts (+-IMU_GYRO_RANGE_DPS)
+//   accel         x y z per sample, raw counts (+-IMU_ACCEL_RANGE_G)
+//
+// Motion changes every sample, so it must not crowd out the gamepad
+// reports. A central is offered a motion report only at a CAN_SEND_NOW with
+// no player report due, and only once everything queued for that central
+// has left the controller: a motion report never sits in front of more than
+// one later player report, and a report collects the samples of about one
+// connection interval. When the
+// link is slower than that, the oldest samples are skipped (the host sees
+// the gap in the sequence) while the orientation, fused on the pad, stays
+// current. A central whose ATT MTU cannot carry the report gets none.
+// *****************************************************************************
+
+#ifndef MOTION_REPORT_H
+#define MOTION_REPORT_H
+
+#include <stdint.h>
+
+#include "gamepad_config.h"
+#include "gamepad_connection.h"
+
+typedef struct {
+    uint16_t sequence;
+    uint8_t count;
+    uint16_t timestamp;
+    int16_t orientation[4];
+    int16_t gyro[MOTION_BATCH_SAMPLES * 3];
+    int16_t accel[MOTION_BATCH_SAMPLES * 3];
+} motion_report_t;
+
+typedef struct {
+    uint32_t samples;            // IMU samples fused
+    uint32_t reports;            // Motion reports sent
+    uint32_t samples_sent;       // Samples carried by them, all centrals
+    uint32_t samples_skipped;    // Samples a central never got: the link fell behind
+    uint32_t deferred;           // Grants taken by a player report while motion was due
+    uint32_t mtu_too_small;      // Reports not sent: ATT MTU too small
+    uint32_t send_failures;
+} motion_report_stats_t;
+
+// Reset the fusion, start the IMU (GAMEPAD_MOTION) and register the data
+// source taking its samples
+void motion_report_init(void);
+
+// Take and fuse the waiting samples (also called by the data source)
+void motion_report_drain(void);
+
+// The central (un)subscribed the motion report; it starts from the next sample
+void motion_report_subscribe(gamepad_connection_t *connection, bool enable);
+
+// True if the central is to be offered a motion report at its next grant
+bool motion_report_due(const gamepad_connection_t *connection);
+
+// Serve a grant with a motion report
+void motion_report_send(gamepad_connection_t *connection);
+
+// A grant went to a player report while motion was due
+void motion_report_deferred(void);
+
+// Print each raw sample to stdio as "imu,<time us>,<gx>,<gy>,<gz>,<ax>,<ay>,<az>",
+// the recording format motion_bench replays
+void motion_report_set_logging(bool enable);
+bool motion_report_logging(void);
+
+const motion_report_stats_t *motion_report_get_stats(void);
+void motion_report_reset_stats(void);
+
+void motion_report_dump(void);
+
+#endif // MOTION_REPORT_H
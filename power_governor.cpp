@@ -0,0 +1,162 @@
+// *****************************************************************************
+// Power governor
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "btstack.h"
+#include "gamepad_connection.h"
+#include "link_tuning.h"
+#include "power_governor.h"
+#include "throughput_test.h"
+#include "trace.h"
+
+// How often the quiet time is checked; stepping down is never urgent
+#define POWER_CHECK_PERIOD_MS 250
+
+typedef struct {
+    uint16_t interval;  // 0 = LINK_TARGET_* as negotiated by link_tuning
+    uint16_t latency;
+} power_link_t;
+
+static const power_link_t power_links[POWER_STATE_COUNT] = {
+    { 0, 0 },
+    { POWER_IDLE_INTERVAL, POWER_IDLE_LATENCY },
+    { POWER_SLEEP_INTERVAL, POWER_SLEEP_LATENCY },
+};
+
+static const char *const state_names[POWER_STATE_COUNT] = {
+    "active",
+    "idle",
+    "sleep",
+};
+
+static power_governor_stats_t stats;
+static btstack_timer_source_t check_timer;
+static btstack_timer_source_t advertising_timer;
+
+static void power_set_advertising(uint8_t fast)
+{
+    bd_addr_t null_addr;
+    memset(null_addr, 0, sizeof(null_addr));
+    if (fast) {
+        gap_advertisements_set_params(ADV_FAST_INTERVAL_MIN, ADV_FAST_INTERVAL_MAX, 0, 0, null_addr, 0x07, 0x00);
+    } else {
+        gap_advertisements_set_params(ADV_SLOW_INTERVAL_MIN, ADV_SLOW_INTERVAL_MAX, 0, 0, null_addr, 0x07, 0x00);
+    }
+    stats.advertising_fast = fast;
+}
+
+static void advertising_timer_handler(btstack_timer_source_t *ts)
+{
+    UNUSED(ts);
+    printf("Power: slow advertising\n");
+    power_set_advertising(0);
+}
+
+void power_governor_fast_advertising(void)
+{
+    power_set_advertising(1);
+    btstack_run_loop_remove_timer(&advertising_timer);
+    btstack_run_loop_set_timer(&advertising_timer, ADV_FAST_DURATION_MS);
+    btstack_run_loop_add_timer(&advertising_timer);
+}
+
+static void power_enter(power_state_t state, uint32_t now_ms)
+{
+    power_state_t previous = stats.state;
+    stats.time_ms[previous] += now_ms - stats.state_since_ms;
+    stats.state = state;
+    stats.state_since_ms = now_ms;
+    stats.entered[state]++;
+    TRACE(POWER_STATE, (uint16_t)previous, (uint16_t)state, (uint16_t)(now_ms - stats.last_activity_ms));
+
+    const power_link_t *link = &power_links[state];
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (connection->con_handle == HCI_CON_HANDLE_INVALID || !connection->input_subscribed) continue;
+        link_tuning_set_power(connection->con_handle, link->interval, link->latency);
+    }
+}
+
+static void check_timer_handler(btstack_timer_source_t *ts)
+{
+    uint32_t now_ms = btstack_run_loop_get_time_ms();
+#if GAMEPAD_THROUGHPUT_TEST
+    // The test sends nothing through the report path but needs every event
+    if (throughput_test_active()) {
+        stats.last_activity_ms = now_ms;
+    }
+#endif
+
+    uint32_t quiet_ms = now_ms - stats.last_activity_ms;
+    power_state_t target = POWER_STATE_ACTIVE;
+    if (quiet_ms >= POWER_SLEEP_AFTER_MS) {
+        target = POWER_STATE_SLEEP;
+    } else if (quiet_ms >= POWER_IDLE_AFTER_MS) {
+        target = POWER_STATE_IDLE;
+    }
+    if (target > stats.state && now_ms - stats.state_since_ms >= POWER_MIN_DWELL_MS) {
+        power_enter(target, now_ms);
+    }
+
+    btstack_run_loop_set_timer(ts, POWER_CHECK_PERIOD_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+void power_governor_init(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    stats.state = POWER_STATE_ACTIVE;
+    stats.state_since_ms = btstack_run_loop_get_time_ms();
+    stats.last_activity_ms = stats.state_since_ms;
+    stats.entered[POWER_STATE_ACTIVE] = 1;
+
+    advertising_timer.process = &advertising_timer_handler;
+    power_governor_fast_advertising();
+
+#if GAMEPAD_POWER_GOVERNOR
+    check_timer.process = &check_timer_handler;
+    btstack_run_loop_set_timer(&check_timer, POWER_CHECK_PERIOD_MS);
+    btstack_run_loop_add_timer(&check_timer);
+#endif
+}
+
+void power_governor_activity(void)
+{
+    uint32_t now_ms = btstack_run_loop_get_time_ms();
+    stats.last_activity_ms = now_ms;
+    if (stats.state != POWER_STATE_ACTIVE) {
+        power_enter(POWER_STATE_ACTIVE, now_ms);
+    }
+}
+
+power_state_t power_governor_state(void)
+{
+    return stats.state;
+}
+
+const power_governor_stats_t *power_governor_get_stats(void)
+{
+    return &stats;
+}
+
+const char *power_state_name(power_state_t state)
+{
+    return state < POWER_STATE_COUNT ? state_names[state] : "?";
+}
+
+void power_governor_dump(void)
+{
+    uint32_t now_ms = btstack_run_loop_get_time_ms();
+    printf("Power: %s for %lu ms, last input change %lu ms ago, %s advertising\n", power_state_name(stats.state),
+           (unsigned long)(now_ms - stats.state_since_ms), (unsigned long)(now_ms - stats.last_activity_ms),
+           stats.advertising_fast ? "fast" : "slow");
+    for (int state = 0; state < POWER_STATE_COUNT; state++) {
+        uint32_t time_ms = stats.time_ms[state];
+        if (state == stats.state) time_ms += now_ms - stats.state_since_ms;
+        printf("  %-6s entered %lu times, %lu.%03lu s\n", state_names[state], (unsigned long)stats.entered[state],
+               (unsigned long)(time_ms / 1000), (unsigned long)(time_ms % 1000));
+    }
+}
@@ -0,0 +1,62 @@
+// *****************************************************************************
+// Power governor
+//
+// Trades input latency for radio power based on what the report path sees:
+//
+//   active   LINK_TARGET_* parameters, every connection event attended
+//   idle     no input change for POWER_IDLE_AFTER_MS: longer interval and
+//            peripheral latency, so the radio skips events with nothing to
+//            send but a new report still goes at the next event
+//   sleep    no input change for POWER_SLEEP_AFTER_MS: longer still
+//
+// An input change or a new subscriber returns to active at once; stepping
+// down needs the quiet time and POWER_MIN_DWELL_MS in the current state, so
+// a restless stick cannot make the links flap. The governor also owns the
+// advertising interval: fast after boot and disconnects, slow once
+// ADV_FAST_DURATION_MS passed without a connection.
+// *****************************************************************************
+
+#ifndef POWER_GOVERNOR_H
+#define POWER_GOVERNOR_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+#include "gamepad_config.h"
+
+typedef enum {
+    POWER_STATE_ACTIVE = 0,
+    POWER_STATE_IDLE,
+    POWER_STATE_SLEEP,
+    POWER_STATE_COUNT
+} power_state_t;
+
+typedef struct {
+    power_state_t state;
+    uint32_t state_since_ms;
+    uint32_t last_activity_ms;
+    uint32_t entered[POWER_STATE_COUNT];     // Transitions into each state
+    uint32_t time_ms[POWER_STATE_COUNT];     // Time spent in earlier stays
+    uint8_t advertising_fast;
+} power_governor_stats_t;
+
+// Start in active with fast advertising; call before advertising is enabled
+void power_governor_init(void);
+
+// The report path saw an input change or a subscription (BTstack core)
+void power_governor_activity(void);
+
+// Undirected advertising, fast for ADV_FAST_DURATION_MS: after a disconnect
+// and when directed advertising gave up
+void power_governor_fast_advertising(void);
+
+power_state_t power_governor_state(void);
+
+const power_governor_stats_t *power_governor_get_stats(void);
+
+const char *power_state_name(power_state_t state);
+
+// Print state, time per state and advertising mode to stdio
+void power_governor_dump(void);
+
+#endif // POWER_GOVERNOR_H
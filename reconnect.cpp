@@ -0,0 +1,405 @@
+// *****************************************************************************
+// Fast reconnect to bonded hosts
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "btstack.h"
+#include "btstack_tlv.h"
+#include "boot_timeline.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "power_governor.h"
+#include "reconnect.h"
+
+// TLV tags: 'G','P','B', LE device DB index per bond; 'G','P','L','H' for
+// the last host served
+#define RECONNECT_BOND_TAG(index) (((uint32_t)'G' << 24) | ((uint32_t)'P' << 16) | ((uint32_t)'B' << 8) | (index))
+#define RECONNECT_LAST_HOST_TAG (((uint32_t)'G' << 24) | ((uint32_t)'P' << 16) | ((uint32_t)'L' << 8) | 'H')
+
+// Advertising type for LE Set Advertising Parameters
+#define ADV_DIRECT_IND_HIGH_DUTY 0x01
+
+// What is kept per bond. The identity address guards against the device
+// DB entry having been reused for another host.
+typedef struct {
+    uint8_t device_index;
+    uint8_t addr_type;
+    bd_addr_t addr;
+    uint8_t input_subscribed;
+} bond_record_t;
+
+typedef struct {
+    hci_con_handle_t con_handle;  // HCI_CON_HANDLE_INVALID = free entry
+    int device_index;             // -1 until the link is known to be bonded
+    uint8_t input_subscribed;
+} peer_t;
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static btstack_packet_callback_registration_t sm_event_callback_registration;
+
+static peer_t peers[GAMEPAD_MAX_CONNECTIONS];
+static bond_record_t last_host;
+static bool last_host_valid;
+
+static bool directed_active;
+static btstack_timer_source_t directed_timer;
+
+// Measurement from power-on or link loss to the first report
+static bool session_armed;
+static uint32_t session_start_us;
+static reconnect_timing_t session;
+static reconnect_timing_t last_timing;
+static bool last_timing_valid;
+
+static const btstack_tlv_t *reconnect_tlv(void **context)
+{
+    const btstack_tlv_t *tlv_impl = NULL;
+    btstack_tlv_get_instance(&tlv_impl, context);
+    return tlv_impl;
+}
+
+// Identity of a bonded host from the LE device DB
+static bool bond_identity(int device_index, bond_record_t *record)
+{
+    int addr_type = BD_ADDR_TYPE_UNKNOWN;
+    memset(record, 0, sizeof(*record));
+    if (device_index < 0 || device_index >= le_device_db_max_count()) return false;
+    le_device_db_info(device_index, &addr_type, record->addr, NULL);
+    if (addr_type == BD_ADDR_TYPE_UNKNOWN) return false;
+    record->device_index = (uint8_t)device_index;
+    record->addr_type = (uint8_t)addr_type;
+    return true;
+}
+
+// The stored record, if it still belongs to the bond in the device DB
+static bool bond_record_load(uint32_t tag, int device_index, bond_record_t *record)
+{
+    void *tlv_context = NULL;
+    const btstack_tlv_t *tlv_impl = reconnect_tlv(&tlv_context);
+    bond_record_t identity;
+    if (!tlv_impl) return false;
+    int size = tlv_impl->get_tag(tlv_context, tag, (uint8_t *)record, sizeof(*record));
+    if (size != (int)sizeof(*record)) return false;
+    if (device_index < 0) device_index = record->device_index;
+    if (!bond_identity(device_index, &identity)) return false;
+    return record->device_index == identity.device_index && record->addr_type == identity.addr_type &&
+           memcmp(record->addr, identity.addr, sizeof(bd_addr_t)) == 0;
+}
+
+// Write only what changed; flash wears
+static void bond_record_store(uint32_t tag, const bond_record_t *record)
+{
+    void *tlv_context = NULL;
+    const btstack_tlv_t *tlv_impl = reconnect_tlv(&tlv_context);
+    bond_record_t stored;
+    if (!tlv_impl) return;
+    if (bond_record_load(tag, record->device_index, &stored) && memcmp(&stored, record, sizeof(stored)) == 0) return;
+    tlv_impl->store_tag(tlv_context, tag, (const uint8_t *)record, sizeof(*record));
+}
+
+// Keep the peer's subscriptions with its bond, and it as the last host
+static void bond_update(const peer_t *peer)
+{
+    bond_record_t record;
+    if (!bond_identity(peer->device_index, &record)) return;
+    record.input_subscribed = peer->input_subscribed;
+    bond_record_store(RECONNECT_BOND_TAG(record.device_index), &record);
+
+    record.input_subscribed = 0;
+    if (last_host_valid && memcmp(&last_host, &record, sizeof(record)) == 0) return;
+    last_host = record;
+    last_host_valid = true;
+    bond_record_store(RECONNECT_LAST_HOST_TAG, &record);
+}
+
+static peer_t *peer_find(hci_con_handle_t con_handle)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (peers[i].con_handle == con_handle) return &peers[i];
+    }
+    return NULL;
+}
+
+static peer_t *peer_add(hci_con_handle_t con_handle)
+{
+    peer_t *peer = peer_find(con_handle);
+    if (peer) return peer;
+    peer = peer_find(HCI_CON_HANDLE_INVALID);
+    if (!peer) return NULL;
+    peer->con_handle = con_handle;
+    peer->device_index = -1;
+    peer->input_subscribed = 0;
+    return peer;
+}
+
+static void session_start(uint8_t after_link_loss, uint32_t start_us)
+{
+    memset(&session, 0, sizeof(session));
+    session.after_link_loss = after_link_loss;
+    session.con_handle = HCI_CON_HANDLE_INVALID;
+    session_start_us = start_us;
+    session_armed = true;
+}
+
+// Time into the session, never 0 so that 0 can mean "not reached"
+static uint32_t session_elapsed_us(void)
+{
+    uint32_t elapsed_us = time_us_32() - session_start_us;
+    return elapsed_us ? elapsed_us : 1;
+}
+
+static bool session_follows(hci_con_handle_t con_handle)
+{
+    return session_armed && session.con_handle == con_handle && con_handle != HCI_CON_HANDLE_INVALID;
+}
+
+// The first session after power-on completes the boot timeline
+static void session_mark(boot_mark_t mark)
+{
+    if (!session.after_link_loss) {
+        boot_timeline_mark(mark);
+    }
+}
+
+static void print_ms(const char *label, uint32_t value_us)
+{
+    if (!value_us) {
+        printf(", %s -", label);
+        return;
+    }
+    printf(", %s %lu.%02lu ms", label, (unsigned long)(value_us / 1000), (unsigned long)(value_us % 1000 / 10));
+}
+
+static void print_timing(const reconnect_timing_t *timing)
+{
+    printf("Reconnect 0x%04x after %s (%s advertising%s)", timing->con_handle,
+           timing->after_link_loss ? "link loss" : "power-on", timing->directed ? "directed" : "undirected",
+           timing->resumed ? ", subscriptions from bond" : "");
+    print_ms("connected", timing->connected_us);
+    print_ms("encrypted", timing->encrypted_us);
+    print_ms("reporting", timing->reporting_us);
+    print_ms("first report", timing->first_report_us);
+    printf("\n");
+}
+
+static void directed_stop(void)
+{
+    directed_active = false;
+    btstack_run_loop_remove_timer(&directed_timer);
+}
+
+// Directed advertising ended without a connection: advertise to everyone
+static void directed_fall_back(void)
+{
+    if (!directed_active) return;
+    directed_stop();
+    printf("Reconnect: no answer to directed advertising\n");
+    gap_advertisements_enable(0);
+    power_governor_fast_advertising();
+    gap_advertisements_enable(1);
+}
+
+static void directed_timeout_handler(btstack_timer_source_t *ts)
+{
+    UNUSED(ts);
+    directed_fall_back();
+}
+
+// Advertise directed at a bonded host; false if there is none to try
+static bool directed_start(const bond_record_t *host, bool restart)
+{
+    if (RECONNECT_DIRECTED_MS == 0) return false;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (peers[i].con_handle != HCI_CON_HANDLE_INVALID && peers[i].device_index == host->device_index) {
+            return false;
+        }
+    }
+
+    bd_addr_t addr;
+    memcpy(addr, host->addr, sizeof(addr));
+    printf("Reconnect: directed advertising to %s\n", bd_addr_to_str(addr));
+    if (restart) {
+        gap_advertisements_enable(0);
+    }
+    gap_advertisements_set_params(ADV_FAST_INTERVAL_MIN, ADV_FAST_INTERVAL_MAX, ADV_DIRECT_IND_HIGH_DUTY,
+                                  host->addr_type, addr, 0x07, 0x00);
+    if (restart) {
+        gap_advertisements_enable(1);
+    }
+    directed_active = true;
+    session.directed = 1;
+
+    // The controller also stops after 1.28 s; this covers a lost event
+    btstack_run_loop_remove_timer(&directed_timer);
+    btstack_run_loop_set_timer(&directed_timer, RECONNECT_DIRECTED_MS);
+    btstack_run_loop_add_timer(&directed_timer);
+    return true;
+}
+
+static void reconnect_connected(hci_con_handle_t con_handle)
+{
+    peer_add(con_handle);
+    if (directed_active) {
+        // Further centrals find the device with undirected advertising
+        directed_stop();
+        power_governor_fast_advertising();
+    }
+    if (session_armed && session.con_handle == HCI_CON_HANDLE_INVALID) {
+        session.con_handle = con_handle;
+        session.connected_us = session_elapsed_us();
+        session_mark(BOOT_MARK_CONNECTED);
+    }
+}
+
+static void reconnect_encrypted(hci_con_handle_t con_handle)
+{
+    peer_t *peer = peer_add(con_handle);
+    if (session_follows(con_handle) && !session.encrypted_us) {
+        session.encrypted_us = session_elapsed_us();
+        session_mark(BOOT_MARK_ENCRYPTED);
+    }
+    if (!peer) return;
+    peer->device_index = sm_le_device_index(con_handle);
+    if (peer->device_index < 0) return;
+
+    // Keys from an earlier pairing: the host expects its CCCDs kept
+    bond_record_t record;
+    if (!peer->input_subscribed && bond_record_load(RECONNECT_BOND_TAG(peer->device_index), peer->device_index,
+                                                    &record) && record.input_subscribed) {
+        if (session_follows(con_handle)) {
+            session.resumed = 1;
+        }
+        printf("Reconnect: resuming reports 0x%02x on 0x%04x\n", record.input_subscribed, con_handle);
+        gamepad_resume_reports(con_handle, record.input_subscribed);
+    }
+    bond_update(peer);
+}
+
+static void reconnect_paired(hci_con_handle_t con_handle)
+{
+    peer_t *peer = peer_find(con_handle);
+    if (!peer) return;
+    peer->device_index = sm_le_device_index(con_handle);
+    bond_update(peer);
+}
+
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size)
+{
+    UNUSED(channel);
+    UNUSED(size);
+
+    if (packet_type != HCI_EVENT_PACKET) return;
+
+    switch (hci_event_packet_get_type(packet)) {
+        case HCI_EVENT_LE_META:
+            if (hci_event_le_meta_get_subevent_code(packet) != HCI_SUBEVENT_LE_CONNECTION_COMPLETE) break;
+            if (hci_subevent_le_connection_complete_get_status(packet) == ERROR_CODE_ADVERTISING_TIMEOUT) {
+                directed_fall_back();
+                break;
+            }
+            if (hci_subevent_le_connection_complete_get_status(packet)) break;
+            reconnect_connected(hci_subevent_le_connection_complete_get_connection_handle(packet));
+            break;
+
+        case HCI_EVENT_ENCRYPTION_CHANGE:
+            if (hci_event_encryption_change_get_status(packet)) break;
+            if (!hci_event_encryption_change_get_encryption_enabled(packet)) break;
+            reconnect_encrypted(hci_event_encryption_change_get_connection_handle(packet));
+            break;
+
+        case SM_EVENT_PAIRING_COMPLETE:
+            if (sm_event_pairing_complete_get_status(packet)) break;
+            reconnect_paired(sm_event_pairing_complete_get_handle(packet));
+            break;
+
+        default:
+            break;
+    }
+}
+
+void reconnect_init(void)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        peers[i].con_handle = HCI_CON_HANDLE_INVALID;
+        peers[i].device_index = -1;
+        peers[i].input_subscribed = 0;
+    }
+    directed_active = false;
+    directed_timer.process = &directed_timeout_handler;
+    last_timing_valid = false;
+
+    hci_event_callback_registration.callback = &hci_event_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+    sm_event_callback_registration.callback = &hci_event_handler;
+    sm_add_event_handler(&sm_event_callback_registration);
+
+    // Power-on is time 0 of time_us_32()
+    session_start(0, 0);
+    last_host_valid = bond_record_load(RECONNECT_LAST_HOST_TAG, -1, &last_host);
+    if (last_host_valid) {
+        directed_start(&last_host, false);
+    }
+}
+
+void reconnect_link_lost(hci_con_handle_t con_handle)
+{
+    peer_t *peer = peer_find(con_handle);
+    bond_record_t host;
+    bool bonded = peer && bond_identity(peer->device_index, &host);
+    if (peer) {
+        peer->con_handle = HCI_CON_HANDLE_INVALID;
+    }
+
+    session_start(1, time_us_32());
+    if (!bonded) {
+        host = last_host;
+        bonded = last_host_valid;
+    }
+    if (bonded && directed_start(&host, true)) return;
+    power_governor_fast_advertising();
+}
+
+void reconnect_subscribed(hci_con_handle_t con_handle, uint8_t input_subscribed)
+{
+    peer_t *peer = peer_add(con_handle);
+    if (session_follows(con_handle) && input_subscribed && !session.reporting_us) {
+        session.reporting_us = session_elapsed_us();
+        session_mark(BOOT_MARK_REPORTING);
+    }
+    if (!peer || peer->input_subscribed == input_subscribed) return;
+    peer->input_subscribed = input_subscribed;
+    bond_update(peer);
+}
+
+void reconnect_report_sent(hci_con_handle_t con_handle)
+{
+    if (!session_follows(con_handle)) return;
+    session.first_report_us = session_elapsed_us();
+    session_armed = false;
+    last_timing = session;
+    last_timing_valid = true;
+    print_timing(&last_timing);
+    session_mark(BOOT_MARK_FIRST_REPORT);
+}
+
+const reconnect_timing_t *reconnect_get_timing(void)
+{
+    return last_timing_valid ? &last_timing : NULL;
+}
+
+void reconnect_dump(void)
+{
+    if (last_host_valid) {
+        bd_addr_t addr;
+        memcpy(addr, last_host.addr, sizeof(addr));
+        printf("Reconnect: last host %s (bond %u)%s\n", bd_addr_to_str(addr), last_host.device_index,
+               directed_active ? ", directed advertising" : "");
+    }
+    if (last_timing_valid) {
+        print_timing(&last_timing);
+    }
+}
@@ -0,0 +1,51 @@
+// *****************************************************************************
+// Fast reconnect to bonded hosts
+//
+// After power-on or a link loss the device advertises directed at the
+// bonded host it last served (high duty cycle, RECONNECT_DIRECTED_MS), so
+// the host connects without scanning, then falls back to undirected
+// advertising. Bonded hosts keep their CCCDs and do not write them again,
+// so the input reports each bonded host subscribed to are kept in flash per
+// LE device DB entry and restored as soon as the link is encrypted with the
+// stored keys; reports flow without waiting for the host. The time from
+// power-on or link loss to connection, encryption, reporting and the first
+// report is logged.
+// *****************************************************************************
+
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+
+typedef struct {
+    uint8_t after_link_loss;     // 0 = measured from power-on
+    uint8_t directed;            // Directed advertising was running
+    uint8_t resumed;             // Subscriptions restored from the bond
+    hci_con_handle_t con_handle;
+    uint32_t connected_us;       // Times since power-on / link loss, 0 = not reached
+    uint32_t encrypted_us;
+    uint32_t reporting_us;       // Input reports enabled, by the host or from the bond
+    uint32_t first_report_us;
+} reconnect_timing_t;
+
+// Register for the events; starts directed advertising if a bonded host is
+// known. Call after gap and sm setup, before advertising is enabled.
+void reconnect_init(void);
+
+// A central disconnected: advertise directed at it if bonded
+void reconnect_link_lost(hci_con_handle_t con_handle);
+
+// The host changed its input report subscriptions (bit per player)
+void reconnect_subscribed(hci_con_handle_t con_handle, uint8_t input_subscribed);
+
+// An input report went to the controller
+void reconnect_report_sent(hci_con_handle_t con_handle);
+
+// Timing of the last completed reconnect, NULL before the first
+const reconnect_timing_t *reconnect_get_timing(void);
+
+void reconnect_dump(void);
+
+#endif // RECONNECT_H
@@ -0,0 +1,105 @@
+// *****************************************************************************
+// Latest-state report mailbox
+// *****************************************************************************
+
+#include <string.h>
+
+#include "report_mailbox.h"
+
+int gamepad_report_equal(const gamepad_report_t *a, const gamepad_report_t *b)
+{
+    // Field-wise: struct padding is not guaranteed to match
+    return a->buttons == b->buttons &&
+           a->left_x == b->left_x && a->left_y == b->left_y &&
+           a->right_x == b->right_x && a->right_y == b->right_y &&
+           a->left_trigger == b->left_trigger && a->right_trigger == b->right_trigger &&
+           a->dpad == b->dpad;
+}
+
+static int report_mailbox_request(report_mailbox_t *mailbox)
+{
+    if (!mailbox->link_ready || mailbox->request_outstanding) return 0;
+    mailbox->request_outstanding = 1;
+    return 1;
+}
+
+void report_mailbox_init(report_mailbox_t *mailbox, uint32_t keepalive_ms)
+{
+    memset(mailbox, 0, sizeof(*mailbox));
+    mailbox->pending.dpad = DPAD_NEUTRAL;
+    mailbox->keepalive_ms = keepalive_ms;
+}
+
+int report_mailbox_post(report_mailbox_t *mailbox, const gamepad_report_t *report)
+{
+    mailbox->posted++;
+
+    if (mailbox->has_sent && gamepad_report_equal(report, &mailbox->last_sent)) {
+        // Back to what the host already has: nothing to send
+        if (mailbox->dirty) {
+            mailbox->coalesced++;
+        } else {
+            mailbox->suppressed++;
+        }
+        mailbox->pending = *report;
+        mailbox->dirty = 0;
+        return 0;
+    }
+
+    if (mailbox->dirty) {
+        if (gamepad_report_equal(report, &mailbox->pending)) {
+            mailbox->suppressed++;
+            return 0;
+        }
+        mailbox->coalesced++;
+    }
+    mailbox->pending = *report;
+    mailbox->dirty = 1;
+    return report_mailbox_request(mailbox);
+}
+
+int report_mailbox_take(report_mailbox_t *mailbox, gamepad_report_t *report, uint32_t now_ms)
+{
+    mailbox->request_outstanding = 0;
+
+    if (mailbox->dirty) {
+        mailbox->last_sent = mailbox->pending;
+        mailbox->has_sent = 1;
+        mailbox->dirty = 0;
+        mailbox->last_sent_ms = now_ms;
+        mailbox->sent++;
+        *report = mailbox->last_sent;
+        return 1;
+    }
+
+    if (mailbox->has_sent && mailbox->keepalive_ms &&
+        (int32_t)(now_ms - mailbox->last_sent_ms) >= (int32_t)mailbox->keepalive_ms) {
+        mailbox->last_sent_ms = now_ms;
+        mailbox->keepalives++;
+        *report = mailbox->last_sent;
+        return 1;
+    }
+    return 0;
+}
+
+int report_mailbox_keepalive(report_mailbox_t *mailbox, uint32_t now_ms)
+{
+    if (!mailbox->has_sent || !mailbox->keepalive_ms) return 0;
+    if ((int32_t)(now_ms - mailbox->last_sent_ms) < (int32_t)mailbox->keepalive_ms) return 0;
+    return report_mailbox_request(mailbox);
+}
+
+int report_mailbox_link_up(report_mailbox_t *mailbox)
+{
+    mailbox->link_ready = 1;
+    mailbox->request_outstanding = 0;
+    mailbox->has_sent = 0;
+    mailbox->dirty = 1;
+    return report_mailbox_request(mailbox);
+}
+
+void report_mailbox_link_down(report_mailbox_t *mailbox)
+{
+    mailbox->link_ready = 0;
+    mailbox->request_outstanding = 0;
+}
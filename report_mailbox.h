@@ -0,0 +1,55 @@
+// *****************************************************************************
+// Latest-state report mailbox
+//
+// Holds the most recent input state for one link. Updates posted between
+// two CAN_SEND_NOW events collapse into a single pending report, reports
+// identical to the last one sent are suppressed, and at most one
+// can-send-now request is outstanding at any time.
+// *****************************************************************************
+
+#ifndef REPORT_MAILBOX_H
+#define REPORT_MAILBOX_H
+
+#include <stdint.h>
+
+#include "gamepad.h"
+
+typedef struct {
+    gamepad_report_t pending;     // Latest posted state
+    gamepad_report_t last_sent;   // State of the last notification
+    uint32_t last_sent_ms;
+    uint32_t keepalive_ms;        // 0 = no keep-alive resend
+    uint8_t dirty;                // pending differs from last_sent
+    uint8_t has_sent;             // last_sent is valid on this link
+    uint8_t link_ready;           // Subscribed, requests may be issued
+    uint8_t request_outstanding;  // can-send-now requested, not yet served
+
+    // Statistics
+    uint32_t posted;
+    uint32_t coalesced;           // Pending report replaced before it was sent
+    uint32_t suppressed;          // Post identical to the last sent report
+    uint32_t sent;
+    uint32_t keepalives;
+} report_mailbox_t;
+
+void report_mailbox_init(report_mailbox_t *mailbox, uint32_t keepalive_ms);
+
+// Post a new state. Returns 1 if the caller must request a can-send-now event.
+int report_mailbox_post(report_mailbox_t *mailbox, const gamepad_report_t *report);
+
+// Serve a CAN_SEND_NOW event. Returns 1 and fills report if something is due.
+int report_mailbox_take(report_mailbox_t *mailbox, gamepad_report_t *report, uint32_t now_ms);
+
+// Returns 1 if the caller must request a can-send-now event for a keep-alive.
+int report_mailbox_keepalive(report_mailbox_t *mailbox, uint32_t now_ms);
+
+// Link subscribed: the current state is sent in full. Returns 1 if the
+// caller must request a can-send-now event.
+int report_mailbox_link_up(report_mailbox_t *mailbox);
+
+// Link lost: drop the outstanding request, keep the latest state
+void report_mailbox_link_down(report_mailbox_t *mailbox);
+
+int gamepad_report_equal(const gamepad_report_t *a, const gamepad_report_t *b);
+
+#endif // REPORT_MAILBOX_H
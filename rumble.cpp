@@ -0,0 +1,205 @@
+// *****************************************************************************
+// Rumble
+// *****************************************************************************
+
+#include <stdio.h>
+
+#include <atomic>
+
+#include "pico/time.h"
+
+#include "btstack.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "latency_stats.h"
+#include "rumble.h"
+#include "rumble_motors.h"
+
+#define RUMBLE_UNIT_US 10000
+
+typedef enum {
+    RUMBLE_IDLE = 0,
+    RUMBLE_DELAY,       // Off before a repetition
+    RUMBLE_ON,
+} rumble_phase_t;
+
+typedef struct {
+    rumble_report_t report;
+    uint32_t written_us;
+} rumble_request_t;
+
+// Newest request, handed from the BTstack core to the alarm interrupt under
+// a sequence lock: odd while being written
+static rumble_request_t pending;
+static std::atomic<uint32_t> pending_sequence;
+
+// Alarm interrupt only
+static uint32_t taken_sequence;
+static rumble_report_t effect;
+static rumble_phase_t phase;
+static uint32_t phase_end_us;
+static uint8_t repetitions_left;
+static bool latency_due;
+static uint32_t latency_from_us;
+
+// BTstack core
+static hci_con_handle_t effect_con_handle = HCI_CON_HANDLE_INVALID;
+static rumble_stats_t stats;
+
+static bool rumble_take_request(rumble_request_t *request)
+{
+    uint32_t sequence = pending_sequence.load(std::memory_order_acquire);
+    if ((sequence & 1) || sequence == taken_sequence) return false;
+    *request = pending;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (pending_sequence.load(std::memory_order_relaxed) != sequence) return false;
+    taken_sequence = sequence;
+    return true;
+}
+
+static void rumble_motors_changed(void)
+{
+    if (latency_due) {
+        latency_due = false;
+        latency_stats_motor(latency_from_us);
+    }
+}
+
+static void rumble_off(void)
+{
+    phase = RUMBLE_IDLE;
+    rumble_motors_set(0, 0);
+    rumble_motors_changed();
+}
+
+// Without a duration the motors run until the next report, or the safety stop
+static void rumble_on(uint32_t start_us)
+{
+    phase = RUMBLE_ON;
+    phase_end_us = start_us + (effect.duration ? effect.duration * RUMBLE_UNIT_US : RUMBLE_MAX_ON_MS * 1000u);
+    rumble_motors_set(effect.strong, effect.weak);
+    rumble_motors_changed();
+}
+
+static void rumble_delay(uint32_t start_us)
+{
+    phase = RUMBLE_DELAY;
+    phase_end_us = start_us + effect.start_delay * RUMBLE_UNIT_US;
+    rumble_motors_set(0, 0);
+}
+
+static void rumble_begin(const rumble_request_t *request, uint32_t now_us)
+{
+    effect = request->report;
+    repetitions_left = effect.loop_count;
+    latency_from_us = request->written_us;
+    if (!effect.strong && !effect.weak) {
+        // Stopping stopped motors changes nothing to measure
+        latency_due = phase != RUMBLE_IDLE;
+        rumble_off();
+        return;
+    }
+    latency_due = true;
+    stats.effects++;
+    if (effect.start_delay) {
+        // The motors are due to change once the delay is over
+        latency_from_us += effect.start_delay * RUMBLE_UNIT_US;
+        rumble_delay(now_us);
+    } else {
+        rumble_on(now_us);
+    }
+}
+
+// Phases follow each other from their scheduled ends, so a late interrupt
+// does not stretch the envelope
+static void rumble_next_phase(void)
+{
+    if (phase == RUMBLE_DELAY) {
+        rumble_on(phase_end_us);
+        return;
+    }
+    if (!effect.duration) {
+        stats.safety_stops++;
+        rumble_off();
+        return;
+    }
+    if (!repetitions_left) {
+        rumble_off();
+        return;
+    }
+    repetitions_left--;
+    if (effect.start_delay) {
+        rumble_delay(phase_end_us);
+    } else {
+        rumble_on(phase_end_us);
+    }
+}
+
+static void rumble_alarm_handler(void)
+{
+    uint32_t now_us = time_us_32();
+    rumble_request_t request;
+    if (rumble_take_request(&request)) {
+        rumble_begin(&request, now_us);
+    } else if (phase != RUMBLE_IDLE && (int32_t)(now_us - phase_end_us) >= 0) {
+        rumble_next_phase();
+    }
+    if (phase != RUMBLE_IDLE) {
+        rumble_motors_alarm_at(phase_end_us);
+    }
+}
+
+static void rumble_request(const rumble_report_t *report)
+{
+    uint32_t sequence = pending_sequence.load(std::memory_order_relaxed);
+    pending_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    pending.report = *report;
+    pending.written_us = time_us_32();
+    pending_sequence.store(sequence + 2, std::memory_order_release);
+
+    // The interrupt takes it from here
+    rumble_motors_alarm_at(pending.written_us);
+}
+
+void rumble_init(void)
+{
+    phase = RUMBLE_IDLE;
+    effect_con_handle = HCI_CON_HANDLE_INVALID;
+    taken_sequence = pending_sequence.load(std::memory_order_relaxed);
+    rumble_motors_init(&rumble_alarm_handler);
+    rumble_motors_set(0, 0);
+}
+
+void rumble_set_report(hci_con_handle_t con_handle, const uint8_t *report, uint16_t report_len)
+{
+    stats.reports++;
+    if (report_len != GAMEPAD_RUMBLE_REPORT_SIZE) {
+        stats.invalid++;
+        return;
+    }
+    rumble_report_t effect_report;
+    gamepad_rumble_report::unpack(report, effect_report);
+    effect_con_handle = con_handle;
+    rumble_request(&effect_report);
+}
+
+void rumble_link_lost(hci_con_handle_t con_handle)
+{
+    if (con_handle != effect_con_handle) return;
+    effect_con_handle = HCI_CON_HANDLE_INVALID;
+    rumble_report_t stop = {};
+    rumble_request(&stop);
+}
+
+const rumble_stats_t *rumble_get_stats(void)
+{
+    return &stats;
+}
+
+void rumble_dump(void)
+{
+    printf("Rumble: %lu reports (%lu invalid), %lu effects, %lu safety stops, now %s\n",
+           (unsigned long)stats.reports, (unsigned long)stats.invalid, (unsigned long)stats.effects,
+           (unsigned long)stats.safety_stops, phase == RUMBLE_ON ? "on" : phase == RUMBLE_DELAY ? "waiting" : "off");
+}
@@ -0,0 +1,54 @@
+// *****************************************************************************
+// Rumble
+//
+// The host writes the rumble output report (GAMEPAD_RUMBLE_REPORT_ID) to
+// start an effect on the two motors:
+//
+//   strong, weak   motor strength 0..255 (PWM duty)
+//   duration       on time per repetition, 10 ms units; 0 = until the next report
+//   start_delay    off time before each repetition, 10 ms units
+//   loop_count     repetitions after the first
+//
+// A report with both strengths 0 stops the motors. The envelope is run from
+// a hardware alarm interrupt (rumble_motors.h), not the BTstack run loop, so
+// a busy run loop does not stretch or delay it. The time from the write
+// reaching the report handler to the motors changing is recorded as the
+// write->motor latency stage (latency_stats.h).
+// *****************************************************************************
+
+#ifndef RUMBLE_H
+#define RUMBLE_H
+
+#include <stdint.h>
+
+#include "btstack.h"
+
+typedef struct {
+    uint8_t strong;
+    uint8_t weak;
+    uint8_t duration;
+    uint8_t start_delay;
+    uint8_t loop_count;
+} rumble_report_t;
+
+typedef struct {
+    uint32_t reports;          // Output reports taken
+    uint32_t invalid;          // Output reports of the wrong length
+    uint32_t effects;          // Effects started (non-zero strength)
+    uint32_t safety_stops;     // Motors stopped after RUMBLE_MAX_ON_MS
+} rumble_stats_t;
+
+// Motors off, alarm claimed
+void rumble_init(void);
+
+// An output report written by the host on con_handle (BTstack core)
+void rumble_set_report(hci_con_handle_t con_handle, const uint8_t *report, uint16_t report_len);
+
+// The link that wrote the running effect is gone: stop it
+void rumble_link_lost(hci_con_handle_t con_handle);
+
+const rumble_stats_t *rumble_get_stats(void);
+
+void rumble_dump(void);
+
+#endif // RUMBLE_H
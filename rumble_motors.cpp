@@ -0,0 +1,66 @@
+// *****************************************************************************
+// Rumble motor outputs and envelope alarm (RP2040)
+// *****************************************************************************
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/pwm.h"
+#include "hardware/timer.h"
+
+#include "gamepad_config.h"
+#include "rumble_motors.h"
+
+static uint16_t pwm_top;
+static int alarm_num = -1;
+static void (*alarm_handler)(void);
+
+static void rumble_motors_alarm_callback(uint alarm)
+{
+    (void)alarm;
+    alarm_handler();
+}
+
+static void rumble_motor_init(uint gpio)
+{
+    uint slice = pwm_gpio_to_slice_num(gpio);
+    gpio_set_function(gpio, GPIO_FUNC_PWM);
+    pwm_set_wrap(slice, pwm_top);
+    pwm_set_gpio_level(gpio, 0);
+    pwm_set_enabled(slice, true);
+}
+
+static uint16_t rumble_motor_level(uint8_t strength)
+{
+    return (uint16_t)(((uint32_t)strength * ((uint32_t)pwm_top + 1) + 127) / 255);
+}
+
+void rumble_motors_init(void (*handler)(void))
+{
+    uint32_t top = clock_get_hz(clk_sys) / RUMBLE_PWM_HZ - 1;
+    hard_assert(top <= 0xFFFF);
+    pwm_top = (uint16_t)top;
+    rumble_motor_init(RUMBLE_STRONG_GPIO);
+    rumble_motor_init(RUMBLE_WEAK_GPIO);
+
+    // The alarm interrupt is taken on this core
+    alarm_handler = handler;
+    alarm_num = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm_num, rumble_motors_alarm_callback);
+}
+
+void rumble_motors_set(uint8_t strong, uint8_t weak)
+{
+    pwm_set_gpio_level(RUMBLE_STRONG_GPIO, rumble_motor_level(strong));
+    pwm_set_gpio_level(RUMBLE_WEAK_GPIO, rumble_motor_level(weak));
+}
+
+void rumble_motors_alarm_at(uint32_t target_us)
+{
+    int32_t delta_us = (int32_t)(target_us - time_us_32());
+    absolute_time_t target = delayed_by_us(get_absolute_time(), delta_us > 0 ? (uint64_t)delta_us : 0);
+    if (hardware_alarm_set_target(alarm_num, target)) {
+        // Already passed, no interrupt would come
+        hardware_alarm_force_irq(alarm_num);
+    }
+}
@@ -0,0 +1,26 @@
+// *****************************************************************************
+// Rumble motor outputs and envelope alarm (RP2040)
+//
+// Two motors driven by PWM at RUMBLE_PWM_HZ from RUMBLE_STRONG_GPIO and
+// RUMBLE_WEAK_GPIO, and one hardware timer alarm whose interrupt runs the
+// rumble envelope. The host build replaces this with a mock on the virtual
+// clock.
+// *****************************************************************************
+
+#ifndef RUMBLE_MOTORS_H
+#define RUMBLE_MOTORS_H
+
+#include <stdint.h>
+
+// Set up the PWM outputs (off) and claim an alarm calling handler from its
+// interrupt
+void rumble_motors_init(void (*handler)(void));
+
+// Motor strengths, 0..255
+void rumble_motors_set(uint8_t strong, uint8_t weak);
+
+// Run the handler at target_us (time_us_32()), or at once if that has passed.
+// Replaces any earlier target.
+void rumble_motors_alarm_at(uint32_t target_us);
+
+#endif // RUMBLE_MOTORS_H
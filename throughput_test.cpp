@@ -0,0 +1,173 @@
+// *****************************************************************************
+// Saturation throughput test
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "btstack.h"
+#include "ble/gatt-service/hids_device.h"
+#include "gamepad_layout.h"
+#include "throughput_test.h"
+
+static bool active;
+static throughput_stats_t stats;
+
+// Per connection slot; reset when the slot's central changes
+static hci_con_handle_t slot_con_handle[GAMEPAD_MAX_CONNECTIONS];
+static uint32_t slot_sequence[GAMEPAD_MAX_CONNECTIONS];
+static uint32_t slot_request_us[GAMEPAD_MAX_CONNECTIONS];
+static uint8_t slot_request_exhausted[GAMEPAD_MAX_CONNECTIONS];
+
+static int throughput_slot(const gamepad_connection_t *connection)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (gamepad_connection_at(i) != connection) continue;
+        if (slot_con_handle[i] != connection->con_handle) {
+            slot_con_handle[i] = connection->con_handle;
+            slot_sequence[i] = 0;
+            slot_request_exhausted[i] = 0;
+        }
+        return i;
+    }
+    return -1;
+}
+
+static bool throughput_is_test_central(hci_con_handle_t con_handle)
+{
+    const gamepad_connection_t *connection = gamepad_connection_find(con_handle);
+    return connection && (connection->input_subscribed & 1u) && connection->protocol_mode;
+}
+
+// Like the report path's request, plus the stall bookkeeping
+static void throughput_request(gamepad_connection_t *connection, int slot)
+{
+    if (connection->can_send_requested) return;
+    slot_request_us[slot] = time_us_32();
+    slot_request_exhausted[slot] = hci_number_free_acl_slots_for_handle(connection->con_handle) <= 0;
+    if (slot_request_exhausted[slot]) {
+        stats.exhausted++;
+    }
+    gamepad_connection_request_can_send_now(connection);
+}
+
+void throughput_test_start(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    memset(slot_sequence, 0, sizeof(slot_sequence));
+    memset(slot_request_exhausted, 0, sizeof(slot_request_exhausted));
+    stats.start_us = time_us_32();
+    active = true;
+
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        gamepad_connection_t *connection = gamepad_connection_at(i);
+        if (connection->con_handle == HCI_CON_HANDLE_INVALID) continue;
+        slot_con_handle[i] = connection->con_handle;
+        if (!throughput_is_test_central(connection->con_handle)) continue;
+        throughput_request(connection, i);
+    }
+}
+
+void throughput_test_stop(void)
+{
+    if (!active) return;
+    stats.elapsed_us = time_us_32() - stats.start_us;
+    active = false;
+}
+
+bool throughput_test_active(void)
+{
+    return active;
+}
+
+void throughput_test_can_send_now(gamepad_connection_t *connection)
+{
+    int slot = throughput_slot(connection);
+    if (slot < 0 || !throughput_is_test_central(connection->con_handle)) return;
+
+    uint32_t now_us = time_us_32();
+    if (slot_request_exhausted[slot]) {
+        uint32_t stall_us = now_us - slot_request_us[slot];
+        stats.stall_sum_us += stall_us;
+        if (stall_us > stats.stall_max_us) stats.stall_max_us = stall_us;
+    }
+
+    gamepad_report_t report;
+    memset(&report, 0, sizeof(report));
+    uint32_t sequence = slot_sequence[slot];
+    report.left_x = (int16_t)(sequence & 0xffff);
+    report.left_y = (int16_t)(sequence >> 16);
+    report.right_x = (int16_t)(now_us & 0xffff);
+    report.right_y = (int16_t)(now_us >> 16);
+    report.left_trigger = THROUGHPUT_TEST_MARKER;
+    report.right_trigger = THROUGHPUT_TEST_MARKER;
+    report.dpad = DPAD_NEUTRAL;
+
+    uint8_t hid_report[GAMEPAD_REPORT_SIZE];
+    gamepad_input_report::pack(report, hid_report);
+    if (hids_device_send_input_report_for_id(connection->con_handle, GAMEPAD_REPORT_ID, hid_report,
+                                             sizeof(hid_report)) == ERROR_CODE_SUCCESS) {
+        slot_sequence[slot] = sequence + 1;
+        stats.sent++;
+    } else {
+        stats.send_failures++;
+    }
+    throughput_request(connection, slot);
+}
+
+void throughput_test_completed_packets(const uint8_t *packet)
+{
+    if (!active) return;
+    uint8_t num_handles = packet[2];
+    int offset = 3;
+    for (uint8_t i = 0; i < num_handles; i++) {
+        hci_con_handle_t con_handle = little_endian_read_16(packet, offset) & 0x0fff;
+        uint16_t num_packets = little_endian_read_16(packet, offset + 2);
+        offset += 4;
+        if (num_packets == 0 || !throughput_is_test_central(con_handle)) continue;
+        stats.completion_events++;
+        stats.completed += num_packets;
+        uint16_t bucket = num_packets < THROUGHPUT_PER_EVENT_BUCKETS ? num_packets : THROUGHPUT_PER_EVENT_BUCKETS;
+        stats.per_event[bucket - 1]++;
+    }
+}
+
+const throughput_stats_t *throughput_test_get_stats(void)
+{
+    if (active) {
+        stats.elapsed_us = time_us_32() - stats.start_us;
+    }
+    return &stats;
+}
+
+void throughput_test_dump(void)
+{
+    const throughput_stats_t *s = throughput_test_get_stats();
+    uint32_t elapsed_ms = s->elapsed_us / 1000;
+    uint32_t rate = s->elapsed_us ? (uint32_t)((uint64_t)s->sent * 1000000 / s->elapsed_us) : 0;
+
+    printf("Throughput test %s: %lu.%03lu s, %lu reports, %lu reports/s\n", active ? "running" : "stopped",
+           (unsigned long)(elapsed_ms / 1000), (unsigned long)(elapsed_ms % 1000), (unsigned long)s->sent,
+           (unsigned long)rate);
+    if (s->completion_events) {
+        uint32_t per_event_x100 = (uint32_t)((uint64_t)s->completed * 100 / s->completion_events);
+        printf("  %lu completion events, %lu.%02lu reports per connection event\n",
+               (unsigned long)s->completion_events, (unsigned long)(per_event_x100 / 100),
+               (unsigned long)(per_event_x100 % 100));
+        for (int bucket = 0; bucket < THROUGHPUT_PER_EVENT_BUCKETS; bucket++) {
+            if (s->per_event[bucket] == 0) continue;
+            printf("    %s%d per event: %lu\n", bucket == THROUGHPUT_PER_EVENT_BUCKETS - 1 ? ">=" : "", bucket + 1,
+                   (unsigned long)s->per_event[bucket]);
+        }
+    }
+    printf("  %lu grants requested with ACL buffers exhausted, stalled avg %lu us, max %lu us\n",
+           (unsigned long)s->exhausted, (unsigned long)(s->exhausted ? s->stall_sum_us / s->exhausted : 0),
+           (unsigned long)s->stall_max_us);
+    printf("  %lu send failures\n", (unsigned long)s->send_failures);
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (slot_con_handle[i] == HCI_CON_HANDLE_INVALID || slot_sequence[i] == 0) continue;
+        printf("  Central 0x%04x: sequence 0 .. %lu\n", slot_con_handle[i], (unsigned long)(slot_sequence[i] - 1));
+    }
+}
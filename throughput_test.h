@@ -0,0 +1,64 @@
+// *****************************************************************************
+// Saturation throughput test
+//
+// While running, every CAN_SEND_NOW of a central subscribed to player 1 is
+// answered with a sequence-numbered report and the next grant is requested
+// straight away, so the link carries as many reports as the controller's
+// ACL buffers and connection events allow. Regular input waits in the
+// mailboxes and resumes when the test stops.
+//
+// Test reports have no buttons, both triggers at THROUGHPUT_TEST_MARKER,
+// the 32-bit sequence number in left_x/left_y (low half first) and
+// time_us_32() at sending in right_x/right_y, so tools/seq_check.py can pick
+// them out of a capture on the receiving side and count gaps. Sequence
+// numbers are per central and start at 0 with every run.
+//
+// Reports per connection event are counted from
+// HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, which the controller sends once per
+// event that freed buffers. A grant requested while no ACL buffer was free is
+// a stall; its wait is how long the report path was blocked on the
+// controller.
+// *****************************************************************************
+
+#ifndef THROUGHPUT_TEST_H
+#define THROUGHPUT_TEST_H
+
+#include <stdint.h>
+
+#include "gamepad_config.h"
+#include "gamepad_connection.h"
+
+#define THROUGHPUT_TEST_MARKER 0x5A
+
+// Histogram of reports completed per event: 1 .. N-1, last bucket N or more
+#define THROUGHPUT_PER_EVENT_BUCKETS 8
+
+typedef struct {
+    uint32_t start_us;
+    uint32_t elapsed_us;            // Until stopped, or until now while running
+    uint32_t sent;
+    uint32_t send_failures;         // Controller refused a report in a grant
+    uint32_t completion_events;     // NUMBER_OF_COMPLETED_PACKETS naming a test central
+    uint32_t completed;             // Reports those events acknowledged
+    uint32_t per_event[THROUGHPUT_PER_EVENT_BUCKETS];
+    uint32_t exhausted;             // Grants requested with no free ACL buffer
+    uint32_t stall_max_us;
+    uint64_t stall_sum_us;
+} throughput_stats_t;
+
+void throughput_test_start(void);
+void throughput_test_stop(void);
+bool throughput_test_active(void);
+
+// Serve a grant; the connection's can_send_requested is already cleared
+void throughput_test_can_send_now(gamepad_connection_t *connection);
+
+// HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS
+void throughput_test_completed_packets(const uint8_t *packet);
+
+const throughput_stats_t *throughput_test_get_stats(void);
+
+// Print the last or running test
+void throughput_test_dump(void);
+
+#endif // THROUGHPUT_TEST_H
@@ -0,0 +1,410 @@
+#!/usr/bin/env python3
+"""Compile, decode, capture and upload gamepad input scripts.
+
+Input scripts are the binary format replayed by input_script.cpp (see
+input_script.h). They are written as text, one command per line:
+
+    players N                 players addressed by the script (default 1)
+    mark "label"              marker record, numbered from 0 in order; traced
+                              as SCRIPT_MARK and labelled by trace_decode.py
+    wait MS | wait USus       time until the next record
+    state [player=N] f=v ...  player's full state, unlisted fields neutral
+    update [player=N] f=v ... change only the listed fields
+
+Fields are buttons, left_x, left_y, right_x, right_y, left_trigger,
+right_trigger and dpad. Buttons take the GAMEPAD_BUTTON_* suffixes joined
+with | (1, L1, SELECT, EXTRA5, ...) or a 0x mask; dpad takes up, up_right,
+... up_left, neutral or 0..8. Only fields that differ from the player's
+previous state are written. A looping script should end in the state it
+starts from, since replay carries the state over into the next pass.
+
+    input_script.py compile demo_script.txt -o demo.bin
+    input_script.py compile demo_script.txt --header demo_script -o demo_script.h
+    input_script.py decompile demo.bin
+    input_script.py from-trace console.log -o session.txt
+    input_script.py send /dev/ttyACM0 demo.bin
+
+from-trace turns the REPORT_SENT records of a captured trace into a script.
+Those records carry buttons and sticks only, so triggers and d-pad stay
+neutral. send uploads over the USB console ('u' command); the board replays
+the script as soon as it is complete.
+"""
+
+import argparse
+import os
+import re
+import shlex
+import struct
+import sys
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+REPO_DIR = os.path.join(TOOLS_DIR, "..")
+
+VERSION = 1
+HEADER_SIZE = 8
+
+# Field name, struct format, neutral value; in mask bit order
+FIELDS = [
+    ("buttons", "<H", 0),
+    ("left_x", "<h", 0),
+    ("left_y", "<h", 0),
+    ("right_x", "<h", 0),
+    ("right_y", "<h", 0),
+    ("left_trigger", "<B", 0),
+    ("right_trigger", "<B", 0),
+    ("dpad", "<B", 8),
+]
+FIELD_NAMES = [name for name, _fmt, _neutral in FIELDS]
+NEUTRAL = {name: neutral for name, _fmt, neutral in FIELDS}
+
+BUTTONS = {
+    "1": 0x0001, "2": 0x0002, "3": 0x0004, "4": 0x0008,
+    "L1": 0x0010, "R1": 0x0020, "SELECT": 0x0040, "START": 0x0080,
+    "L3": 0x0100, "R3": 0x0200, "HOME": 0x0400, "EXTRA1": 0x0800,
+    "EXTRA2": 0x1000, "EXTRA3": 0x2000, "EXTRA4": 0x4000, "EXTRA5": 0x8000,
+}
+DPAD = ["up", "up_right", "right", "down_right", "down", "down_left", "left", "up_left", "neutral"]
+
+
+class ScriptError(Exception):
+    pass
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def read_varint(data, offset):
+    value = 0
+    for shift in range(0, 35, 7):
+        if offset >= len(data):
+            break
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, offset
+    raise ScriptError("truncated delta at offset %d" % offset)
+
+
+class Writer:
+    """Builds the binary script, writing only what changed."""
+
+    def __init__(self, players):
+        if not 1 <= players <= 255:
+            raise ScriptError("players must be 1..255")
+        self.players = players
+        self.states = [dict(NEUTRAL) for _ in range(players)]
+        self.records = bytearray()
+        self.pending_us = 0
+        self.marks = []
+
+    def wait(self, us):
+        self.pending_us += us
+
+    def mark(self, label):
+        if len(self.marks) > 255:
+            raise ScriptError("more than 256 marks")
+        self.records += varint(self.pending_us) + bytes([0, len(self.marks)])
+        self.pending_us = 0
+        self.marks.append(label)
+
+    def set(self, player, values):
+        if player >= self.players:
+            raise ScriptError("player %d of a %d-player script" % (player, self.players))
+        state = self.states[player]
+        mask = 0
+        fields = bytearray()
+        for bit, (name, fmt, _neutral) in enumerate(FIELDS):
+            if name in values and values[name] != state[name]:
+                mask |= 1 << bit
+                fields += struct.pack(fmt, values[name])
+                state[name] = values[name]
+        if not mask:
+            return
+        self.records += varint(self.pending_us) + bytes([mask])
+        if self.players > 1:
+            self.records.append(player)
+        self.records += fields
+        self.pending_us = 0
+
+    def finish(self):
+        # A trailing wait becomes a record repeating player 1's buttons, so
+        # a looping script keeps its full length
+        if self.pending_us:
+            self.records += varint(self.pending_us) + bytes([1])
+            if self.players > 1:
+                self.records.append(0)
+            self.records += struct.pack("<H", self.states[0]["buttons"])
+            self.pending_us = 0
+        return b"GPS" + bytes([VERSION, self.players, 0, 0, 0]) + bytes(self.records)
+
+
+def parse_buttons(text):
+    if text.lower().startswith("0x"):
+        return int(text, 16) & 0xFFFF
+    mask = 0
+    for name in text.split("|"):
+        if name.upper() not in BUTTONS:
+            raise ScriptError("unknown button %r" % name)
+        mask |= BUTTONS[name.upper()]
+    return mask
+
+
+def parse_field(name, text):
+    if name == "buttons":
+        return parse_buttons(text)
+    if name == "dpad":
+        if text.lower() in DPAD:
+            return DPAD.index(text.lower())
+        value = int(text, 0)
+        if not 0 <= value <= 8:
+            raise ScriptError("dpad out of range")
+        return value
+    value = int(text, 0)
+    fmt = dict((n, f) for n, f, _ in FIELDS)[name]
+    try:
+        struct.pack(fmt, value)
+    except struct.error:
+        raise ScriptError("%s out of range: %d" % (name, value))
+    return value
+
+
+def parse_wait(text):
+    if text.endswith("us"):
+        return int(text[:-2], 0)
+    if text.endswith("ms"):
+        text = text[:-2]
+    return int(float(text) * 1000)
+
+
+def compile_text(text):
+    writer = None
+    players = 1
+    for number, line in enumerate(text.splitlines(), 1):
+        try:
+            words = shlex.split(line, comments=True)
+            if not words:
+                continue
+            command, args = words[0], words[1:]
+            if command == "players":
+                if writer:
+                    raise ScriptError("players must come before the first record")
+                players = int(args[0])
+                continue
+            if writer is None:
+                writer = Writer(players)
+            if command == "wait":
+                writer.wait(parse_wait(args[0]))
+            elif command == "mark":
+                writer.mark(" ".join(args))
+            elif command in ("state", "update"):
+                player = 0
+                values = {}
+                for arg in args:
+                    name, _, value = arg.partition("=")
+                    if name == "player":
+                        player = int(value) - 1
+                    elif name in FIELD_NAMES:
+                        values[name] = parse_field(name, value)
+                    else:
+                        raise ScriptError("unknown field %r" % name)
+                if command == "state":
+                    values = dict(NEUTRAL, **values)
+                writer.set(player, values)
+            else:
+                raise ScriptError("unknown command %r" % command)
+        except (ScriptError, ValueError, IndexError) as error:
+            raise ScriptError("line %d: %s" % (number, error))
+    if writer is None:
+        writer = Writer(players)
+    return writer.finish(), writer.marks
+
+
+def load_marks(path):
+    """Mark labels of a text script, by marker number."""
+    with open(path) as f:
+        _data, marks = compile_text(f.read())
+    return dict(enumerate(marks))
+
+
+def decode(data):
+    """Yields (time_us, player, fields) and (time_us, None, marker)."""
+    if len(data) < HEADER_SIZE or data[:3] != b"GPS" or data[3] != VERSION or data[4] == 0:
+        raise ScriptError("not a version %d input script" % VERSION)
+    players = data[4]
+    offset = HEADER_SIZE
+    time_us = 0
+    while offset < len(data):
+        delta, offset = read_varint(data, offset)
+        time_us += delta
+        if offset >= len(data):
+            raise ScriptError("truncated record")
+        mask = data[offset]
+        offset += 1
+        if mask == 0:
+            if offset >= len(data):
+                raise ScriptError("truncated marker")
+            yield time_us, None, data[offset]
+            offset += 1
+            continue
+        player = 0
+        if players > 1:
+            player = data[offset]
+            offset += 1
+        values = {}
+        for bit, (name, fmt, _neutral) in enumerate(FIELDS):
+            if mask & (1 << bit):
+                size = struct.calcsize(fmt)
+                if offset + size > len(data):
+                    raise ScriptError("truncated fields")
+                values[name] = struct.unpack_from(fmt, data, offset)[0]
+                offset += size
+        yield time_us, player, values
+
+
+def format_field(name, value):
+    if name == "buttons":
+        names = [n for n, bit in BUTTONS.items() if value & bit]
+        return "|".join(names) if value and len(names) <= 4 else "0x%04x" % value
+    if name == "dpad":
+        return DPAD[value] if value < len(DPAD) else str(value)
+    return str(value)
+
+
+def decompile(data, out):
+    players = data[4] if len(data) > 4 else 1
+    out.write("players %d\n" % players)
+    last_us = 0
+    for time_us, player, values in decode(data):
+        if time_us != last_us:
+            delta = time_us - last_us
+            out.write("wait %s\n" % (("%d" % (delta // 1000)) if delta % 1000 == 0 else "%dus" % delta))
+            last_us = time_us
+        if player is None:
+            out.write('mark "#%d"\n' % values)
+            continue
+        words = ["update"]
+        if players > 1:
+            words.append("player=%d" % (player + 1))
+        words += ["%s=%s" % (name, format_field(name, value)) for name, value in values.items()]
+        out.write(" ".join(words) + "\n")
+
+
+def from_trace(source, out):
+    sys.path.insert(0, TOOLS_DIR)
+    import trace_decode
+
+    events = trace_decode.load_events(os.path.join(REPO_DIR, "trace_events.h"))
+    sent = [name for name, _fmt in events].index("REPORT_SENT")
+    out.write("# Captured from REPORT_SENT trace records (buttons and sticks)\nplayers 1\n")
+    last = None
+    high = 0
+    for line in source:
+        match = trace_decode.RECORD_RE.search(line)
+        if not match or int(match.group(3), 16) != sent:
+            continue
+        raw = int(match.group(2), 16)
+        if last is not None and raw < (last & 0xFFFFFFFF) and (last & 0xFFFFFFFF) - raw > 0x80000000:
+            high += 1 << 32
+        now = raw + high
+        args = [int(a, 16) for a in match.group(4).split()]
+        signed = [a - 0x10000 if a & 0x8000 else a for a in args[1:5]]
+        if last is not None and now > last:
+            out.write("wait %dus\n" % (now - last))
+        last = now
+        out.write("state buttons=0x%04x left_x=%d left_y=%d right_x=%d right_y=%d\n" % (args[0], *signed))
+
+
+def write_header(data, name, source, out):
+    out.write("// Generated by tools/input_script.py from %s; do not edit\n\n" % os.path.basename(source))
+    out.write("#include <stdint.h>\n\n")
+    out.write("static const uint8_t %s[%d] = {\n" % (name, len(data)))
+    for start in range(0, len(data), 12):
+        out.write("    " + " ".join("0x%02x," % b for b in data[start:start + 12]) + "\n")
+    out.write("};\n")
+
+
+def send(port, data):
+    import termios
+    import time
+
+    fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+    try:
+        attrs = termios.tcgetattr(fd)
+        attrs[0] = 0                                  # iflag
+        attrs[1] = 0                                  # oflag
+        attrs[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attrs[3] = 0                                  # lflag: raw
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        os.write(fd, b"u" + struct.pack("<I", len(data)))
+        # USB CDC has its own flow control; chunks keep the console responsive
+        for start in range(0, len(data), 256):
+            os.write(fd, data[start:start + 256])
+            time.sleep(0.002)
+        termios.tcdrain(fd)
+    finally:
+        os.close(fd)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    p = commands.add_parser("compile", help="text script to binary or C header")
+    p.add_argument("script")
+    p.add_argument("-o", "--output", required=True)
+    p.add_argument("--header", metavar="NAME", help="write a C header defining array NAME")
+
+    p = commands.add_parser("decompile", help="binary script to text")
+    p.add_argument("binary")
+    p.add_argument("-o", "--output")
+
+    p = commands.add_parser("from-trace", help="captured trace to text script")
+    p.add_argument("log", nargs="?")
+    p.add_argument("-o", "--output")
+
+    p = commands.add_parser("send", help="upload a script over the USB console")
+    p.add_argument("port")
+    p.add_argument("script", help="binary script, or text script to compile first")
+
+    options = parser.parse_args()
+    try:
+        if options.command == "compile":
+            with open(options.script) as f:
+                data, _marks = compile_text(f.read())
+            if options.header:
+                with open(options.output, "w") as out:
+                    write_header(data, options.header, options.script, out)
+            else:
+                with open(options.output, "wb") as out:
+                    out.write(data)
+        elif options.command == "decompile":
+            with open(options.binary, "rb") as f:
+                data = f.read()
+            out = open(options.output, "w") if options.output else sys.stdout
+            decompile(data, out)
+        elif options.command == "from-trace":
+            source = open(options.log, errors="replace") if options.log else sys.stdin
+            out = open(options.output, "w") if options.output else sys.stdout
+            from_trace(source, out)
+        elif options.command == "send":
+            with open(options.script, "rb") as f:
+                data = f.read()
+            if not data.startswith(b"GPS"):
+                data, _marks = compile_text(data.decode())
+            send(options.port, data)
+    except ScriptError as error:
+        sys.exit("input_script.py: %s" % error)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,261 @@
+#!/usr/bin/env python3
+"""Report flash and RAM use per module from a GNU ld map file.
+
+Reads the map the Pico SDK writes next to the firmware (BTTest2.elf.map)
+and adds up the input sections placed in each memory region of the map's
+Memory Configuration: flash is code, read-only data and the load image of
+initialised data; RAM is initialised and zeroed data plus the stacks and
+heap reservation, in main RAM and the scratch banks. Sections the linker
+discarded and debug sections do not count.
+
+Objects are grouped into modules: the firmware's own sources by file
+(gamepad.cpp, ...), the SDK's libraries by library (btstack, cyw43-driver,
+tinyusb, pico-sdk) and toolchain archives by archive (libc, libgcc, ...).
+The largest symbols follow the table; a section without a global symbol
+(static data, string pools) is listed by section name.
+
+Exits with 1 if a budget is exceeded, so a build can fail on it; the
+firmware's memory_budget target (CMakeLists.txt) runs it that way.
+
+usage: map_budget.py [--flash-budget N] [--ram-budget N]
+                     [--module-budget MODULE:FLASH:RAM ...] [--symbols N] map
+"""
+
+import argparse
+import os
+import re
+import sys
+
+# Object path fragment -> module, first match wins
+LIBRARIES = (
+    ("/lib/btstack/", "btstack"),
+    ("/lib/cyw43-driver/", "cyw43-driver"),
+    ("/lib/tinyusb/", "tinyusb"),
+    ("/lib/mbedtls/", "mbedtls"),
+    ("pico-sdk/", "pico-sdk"),
+    ("/src/rp2_common/", "pico-sdk"),
+    ("/src/rp2040/", "pico-sdk"),
+    ("/src/common/", "pico-sdk"),
+)
+
+# Sections that take RAM but nothing from the load image; ld still prints a
+# load address for some of them
+ZEROED = (".bss", ".sbss", "COMMON", ".heap", ".stack", ".uninitialized", ".noinit", ".ram_vector_table")
+
+REGION_RE = re.compile(r"^(\S+)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)(?:\s+(\S+))?\s*$")
+OUTPUT_RE = re.compile(r"^(\S+)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)(?:\s+load address (0x[0-9a-fA-F]+))?")
+INPUT_RE = re.compile(r"^ (\S+)\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)\s*(.*)$")
+ADDRESS_RE = re.compile(r"^\s+(0x[0-9a-fA-F]+)\s+(0x[0-9a-fA-F]+)(?:\s+load address (0x[0-9a-fA-F]+))?\s*(.*)$")
+SYMBOL_RE = re.compile(r"^\s+(0x[0-9a-fA-F]+)\s+(\S.*)$")
+
+
+def module_of(path):
+    if not path:
+        return "(linker)"
+    archive = re.match(r"^(.*?)\(([^)]*)\)$", path)
+    if archive:
+        name = os.path.basename(archive.group(1))
+        return name[:-2] if name.endswith(".a") else name
+    for fragment, module in LIBRARIES:
+        if fragment in path:
+            return module
+    name = os.path.basename(path)
+    for suffix in (".obj", ".o"):
+        if name.endswith(suffix):
+            name = name[:-len(suffix)]
+    return name
+
+
+class Region:
+    def __init__(self, name, origin, length, attributes):
+        self.name = name
+        self.origin = origin
+        self.length = length
+        # Regions the image may write hold RAM; the rest is flash
+        self.ram = "w" in attributes
+
+    def holds(self, address):
+        return self.origin <= address < self.origin + self.length
+
+
+class Section:
+    """One input section (or *fill*) placed by the linker"""
+
+    def __init__(self, name, size, path, ram, flash):
+        self.name = name
+        self.size = size
+        self.module = "(fill)" if name == "*fill*" else module_of(path)
+        self.ram = ram
+        self.flash = flash
+        self.symbol = None
+
+    def label(self):
+        if self.symbol:
+            return self.symbol
+        # .text.name / .bss.name from -ffunction-sections / -fdata-sections
+        for prefix in (".text.", ".rodata.", ".data.", ".bss.", ".sdata.", ".sbss."):
+            if self.name.startswith(prefix):
+                return self.name[len(prefix):]
+        return self.name
+
+
+def read_map(lines):
+    regions = []
+    sections = []
+    state = "start"
+    output = None
+    vma_region = lma_region = None
+    pending = None              # Section name wrapped onto the next line
+    pending_output = False
+    current = None
+
+    def region_of(address):
+        for region in regions:
+            if region.holds(address):
+                return region
+        return None
+
+    def place(name, address, size, path):
+        if not size or vma_region is None or not address:
+            return None
+        ram = vma_region.ram
+        loaded = not name.startswith(ZEROED) and not (output or "").startswith(ZEROED)
+        flash = not vma_region.ram or (loaded and lma_region is not None and not lma_region.ram)
+        section = Section(name, size, path.strip(), ram, flash)
+        sections.append(section)
+        return section
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if state == "start":
+            if line.startswith("Memory Configuration"):
+                state = "regions"
+            continue
+        if state == "regions":
+            if line.startswith("Linker script and memory map"):
+                state = "map"
+                continue
+            match = REGION_RE.match(line)
+            if match and match.group(1) not in ("Name", "*default*"):
+                regions.append(Region(match.group(1), int(match.group(2), 16), int(match.group(3), 16),
+                                      match.group(4) or ""))
+            continue
+
+        if pending is not None:
+            match = ADDRESS_RE.match(line)
+            name, is_output = pending, pending_output
+            pending = None
+            if match:
+                address, size = int(match.group(1), 16), int(match.group(2), 16)
+                if is_output:
+                    output = name
+                    vma_region = region_of(address) if address else None
+                    lma = match.group(3)
+                    lma_region = region_of(int(lma, 16)) if lma else None
+                else:
+                    current = place(name, address, size, match.group(4))
+                continue
+
+        if not line:
+            continue
+        if not line[0].isspace():
+            match = OUTPUT_RE.match(line)
+            current = None
+            if match:
+                output = match.group(1)
+                address = int(match.group(2), 16)
+                vma_region = region_of(address) if address else None
+                lma = match.group(4)
+                lma_region = region_of(int(lma, 16)) if lma else None
+            elif re.match(r"^\.?\S+$", line) and not line.startswith(("LOAD", "OUTPUT", "START")):
+                # Name alone: the address follows, or the section is empty
+                pending, pending_output = line, True
+                output, vma_region, lma_region = line, None, None
+            continue
+        match = INPUT_RE.match(line)
+        if match:
+            current = place(match.group(1), int(match.group(2), 16), int(match.group(3), 16), match.group(4))
+            continue
+        if re.match(r"^ \S+$", line) and not line.startswith(" *("):
+            pending, pending_output = line.strip(), False
+            continue
+        match = SYMBOL_RE.match(line)
+        if match and current is not None and current.symbol is None:
+            symbol = match.group(2).strip()
+            # Assignments (__end__ = .) and PROVIDE() are not symbols of the section
+            if "=" not in symbol and not symbol.startswith("PROVIDE"):
+                current.symbol = symbol
+    return regions, sections
+
+
+def parse_budget(text):
+    """MODULE:FLASH:RAM with '-' for no limit"""
+    parts = text.split(":")
+    if len(parts) != 3:
+        raise argparse.ArgumentTypeError("expected MODULE:FLASH:RAM, got %r" % text)
+    limits = [None if part in ("", "-") else int(part, 0) for part in parts[1:]]
+    return parts[0], limits[0], limits[1]
+
+
+def check(what, used, budget, failures):
+    if budget is not None and used > budget:
+        failures.append("%s uses %d bytes, budget %d (%d over)" % (what, used, budget, used - budget))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map", help="linker map file (BTTest2.elf.map)")
+    parser.add_argument("--flash-budget", type=lambda text: int(text, 0), help="flash bytes the image may use")
+    parser.add_argument("--ram-budget", type=lambda text: int(text, 0), help="RAM bytes the image may use")
+    parser.add_argument("--module-budget", type=parse_budget, action="append", default=[],
+                        metavar="MODULE:FLASH:RAM", help="budget for one module ('-' for no limit)")
+    parser.add_argument("--symbols", type=int, default=20, help="largest symbols to list per memory")
+    options = parser.parse_args()
+
+    with open(options.map, errors="replace") as f:
+        regions, sections = read_map(f)
+    if not regions:
+        print("%s: no Memory Configuration, not a GNU ld map?" % options.map)
+        return 1
+
+    modules = {}
+    for section in sections:
+        usage = modules.setdefault(section.module, [0, 0])
+        if section.flash:
+            usage[0] += section.size
+        if section.ram:
+            usage[1] += section.size
+    flash_total = sum(usage[0] for usage in modules.values())
+    ram_total = sum(usage[1] for usage in modules.values())
+    flash_size = sum(region.length for region in regions if not region.ram)
+    ram_size = sum(region.length for region in regions if region.ram)
+
+    print("Memory use from %s" % options.map)
+    print("  %-24s %9s %9s" % ("module", "flash", "RAM"))
+    for name, (flash, ram) in sorted(modules.items(), key=lambda item: (-item[1][1], -item[1][0], item[0])):
+        print("  %-24s %9d %9d" % (name, flash, ram))
+    print("  %-24s %9d %9d" % ("total", flash_total, ram_total))
+    print("  %-24s %9d %9d" % ("of", flash_size, ram_size))
+
+    for title, used_in in (("RAM", lambda section: section.ram), ("flash", lambda section: section.flash)):
+        largest = sorted((section for section in sections if used_in(section)), key=lambda section: -section.size)
+        if not options.symbols or not largest:
+            continue
+        print("Largest in %s:" % title)
+        for section in largest[:options.symbols]:
+            print("  %8d  %-16s %s" % (section.size, section.module, section.label()))
+
+    failures = []
+    check("Flash", flash_total, options.flash_budget, failures)
+    check("RAM", ram_total, options.ram_budget, failures)
+    for name, flash_budget, ram_budget in options.module_budget:
+        flash, ram = modules.get(name, (0, 0))
+        check("%s flash" % name, flash, flash_budget, failures)
+        check("%s RAM" % name, ram, ram_budget, failures)
+    for failure in failures:
+        print("FAIL: %s" % failure)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
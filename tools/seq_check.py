@@ -0,0 +1,208 @@
+#!/usr/bin/env python3
+"""Check the sequence numbers of throughput test reports in a capture.
+
+Reads what the receiving side recorded during the firmware's throughput
+test (console 't', see throughput_test.h) and reports, per stream, the
+reports received, sequence gaps, duplicates and reordering, and the
+achieved rate. No BlueZ needed; the input is either
+
+  - a btsnoop file (btmon -w, Android's btsnoop_hci.log, ...): ATT Handle
+    Value Notifications are taken from ACL packets, one stream per
+    connection handle and attribute handle, or
+  - a text log with one report per line: [time] [stream] <hex bytes>.
+    time is in microseconds, or seconds if it has a decimal point; hidraw
+    dumps with the report ID in front are recognised by their length.
+    host/bench/throughput_bench writes this format.
+
+Test reports are recognised by THROUGHPUT_TEST_MARKER in both triggers;
+everything else (demo input, other devices) is ignored. Exits with 1 if
+any stream has gaps, duplicates or reordering, so runs can be scripted.
+
+usage: seq_check.py [--gaps N] capture   (stdin for a text log if omitted)
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+REPORT_SIZE = 13            # GAMEPAD_REPORT_SIZE
+MARKER = 0x5A               # THROUGHPUT_TEST_MARKER
+ATT_CID = 0x0004
+ATT_HANDLE_VALUE_NOTIFICATION = 0x1B
+
+HEX_BYTE_RE = re.compile(r'^[0-9a-fA-F]{2}$')
+HEX_RUN_RE = re.compile(r'^(?:[0-9a-fA-F]{2})+$')
+
+
+def test_report(report):
+    """(sequence, device_us) of a test report, or None."""
+    if len(report) != REPORT_SIZE or report[10] != MARKER or report[11] != MARKER:
+        return None
+    _buttons, seq_low, seq_high, us_low, us_high = struct.unpack_from("<HHHHH", report)
+    return seq_low | (seq_high << 16), us_low | (us_high << 16)
+
+
+def read_btsnoop(data):
+    """Yields (time_us, stream, report) for ATT notifications."""
+    if data[:8] != b"btsnoop\0":
+        raise ValueError("not a btsnoop file")
+    _version, datalink = struct.unpack_from(">II", data, 8)
+    offset = 16
+    while offset + 24 <= len(data):
+        _orig_len, incl_len, flags, _drops, timestamp = struct.unpack_from(">IIIIq", data, offset)
+        packet = data[offset + 24:offset + 24 + incl_len]
+        offset += 24 + incl_len
+        if datalink == 1002:            # H4: packet type in front
+            if not packet or packet[0] != 0x02:
+                continue
+            acl = packet[1:]
+        elif datalink == 1001:          # Unencapsulated: flags bit 1 = command/event
+            if flags & 0x02:
+                continue
+            acl = packet
+        else:
+            raise ValueError("unsupported btsnoop datalink %d" % datalink)
+        if len(acl) < 9:
+            continue
+        handle_flags, _acl_len, _l2cap_len, cid = struct.unpack_from("<HHHH", acl)
+        if (handle_flags >> 12) & 0x03 == 0x01:     # Continuation fragment
+            continue
+        if cid != ATT_CID or acl[8] != ATT_HANDLE_VALUE_NOTIFICATION or len(acl) < 11:
+            continue
+        attribute = struct.unpack_from("<H", acl, 9)[0]
+        stream = "0x%04x/0x%04x" % (handle_flags & 0x0FFF, attribute)
+        yield timestamp, stream, bytes(acl[11:])
+
+
+def read_text(lines):
+    """Yields (time_us, stream, report) for lines ending in hex bytes."""
+    for line in lines:
+        tokens = line.split()
+        hex_bytes = []
+        while tokens and HEX_BYTE_RE.match(tokens[-1]):
+            hex_bytes.insert(0, tokens.pop())
+        if not hex_bytes and tokens and HEX_RUN_RE.match(tokens[-1]) and len(tokens[-1]) >= 2 * REPORT_SIZE:
+            run = tokens.pop()
+            hex_bytes = [run[i:i + 2] for i in range(0, len(run), 2)]
+        report = bytes(int(b, 16) for b in hex_bytes)
+        # Report IDs precede the report in hidraw dumps
+        stream = tokens[1] if len(tokens) > 1 else "-"
+        if len(report) == REPORT_SIZE + 1:
+            stream, report = "id%d" % report[0], report[1:]
+        time_us = None
+        if tokens:
+            try:
+                time_us = float(tokens[0]) * 1e6 if "." in tokens[0] else int(tokens[0], 0)
+            except ValueError:
+                time_us = None
+        yield time_us, stream, report
+
+
+class Stream:
+    def __init__(self):
+        self.received = 0
+        self.first = None
+        self.expected = None
+        self.missing = 0
+        self.gaps = []              # (after sequence, missing)
+        self.duplicates = 0
+        self.reordered = 0
+        self.seen_high = -1
+        self.late = set()
+        self.first_us = self.last_us = None
+        self.first_device_us = self.last_device_us = None
+        self.device_wraps = 0
+
+    def add(self, time_us, seq, device_us):
+        self.received += 1
+        if self.first is None:
+            self.first = seq
+            self.expected = seq
+        if seq == self.expected:
+            self.expected = seq + 1
+        elif seq > self.expected:
+            self.gaps.append((self.expected - 1, seq - self.expected))
+            self.missing += seq - self.expected
+            self.expected = seq + 1
+        elif seq <= self.seen_high:
+            # Already counted as missing if it is late; else a repeat
+            if seq not in self.late and any(after < seq <= after + count for after, count in self.gaps):
+                self.late.add(seq)
+                self.reordered += 1
+                self.missing -= 1
+            else:
+                self.duplicates += 1
+        self.seen_high = max(self.seen_high, seq)
+
+        if time_us is not None:
+            if self.first_us is None:
+                self.first_us = time_us
+            self.last_us = max(self.last_us if self.last_us is not None else time_us, time_us)
+        # Device time (time_us_32) of the newest report; it wraps every 71.6 min
+        if self.first_device_us is None:
+            self.first_device_us = self.last_device_us = device_us
+        elif (device_us - self.last_device_us) & 0xFFFFFFFF < 0x80000000:
+            if device_us < self.last_device_us:
+                self.device_wraps += 1
+            self.last_device_us = device_us
+
+    def device_span_us(self):
+        return self.last_device_us + (self.device_wraps << 32) - self.first_device_us
+
+    def ok(self):
+        return self.missing == 0 and self.duplicates == 0 and self.reordered == 0
+
+
+def rate(count, span_us):
+    return "%.1f reports/s" % (count * 1e6 / span_us) if span_us else "-"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="btsnoop file or text log (default: text on stdin)")
+    parser.add_argument("--gaps", type=int, default=10, help="largest gaps to list per stream")
+    options = parser.parse_args()
+
+    if options.capture:
+        with open(options.capture, "rb") as f:
+            data = f.read()
+        if data.startswith(b"btsnoop\0"):
+            records = read_btsnoop(data)
+        else:
+            records = read_text(data.decode(errors="replace").splitlines())
+    else:
+        records = read_text(sys.stdin)
+
+    streams = {}
+    ignored = 0
+    for time_us, stream, report in records:
+        decoded = test_report(report)
+        if decoded is None:
+            ignored += 1
+            continue
+        streams.setdefault(stream, Stream()).add(time_us, *decoded)
+
+    if not streams:
+        print("no throughput test reports found (%d other reports)" % ignored)
+        return 1
+    ok = True
+    for name, stream in sorted(streams.items()):
+        ok &= stream.ok()
+        print("Stream %s: sequence %d .. %d" % (name, stream.first, stream.seen_high))
+        print("  received    %d, missing %d in %d gaps, %d duplicates, %d reordered" %
+              (stream.received, stream.missing, len(stream.gaps), stream.duplicates, stream.reordered))
+        if stream.first_us is not None:
+            print("  receiver    %s over %.3f s" % (rate(stream.received, stream.last_us - stream.first_us),
+                                                  (stream.last_us - stream.first_us) / 1e6))
+        sent = stream.seen_high - stream.first + 1
+        print("  device      %s sent (device clock)" % rate(sent, stream.device_span_us()))
+        for after, count in sorted(stream.gaps, key=lambda gap: -gap[1])[:options.gaps]:
+            print("    gap of %d after %d" % (count, after))
+    if ignored:
+        print("%d other reports ignored" % ignored)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
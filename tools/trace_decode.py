@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Decode the firmware's binary trace from a captured console log.
+
+The firmware prints trace records as lines of the form
+
+    @T <core> <timestamp_us hex> <event hex> <arg0> .. <arg4>
+
+Event names and formats come from trace_events.h, so this tool stays in
+step with the firmware it was checked out with. SCRIPT_MARK events are
+labelled from the marks of the script being replayed (demo_script.txt
+unless --script names another). Other console lines are
+passed through unchanged unless --trace-only is given.
+
+usage: trace_decode.py [--trace-only] [--absolute] [--script script.txt] [log]   (stdin if no log)
+"""
+
+import argparse
+import os
+import re
+import sys
+
+REPO_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+EVENT_RE = re.compile(r'^\s*TRACE_EVENT\(\s*(\w+)\s*,\s*(\w+)\s*,\s*"((?:[^"\\]|\\.)*)"\s*\)', re.M)
+RECORD_RE = re.compile(r'@T ([0-9]+) ([0-9a-fA-F]{8}) ([0-9a-fA-F]{4})((?: [0-9a-fA-F]{4}){5})')
+SPEC_RE = re.compile(r'%[-+ #0]*\d*([duxXc])')
+
+
+def load_events(path):
+    with open(path) as f:
+        return [(name, fmt) for name, _level, fmt in EVENT_RE.findall(f.read())]
+
+
+def load_script_marks(path):
+    sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+    import input_script
+
+    try:
+        return input_script.load_marks(path)
+    except (OSError, input_script.ScriptError):
+        return {}
+
+
+def format_args(fmt, args):
+    # Arguments are raw 16-bit values; %d reads them as signed
+    values = []
+    for spec, raw in zip(SPEC_RE.findall(fmt), args):
+        if spec == "d":
+            values.append(raw - 0x10000 if raw & 0x8000 else raw)
+        else:
+            values.append(raw)
+    return fmt % tuple(values)
+
+
+class Decoder:
+    def __init__(self, events, script_marks, absolute):
+        self.events = events
+        self.script_marks = script_marks
+        self.absolute = absolute
+        self.origin = None
+        self.last = None
+        self.wraps = 0
+
+    def timestamp(self, raw_us):
+        # time_us_32() wraps every 71.6 minutes
+        if self.last is not None and raw_us < self.last and self.last - raw_us > 0x80000000:
+            self.wraps += 1
+        self.last = raw_us
+        us = raw_us + (self.wraps << 32)
+        if self.origin is None:
+            self.origin = 0 if self.absolute else us
+        return (us - self.origin) / 1000.0
+
+    def decode(self, match):
+        core = int(match.group(1))
+        ms = self.timestamp(int(match.group(2), 16))
+        event = int(match.group(3), 16)
+        args = [int(a, 16) for a in match.group(4).split()]
+
+        if event < len(self.events):
+            name, fmt = self.events[event]
+            text = format_args(fmt, args)
+            if name == "SCRIPT_MARK" and args[0] in self.script_marks:
+                text += ": " + self.script_marks[args[0]]
+        else:
+            name, text = "EVENT_%d" % event, " ".join("%04x" % a for a in args)
+        return "[%10.3f ms core%d] %-14s %s" % (ms, core, name, text)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="captured console output (default: stdin)")
+    parser.add_argument("--trace-only", action="store_true", help="drop non-trace console lines")
+    parser.add_argument("--absolute", action="store_true", help="show time_us_32() time instead of relative")
+    parser.add_argument("--events", default=os.path.join(REPO_DIR, "trace_events.h"))
+    parser.add_argument("--script", default=os.path.join(REPO_DIR, "demo_script.txt"),
+                        help="text input script whose marks label SCRIPT_MARK events")
+    options = parser.parse_args()
+
+    decoder = Decoder(load_events(options.events), load_script_marks(options.script), options.absolute)
+    source = open(options.log, errors="replace") if options.log else sys.stdin
+    with source:
+        for line in source:
+            match = RECORD_RE.search(line)
+            if match:
+                print(decoder.decode(match))
+            elif not options.trace_only:
+                sys.stdout.write(line)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,114 @@
+// *****************************************************************************
+// Binary event trace
+// *****************************************************************************
+
+#include <atomic>
+#include <stdio.h>
+
+#include "pico/platform.h"
+#include "pico/time.h"
+
+#include "btstack.h"
+#include "input_ring.h"
+#include "trace.h"
+
+#if TRACE_LEVEL > TRACE_LEVEL_NONE
+
+#define TRACE_CORES 2
+
+// One ring per core keeps each single-producer; both drain on core0
+static spsc_ring<trace_record_t, TRACE_RING_SIZE> trace_rings[TRACE_CORES];
+
+// Written by the producing core only; the drain remembers what it reported
+static std::atomic<uint32_t> trace_lost[TRACE_CORES];
+static uint32_t trace_lost_reported[TRACE_CORES];
+
+static btstack_timer_source_t trace_timer;
+
+void trace_record(uint16_t event, uint16_t arg0, uint16_t arg1, uint16_t arg2, uint16_t arg3, uint16_t arg4)
+{
+    trace_record_t record;
+    record.timestamp_us = time_us_32();
+    record.event = event;
+    record.arg[0] = arg0;
+    record.arg[1] = arg1;
+    record.arg[2] = arg2;
+    record.arg[3] = arg3;
+    record.arg[4] = arg4;
+
+    uint32_t core = get_core_num();
+    if (!trace_rings[core].push(record)) {
+        trace_lost[core].store(trace_lost[core].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+static void trace_print(uint32_t core, const trace_record_t *record)
+{
+    printf("@T %lu %08lx %04x %04x %04x %04x %04x %04x\n", (unsigned long)core,
+           (unsigned long)record->timestamp_us, record->event, record->arg[0], record->arg[1], record->arg[2],
+           record->arg[3], record->arg[4]);
+}
+
+// Print at most max_records per core, returns the number printed
+static uint32_t trace_drain_some(uint32_t max_records)
+{
+    uint32_t printed = 0;
+    for (uint32_t core = 0; core < TRACE_CORES; core++) {
+        uint32_t lost = trace_lost[core].load(std::memory_order_relaxed);
+        if (lost != trace_lost_reported[core]) {
+            trace_record_t record = { time_us_32(), TRACE_LOST,
+                                      { (uint16_t)(lost - trace_lost_reported[core]), (uint16_t)core, 0, 0, 0 } };
+            trace_print(core, &record);
+            trace_lost_reported[core] = lost;
+        }
+
+        trace_record_t record;
+        for (uint32_t i = 0; i < max_records && trace_rings[core].pop(record); i++) {
+            trace_print(core, &record);
+            printed++;
+        }
+    }
+    return printed;
+}
+
+static void trace_timer_handler(btstack_timer_source_t *ts)
+{
+    trace_drain_some(TRACE_DRAIN_BATCH);
+    btstack_run_loop_set_timer(ts, TRACE_DRAIN_PERIOD_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+void trace_init(void)
+{
+    trace_timer.process = &trace_timer_handler;
+    btstack_run_loop_set_timer(&trace_timer, TRACE_DRAIN_PERIOD_MS);
+    btstack_run_loop_add_timer(&trace_timer);
+}
+
+void trace_drain(void)
+{
+    while (trace_drain_some(TRACE_DRAIN_BATCH)) {
+    }
+}
+
+#else
+
+void trace_record(uint16_t event, uint16_t arg0, uint16_t arg1, uint16_t arg2, uint16_t arg3, uint16_t arg4)
+{
+    UNUSED(event);
+    UNUSED(arg0);
+    UNUSED(arg1);
+    UNUSED(arg2);
+    UNUSED(arg3);
+    UNUSED(arg4);
+}
+
+void trace_init(void)
+{
+}
+
+void trace_drain(void)
+{
+}
+
+#endif
@@ -0,0 +1,68 @@
+// *****************************************************************************
+// Binary event trace
+//
+// TRACE(name, args...) stores an event ID, a time_us_32() timestamp and up
+// to five 16-bit arguments in a per-core RAM ring; no formatting happens on
+// the calling path. Events above TRACE_LEVEL compile to nothing. A run loop
+// timer drains the rings to stdio as "@T" hex lines, and
+// tools/trace_decode.py turns a captured console log back into text.
+// *****************************************************************************
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#include "gamepad_config.h"
+
+#define TRACE_LEVEL_NONE   0
+#define TRACE_LEVEL_ERROR  1
+#define TRACE_LEVEL_WARN   2
+#define TRACE_LEVEL_INFO   3
+#define TRACE_LEVEL_DEBUG  4
+
+// Debug builds trace everything, release builds only errors and warnings
+#ifndef TRACE_LEVEL
+#ifdef NDEBUG
+#define TRACE_LEVEL TRACE_LEVEL_WARN
+#else
+#define TRACE_LEVEL TRACE_LEVEL_DEBUG
+#endif
+#endif
+
+typedef enum {
+#define TRACE_EVENT(name, level, format) TRACE_##name,
+#include "trace_events.h"
+#undef TRACE_EVENT
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+enum {
+#define TRACE_EVENT(name, level, format) TRACE_LEVEL_OF_##name = level,
+#include "trace_events.h"
+#undef TRACE_EVENT
+};
+
+typedef struct {
+    uint32_t timestamp_us;
+    uint16_t event;
+    uint16_t arg[5];
+} trace_record_t;
+
+void trace_record(uint16_t event, uint16_t arg0 = 0, uint16_t arg1 = 0, uint16_t arg2 = 0, uint16_t arg3 = 0,
+                  uint16_t arg4 = 0);
+
+#define TRACE(name, ...)                                                   \
+    do {                                                                   \
+        if (TRACE_LEVEL_OF_##name <= TRACE_LEVEL) {                        \
+            trace_record(TRACE_##name, ##__VA_ARGS__);                     \
+        }                                                                  \
+    } while (0)
+
+// Start draining to stdio from a run loop timer
+void trace_init(void);
+
+// Print everything recorded so far
+void trace_drain(void);
+
+#endif // TRACE_H
@@ -0,0 +1,18 @@
+// *****************************************************************************
+// Trace event table
+//
+// TRACE_EVENT(name, level, format): format is printf-style over the five
+// 16-bit arguments (%d reads them as signed) and is only used by
+// tools/trace_decode.py, which parses this file. Append new events at the
+// end so recorded IDs keep their meaning.
+// *****************************************************************************
+
+TRACE_EVENT(LOST,            TRACE_LEVEL_ERROR, "%u trace records lost on core %u")
+TRACE_EVENT(SEND_FAILED,     TRACE_LEVEL_ERROR, "input report send failed: status 0x%02x")
+TRACE_EVENT(INPUT_DROPPED,   TRACE_LEVEL_WARN,  "core1 snapshot of player %u dropped, ring full")
+TRACE_EVENT(SCRIPT_MARK,     TRACE_LEVEL_INFO,  "script mark %u")
+TRACE_EVENT(REPORT_REQUEST,  TRACE_LEVEL_DEBUG, "request send buttons=0x%04x player %u")
+TRACE_EVENT(REPORT_SENT,     TRACE_LEVEL_DEBUG, "sent buttons=0x%04x left=(%d,%d) right=(%d,%d)")
+TRACE_EVENT(POWER_STATE,     TRACE_LEVEL_INFO,  "power state %u -> %u after %u ms quiet")
+TRACE_EVENT(BUTTON_EVENT,    TRACE_LEVEL_DEBUG, "buttons=0x%04x settled %u us before core1 took them")
+TRACE_EVENT(FLASH_COMMIT,    TRACE_LEVEL_INFO,  "flash write of tag 0x%04x%04x blocked %u us, %u waiting")
@@ -0,0 +1,400 @@
+// *****************************************************************************
+// Tuning service
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "btstack.h"
+#include "axis_profiles.h"
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_connection.h"
+#include "input_sampler.h"
+#include "latency_stats.h"
+#include "link_tuning.h"
+#include "tuning_service.h"
+
+// 7A3E000x-5D2B-4C8E-9F61-0B4D8C2A1E57, big-endian as in the .gatt file
+#define TUNING_UUID(x) { 0x7A, 0x3E, 0x00, (x), 0x5D, 0x2B, 0x4C, 0x8E, \
+                         0x9F, 0x61, 0x0B, 0x4D, 0x8C, 0x2A, 0x1E, 0x57 }
+
+static const uint8_t service_uuid[16] = TUNING_UUID(0x01);
+static const uint8_t report_uuid[16] = TUNING_UUID(0x02);
+static const uint8_t stick_uuid[16] = TUNING_UUID(0x03);
+static const uint8_t link_uuid[16] = TUNING_UUID(0x04);
+static const uint8_t counters_uuid[16] = TUNING_UUID(0x05);
+
+#define REPORT_SIZE 5
+#define STICK_SIZE (1 + 2 + 2 + 2 * AXIS_TRIGGERS)
+#define LINK_SIZE 6
+#define COUNTERS_SIZE 18
+
+#define REPORT_FLAG_EVENT_SCHEDULE 0x01
+
+// Core1 keeps up with more, but the pipeline and the ring are sized for
+// around a millisecond; a keep-alive faster than this floods the link
+#define SAMPLE_PERIOD_MIN_US 250
+#define SAMPLE_PERIOD_MAX_US 20000
+#define KEEPALIVE_MIN_MS 10
+
+// Within the Core Specification's limits
+#define LINK_INTERVAL_MIN 6
+#define LINK_INTERVAL_MAX 3200
+#define LINK_LATENCY_MAX 499
+#define LINK_TIMEOUT_MIN 10
+#define LINK_TIMEOUT_MAX 3200
+
+typedef struct {
+    hci_con_handle_t con_handle;   // HCI_CON_HANDLE_INVALID = free
+    uint16_t configuration;        // Client characteristic configuration of the counters
+    bool send_pending;             // CAN_SEND_NOW requested for a notification
+    btstack_context_callback_registration_t send_request;
+} subscriber_t;
+
+static att_service_handler_t service_handler;
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static btstack_timer_source_t counters_timer;
+static subscriber_t subscribers[GAMEPAD_MAX_CONNECTIONS];
+static tuning_service_stats_t stats;
+
+static uint16_t report_handle;
+static uint16_t stick_handle;
+static uint16_t link_handle;
+static uint16_t counters_handle;
+static uint16_t counters_configuration_handle;
+
+// Player a stick read returns
+static uint8_t stick_player;
+
+static subscriber_t *subscriber_find(hci_con_handle_t con_handle)
+{
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        if (subscribers[i].con_handle == con_handle) return &subscribers[i];
+    }
+    return NULL;
+}
+
+static subscriber_t *subscriber_add(hci_con_handle_t con_handle)
+{
+    subscriber_t *subscriber = subscriber_find(con_handle);
+    if (!subscriber) {
+        subscriber = subscriber_find(HCI_CON_HANDLE_INVALID);
+    }
+    if (subscriber) {
+        subscriber->con_handle = con_handle;
+    }
+    return subscriber;
+}
+
+static uint32_t sample_period_us(void)
+{
+#if GAMEPAD_DUAL_CORE
+    return input_sampler_period_us();
+#else
+    return GAMEPAD_SAMPLE_PERIOD_US;
+#endif
+}
+
+static uint16_t saturate_16(uint32_t value)
+{
+    return (uint16_t)(value > 0xffff ? 0xffff : value);
+}
+
+static void report_read(uint8_t *value)
+{
+    little_endian_store_16(value, 0, (uint16_t)sample_period_us());
+    little_endian_store_16(value, 2, saturate_16(gamepad_keepalive()));
+    value[4] = gamepad_event_schedule() ? REPORT_FLAG_EVENT_SCHEDULE : 0;
+}
+
+static void stick_read(uint8_t *value)
+{
+    const axis_profile_t *profile = axis_profiles_get(stick_player);
+    value[0] = stick_player;
+    little_endian_store_16(value, 1, profile->radial_deadzone);
+    little_endian_store_16(value, 3, profile->axial_deadzone);
+    for (int trigger = 0; trigger < AXIS_TRIGGERS; trigger++) {
+        value[5 + trigger] = profile->trigger_low[trigger];
+        value[5 + AXIS_TRIGGERS + trigger] = profile->trigger_high[trigger];
+    }
+}
+
+static void link_read(uint8_t *value)
+{
+    const link_targets_t *targets = link_tuning_get_targets();
+    little_endian_store_16(value, 0, targets->interval);
+    little_endian_store_16(value, 2, targets->latency);
+    little_endian_store_16(value, 4, targets->supervision_timeout);
+}
+
+static void counters_read(hci_con_handle_t con_handle, uint8_t *value)
+{
+    uint32_t sent = 0;
+    uint32_t coalesced = 0;
+    uint32_t suppressed = 0;
+    const gamepad_connection_t *connection = gamepad_connection_find(con_handle);
+    for (int player = 0; connection && player < GAMEPAD_PLAYERS; player++) {
+        const report_mailbox_t *mailbox = &connection->mailbox[player];
+        sent += mailbox->sent + mailbox->keepalives;
+        coalesced += mailbox->coalesced;
+        suppressed += mailbox->suppressed;
+    }
+    little_endian_store_32(value, 0, sent);
+    little_endian_store_32(value, 4, coalesced);
+    little_endian_store_32(value, 8, suppressed);
+    little_endian_store_16(value, 12, saturate_16(latency_stats_percentile(LATENCY_SAMPLE_TO_DONE, 50)));
+    little_endian_store_16(value, 14, saturate_16(latency_stats_percentile(LATENCY_SAMPLE_TO_DONE, 90)));
+    little_endian_store_16(value, 16, saturate_16(latency_stats_percentile(LATENCY_SAMPLE_TO_DONE, 99)));
+}
+
+static uint16_t att_read_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t offset,
+                                  uint8_t *buffer, uint16_t buffer_size)
+{
+    uint8_t value[COUNTERS_SIZE];
+    uint16_t size;
+    if (attribute_handle == report_handle) {
+        report_read(value);
+        size = REPORT_SIZE;
+    } else if (attribute_handle == stick_handle) {
+        stick_read(value);
+        size = STICK_SIZE;
+    } else if (attribute_handle == link_handle) {
+        link_read(value);
+        size = LINK_SIZE;
+    } else if (attribute_handle == counters_handle) {
+        counters_read(con_handle, value);
+        size = COUNTERS_SIZE;
+    } else if (attribute_handle == counters_configuration_handle) {
+        const subscriber_t *subscriber = subscriber_find(con_handle);
+        little_endian_store_16(value, 0, subscriber ? subscriber->configuration : 0);
+        size = 2;
+    } else {
+        return 0;
+    }
+    // BTstack asks for the size first, without a buffer
+    if (buffer) {
+        stats.reads++;
+    }
+    return att_read_callback_handle_blob(value, size, offset, buffer, buffer_size);
+}
+
+static int report_write(const uint8_t *value)
+{
+    uint16_t period_us = little_endian_read_16(value, 0);
+    uint16_t keepalive_ms = little_endian_read_16(value, 2);
+    if (period_us < SAMPLE_PERIOD_MIN_US || period_us > SAMPLE_PERIOD_MAX_US) return ATT_ERROR_VALUE_NOT_ALLOWED;
+    if (keepalive_ms && keepalive_ms < KEEPALIVE_MIN_MS) return ATT_ERROR_VALUE_NOT_ALLOWED;
+    if (value[4] & ~REPORT_FLAG_EVENT_SCHEDULE) return ATT_ERROR_VALUE_NOT_ALLOWED;
+#if GAMEPAD_DUAL_CORE
+    input_sampler_set_period_us(period_us);
+#else
+    // The demo timer has no sampling period
+    if (period_us != GAMEPAD_SAMPLE_PERIOD_US) return ATT_ERROR_VALUE_NOT_ALLOWED;
+#endif
+    gamepad_set_keepalive(keepalive_ms);
+    gamepad_set_event_schedule((value[4] & REPORT_FLAG_EVENT_SCHEDULE) != 0);
+    printf("Tuning: sample period %u us, keep-alive %u ms, event schedule %s\n", period_us, keepalive_ms,
+           gamepad_event_schedule() ? "on" : "off");
+    return 0;
+}
+
+static int stick_write(const uint8_t *value, uint16_t size)
+{
+    if (value[0] >= GAMEPAD_PLAYERS) return ATT_ERROR_VALUE_NOT_ALLOWED;
+    if (size == 1) {
+        stick_player = value[0];
+        return 0;
+    }
+    axis_profile_t profile = *axis_profiles_get(value[0]);
+    profile.radial_deadzone = little_endian_read_16(value, 1);
+    profile.axial_deadzone = little_endian_read_16(value, 3);
+    for (int trigger = 0; trigger < AXIS_TRIGGERS; trigger++) {
+        profile.trigger_low[trigger] = value[5 + trigger];
+        profile.trigger_high[trigger] = value[5 + AXIS_TRIGGERS + trigger];
+    }
+    if (!axis_profile_valid(&profile)) return ATT_ERROR_VALUE_NOT_ALLOWED;
+    if (axis_profiles_store(value[0], &profile) != 0) return ATT_ERROR_UNLIKELY_ERROR;
+    stick_player = value[0];
+    printf("Tuning: player %u deadzones %u / %u\n", value[0] + 1, profile.radial_deadzone, profile.axial_deadzone);
+    return 0;
+}
+
+static int link_write(const uint8_t *value)
+{
+    link_targets_t targets;
+    targets.interval = little_endian_read_16(value, 0);
+    targets.latency = little_endian_read_16(value, 2);
+    targets.supervision_timeout = little_endian_read_16(value, 4);
+    if (targets.interval < LINK_INTERVAL_MIN || targets.interval > LINK_INTERVAL_MAX) return ATT_ERROR_VALUE_NOT_ALLOWED;
+    if (targets.latency > LINK_LATENCY_MAX) return ATT_ERROR_VALUE_NOT_ALLOWED;
+    if (targets.supervision_timeout < LINK_TIMEOUT_MIN || targets.supervision_timeout > LINK_TIMEOUT_MAX) {
+        return ATT_ERROR_VALUE_NOT_ALLOWED;
+    }
+    // The timeout must outlast the events the peripheral may skip, twice:
+    // timeout * 10 ms > (1 + latency) * interval * 1.25 ms * 2
+    if ((uint32_t)targets.supervision_timeout * 4 <= (1u + targets.latency) * targets.interval) {
+        return ATT_ERROR_VALUE_NOT_ALLOWED;
+    }
+    printf("Tuning: link targets interval %u, latency %u, timeout %u\n", targets.interval, targets.latency,
+           targets.supervision_timeout);
+    link_tuning_set_targets(&targets);
+    return 0;
+}
+
+static void counters_send(void *context)
+{
+    subscriber_t *subscriber = (subscriber_t *)context;
+    subscriber->send_pending = false;
+    if (subscriber->con_handle == HCI_CON_HANDLE_INVALID) return;
+    if (!(subscriber->configuration & GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION)) return;
+    uint8_t value[COUNTERS_SIZE];
+    counters_read(subscriber->con_handle, value);
+    if (att_server_notify(subscriber->con_handle, counters_handle, value, sizeof(value)) == ERROR_CODE_SUCCESS) {
+        stats.notifications++;
+    }
+}
+
+static void counters_timer_handler(btstack_timer_source_t *ts)
+{
+    bool subscribed = false;
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        subscriber_t *subscriber = &subscribers[i];
+        if (subscriber->con_handle == HCI_CON_HANDLE_INVALID) continue;
+        if (!(subscriber->configuration & GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION)) continue;
+        subscribed = true;
+        // A notification still waiting for its grant is sent with fresh counters
+        if (subscriber->send_pending) continue;
+        subscriber->send_pending = true;
+        att_server_register_can_send_now_callback(&subscriber->send_request, subscriber->con_handle);
+    }
+    if (!subscribed) return;
+    btstack_run_loop_set_timer(ts, TUNING_STATS_PERIOD_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+static int configuration_write(hci_con_handle_t con_handle, const uint8_t *value)
+{
+    uint16_t configuration = little_endian_read_16(value, 0);
+    subscriber_t *subscriber = configuration ? subscriber_add(con_handle) : subscriber_find(con_handle);
+    if (!subscriber) return configuration ? ATT_ERROR_UNLIKELY_ERROR : 0;
+    subscriber->configuration = configuration;
+    if (configuration & GATT_CLIENT_CHARACTERISTICS_CONFIGURATION_NOTIFICATION) {
+        btstack_run_loop_set_timer(&counters_timer, TUNING_STATS_PERIOD_MS);
+        btstack_run_loop_add_timer(&counters_timer);
+    }
+    return 0;
+}
+
+static int att_write_callback(hci_con_handle_t con_handle, uint16_t attribute_handle, uint16_t transaction_mode,
+                              uint16_t offset, uint8_t *buffer, uint16_t buffer_size)
+{
+    if (transaction_mode != ATT_TRANSACTION_MODE_NONE) return 0;
+
+    uint16_t expected;
+    if (attribute_handle == report_handle) {
+        expected = REPORT_SIZE;
+    } else if (attribute_handle == stick_handle) {
+        expected = buffer_size == 1 ? 1 : STICK_SIZE;
+    } else if (attribute_handle == link_handle) {
+        expected = LINK_SIZE;
+    } else if (attribute_handle == counters_configuration_handle) {
+        expected = 2;
+    } else {
+        return ATT_ERROR_WRITE_NOT_PERMITTED;
+    }
+
+    int status;
+    if (offset != 0) {
+        status = ATT_ERROR_INVALID_OFFSET;
+    } else if (buffer_size != expected) {
+        status = ATT_ERROR_INVALID_ATTRIBUTE_VALUE_LENGTH;
+    } else if (attribute_handle == report_handle) {
+        status = report_write(buffer);
+    } else if (attribute_handle == stick_handle) {
+        status = stick_write(buffer, buffer_size);
+    } else if (attribute_handle == link_handle) {
+        status = link_write(buffer);
+    } else {
+        return configuration_write(con_handle, buffer);
+    }
+    if (status) {
+        stats.rejected++;
+    } else {
+        stats.writes++;
+    }
+    return status;
+}
+
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size)
+{
+    UNUSED(channel);
+    UNUSED(size);
+
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != HCI_EVENT_DISCONNECTION_COMPLETE) return;
+    subscriber_t *subscriber = subscriber_find(hci_event_disconnection_complete_get_connection_handle(packet));
+    if (!subscriber) return;
+    subscriber->con_handle = HCI_CON_HANDLE_INVALID;
+    subscriber->configuration = 0;
+    // att_server drops the connection's requests without granting them
+    subscriber->send_pending = false;
+}
+
+void tuning_service_init(void)
+{
+    uint16_t start_handle = 0;
+    uint16_t end_handle = 0;
+    if (!gatt_server_get_handle_range_for_service_with_uuid128(service_uuid, &start_handle, &end_handle)) {
+        printf("Tuning service not in the GATT database\n");
+        return;
+    }
+    report_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                                report_uuid);
+    stick_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                               stick_uuid);
+    link_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle, link_uuid);
+    counters_handle = gatt_server_get_value_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                                  counters_uuid);
+    counters_configuration_handle =
+        gatt_server_get_client_configuration_handle_for_characteristic_with_uuid128(start_handle, end_handle,
+                                                                                    counters_uuid);
+
+    stick_player = 0;
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < GAMEPAD_MAX_CONNECTIONS; i++) {
+        subscribers[i].con_handle = HCI_CON_HANDLE_INVALID;
+        subscribers[i].configuration = 0;
+        subscribers[i].send_pending = false;
+        subscribers[i].send_request.callback = &counters_send;
+        subscribers[i].send_request.context = &subscribers[i];
+    }
+    counters_timer.process = &counters_timer_handler;
+
+    service_handler.start_handle = start_handle;
+    service_handler.end_handle = end_handle;
+    service_handler.read_callback = &att_read_callback;
+    service_handler.write_callback = &att_write_callback;
+    service_handler.packet_handler = NULL;
+    att_server_register_service_handler(&service_handler);
+
+    hci_event_callback_registration.callback = &hci_event_handler;
+    hci_add_event_handler(&hci_event_callback_registration);
+}
+
+const tuning_service_stats_t *tuning_service_get_stats(void)
+{
+    return &stats;
+}
+
+void tuning_service_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void tuning_service_dump(void)
+{
+    printf("Tuning service: %lu reads, %lu writes, %lu rejected, %lu counter notifications\n",
+           (unsigned long)stats.reads, (unsigned long)stats.writes, (unsigned long)stats.rejected,
+           (unsigned long)stats.notifications);
+}
@@ -0,0 +1,53 @@
+// *****************************************************************************
+// Tuning service
+//
+// A vendor GATT service (hog_keyboard_demo.gatt) to read and change the
+// report path's settings without reflashing. All values little-endian;
+// writes need an encrypted link and take effect at once:
+//
+//   report   (7A3E0002)  sample period, us (u16; core1 builds only),
+//                        keep-alive period, ms (u16; 0 = reports only on
+//                        change), flags (u8; bit 0 = release reports on the
+//                        connection event schedule)
+//   stick    (7A3E0003)  player (u8), radial and axial deadzone (u16 each),
+//                        trigger low and high (u8 per trigger); written in
+//                        full it is stored as that player's axis profile
+//                        (axis_profiles.h), the player alone selects which
+//                        player a read returns
+//   link     (7A3E0004)  connection interval (u16, 1.25 ms units, requested
+//                        as is; link_tuning's ladder only after a refusal),
+//                        peripheral latency (u16),
+//                        supervision timeout (u16, 10 ms units)
+//   counters (7A3E0005)  this central's reports sent, coalesced and
+//                        suppressed (u32 each, all players), player 1's
+//                        sample->done latency p50, p90, p99 (u16, us);
+//                        18 bytes, one notification at the default ATT MTU
+//
+// A host that enables notifications on the counters gets them every
+// TUNING_STATS_PERIOD_MS. They wait for att_server's CAN_SEND_NOW like
+// the player reports, so they only take a buffer the reports leave free.
+// A write out of range is refused with ATT_ERROR_VALUE_NOT_ALLOWED and
+// changes nothing. Settings other than stick profiles last until reset.
+// *****************************************************************************
+
+#ifndef TUNING_SERVICE_H
+#define TUNING_SERVICE_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t reads;
+    uint32_t writes;           // Settings changed
+    uint32_t rejected;         // Writes refused
+    uint32_t notifications;    // Counter notifications sent
+} tuning_service_stats_t;
+
+// Register with the ATT server; after att_server_init()
+void tuning_service_init(void);
+
+const tuning_service_stats_t *tuning_service_get_stats(void);
+void tuning_service_reset_stats(void);
+
+void tuning_service_dump(void);
+
+#endif // TUNING_SERVICE_H
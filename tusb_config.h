@@ -0,0 +1,33 @@
+// *****************************************************************************
+// TinyUSB configuration: CDC (USB stdio) and HID gamepad composite device
+//
+// Linking tinyusb_device makes the application own the descriptors and
+// tud_task(); see usb_device.cpp. The HID interface is only there with
+// GAMEPAD_USB_HID.
+// *****************************************************************************
+
+#ifndef TUSB_CONFIG_H
+#define TUSB_CONFIG_H
+
+#include "gamepad_config.h"
+
+#ifndef CFG_TUSB_RHPORT0_MODE
+#define CFG_TUSB_RHPORT0_MODE OPT_MODE_DEVICE
+#endif
+
+#define CFG_TUD_ENABLED 1
+#define CFG_TUD_ENDPOINT0_SIZE 64
+
+#define CFG_TUD_CDC 1
+#define CFG_TUD_HID GAMEPAD_USB_HID
+#define CFG_TUD_MSC 0
+#define CFG_TUD_MIDI 0
+#define CFG_TUD_VENDOR 0
+
+#define CFG_TUD_CDC_RX_BUFSIZE 256
+#define CFG_TUD_CDC_TX_BUFSIZE 256
+
+// Full speed interrupt endpoints; a player report fits one packet
+#define CFG_TUD_HID_EP_BUFSIZE 64
+
+#endif // TUSB_CONFIG_H
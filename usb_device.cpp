@@ -0,0 +1,264 @@
+// *****************************************************************************
+// USB device: CDC stdio and the HID gamepad interface (RP2040, TinyUSB)
+// *****************************************************************************
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/unique_id.h"
+#include "tusb.h"
+
+#include "btstack.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "usb_device.h"
+
+enum {
+    ITF_NUM_CDC = 0,
+    ITF_NUM_CDC_DATA,
+#if GAMEPAD_USB_HID
+    ITF_NUM_HID,
+#endif
+    ITF_NUM_TOTAL
+};
+
+#define EPNUM_CDC_NOTIF 0x81
+#define EPNUM_CDC_OUT 0x02
+#define EPNUM_CDC_IN 0x82
+#define EPNUM_HID_OUT 0x03
+#define EPNUM_HID_IN 0x83
+
+#if GAMEPAD_USB_HID
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_INOUT_DESC_LEN)
+#else
+#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN)
+#endif
+
+enum {
+    STRID_LANGID = 0,
+    STRID_MANUFACTURER,
+    STRID_PRODUCT,
+    STRID_SERIAL,
+    STRID_CDC,
+    STRID_HID,
+};
+
+// Interface association: the CDC pair is one function next to the HID one
+static const tusb_desc_device_t device_descriptor = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = 0x0200,
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+    .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
+    .idVendor = GAMEPAD_USB_VID,
+    .idProduct = GAMEPAD_USB_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = STRID_MANUFACTURER,
+    .iProduct = STRID_PRODUCT,
+    .iSerialNumber = STRID_SERIAL,
+    .bNumConfigurations = 1,
+};
+
+static_assert(GAMEPAD_REPORT_SIZE + 1 <= CFG_TUD_HID_EP_BUFSIZE, "Player report does not fit one HID packet");
+
+// Without GAMEPAD_USB_HID the host sees the serial console only
+static const uint8_t configuration_descriptor[] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0, 100),
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+#if GAMEPAD_USB_HID
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, STRID_HID, HID_ITF_PROTOCOL_NONE, hid_descriptor_gamepad.size(),
+                             EPNUM_HID_OUT, EPNUM_HID_IN, CFG_TUD_HID_EP_BUFSIZE, USB_HID_POLL_INTERVAL_MS),
+#endif
+};
+
+static const char *const strings[] = {
+    NULL,
+    "Raspberry Pi",
+    "BT Gamepad",
+    NULL,               // Board ID
+    "BT Gamepad Console",
+    "BT Gamepad",
+};
+
+static btstack_data_source_t usb_data_source;
+static const usb_device_handlers_t *handlers;
+static bool ready;
+
+static void usb_device_update(void)
+{
+    bool now_ready = tud_mounted() && !tud_suspended();
+    if (now_ready == ready) return;
+    ready = now_ready;
+    if (handlers) {
+        handlers->changed(ready);
+    }
+}
+
+// TinyUSB descriptor callbacks
+
+const uint8_t *tud_descriptor_device_cb(void)
+{
+    return (const uint8_t *)&device_descriptor;
+}
+
+const uint8_t *tud_descriptor_configuration_cb(uint8_t index)
+{
+    (void)index;
+    return configuration_descriptor;
+}
+
+#if GAMEPAD_USB_HID
+const uint8_t *tud_hid_descriptor_report_cb(uint8_t instance)
+{
+    (void)instance;
+    return hid_descriptor_gamepad.data();
+}
+#endif
+
+const uint16_t *tud_descriptor_string_cb(uint8_t index, uint16_t langid)
+{
+    (void)langid;
+    static uint16_t descriptor[32];
+    char serial[2 * PICO_UNIQUE_BOARD_ID_SIZE_BYTES + 1];
+
+    uint8_t count;
+    if (index == STRID_LANGID) {
+        descriptor[1] = 0x0409;
+        count = 1;
+    } else {
+        if (index >= sizeof(strings) / sizeof(strings[0])) return NULL;
+        const char *string = strings[index];
+        if (index == STRID_SERIAL) {
+            pico_get_unique_board_id_string(serial, sizeof(serial));
+            string = serial;
+        }
+        count = (uint8_t)strlen(string);
+        if (count > 31) count = 31;
+        for (uint8_t i = 0; i < count; i++) {
+            descriptor[1 + i] = (uint8_t)string[i];
+        }
+    }
+    descriptor[0] = (uint16_t)((TUSB_DESC_STRING << 8) | (2 * count + 2));
+    return descriptor;
+}
+
+// TinyUSB device callbacks, all from tud_task() on the run loop
+
+void tud_mount_cb(void)
+{
+    usb_device_update();
+}
+
+void tud_umount_cb(void)
+{
+    usb_device_update();
+}
+
+void tud_suspend_cb(bool remote_wakeup_en)
+{
+    (void)remote_wakeup_en;
+    usb_device_update();
+}
+
+void tud_resume_cb(void)
+{
+    usb_device_update();
+}
+
+#if GAMEPAD_USB_HID
+void tud_hid_report_complete_cb(uint8_t instance, const uint8_t *report, uint16_t len)
+{
+    (void)instance;
+    (void)report;
+    (void)len;
+    if (handlers) {
+        handlers->sent();
+    }
+}
+
+// Input reports are only sent as they change; a GET_REPORT gets nothing
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                               uint8_t *buffer, uint16_t reqlen)
+{
+    (void)instance;
+    (void)report_id;
+    (void)report_type;
+    (void)buffer;
+    (void)reqlen;
+    return 0;
+}
+
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type,
+                           const uint8_t *buffer, uint16_t bufsize)
+{
+    (void)instance;
+    // On the OUT endpoint the report ID is the first byte
+    if (report_id == 0 && report_type == HID_REPORT_TYPE_INVALID) {
+        if (bufsize == 0) return;
+        report_id = buffer[0];
+        buffer++;
+        bufsize--;
+    } else if (report_type != HID_REPORT_TYPE_OUTPUT) {
+        return;
+    }
+    if (handlers) {
+        handlers->output(report_id, buffer, bufsize);
+    }
+}
+#endif
+
+// The USB interrupt queued an event for tud_task()
+void tud_event_hook_cb(uint8_t rhport, uint32_t eventid, bool in_isr)
+{
+    (void)rhport;
+    (void)eventid;
+    (void)in_isr;
+    btstack_run_loop_poll_data_sources_from_irq();
+}
+
+static void usb_data_source_handler(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type)
+{
+    UNUSED(ds);
+    if (callback_type != DATA_SOURCE_CALLBACK_POLL) return;
+    tud_task();
+}
+
+void usb_device_init(void)
+{
+    tusb_init();
+    // Until the run loop serves it, the host would time out enumerating
+    tud_disconnect();
+}
+
+void usb_device_start(void)
+{
+    btstack_run_loop_set_data_source_handler(&usb_data_source, &usb_data_source_handler);
+    btstack_run_loop_enable_data_source_callbacks(&usb_data_source, DATA_SOURCE_CALLBACK_POLL);
+    btstack_run_loop_add_data_source(&usb_data_source);
+    tud_connect();
+}
+
+void usb_device_set_handlers(const usb_device_handlers_t *device_handlers)
+{
+    handlers = device_handlers;
+}
+
+bool usb_device_ready(void)
+{
+    return ready;
+}
+
+bool usb_device_send(uint8_t report_id, const uint8_t *report, uint16_t report_len)
+{
+#if GAMEPAD_USB_HID
+    if (!ready || !tud_hid_ready()) return false;
+    return tud_hid_report(report_id, report, report_len);
+#else
+    (void)report_id;
+    (void)report;
+    (void)report_len;
+    return false;
+#endif
+}
@@ -0,0 +1,45 @@
+// *****************************************************************************
+// USB device: CDC stdio and the HID gamepad interface (RP2040, TinyUSB)
+//
+// A composite device: the CDC interface carries USB stdio as before, the
+// HID interface uses hid_descriptor_gamepad and an interrupt IN endpoint
+// polled every USB_HID_POLL_INTERVAL_MS, plus an OUT endpoint for output
+// reports. With GAMEPAD_USB_HID=0 the device is the CDC interface alone and
+// usb_device_send() always fails. TinyUSB runs on the BTstack run loop: its
+// interrupt only polls the run loop's data sources, and the handlers below
+// are called from there. The host build replaces this with a mock on the
+// virtual clock.
+// *****************************************************************************
+
+#ifndef USB_DEVICE_H
+#define USB_DEVICE_H
+
+#include <stdint.h>
+
+typedef struct {
+    // The host configured the device and it is not suspended, or no longer
+    void (*changed)(bool ready);
+
+    // The host took the report passed to usb_device_send()
+    void (*sent)(void);
+
+    // The host wrote an output report (without its report ID)
+    void (*output)(uint8_t report_id, const uint8_t *report, uint16_t report_len);
+} usb_device_handlers_t;
+
+// Bring up TinyUSB with the device detached; before stdio_init_all()
+void usb_device_init(void);
+
+// Attach once the run loop is running and can answer the host in time
+void usb_device_start(void);
+
+void usb_device_set_handlers(const usb_device_handlers_t *handlers);
+
+// Configured by a host and not suspended
+bool usb_device_ready(void);
+
+// Queue an input report for the next IN poll; false while the previous
+// one has not been taken or the device is not ready
+bool usb_device_send(uint8_t report_id, const uint8_t *report, uint16_t report_len);
+
+#endif // USB_DEVICE_H
@@ -0,0 +1,147 @@
+// *****************************************************************************
+// Wired transport: player reports over USB HID
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gamepad.h"
+#include "gamepad_config.h"
+#include "gamepad_layout.h"
+#include "latency_stats.h"
+#include "power_governor.h"
+#include "report_mailbox.h"
+#include "rumble.h"
+#include "trace.h"
+#include "usb_device.h"
+#include "usb_hid.h"
+
+static bool active;
+static bool busy;                                  // A report waits for the host's poll
+static bool timed;                                 // and carries the input latency_stats follows
+static uint32_t dirty;                             // Bit per player with a state to send
+static uint8_t next_player;
+static gamepad_report_t pending[GAMEPAD_PLAYERS];
+static gamepad_report_t last_sent[GAMEPAD_PLAYERS];
+static uint32_t has_sent;                          // Bit per player: last_sent is what the host has
+static usb_hid_stats_t stats;
+
+// One report per free endpoint; players take turns
+static void usb_hid_send_next(void)
+{
+    if (busy || !dirty) return;
+    for (int i = 0; i < GAMEPAD_PLAYERS; i++) {
+        uint8_t player = (uint8_t)((next_player + i) % GAMEPAD_PLAYERS);
+        if (!(dirty & (1u << player))) continue;
+
+        uint8_t hid_report[GAMEPAD_REPORT_SIZE];
+        gamepad_input_report::pack(pending[player], hid_report);
+        if (player == 0) {
+            latency_stats_can_send_now();
+        }
+        if (!usb_device_send(GAMEPAD_PLAYER_REPORT_ID(player), hid_report, sizeof(hid_report))) return;
+        timed = player == 0 && latency_stats_sent();
+        TRACE(REPORT_SENT, pending[player].buttons, (uint16_t)pending[player].left_x,
+              (uint16_t)pending[player].left_y, (uint16_t)pending[player].right_x, (uint16_t)pending[player].right_y);
+        dirty &= ~(1u << player);
+        last_sent[player] = pending[player];
+        has_sent |= 1u << player;
+        next_player = (uint8_t)((player + 1) % GAMEPAD_PLAYERS);
+        busy = true;
+        return;
+    }
+}
+
+static void usb_hid_changed(bool ready)
+{
+    if (ready == active) return;
+    active = ready;
+    busy = false;
+    timed = false;
+    dirty = 0;
+    // A host that comes (back) starts from the full state
+    has_sent = 0;
+    if (active) {
+        stats.attached++;
+    } else {
+        stats.detached++;
+        rumble_link_lost(USB_HID_CON_HANDLE);
+    }
+    printf("USB %s\n", active ? "attached: player reports go over USB" : "detached: player reports go over Bluetooth");
+    gamepad_usb_changed(active);
+}
+
+static void usb_hid_sent(void)
+{
+    busy = false;
+    stats.sent++;
+    if (timed) {
+        timed = false;
+        latency_stats_completed();
+    }
+    usb_hid_send_next();
+}
+
+static void usb_hid_output(uint8_t report_id, const uint8_t *report, uint16_t report_len)
+{
+    if (report_id != GAMEPAD_RUMBLE_REPORT_ID) return;
+    rumble_set_report(USB_HID_CON_HANDLE, report, report_len);
+    power_governor_activity();
+}
+
+static const usb_device_handlers_t handlers = {
+    &usb_hid_changed,
+    &usb_hid_sent,
+    &usb_hid_output,
+};
+
+void usb_hid_init(void)
+{
+    active = false;
+    busy = false;
+    timed = false;
+    dirty = 0;
+    has_sent = 0;
+    next_player = 0;
+    memset(&stats, 0, sizeof(stats));
+    usb_device_set_handlers(&handlers);
+    if (usb_device_ready()) {
+        usb_hid_changed(true);
+    }
+}
+
+bool usb_hid_active(void)
+{
+    return active;
+}
+
+void usb_hid_post(uint8_t player, const gamepad_report_t *report)
+{
+    if (!active || player >= GAMEPAD_PLAYERS) return;
+    stats.posted++;
+    uint32_t bit = 1u << player;
+    if ((has_sent & bit) && !(dirty & bit) && gamepad_report_equal(report, &last_sent[player])) return;
+    if (dirty & bit) {
+        stats.coalesced++;
+    }
+    pending[player] = *report;
+    dirty |= bit;
+    usb_hid_send_next();
+}
+
+const usb_hid_stats_t *usb_hid_get_stats(void)
+{
+    return &stats;
+}
+
+void usb_hid_reset_stats(void)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+void usb_hid_dump(void)
+{
+    printf("USB: %s, %lu posted, %lu coalesced, %lu sent, attached %lu times, detached %lu times\n",
+           active ? "active" : "inactive", (unsigned long)stats.posted, (unsigned long)stats.coalesced,
+           (unsigned long)stats.sent, (unsigned long)stats.attached, (unsigned long)stats.detached);
+}
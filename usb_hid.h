@@ -0,0 +1,51 @@
+// *****************************************************************************
+// Wired transport: player reports over USB HID
+//
+// While a USB host has the device configured (usb_device.h), player reports
+// go to it instead of the Bluetooth centrals: the host polls the interrupt
+// endpoint every USB_HID_POLL_INTERVAL_MS instead of once per connection
+// interval. One report is in flight at a time; players that change
+// meanwhile keep only their newest state and go in turn, like the BLE
+// mailboxes.
+//
+// The switch keeps every player's state: when USB comes up the host gets
+// all of them, and the centrals a neutral report, so a host listening on
+// both does not keep a button held over Bluetooth; when it goes away the
+// centrals get the current state again (gamepad.cpp). Output reports
+// written over USB reach rumble.h like the centrals' do, with
+// USB_HID_CON_HANDLE standing in for the connection.
+// *****************************************************************************
+
+#ifndef USB_HID_H
+#define USB_HID_H
+
+#include <stdint.h>
+
+#include "gamepad.h"
+
+// Not a valid LE connection handle (those end at 0x0eff)
+#define USB_HID_CON_HANDLE 0x0fff
+
+typedef struct {
+    uint32_t posted;           // Player states posted while USB was active
+    uint32_t sent;             // Reports the host took
+    uint32_t coalesced;        // Posted state replaced before it was sent
+    uint32_t attached;         // Times USB became the transport
+    uint32_t detached;         // Times it went back to Bluetooth
+} usb_hid_stats_t;
+
+// Register with usb_device.h; picks up a host that is already there
+void usb_hid_init(void);
+
+// USB is the transport for player reports
+bool usb_hid_active(void);
+
+// Newest state of a player; sent when the endpoint is free
+void usb_hid_post(uint8_t player, const gamepad_report_t *report);
+
+const usb_hid_stats_t *usb_hid_get_stats(void);
+void usb_hid_reset_stats(void);
+
+void usb_hid_dump(void);
+
+#endif // USB_HID_H